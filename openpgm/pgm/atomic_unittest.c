@@ -85,6 +85,41 @@ START_TEST (test_int32_add_pass_002)
 }
 END_TEST
 
+/* target:
+ *	void
+ *	pgm_atomic_add64 (
+ *		volatile uint64_t*	atomic,
+ *		const uint64_t		val
+ *	)
+ */
+
+/* carry past 32 bits */
+START_TEST (test_int64_add_pass_001)
+{
+	volatile uint64_t atomic = UINT32_MAX;
+	pgm_atomic_add64 (&atomic, 1);
+	fail_unless ((uint64_t)UINT32_MAX + 1 == atomic, "add failed");
+	pgm_atomic_add64 (&atomic, UINT32_MAX);
+	fail_unless ((uint64_t)UINT32_MAX * 2 + 1 == atomic, "add failed");
+	pgm_atomic_add64 (&atomic, UINT64_MAX - atomic);
+	fail_unless (UINT64_MAX == atomic, "add failed");
+}
+END_TEST
+
+/* target:
+ *	uint64_t
+ *	pgm_atomic_read64 (
+ *		volatile uint64_t*	atomic
+ *	)
+ */
+
+START_TEST (test_int64_get_pass_001)
+{
+	volatile uint64_t atomic = (uint64_t)UINT32_MAX << 16;
+	fail_unless ((uint64_t)UINT32_MAX << 16 == pgm_atomic_read64 (&atomic), "read failed");
+}
+END_TEST
+
 /* target:
  *	uint32_t
  *	pgm_atomic_read32 (
@@ -115,6 +150,45 @@ START_TEST (test_int32_set_pass_001)
 }
 END_TEST
 
+/* target:
+ *	bool
+ *	pgm_atomic_cas_pointer (
+ *		void* volatile*		atomic,
+ *		void*			oldval,
+ *		void*			newval
+ *	)
+ */
+
+START_TEST (test_pointer_cas_pass_001)
+{
+	int a, b;
+	void* volatile atomic = &a;
+	fail_unless (TRUE == pgm_atomic_cas_pointer (&atomic, &a, &b), "cas failed");
+	fail_unless (&b == atomic, "cas failed");
+	fail_unless (FALSE == pgm_atomic_cas_pointer (&atomic, &a, NULL), "cas failed");
+	fail_unless (&b == atomic, "cas failed");
+}
+END_TEST
+
+/* target:
+ *	void*
+ *	pgm_atomic_exchange_pointer (
+ *		void* volatile*		atomic,
+ *		void*			newval
+ *	)
+ */
+
+START_TEST (test_pointer_exchange_pass_001)
+{
+	int a;
+	void* volatile atomic = &a;
+	fail_unless (&a == pgm_atomic_exchange_pointer (&atomic, NULL), "exchange failed");
+	fail_unless (NULL == atomic, "exchange failed");
+	fail_unless (NULL == pgm_atomic_exchange_pointer (&atomic, &a), "exchange failed");
+	fail_unless (&a == atomic, "exchange failed");
+}
+END_TEST
+
 
 static
 Suite*
@@ -132,15 +206,25 @@ make_test_suite (void)
 	suite_add_tcase (s, tc_add);
 	tcase_add_test (tc_add, test_int32_add_pass_001);
 	tcase_add_test (tc_add, test_int32_add_pass_002);
+	tcase_add_test (tc_add, test_int64_add_pass_001);
 
 	TCase* tc_get = tcase_create ("get");
 	suite_add_tcase (s, tc_get);
 	tcase_add_test (tc_get, test_int32_get_pass_001);
+	tcase_add_test (tc_get, test_int64_get_pass_001);
 
 	TCase* tc_set = tcase_create ("set");
 	suite_add_tcase (s, tc_set);
 	tcase_add_test (tc_set, test_int32_set_pass_001);
 
+	TCase* tc_cas = tcase_create ("cas");
+	suite_add_tcase (s, tc_cas);
+	tcase_add_test (tc_cas, test_pointer_cas_pass_001);
+
+	TCase* tc_exchange = tcase_create ("exchange");
+	suite_add_tcase (s, tc_exchange);
+	tcase_add_test (tc_exchange, test_pointer_exchange_pass_001);
+
 	return s;
 }
 
@@ -38,10 +38,17 @@
 static
 void
 __cpuidex (int cpu_info[4], int function_id, int subfunction_id) {
+// preserve the full register, cpuid clears the upper half of %rbx.
   __asm__ volatile (
+#if defined(__x86_64__)
+    "mov %%rbx, %%rdi\n"
+    "cpuid\n"
+    "xchg %%rdi, %%rbx\n"
+#else
     "mov %%ebx, %%edi\n"
     "cpuid\n"
     "xchg %%edi, %%ebx\n"
+#endif
     : "=a"(cpu_info[0]), "=D"(cpu_info[1]), "=c"(cpu_info[2]), "=d"(cpu_info[3])
     : "a"(function_id), "c"(subfunction_id)
   );
@@ -80,6 +87,35 @@ pgm_cpuid (pgm_cpu_t* cpu)
 	if (num_ids >= 7) {
 		__cpuidex (cpu_info7, 0x7, 0x0);
 	}
+	cpu->signature = (uint32_t)cpu_info[0];
+
+// TSC frequency from the crystal clock ratio.  The leaf 0x16 base frequency
+// is only given in MHz and is not used.
+	if (num_ids >= 0x15) {
+		int cpu_info15[4] = {0};
+		__cpuidex (cpu_info15, 0x15, 0x0);
+		if (cpu_info15[0] && cpu_info15[1] && cpu_info15[2]) {
+			cpu->tsc_khz = (uint32_t)(((uint64_t)(uint32_t)cpu_info15[2] * (uint32_t)cpu_info15[1])
+						   / (uint32_t)cpu_info15[0] / 1000);
+		}
+	}
+
+// Extended leaves for the processor brand string and invariant TSC.
+	int cpu_info_ext[4] = {0};
+	__cpuidex (cpu_info_ext, 0x80000000, 0x0);
+	const uint32_t num_ext_ids = (uint32_t)cpu_info_ext[0];
+	if (num_ext_ids >= 0x80000004) {
+		for (unsigned i = 0; i < 3; i++) {
+			int cpu_info_brand[4];
+			__cpuidex (cpu_info_brand, 0x80000002 + i, 0x0);
+			memcpy (cpu->brand + (i * sizeof (cpu_info_brand)), cpu_info_brand, sizeof (cpu_info_brand));
+		}
+		cpu->brand[48] = '\0';
+	}
+	if (num_ext_ids >= 0x80000007) {
+		__cpuidex (cpu_info_ext, 0x80000007, 0x0);
+		cpu->has_invariant_tsc = (cpu_info_ext[3] & 0x00000100) != 0;
+	}
 
 	cpu->has_mmx =   (cpu_info[3] & 0x00800000) != 0;
 	cpu->has_sse =   (cpu_info[3] & 0x02000000) != 0;
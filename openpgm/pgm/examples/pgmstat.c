@@ -0,0 +1,320 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * Display PGM statistics segments published with pgm_shm_init(): sockets,
+ * peers, window edges and rate limit state of every process on the host,
+ * without touching the processes themselves.
+ *
+ * Copyright (c) 2006-2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <locale.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pgm/pgm.h>
+
+
+/* segments followed at once */
+#define MAX_SEGMENTS		16
+
+/* attempts to read a consistent copy before giving up on this refresh */
+#define MAX_RETRIES		100
+
+struct segment {
+	char				name[NAME_MAX + 2];
+	struct pgm_shm_header_t*	snap;		/* current copy */
+	struct pgm_shm_header_t*	last;		/* previous copy for rates */
+	size_t				len;
+};
+
+/* globals */
+
+static const char*	segment_name = NULL;
+static unsigned		refresh_secs = 1;
+static bool		is_oneshot = FALSE;
+static volatile bool	is_terminated = FALSE;
+
+static struct segment	segments[MAX_SEGMENTS];
+static unsigned		segment_count = 0;
+
+static void on_signal (int);
+static void usage (const char*) __attribute__((__noreturn__));
+
+
+static void
+usage (
+	const char*	bin
+	)
+{
+	fprintf (stderr, "Usage: %s [options]\n", bin);
+	fprintf (stderr, "  -n, --name NAME          : Segment name, e.g. " PGM_SHM_PREFIX "1234, default all\n");
+	fprintf (stderr, "  -i, --interval SECONDS   : Refresh interval (1)\n");
+	fprintf (stderr, "  -1, --once               : Display once and exit\n");
+	exit (EXIT_SUCCESS);
+}
+
+static void
+on_signal (
+	PGM_GNUC_UNUSED int	signum
+	)
+{
+	is_terminated = TRUE;
+}
+
+/* copy the segment under its sequence, FALSE if missing, foreign, or never
+ * stable.
+ */
+
+static bool
+read_segment (
+	struct segment*		seg
+	)
+{
+	struct stat st;
+	bool is_read = FALSE;
+
+	const int fd = shm_open (seg->name, O_RDONLY, 0);
+	if (-1 == fd)
+		return FALSE;
+	if (0 != fstat (fd, &st) || (size_t)st.st_size < sizeof (struct pgm_shm_header_t)) {
+		close (fd);
+		return FALSE;
+	}
+	const struct pgm_shm_header_t* header = mmap (NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if (MAP_FAILED == header)
+		return FALSE;
+	if (PGM_SHM_MAGIC != header->magic ||
+	    PGM_SHM_VERSION != header->version ||
+	    (size_t)st.st_size < pgm_shm_size (header->max_socks, header->max_peers))
+		goto out;
+
+	if (seg->len != (size_t)st.st_size) {
+		free (seg->snap);
+		free (seg->last);
+		seg->snap = calloc (1, (size_t)st.st_size);
+		seg->last = NULL;
+		seg->len  = (size_t)st.st_size;
+	} else {
+		struct pgm_shm_header_t* tmp = seg->last;
+		seg->last = seg->snap;
+		seg->snap = tmp ? tmp : calloc (1, seg->len);
+	}
+
+	for (unsigned i = 0; i < MAX_RETRIES; i++) {
+		const uint32_t sequence = header->sequence;
+		if (sequence & 1) {
+			usleep (100);
+			continue;
+		}
+		__sync_synchronize();
+		memcpy (seg->snap, header, seg->len);
+		__sync_synchronize();
+		if (sequence == header->sequence) {
+			is_read = TRUE;
+			break;
+		}
+	}
+out:
+	munmap ((void*)header, (size_t)st.st_size);
+	return is_read;
+}
+
+/* name given or every PGM_SHM_PREFIX entry in /dev/shm */
+
+static void
+find_segments (void)
+{
+	if (NULL != segment_name) {
+		if (0 == segment_count) {
+			snprintf (segments[0].name, sizeof (segments[0].name), "%s", segment_name);
+			segment_count = 1;
+		}
+		return;
+	}
+
+	DIR* dir = opendir ("/dev/shm");
+	if (NULL == dir)
+		return;
+	struct dirent* entry;
+	while (NULL != (entry = readdir (dir)) && segment_count < MAX_SEGMENTS) {
+		char name[NAME_MAX + 2];
+		if (0 != strncmp (entry->d_name, PGM_SHM_PREFIX + 1, strlen (PGM_SHM_PREFIX) - 1))
+			continue;
+		snprintf (name, sizeof (name), "/%s", entry->d_name);
+		bool is_known = FALSE;
+		for (unsigned i = 0; i < segment_count; i++)
+			if (0 == strcmp (segments[i].name, name))
+				is_known = TRUE;
+		if (is_known)
+			continue;
+		memset (&segments[segment_count], 0, sizeof (struct segment));
+		snprintf (segments[segment_count].name, sizeof (segments[segment_count].name), "%s", name);
+		segment_count++;
+	}
+	closedir (dir);
+}
+
+/* per second over the publisher's own clock */
+static double
+rate (
+	const uint64_t		now,
+	const uint64_t		then,
+	const double		secs
+	)
+{
+	return secs > 0.0 ? (double)(now - then) / secs : 0.0;
+}
+
+static void
+print_segment (
+	const struct segment*	seg
+	)
+{
+	const struct pgm_shm_header_t* snap = seg->snap;
+	const struct pgm_shm_header_t* last = seg->last;
+	const struct pgm_shm_sock_t* socks = pgm_shm_socks (snap);
+	const struct pgm_shm_peer_t* peers = pgm_shm_peers (snap);
+	double secs = 0.0;
+	char tsi[PGM_TSISTRLEN];
+
+	if (NULL != last && last->timestamp < snap->timestamp &&
+	    last->sock_count == snap->sock_count)
+		secs = (double)(snap->timestamp - last->timestamp) / 1000000.0;
+
+	printf ("%s  pid %" PRIu32 "  interval %" PRIu32 " ms  sockets %" PRIu32 "  peers %" PRIu32 "\n",
+		seg->name, snap->pid, snap->interval, snap->sock_count, snap->peer_count);
+
+	for (unsigned i = 0; i < snap->sock_count; i++)
+	{
+		const struct pgm_shm_sock_t* s = &socks[i];
+		const struct pgm_shm_sock_t* l = secs > 0.0 ? &pgm_shm_socks (last)[i] : s;
+
+		pgm_tsi_print_r (&s->tsi, tsi, sizeof (tsi));
+		printf ("  %s:%u", tsi, s->dport);
+		if (s->can_send_data) {
+			printf ("  sent %" PRIu64 " msgs %.0f/s %.0f B/s  naks %" PRIu64 "  rdata %" PRIu64 "  txw %" PRIu32 "..%" PRIu32 " %" PRIu64 " B",
+				s->stats.data_msgs_sent,
+				rate (s->stats.data_msgs_sent, l->stats.data_msgs_sent, secs),
+				rate (s->stats.bytes_sent, l->stats.bytes_sent, secs),
+				s->stats.selective_naks_received,
+				s->stats.selective_msgs_retransmitted,
+				s->txw_trail, s->txw_lead, s->txw_bytes);
+			if (s->txw_max_rte > 0)
+				printf ("  rate %" PRId64 "/%" PRId64, s->rate_limit, s->txw_max_rte);
+			if (s->cwnd_size > 0)
+				printf ("  cwnd %" PRIu32 " tokens %" PRIu32 "%s", s->cwnd_size, s->tokens, s->is_congested ? " congested" : "");
+			if (s->is_apdu_eagain)
+				printf ("  blocked");
+		}
+		putchar ('\n');
+
+		for (unsigned j = s->peer_index; j < s->peer_index + s->peer_count; j++)
+		{
+			const struct pgm_shm_peer_t* p = &peers[j];
+			const struct pgm_shm_peer_t* lp = p;
+			if (secs > 0.0) {
+/* match by TSI as peers come and go between updates */
+				const struct pgm_shm_peer_t* last_peers = pgm_shm_peers (last);
+				for (unsigned k = 0; k < last->peer_count; k++)
+					if (pgm_tsi_equal (&last_peers[k].stats.tsi, &p->stats.tsi))
+						lp = &last_peers[k];
+			}
+			pgm_tsi_print_r (&p->stats.tsi, tsi, sizeof (tsi));
+			printf ("    <- %s  recv %" PRIu64 " msgs %.0f/s %.0f B/s  losses %" PRIu32 "  dups %" PRIu64 "  naks %" PRIu64 "  failed %" PRIu64 "  rxw %" PRIu32 "..%" PRIu32 " commit %" PRIu32 " %" PRIu64 " B\n",
+				tsi,
+				p->stats.data_msgs_received,
+				rate (p->stats.data_msgs_received, lp->stats.data_msgs_received, secs),
+				rate (p->stats.bytes_received, lp->stats.bytes_received, secs),
+				p->rxw_losses,
+				p->stats.dup_datas,
+				p->stats.selective_naks_sent,
+				p->stats.naks_failed_ncf_retries_exceeded + p->stats.naks_failed_data_retries_exceeded + p->stats.naks_failed_gen_expired,
+				p->rxw_trail, p->rxw_lead, p->rxw_commit_lead, p->rxw_bytes);
+		}
+	}
+	putchar ('\n');
+}
+
+int
+main (
+	int		argc,
+	char*		argv[]
+	)
+{
+	static const struct option long_options[] = {
+		{ "name",	required_argument,	NULL, 'n' },
+		{ "interval",	required_argument,	NULL, 'i' },
+		{ "once",	no_argument,		NULL, '1' },
+		{ "help",	no_argument,		NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	int c;
+
+	setlocale (LC_ALL, "");
+
+	while ((c = getopt_long (argc, argv, "n:i:1h", long_options, NULL)) != -1)
+	{
+		switch (c) {
+		case 'n':	segment_name = optarg; break;
+		case 'i':	refresh_secs = (unsigned)atoi (optarg); break;
+		case '1':	is_oneshot = TRUE; break;
+		case 'h':
+		case '?': usage (argv[0]);
+		}
+	}
+
+	signal (SIGINT, on_signal);
+	signal (SIGTERM, on_signal);
+
+	do {
+		find_segments ();
+		if (!is_oneshot)
+			printf ("\033[H\033[2J");
+		unsigned shown = 0;
+		for (unsigned i = 0; i < segment_count; i++) {
+			if (!read_segment (&segments[i]))
+				continue;
+			print_segment (&segments[i]);
+			shown++;
+		}
+		if (0 == shown)
+			printf ("No PGM statistics segments found.\n");
+		fflush (stdout);
+		if (is_oneshot || is_terminated)
+			break;
+		sleep (refresh_secs);
+	} while (!is_terminated);
+
+	for (unsigned i = 0; i < segment_count; i++) {
+		free (segments[i].snap);
+		free (segments[i].last);
+	}
+	return EXIT_SUCCESS;
+}
+
+/* eof */
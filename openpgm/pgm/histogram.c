@@ -422,4 +422,111 @@ get_ascii_bucket_range (
 	return result;
 }
 
+/* highest value recorded in a latency bucket.
+ */
+
+PGM_GNUC_INTERNAL
+uint32_t
+pgm_latency_value (
+	const unsigned		i
+	)
+{
+	pgm_assert_cmpuint (i, <, PGM_LATENCY_BUCKETS);
+	if (i < 2 * PGM_LATENCY_SUB_BUCKETS)
+		return i;
+	const unsigned shift = (i >> PGM_LATENCY_SUB_BUCKET_BITS) - 1;
+	const uint64_t lowest = (uint64_t)((i & (PGM_LATENCY_SUB_BUCKETS - 1)) + PGM_LATENCY_SUB_BUCKETS) << shift;
+	return (uint32_t)(lowest + ((uint64_t)1 << shift) - 1);
+}
+
+/* value at or below which percentile of samples fall, bounded by the
+ * recorded extremes, 0 when empty.
+ */
+
+uint32_t
+pgm_latency_percentile (
+	const struct pgm_latency_t*	latency,
+	const double			percentile
+	)
+{
+	pgm_return_val_if_fail (NULL != latency, 0);
+	pgm_return_val_if_fail (percentile >= 0.0 && percentile <= 100.0, 0);
+
+	if (0 == latency->count)
+		return 0;
+	uint64_t rank = (uint64_t)ceil ((percentile / 100.0) * (double)latency->count);
+	if (0 == rank)
+		rank = 1;
+	uint64_t total = 0;
+	for (unsigned i = 0; i < PGM_LATENCY_BUCKETS; i++) {
+		total += latency->counts[ i ];
+		if (total >= rank) {
+			const uint32_t value = pgm_latency_value (i);
+			if (value < latency->min)
+				return latency->min;
+			return value > latency->max ? latency->max : value;
+		}
+	}
+	return latency->max;
+}
+
+PGM_GNUC_INTERNAL
+void
+pgm_latency_merge (
+	struct pgm_latency_t*	    restrict dst,
+	const struct pgm_latency_t* restrict src
+	)
+{
+	pgm_assert (NULL != dst);
+	pgm_assert (NULL != src);
+
+	if (0 == src->count)
+		return;
+	if (0 == dst->count || src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	dst->count += src->count;
+	dst->sum   += src->sum;
+	for (unsigned i = 0; i < PGM_LATENCY_BUCKETS; i++)
+		dst->counts[ i ] += src->counts[ i ];
+}
+
+/* one table row of summary percentiles.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_latency_write_html (
+	const struct pgm_latency_t* restrict latency,
+	const char*		    restrict name,
+	pgm_string_t*		    restrict output
+	)
+{
+	pgm_assert (NULL != latency);
+	pgm_assert (NULL != name);
+	pgm_assert (NULL != output);
+
+	pgm_string_append_printf (output,	"<tr>"
+							"<th>%s</th>"
+							"<td>%" PRIu64 "</td>"
+							"<td>%" PRIu32 "</td>"
+							"<td>%" PRIu64 "</td>"
+							"<td>%" PRIu32 "</td>"
+							"<td>%" PRIu32 "</td>"
+							"<td>%" PRIu32 "</td>"
+							"<td>%" PRIu32 "</td>"
+							"<td>%" PRIu32 "</td>"
+						"</tr>\n",
+					name,
+					latency->count,
+					latency->min,
+					latency->count ? latency->sum / latency->count : 0,
+					pgm_latency_percentile (latency, 50.0),
+					pgm_latency_percentile (latency, 90.0),
+					pgm_latency_percentile (latency, 99.0),
+					pgm_latency_percentile (latency, 99.9),
+					latency->max);
+}
+
 /* eof */
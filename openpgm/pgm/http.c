@@ -128,6 +128,7 @@ static void index_callback (struct http_connection_t*restrict, const char*restri
 static void interfaces_callback (struct http_connection_t*restrict, const char*restrict);
 static void transports_callback (struct http_connection_t*restrict, const char*restrict);
 static void histograms_callback (struct http_connection_t*restrict, const char*restrict);
+static void http_each_latency (const pgm_sock_t*restrict, pgm_string_t*restrict);
 
 static struct {
 	const char*	path;
@@ -137,10 +138,8 @@ static struct {
 	{ "/base.css",		css_callback },
 	{ "/",			index_callback },
 	{ "/interfaces",	interfaces_callback },
-	{ "/transports",	transports_callback }
-#ifdef USE_HISTOGRAMS
-       ,{ "/histograms",	histograms_callback }
-#endif
+	{ "/transports",	transports_callback },
+	{ "/histograms",	histograms_callback }
 };
 
 
@@ -830,9 +829,7 @@ http_create_response (
 						"<a href=\"/\"><span class=\"tab\" id=\"tab%s\">General Information</span></a>"
 						"<a href=\"/interfaces\"><span class=\"tab\" id=\"tab%s\">Interfaces</span></a>"
 						"<a href=\"/transports\"><span class=\"tab\" id=\"tab%s\">Transports</span></a>"
-#ifdef USE_HISTOGRAMS
 						"<a href=\"/histograms\"><span class=\"tab\" id=\"tab%s\">Histograms</span></a>"
-#endif
 						"<div id=\"tabline\"></div>"
 					"</div>"
 					"<div id=\"content\">",
@@ -843,10 +840,8 @@ http_create_response (
 				timestamp,
 				tab == HTTP_TAB_GENERAL_INFORMATION ? "top" : "bottom",
 				tab == HTTP_TAB_INTERFACES ? "top" : "bottom",
-				tab == HTTP_TAB_TRANSPORTS ? "top" : "bottom"
-#ifdef USE_HISTOGRAMS
-			       ,tab == HTTP_TAB_HISTOGRAMS ? "top" : "bottom"
-#endif
+				tab == HTTP_TAB_TRANSPORTS ? "top" : "bottom",
+				tab == HTTP_TAB_HISTOGRAMS ? "top" : "bottom"
 	);
 
 	return response;
@@ -1069,10 +1064,84 @@ histograms_callback (
         )
 {
 	pgm_string_t* response = http_create_response ("Histograms", HTTP_TAB_HISTOGRAMS);
+	if (pgm_sock_list)
+	{
+		pgm_rwlock_reader_lock (&pgm_sock_list_lock);
+		for (pgm_slist_t* list = pgm_sock_list; list; list = list->next)
+			http_each_latency (list->data, response);
+		pgm_rwlock_reader_unlock (&pgm_sock_list_lock);
+	}
 	pgm_histogram_write_html_graph_all (response);
 	http_finalize_response (connection, response);
 }
 
+/* latency percentiles in microseconds of one transport and each of its peers,
+ * peers of single-threaded sockets are only reachable from the owning thread.
+ */
+
+static
+void
+http_each_latency (
+	const pgm_sock_t*	restrict sock,
+	pgm_string_t*		restrict response
+	)
+{
+	static const char* names[PGM_LATENCY_MAX] = {
+		"Source NAK service",
+		"NAK service",
+		"Repair",
+		"Delivery",
+		"FEC reconstruction"
+	};
+	struct pgm_latency_t* latency = pgm_new0 (struct pgm_latency_t, PGM_LATENCY_MAX);
+	char tsi[ PGM_TSISTRLEN ];
+
+	pgm_tsi_print_r (&sock->tsi, tsi, sizeof(tsi));
+	pgm_string_append_printf (response,	"<div class=\"bubbly\">"
+						"\n<table cellspacing=\"0\">"
+						"<tr>"
+							"<th><a href=\"/%s\">%s</a></th>"
+							"<th>Samples</th>"
+							"<th>Min μs</th>"
+							"<th>Mean μs</th>"
+							"<th>p50 μs</th>"
+							"<th>p90 μs</th>"
+							"<th>p99 μs</th>"
+							"<th>p99.9 μs</th>"
+							"<th>Max μs</th>"
+						"</tr>\n",
+				tsi, tsi);
+
+	memcpy (latency, sock->latency, PGM_LATENCY_MAX * sizeof (struct pgm_latency_t));
+	if (!sock->is_single_threaded) {
+		pgm_rwlock_reader_lock (&((pgm_sock_t*)sock)->peers_lock);
+		for (const pgm_list_t* list = sock->peers_list; list; list = list->next) {
+			const pgm_peer_t* peer = list->data;
+			for (unsigned i = 0; i < PGM_LATENCY_MAX; i++)
+				pgm_latency_merge (&latency[i], &peer->window->latency[i]);
+		}
+	}
+	for (unsigned i = 0; i < PGM_LATENCY_MAX; i++)
+		if (PGM_LATENCY_SOURCE_NAK_SVC == i ? sock->can_send_data : sock->can_recv_data)
+			pgm_latency_write_html (&latency[i], names[i], response);
+
+	if (!sock->is_single_threaded) {
+		for (const pgm_list_t* list = sock->peers_list; list; list = list->next) {
+			const pgm_peer_t* peer = list->data;
+			pgm_tsi_print_r (&peer->tsi, tsi, sizeof(tsi));
+			pgm_string_append_printf (response,	"<tr><th colspan=\"9\"><a href=\"/%s\">%s</a></th></tr>\n",
+						tsi, tsi);
+			for (unsigned i = PGM_LATENCY_RECEIVER_NAK_SVC; i < PGM_LATENCY_MAX; i++)
+				pgm_latency_write_html (&peer->window->latency[i], names[i], response);
+		}
+		pgm_rwlock_reader_unlock (&((pgm_sock_t*)sock)->peers_lock);
+	}
+
+	pgm_string_append (response,		"</table>\n"
+						"</div>");
+	pgm_free (latency);
+}
+
 static
 void
 default_callback (
@@ -1290,39 +1359,39 @@ http_tsi_response (
 	pgm_string_append_printf (response,	"\n<h2>Performance information</h2>"
 						"\n<table>"
 						"<tr>"
-							"<th>Data bytes sent</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Data bytes sent</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Data packets sent</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Data packets sent</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
 							"<th>Bytes buffered</th><td>%" GROUP_FORMAT PRIu32 "</td>"
 						"</tr><tr>"
 							"<th>Packets buffered</th><td>%" GROUP_FORMAT PRIu32 "</td>"
 						"</tr><tr>"
-							"<th>Bytes sent</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Bytes sent</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Raw NAKs received</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Raw NAKs received</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Checksum errors</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Checksum errors</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Malformed NAKs</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Malformed NAKs</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Packets discarded</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Packets discarded</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Bytes retransmitted</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Bytes retransmitted</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Packets retransmitted</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Packets retransmitted</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>NAKs received</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NAKs received</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>NAKs ignored</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NAKs ignored</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Transmission rate</th><td>%" GROUP_FORMAT PRIu32 " bps</td>"
+							"<th>Transmission rate</th><td>%" GROUP_FORMAT PRIu64 " bps</td>"
 						"</tr><tr>"
-							"<th>NNAK packets received</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NNAK packets received</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>NNAKs received</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NNAKs received</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Malformed NNAKs</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Malformed NNAKs</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr>"
 						"</table>\n",
 						sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT],
@@ -1564,55 +1633,59 @@ http_receiver_response (
 	pgm_string_append_printf (response,	"\n<h2>Performance information</h2>"
 						"\n<table>"
 						"<tr>"
-							"<th>Data bytes received</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Data bytes received</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Data packets received</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Data packets received</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>NAK failures</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NAK failures</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Bytes received</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Bytes received</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Checksum errors</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Checksum errors</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Malformed SPMs</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Malformed SPMs</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Malformed ODATA</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Malformed ODATA</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Malformed RDATA</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Malformed RDATA</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Malformed NCFs</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Malformed NCFs</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Packets discarded</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Packets discarded</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
 							"<th>Losses</th><td>%" GROUP_FORMAT PRIu32 "</td>"	/* detected missed packets */
+						"</tr><tr>"
+							"<th>Packets spilled</th><td>%" GROUP_FORMAT PRIu32 "</td>"	/* written to overflow log */
 						"</tr><tr>"
 							"<th>Bytes delivered to app</th><td>%" GROUP_FORMAT PRIu32 "</td>"
 						"</tr><tr>"
 							"<th>Packets delivered to app</th><td>%" GROUP_FORMAT PRIu32 "</td>"
 						"</tr><tr>"
-							"<th>Duplicate SPMs</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Duplicate SPMs</th><td>%" GROUP_FORMAT PRIu64 "</td>"
+						"</tr><tr>"
+							"<th>Duplicate ODATA/RDATA</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Duplicate ODATA/RDATA</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NAK packets sent</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>NAK packets sent</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NAKs sent</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>NAKs sent</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NAKs retransmitted</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>NAKs retransmitted</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NAKs failed</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>NAKs failed</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NAKs failed due to RXW advance</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>NAKs failed due to RXW advance</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NAKs failed due to NCF retries</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>NAKs failed due to NCF retries</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NAKs failed due to DATA retries</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>NAKs failed due to DATA retries</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NAKs failed due to deadline</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>NAK failures delivered to app</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NAK failures delivered to app</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>NAKs suppressed</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NAKs suppressed</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
-							"<th>Malformed NAKs</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>Malformed NAKs</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
 							"<th>Outstanding NAKs</th><td>%" GROUP_FORMAT PRIu32 "</td>"
 						"</tr><tr>"
@@ -1620,21 +1693,33 @@ http_receiver_response (
 						"</tr><tr>"
 							"<th>NAK repair min time</th><td>%" GROUP_FORMAT PRIu32 " μs</td>"
 						"</tr><tr>"
-							"<th>NAK repair mean time</th><td>%" GROUP_FORMAT PRIu32 " μs</td>"
+							"<th>NAK repair mean time</th><td>%" GROUP_FORMAT PRIu64 " μs</td>"
 						"</tr><tr>"
 							"<th>NAK repair max time</th><td>%" GROUP_FORMAT PRIu32 " μs</td>"
+						"</tr><tr>"
+							"<th>NAK repair 99th percentile</th><td>%" GROUP_FORMAT PRIu32 " μs</td>"
+						"</tr><tr>"
+							"<th>NAK repair 99.9th percentile</th><td>%" GROUP_FORMAT PRIu32 " μs</td>"
 						"</tr><tr>"
 							"<th>NAK fail min time</th><td>%" GROUP_FORMAT PRIu32 " μs</td>"
 						"</tr><tr>"
-							"<th>NAK fail mean time</th><td>%" GROUP_FORMAT PRIu32 " μs</td>"
+							"<th>NAK fail mean time</th><td>%" GROUP_FORMAT PRIu64 " μs</td>"
 						"</tr><tr>"
 							"<th>NAK fail max time</th><td>%" GROUP_FORMAT PRIu32 " μs</td>"
 						"</tr><tr>"
 							"<th>NAK min retransmit count</th><td>%" GROUP_FORMAT PRIu32 "</td>"
 						"</tr><tr>"
-							"<th>NAK mean retransmit count</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+							"<th>NAK mean retransmit count</th><td>%" GROUP_FORMAT PRIu64 "</td>"
 						"</tr><tr>"
 							"<th>NAK max retransmit count</th><td>%" GROUP_FORMAT PRIu32 "</td>"
+						"</tr><tr>"
+							"<th>Delivery min lag</th><td>%" GROUP_FORMAT PRIu32 " μs</td>"
+						"</tr><tr>"
+							"<th>Delivery mean lag</th><td>%" GROUP_FORMAT PRIu32 " μs</td>"
+						"</tr><tr>"
+							"<th>Delivery max lag</th><td>%" GROUP_FORMAT PRIu32 " μs</td>"
+						"</tr><tr>"
+							"<th>Delivery weight</th><td>%" GROUP_FORMAT PRIu32 "</td>"
 						"</tr>"
 						"</table>\n",
 						peer->cumulative_stats[PGM_PC_RECEIVER_DATA_BYTES_RECEIVED],
@@ -1648,6 +1733,7 @@ http_receiver_response (
 						peer->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_NCFS],
 						peer->cumulative_stats[PGM_PC_RECEIVER_PACKETS_DISCARDED],
 						window->cumulative_losses,
+						window->cumulative_spilled,
 						window->bytes_delivered,
 						window->msgs_delivered,
 						peer->cumulative_stats[PGM_PC_RECEIVER_DUP_SPMS],
@@ -1659,20 +1745,27 @@ http_receiver_response (
 						peer->cumulative_stats[PGM_PC_RECEIVER_NAKS_FAILED_RXW_ADVANCED],
 						peer->cumulative_stats[PGM_PC_RECEIVER_NAKS_FAILED_NCF_RETRIES_EXCEEDED],
 						peer->cumulative_stats[PGM_PC_RECEIVER_NAKS_FAILED_DATA_RETRIES_EXCEEDED],
+						peer->cumulative_stats[PGM_PC_RECEIVER_NAKS_FAILED_GEN_EXPIRED],
 						peer->cumulative_stats[PGM_PC_RECEIVER_NAK_FAILURES_DELIVERED],
 						peer->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAKS_SUPPRESSED],
 						peer->cumulative_stats[PGM_PC_RECEIVER_NAK_ERRORS],
 						outstanding_naks,
 						last_activity,
 						window->min_fill_time,
-						peer->cumulative_stats[PGM_PC_RECEIVER_NAK_SVC_TIME_MEAN],
+						window->latency[PGM_LATENCY_RECEIVER_REPAIR].count ? window->latency[PGM_LATENCY_RECEIVER_REPAIR].sum / window->latency[PGM_LATENCY_RECEIVER_REPAIR].count : 0,
 						window->max_fill_time,
+						pgm_latency_percentile (&window->latency[PGM_LATENCY_RECEIVER_REPAIR], 99.0),
+						pgm_latency_percentile (&window->latency[PGM_LATENCY_RECEIVER_REPAIR], 99.9),
 						peer->min_fail_time,
 						peer->cumulative_stats[PGM_PC_RECEIVER_NAK_FAIL_TIME_MEAN],
 						peer->max_fail_time,
 						window->min_nak_transmit_count,
 						peer->cumulative_stats[PGM_PC_RECEIVER_TRANSMIT_MEAN],
-						window->max_nak_transmit_count);
+						window->max_nak_transmit_count,
+						peer->min_delivery_lag,
+						peer->delivery_lag_count ? (uint32_t)(peer->delivery_lag_sum / peer->delivery_lag_count) : 0,
+						peer->max_delivery_lag,
+						peer->weight);
 	http_finalize_response (connection, response);
 	return 0;
 }
@@ -45,6 +45,10 @@ struct pgm_cpu_t {
 	bool		has_sse42;
 	bool		has_avx;
 	bool		has_avx2;
+	bool		has_invariant_tsc;
+	uint32_t	signature;		/* family, model, and stepping */
+	uint32_t	tsc_khz;		/* zero if not enumerated */
+	char		brand[49];
 };
 
 PGM_GNUC_INTERNAL void pgm_cpuid (pgm_cpu_t*);
@@ -31,6 +31,7 @@
 
 #include <pgm/types.h>
 #include <pgm/time.h>
+#include <pgm/socket.h>
 #include <impl/slist.h>
 #include <impl/string.h>
 
@@ -115,6 +116,51 @@ void pgm_histogram_init (pgm_histogram_t*);
 void pgm_histogram_add (pgm_histogram_t*, int);
 void pgm_histogram_write_html_graph_all (pgm_string_t*);
 
+/* latency histograms are always compiled in, a sample costs a bit scan and
+ * three increments.
+ */
+
+static inline unsigned pgm_latency_index (const uint32_t) PGM_GNUC_CONST;
+
+static inline
+unsigned
+pgm_latency_index (
+	const uint32_t		value
+	)
+{
+	if (value < 2 * PGM_LATENCY_SUB_BUCKETS)
+		return value;
+#if defined( __GNUC__ ) || defined( __clang__ )
+	const unsigned msb = 31 - __builtin_clz (value);
+#else
+	unsigned msb = 0;
+	for (uint32_t v = value >> 1; v; v >>= 1)
+		msb++;
+#endif
+	const unsigned shift = msb - PGM_LATENCY_SUB_BUCKET_BITS;
+	return ((shift + 1) << PGM_LATENCY_SUB_BUCKET_BITS) + (value >> shift) - PGM_LATENCY_SUB_BUCKETS;
+}
+
+static inline
+void
+pgm_latency_add (
+	struct pgm_latency_t*const	latency,
+	const pgm_time_t		sample		/* microseconds */
+	)
+{
+	const uint32_t value = sample > UINT32_MAX ? UINT32_MAX : (uint32_t)sample;
+	latency->counts[ pgm_latency_index (value) ]++;
+	if (0 == latency->count++ || value < latency->min)
+		latency->min = value;
+	if (value > latency->max)
+		latency->max = value;
+	latency->sum += value;
+}
+
+PGM_GNUC_INTERNAL uint32_t pgm_latency_value (const unsigned) PGM_GNUC_CONST;
+PGM_GNUC_INTERNAL void pgm_latency_merge (struct pgm_latency_t*restrict, const struct pgm_latency_t*restrict);
+PGM_GNUC_INTERNAL void pgm_latency_write_html (const struct pgm_latency_t*restrict, const char*restrict, pgm_string_t*restrict);
+
 static inline
 void
 pgm_histogram_add_time (
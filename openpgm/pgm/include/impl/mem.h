@@ -31,6 +31,8 @@ PGM_BEGIN_DECLS
 
 PGM_GNUC_INTERNAL void pgm_mem_init (void);
 PGM_GNUC_INTERNAL void pgm_mem_shutdown (void);
+PGM_GNUC_INTERNAL void* pgm_malloc0_aligned (const size_t, const size_t) PGM_GNUC_MALLOC PGM_GNUC_ALLOC_SIZE(1);
+PGM_GNUC_INTERNAL void pgm_free_aligned (void*);
 
 PGM_END_DECLS
 
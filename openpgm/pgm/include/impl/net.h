@@ -34,6 +34,12 @@ PGM_BEGIN_DECLS
 
 PGM_GNUC_INTERNAL ssize_t pgm_sendto_hops (pgm_sock_t*restrict, bool, pgm_rate_t*restrict, bool, int, const void*restrict, size_t, const struct sockaddr*restrict, socklen_t);
 PGM_GNUC_INTERNAL int pgm_set_nonblocking (SOCKET fd[2]);
+PGM_GNUC_INTERNAL ssize_t pgm_sendto_skbv (pgm_sock_t*restrict, bool, pgm_rate_t*restrict, bool, struct pgm_sk_buff_t*const*restrict, unsigned, const struct sockaddr*restrict, socklen_t);
+#ifdef HAVE_MSG_ZEROCOPY
+PGM_GNUC_INTERNAL bool pgm_zerocopy_create (pgm_sock_t*const) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL void pgm_zerocopy_destroy (pgm_sock_t*const);
+PGM_GNUC_INTERNAL unsigned pgm_zerocopy_reap (pgm_sock_t*const);
+#endif
 
 static inline
 ssize_t
@@ -64,7 +64,7 @@ enum {
 	PGM_PC_RECEIVER_NAKS_FAILED_RXW_ADVANCED,
 	PGM_PC_RECEIVER_NAKS_FAILED_NCF_RETRIES_EXCEEDED,
 	PGM_PC_RECEIVER_NAKS_FAILED_DATA_RETRIES_EXCEEDED,
-/*	PGM_PC_RECEIVER_NAKS_FAILED_GEN_EXPIRED */
+	PGM_PC_RECEIVER_NAKS_FAILED_GEN_EXPIRED,
 	PGM_PC_RECEIVER_NAK_FAILURES_DELIVERED,
 	PGM_PC_RECEIVER_SELECTIVE_NAKS_SUPPRESSED,
 	PGM_PC_RECEIVER_NAK_ERRORS,
@@ -118,11 +118,18 @@ struct pgm_peer_t {
 	unsigned			last_commit;
 	uint32_t			lost_count;
 	uint32_t			last_cumulative_losses;
-	volatile uint32_t		cumulative_stats[PGM_PC_RECEIVER_MAX];
-	uint32_t			snap_stats[PGM_PC_RECEIVER_MAX];
+	volatile uint64_t		cumulative_stats[PGM_PC_RECEIVER_MAX];
+	uint64_t			snap_stats[PGM_PC_RECEIVER_MAX];
 
 	uint32_t			min_fail_time;
 	uint32_t			max_fail_time;
+
+	uint32_t			weight;			/* delivery quantum multiplier */
+	unsigned			deficit;		/* messages remaining in round */
+	uint32_t			min_delivery_lag;	/* arrival to application */
+	uint32_t			max_delivery_lag;
+	uint64_t			delivery_lag_sum;
+	uint32_t			delivery_lag_count;
 };
 
 PGM_GNUC_INTERNAL pgm_peer_t* pgm_new_peer (pgm_sock_t*const restrict, const pgm_tsi_t*const restrict, const struct sockaddr*const restrict, const socklen_t, const struct sockaddr*const restrict, const socklen_t, const pgm_time_t);
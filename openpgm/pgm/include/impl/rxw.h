@@ -27,6 +27,8 @@
 
 typedef struct pgm_rxw_state_t pgm_rxw_state_t;
 typedef struct pgm_rxw_t pgm_rxw_t;
+typedef struct pgm_rxw_reclaim_t pgm_rxw_reclaim_t;
+typedef struct pgm_rxw_spill_t pgm_rxw_spill_t;
 
 #include <impl/framework.h>
 
@@ -61,6 +63,8 @@ enum
 /* must be smaller than PGM skbuff control buffer */
 struct pgm_rxw_state_t {
 	pgm_time_t	timer_expiry;
+	pgm_time_t	nak_tstamp;		/* first NAK sent */
+	struct pgm_sk_buff_t* apdu_skb;		/* contiguous APDU, one reference */
         int		pkt_state;
 
 	uint8_t		nak_transmit_count;	/* 8-bit for size constraints */
@@ -69,10 +73,35 @@ struct pgm_rxw_state_t {
 
 /* only valid on tg_sqn::pkt_sqn = 0 */
 	unsigned	is_contiguous:1;	/* transmission group */
+	unsigned	is_delivered:1;		/* read ahead of commit lead */
+};
+
+/* skbs removed from windows awaiting release, pushed by the receive thread
+ * and taken entire by any thread.
+ */
+struct pgm_rxw_reclaim_t {
+	struct pgm_sk_buff_t* volatile	head;		/* lock-free stack */
+	uint32_t			pushed;		/* receive thread only */
+	volatile uint32_t		freed;		/* atomic */
+};
+
+/* overflow log of complete APDUs taken from the commit lead, memory-mapped
+ * from an unlinked temporary file and read back before the window.
+ */
+struct pgm_rxw_spill_t {
+	int			fd;
+	char*			base;			/* mapping of file */
+	size_t			capacity;		/* in bytes */
+	size_t			head;			/* next record to read */
+	size_t			tail;			/* next record to write */
 };
 
 struct pgm_rxw_t {
 	const pgm_tsi_t*	tsi;
+	pgm_rxw_reclaim_t*	reclaim;		/* deferred release, or NULL */
+	pgm_rxw_spill_t*	spill;			/* overflow log, or NULL */
+	size_t			spill_threshold;	/* in bytes, zero to disable */
+	pgm_queue_t		spill_commit_queue;	/* read from log, freed on commit */
 
         pgm_queue_t		ack_backoff_queue;
         pgm_queue_t		nak_backoff_queue;
@@ -83,15 +112,30 @@ struct pgm_rxw_t {
 	uint32_t		fragment_count;		/* incomplete apdu */
 	uint32_t		parity_count;		/* parity for repairs */
 	uint32_t		committed_count;	/* but still in window */
+	volatile uint32_t	lease_count;		/* held by application, atomic */
 
         uint16_t		max_tpdu;               /* maximum packet size */
         uint32_t		lead, trail;
         uint32_t		rxw_trail, rxw_trail_init;
 	uint32_t		commit_lead;
+	uint32_t		missing_trail;		/* no sequence before is waiting on recovery */
         unsigned		is_constrained:1;
         unsigned		is_defined:1;
 	unsigned		has_event:1;		/* edge triggered */
 	unsigned		is_fec_available:1;
+	unsigned		is_unordered:1;		/* deliver in arrival order */
+	unsigned		is_reassemble:1;	/* contiguous APDUs */
+	unsigned		is_apdu_scan_valid:1;
+	uint32_t		unordered_lead;		/* next sequence to read ahead */
+	uint32_t		max_apdu;		/* in bytes */
+	uint32_t		max_fragments;		/* TPDUs per APDU */
+	size_t			apdu_remaining;		/* bytes of APDU at commit lead not yet read */
+	uint32_t		apdu_remaining_first;	/* first sequence of that APDU */
+/* completion scan of one APDU, resumed on the next check */
+	uint32_t		apdu_scan_first;
+	uint32_t		apdu_scan_next;		/* first sequence not counted */
+	uint32_t		apdu_scan_tpdus;
+	size_t			apdu_scan_size;
 	pgm_rs_t		rs;
 	uint32_t		tg_size;		/* transmission group size for parity recovery */
 	uint8_t			tg_sqn_shift;
@@ -106,8 +150,10 @@ struct pgm_rxw_t {
 	uint32_t		min_nak_transmit_count;
 	uint32_t		max_nak_transmit_count;
 	uint32_t		cumulative_losses;
+	uint32_t		cumulative_spilled;	/* TPDUs */
 	uint32_t		bytes_delivered;
 	uint32_t		msgs_delivered;
+	struct pgm_latency_t	latency[PGM_LATENCY_MAX];
 
 	size_t			size;			/* in bytes */
 	unsigned		alloc;			/* in pkts */
@@ -123,6 +169,8 @@ PGM_GNUC_INTERNAL void pgm_rxw_add_ack (pgm_rxw_t*const restrict, struct pgm_sk_
 PGM_GNUC_INTERNAL void pgm_rxw_remove_ack (pgm_rxw_t*const restrict, struct pgm_sk_buff_t*const restrict);
 PGM_GNUC_INTERNAL void pgm_rxw_remove_commit (pgm_rxw_t*const);
 PGM_GNUC_INTERNAL ssize_t pgm_rxw_readv (pgm_rxw_t*const restrict, struct pgm_msgv_t** restrict, const unsigned) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL void pgm_rxw_lease (pgm_rxw_t*const restrict, const struct pgm_msgv_t* restrict, const struct pgm_msgv_t*const restrict);
+PGM_GNUC_INTERNAL void pgm_rxw_release_lease (pgm_rxw_t*const, const unsigned);
 PGM_GNUC_INTERNAL unsigned pgm_rxw_remove_trail (pgm_rxw_t*const) PGM_GNUC_WARN_UNUSED_RESULT;
 PGM_GNUC_INTERNAL unsigned pgm_rxw_update (pgm_rxw_t*const, const uint32_t, const uint32_t, const pgm_time_t, const pgm_time_t) PGM_GNUC_WARN_UNUSED_RESULT;
 PGM_GNUC_INTERNAL void pgm_rxw_update_fec (pgm_rxw_t*const, const uint8_t);
@@ -130,6 +178,9 @@ PGM_GNUC_INTERNAL int pgm_rxw_confirm (pgm_rxw_t*const, const uint32_t, const pg
 PGM_GNUC_INTERNAL void pgm_rxw_lost (pgm_rxw_t*const, const uint32_t);
 PGM_GNUC_INTERNAL void pgm_rxw_state (pgm_rxw_t*const restrict, struct pgm_sk_buff_t*const restrict, const int);
 PGM_GNUC_INTERNAL struct pgm_sk_buff_t* pgm_rxw_peek (pgm_rxw_t*const, const uint32_t) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL struct pgm_sk_buff_t* pgm_rxw_first_missing (pgm_rxw_t*const, uint32_t) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL unsigned pgm_rxw_reclaim (pgm_rxw_reclaim_t*const);
+PGM_GNUC_INTERNAL unsigned pgm_rxw_spill (pgm_rxw_t*const);
 PGM_GNUC_INTERNAL const char* pgm_pkt_state_string (const int) PGM_GNUC_WARN_UNUSED_RESULT;
 PGM_GNUC_INTERNAL const char* pgm_rxw_returns_string (const int) PGM_GNUC_WARN_UNUSED_RESULT;
 PGM_GNUC_INTERNAL void pgm_rxw_dump (const pgm_rxw_t*const);
@@ -142,6 +193,7 @@ static inline bool pgm_rxw_is_empty (const pgm_rxw_t*const) PGM_GNUC_WARN_UNUSED
 static inline bool pgm_rxw_is_full (const pgm_rxw_t*const) PGM_GNUC_WARN_UNUSED_RESULT;
 static inline uint32_t pgm_rxw_lead (const pgm_rxw_t*const) PGM_GNUC_WARN_UNUSED_RESULT;
 static inline uint32_t pgm_rxw_next_lead (const pgm_rxw_t*const) PGM_GNUC_WARN_UNUSED_RESULT;
+static inline uint32_t pgm_rxw_reclaim_backlog (const pgm_rxw_reclaim_t*const) PGM_GNUC_WARN_UNUSED_RESULT;
 
 static inline
 unsigned
@@ -213,6 +265,19 @@ pgm_rxw_next_lead (
 	return (uint32_t)(pgm_rxw_lead (window) + 1);
 }
 
+/* skbs pushed and not yet released, read by the receive thread.
+ */
+
+static inline
+uint32_t
+pgm_rxw_reclaim_backlog (
+	const pgm_rxw_reclaim_t* const reclaim
+	)
+{
+	pgm_assert (NULL != reclaim);
+	return reclaim->pushed - pgm_atomic_read32 (&reclaim->freed);
+}
+
 PGM_END_DECLS
 
 #endif /* __PGM_IMPL_RXW_H__ */
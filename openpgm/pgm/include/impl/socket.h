@@ -29,6 +29,7 @@ struct pgm_sock_t;
 
 #include <impl/framework.h>
 #include <impl/txw.h>
+#include <impl/rxw.h>
 #include <impl/source.h>
 
 PGM_BEGIN_DECLS
@@ -37,7 +38,26 @@ PGM_BEGIN_DECLS
 #	define IP_MAX_MEMBERSHIPS	20
 #endif
 
+/* kernel UDP_MAX_SEGMENTS, also bounds datagrams coalesced by UDP_GRO */
+#define PGM_UDP_MAX_SEGMENTS		64
+
+/* separate state written by the sending and receiving threads */
+#define PGM_CACHELINE_SIZE		64
+#if defined(__GNUC__) || defined(__SUNPRO_C)
+#	define PGM_CACHELINE_ALIGNED_MEMBER	__attribute__((__aligned__(PGM_CACHELINE_SIZE)))
+#elif defined(_MSC_VER)
+#	define PGM_CACHELINE_ALIGNED_MEMBER	__declspec(align(PGM_CACHELINE_SIZE))
+#else
+#	define PGM_CACHELINE_ALIGNED_MEMBER
+#endif
+
+/* grouped by writer: configuration fixed at bind, state shared by both
+ * paths, the sender, the receiver, and counters.  each group after the first
+ * starts a new cache line so that a sending thread and a receiving thread do
+ * not false share.
+ */
 struct pgm_sock_t {
+/* configuration, read-mostly after bind */
 	sa_family_t			family;				/* communications domain */
 	int				socket_type;
 	int				protocol;
@@ -45,26 +65,29 @@ struct pgm_sock_t {
 	in_port_t			dport;
 	in_port_t			udp_encap_ucast_port;
 	in_port_t			udp_encap_mcast_port;
+	bool				use_udp_gso;			/* UDP segmentation offload */
+	bool				use_udp_gro;			/* UDP receive offload */
+	bool				use_kernel_tstamp;		/* SO_TIMESTAMPNS arrival time */
+	unsigned			udp_gso_segments;		/* TPDUs per super-buffer */
+	unsigned			tx_batch_size;			/* TPDUs per sendmmsg() */
+	size_t				zerocopy_threshold;		/* minimum MSG_ZEROCOPY send */
+	struct pgm_zerocopy_t* restrict	zerocopy;
 	uint32_t			rand_node_id;			/* node identifier */
 
-	pgm_rwlock_t			lock;				/* running / destroyed */
-	pgm_mutex_t			receiver_mutex;			/* receiver API */
-	pgm_mutex_t			source_mutex;			/* source API */
-	pgm_spinlock_t			txw_spinlock;			/* transmit window */
-	pgm_mutex_t			send_mutex;			/* non-router alert socket */
-	pgm_mutex_t			timer_mutex;			/* next timer expiration */
-
 	bool				is_bound;
 	bool				is_connected;
 	bool				is_destroyed;
-	bool	            		is_reset;
 	bool				is_abort_on_reset;
 
 	bool				can_send_data;			/* and SPMs */
 	bool				can_send_nak;			/* muted receiver */
 	bool				can_recv_data;			/* send-only */
 	bool				is_edge_triggered_recv;
+	bool				use_recv_lease;			/* application releases msgv */
+	bool				use_unordered_recv;		/* arrival order delivery */
+	bool				use_recv_reassemble;		/* contiguous APDUs */
 	bool				is_nonblocking;
+	bool				is_single_threaded;		/* locks and skb atomics elided */
 
 	struct group_source_req		send_gsr;			/* multicast */
 	struct sockaddr_storage		send_addr;			/* unicast nla */
@@ -75,6 +98,7 @@ struct pgm_sock_t {
 	SOCKET				recv_sock;
 
 	size_t				max_apdu;
+	uint32_t			large_apdu;			/* configured APDU limit */
 	uint16_t			max_tpdu;
 	uint16_t			max_tsdu;		    /* excluding optional var_pktlen word */
 	uint16_t			max_tsdu_fragment;
@@ -82,52 +106,76 @@ struct pgm_sock_t {
 	bool				use_multicast_loop;    	    /* and reuseaddr for UDP encapsulation */
 	unsigned			hops;
 	unsigned			txw_sqns, txw_secs;
+	unsigned			txw_history_sqns;	    /* repair history beyond window */
+	unsigned			late_join;		    /* OPT_JOIN sequences */
 	unsigned			rxw_sqns, rxw_secs;
 	ssize_t				txw_max_rte, rxw_max_rte;
 	ssize_t				odata_max_rte;
 	ssize_t				rdata_max_rte;
 	size_t				sndbuf, rcvbuf;		    /* setsockopt (SO_SNDBUF/SO_RCVBUF) */
 
-	pgm_txw_t* restrict    		window;
-	pgm_rate_t			rate_control;
-	pgm_rate_t			odata_rate_control;
-	pgm_rate_t			rdata_rate_control;
 	pgm_time_t			adv_ivl;		/* advancing with data */
 	unsigned			adv_mode;		/* 0 = time, 1 = data */
 	bool				is_controlled_spm;
 	bool				is_controlled_odata;
 	bool				is_controlled_rdata;
-
 	bool				use_cr;			/* congestion reports */
 	bool				use_pgmcc;		/* congestion control */
-	bool				is_pending_crqst;
 	unsigned			ack_c;			/* constant C */
 	unsigned			ack_c_p;		/* constant Cᵨ */
-	uint32_t			ssthresh;		/* slow-start threshold */
-	uint32_t			tokens;
-	uint32_t			cwnd_size;		/* congestion window size */
-	uint32_t			ack_rx_max;
-	uint32_t			ack_bitmap;
-	uint32_t			acks_after_loss;
-	uint32_t			suspended_sqn;
-	bool				is_congested;
-	pgm_time_t			ack_expiry;
 	pgm_time_t			ack_expiry_ivl;
-	pgm_time_t			next_crqst;
 	pgm_time_t			crqst_ivl;
 	pgm_time_t			ack_bo_ivl;
-	struct sockaddr_storage		acker_nla;
-	uint64_t			acker_loss;
 
-	pgm_notify_t			ack_notify;
-	pgm_notify_t			rdata_notify;
+	unsigned			spm_ambient_interval;	    /* microseconds */
+	unsigned* restrict		spm_heartbeat_interval;     /* zero terminated, zero lead-pad */
+	unsigned			spm_heartbeat_len;
+	unsigned			peer_expiry;		    /* from absence of SPMs */
+	unsigned			spmr_expiry;		    /* waiting for peer SPMRs */
+	unsigned			nak_data_retries, nak_ncf_retries;
+	pgm_time_t			nak_bo_ivl, nak_rpt_ivl, nak_rdata_ivl;
+	pgm_time_t			recv_deadline;		    /* cancel recovery after */
 
-	pgm_hash_t			last_hash_key;
-	void* restrict			last_hash_value;
-	unsigned			last_commit;
+	bool				use_proactive_parity;
+	bool				use_ondemand_parity;
+	bool				use_var_pktlen;
+	uint8_t				rs_n;
+	uint8_t				rs_k;
+	uint8_t				rs_proactive_h;		    /* 0 <= proactive-h <= ( n - k ) */
+	uint8_t				tg_sqn_shift;
+	unsigned			rx_batch_size;		    /* datagrams per recvmmsg() */
+	unsigned			recv_quantum;		    /* messages per peer per round */
+	pgm_slist_t*     restrict	peer_weights;		    /* struct pgm_peerweight_t */
+	unsigned			reclaim_max;		    /* backlog released in line */
+	size_t				spill_threshold;	    /* window bytes before overflow log */
+	bool				use_event_sock;
+	SOCKET				event_sock;		    /* epoll set of sockets, channels and timer */
+	int				event_timer;		    /* timerfd */
+	int				rate_timer;		    /* timerfd, readable at send_expiry */
+
+/* shared by both paths: API entry and timers */
+	PGM_CACHELINE_ALIGNED_MEMBER
+	pgm_rwlock_t			lock;				/* running / destroyed */
+	pgm_mutex_t			timer_mutex;			/* next timer expiration */
+	pgm_time_t			next_poll;
+	pgm_time_t			event_expiry;		    /* armed timer expiration */
+	pgm_time_t			rate_expiry;		    /* blocked send admitted */
+	unsigned			spm_heartbeat_state;	    /* indexof spm_heartbeat_interval */
+	pgm_time_t			next_heartbeat_spm, next_ambient_spm;
+	pgm_mutex_t			send_mutex;			/* non-router alert socket */
+	pgm_spinlock_t			txw_spinlock;			/* transmit window */
+
+/* sender */
+	PGM_CACHELINE_ALIGNED_MEMBER
+	pgm_mutex_t			source_mutex;			/* source API */
+	pgm_txw_t* restrict    		window;
+	pgm_rate_t			rate_control;
+	pgm_rate_t			odata_rate_control;
 	size_t				blocklen;		    /* length of buffer blocked */
 	bool				is_apdu_eagain;		    /* writer-lock on window_lock exists as send would block */
 	bool				is_spm_eagain;		    /* writer-lock in receiver */
+	pgm_time_t			send_expiry;		    /* rate limited send admitted */
+	uint32_t			spm_sqn;
 
 	struct {
 		size_t			    	data_pkt_offset;
@@ -140,41 +188,53 @@ struct pgm_sock_t {
 		unsigned			vector_index;
 		size_t				vector_offset;
 		bool				is_rate_limited;
+		uint32_t			gso_first_sqn;	/* first TPDU of pending super-buffer */
+		unsigned			gso_count;
+		struct pgm_skb_ref_t*		ref;		/* application payload */
 	} pkt_dontwait_state;
 
-	uint32_t			spm_sqn;
-	unsigned			spm_ambient_interval;	    /* microseconds */
-	unsigned* restrict		spm_heartbeat_interval;     /* zero terminated, zero lead-pad */
-	unsigned			spm_heartbeat_state;	    /* indexof spm_heartbeat_interval */
-	unsigned			spm_heartbeat_len;
-	unsigned			peer_expiry;		    /* from absence of SPMs */
-	unsigned			spmr_expiry;		    /* waiting for peer SPMRs */
-
-	pgm_rand_t			rand_;			    /* for calculating nak_rb_ivl from nak_bo_ivl */
-	unsigned			nak_data_retries, nak_ncf_retries;
-	pgm_time_t			nak_bo_ivl, nak_rpt_ivl, nak_rdata_ivl;
-	pgm_time_t			next_heartbeat_spm, next_ambient_spm;
+/* PGMCC, tokens consumed by the sender and returned by ACKs */
+	bool				is_pending_crqst;
+	uint32_t			ssthresh;		/* slow-start threshold */
+	uint32_t			tokens;
+	uint32_t			cwnd_size;		/* congestion window size */
+	uint32_t			ack_rx_max;
+	uint32_t			ack_bitmap;
+	uint32_t			acks_after_loss;
+	uint32_t			suspended_sqn;
+	bool				is_congested;
+	pgm_time_t			ack_expiry;
+	pgm_time_t			next_crqst;
+	struct sockaddr_storage		acker_nla;
+	uint64_t			acker_loss;
+	pgm_notify_t			ack_notify;
 
-	bool				use_proactive_parity;
-	bool				use_ondemand_parity;
-	bool				use_var_pktlen;
-	uint8_t				rs_n;
-	uint8_t				rs_k;
-	uint8_t				rs_proactive_h;		    /* 0 <= proactive-h <= ( n - k ) */
-	uint8_t				tg_sqn_shift;
+/* receiver, including repairs sent on NAKs */
+	PGM_CACHELINE_ALIGNED_MEMBER
+	pgm_mutex_t			receiver_mutex;			/* receiver API */
+	bool	            		is_reset;
+	bool				is_pending_read;
 	struct pgm_sk_buff_t* restrict	rx_buffer;
-
+	struct pgm_rx_batch_t* restrict	rx_batch;
+	pgm_hash_t			last_hash_key;
+	void* restrict			last_hash_value;
+	unsigned			last_commit;
+	pgm_rand_t			rand_;			    /* for calculating nak_rb_ivl from nak_bo_ivl */
 	pgm_rwlock_t			peers_lock;
 	pgm_hashtable_t* restrict	peers_hashtable;	    /* fast lookup */
 	pgm_list_t*      restrict	peers_list;		    /* easy iteration */
 	pgm_slist_t*     restrict	peers_pending;		    /* rxw: have or lost data */
+	pgm_rxw_reclaim_t		reclaim;		    /* skbs pending release */
 	pgm_notify_t			pending_notify;		    /* timer to rx */
-	bool				is_pending_read;
-	pgm_time_t			next_poll;
+	pgm_rate_t			rdata_rate_control;
+	pgm_notify_t			rdata_notify;
 
-	uint32_t			cumulative_stats[PGM_PC_SOURCE_MAX];
-	uint32_t			snap_stats[PGM_PC_SOURCE_MAX];
+/* counters, updated per packet */
+	PGM_CACHELINE_ALIGNED_MEMBER
+	uint64_t			cumulative_stats[PGM_PC_SOURCE_MAX];
+	uint64_t			snap_stats[PGM_PC_SOURCE_MAX];
 	pgm_time_t			snap_time;
+	struct pgm_latency_t		latency[PGM_LATENCY_MAX];	/* source and expired peers */
 };
 
 
@@ -183,6 +243,133 @@ extern pgm_rwlock_t pgm_sock_list_lock;
 extern pgm_slist_t* pgm_sock_list;
 
 size_t pgm_pkt_offset (bool, sa_family_t);
+PGM_GNUC_INTERNAL void pgm_sock_copy_stats (const pgm_sock_t*const restrict, struct pgm_stats_t*const restrict);
+PGM_GNUC_INTERNAL void pgm_peer_copy_stats (const struct pgm_peer_t*const restrict, struct pgm_peer_stats_t*const restrict);
+
+/* counters with a single writer are read without locks by PGM_STATS and the
+ * shared memory publisher, a plain 64-bit add may tear on 32-bit hosts.
+ */
+
+static inline
+void
+pgm_stats_add (
+	volatile uint64_t* const counter,
+	const uint64_t		 val
+	)
+{
+#if defined( __x86_64__ ) || defined( __amd64 ) || defined( _M_X64 ) || defined( __LP64__ ) || defined( _LP64 )
+	*counter += val;
+#else
+	pgm_atomic_add64 (counter, val);
+#endif
+}
+
+static inline
+void
+pgm_stats_inc (
+	volatile uint64_t* const counter
+	)
+{
+	pgm_stats_add (counter, 1);
+}
+
+/* socket lock wrappers, no-ops on a PGM_SINGLE_THREADED socket which is only
+ * used by one thread from bind to close.
+ */
+
+static inline
+bool
+pgm_sock_reader_trylock (
+	pgm_sock_t*   const sock,
+	pgm_rwlock_t* const rwlock
+	)
+{
+	if (sock->is_single_threaded)
+		return TRUE;
+	return pgm_rwlock_reader_trylock (rwlock);
+}
+
+static inline
+void
+pgm_sock_reader_lock (
+	pgm_sock_t*   const sock,
+	pgm_rwlock_t* const rwlock
+	)
+{
+	if (!sock->is_single_threaded)
+		pgm_rwlock_reader_lock (rwlock);
+}
+
+static inline
+void
+pgm_sock_reader_unlock (
+	pgm_sock_t*   const sock,
+	pgm_rwlock_t* const rwlock
+	)
+{
+	if (!sock->is_single_threaded)
+		pgm_rwlock_reader_unlock (rwlock);
+}
+
+static inline
+void
+pgm_sock_mutex_lock (
+	pgm_sock_t*  const sock,
+	pgm_mutex_t* const mutex
+	)
+{
+	if (!sock->is_single_threaded)
+		pgm_mutex_lock (mutex);
+}
+
+static inline
+void
+pgm_sock_mutex_unlock (
+	pgm_sock_t*  const sock,
+	pgm_mutex_t* const mutex
+	)
+{
+	if (!sock->is_single_threaded)
+		pgm_mutex_unlock (mutex);
+}
+
+static inline
+void
+pgm_sock_spinlock_lock (
+	pgm_sock_t*     const sock,
+	pgm_spinlock_t* const spinlock
+	)
+{
+	if (!sock->is_single_threaded)
+		pgm_spinlock_lock (spinlock);
+}
+
+static inline
+void
+pgm_sock_spinlock_unlock (
+	pgm_sock_t*     const sock,
+	pgm_spinlock_t* const spinlock
+	)
+{
+	if (!sock->is_single_threaded)
+		pgm_spinlock_unlock (spinlock);
+}
+
+/* allocate an skb for the socket, reference counts are plain integers on a
+ * single-threaded socket.
+ */
+
+static inline
+struct pgm_sk_buff_t*
+pgm_sock_alloc_skb (
+	pgm_sock_t*    const sock,
+	const uint16_t	     size
+	)
+{
+	struct pgm_sk_buff_t* skb = pgm_alloc_skb (size);
+	skb->single_threaded = sock->is_single_threaded;
+	return skb;
+}
 
 PGM_END_DECLS
 
@@ -251,6 +251,17 @@ PGM_GNUC_INTERNAL void pgm_cond_wait (pgm_cond_t*, CRITICAL_SECTION*);
 #endif
 PGM_GNUC_INTERNAL void pgm_cond_free (pgm_cond_t*);
 
+/* wait on a condition variable guarded by a pgm_mutex_t, mutex must be held.
+ */
+
+static inline void pgm_cond_wait_mutex (pgm_cond_t* cond, pgm_mutex_t* mutex) {
+#ifndef _WIN32
+	pgm_cond_wait (cond, &mutex->pthread_mutex);
+#else
+	pgm_cond_wait (cond, &mutex->win32_crit);
+#endif /* !_WIN32 */
+}
+
 #if defined( _WIN32 ) && !( _WIN32_WINNT >= 0x600 ) && !defined( USE_DUMB_RWSPINLOCK )
 /* read-write lock implementation for Windows XP */
 PGM_GNUC_INTERNAL void pgm_rwlock_reader_lock (pgm_rwlock_t*);
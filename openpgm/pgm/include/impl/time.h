@@ -45,8 +45,66 @@ typedef pgm_time_t (*pgm_time_update_func)(void);
 
 extern pgm_time_update_func		pgm_time_update_now;
 
+/* per-thread time stamp shared by the internal consumers of one receive or
+ * send call, outside of a cache scope the clock is read directly.
+ */
+
+#if defined(_MSC_VER)
+#	define PGM_THREAD_LOCAL		__declspec(thread)
+#else
+#	define PGM_THREAD_LOCAL		__thread
+#endif
+
+struct pgm_time_cache_t {
+	pgm_time_t		now;
+	unsigned		depth;
+};
+
+extern PGM_THREAD_LOCAL struct pgm_time_cache_t	pgm_time_cache;
+
+static inline
+void
+pgm_time_cache_begin (void)
+{
+	if (0 == pgm_time_cache.depth++)
+		pgm_time_cache.now = pgm_time_update_now();
+}
+
+static inline
+void
+pgm_time_cache_end (void)
+{
+	--pgm_time_cache.depth;
+}
+
+/* cached time stamp if within a scope */
+static inline
+pgm_time_t
+pgm_time_cached (void)
+{
+	if (PGM_LIKELY(pgm_time_cache.depth))
+		return pgm_time_cache.now;
+	return pgm_time_update_now();
+}
+
+/* read the clock and update any cached time stamp, for packet arrival and
+ * after waiting.
+ */
+static inline
+pgm_time_t
+pgm_time_refresh (void)
+{
+	const pgm_time_t now = pgm_time_update_now();
+	if (pgm_time_cache.depth)
+		pgm_time_cache.now = now;
+	return now;
+}
+
 PGM_GNUC_INTERNAL bool pgm_time_init (pgm_error_t**) PGM_GNUC_WARN_UNUSED_RESULT;
 PGM_GNUC_INTERNAL bool pgm_time_shutdown (void);
+#ifdef HAVE_GETTIMEOFDAY
+PGM_GNUC_INTERNAL pgm_time_t pgm_time_from_realtime (const pgm_time_t);
+#endif
 
 PGM_END_DECLS
 
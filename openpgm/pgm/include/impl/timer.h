@@ -34,6 +34,14 @@ PGM_GNUC_INTERNAL bool pgm_timer_prepare (pgm_sock_t*const);
 PGM_GNUC_INTERNAL bool pgm_timer_check (pgm_sock_t*const);
 PGM_GNUC_INTERNAL pgm_time_t pgm_timer_expiration (pgm_sock_t*const);
 PGM_GNUC_INTERNAL bool pgm_timer_dispatch (pgm_sock_t*const);
+#ifdef HAVE_TIMERFD_CREATE
+PGM_GNUC_INTERNAL bool pgm_timer_event_create (pgm_sock_t*const);
+PGM_GNUC_INTERNAL void pgm_timer_event_destroy (pgm_sock_t*const);
+PGM_GNUC_INTERNAL void pgm_timer_arm (pgm_sock_t*const, const pgm_time_t);
+PGM_GNUC_INTERNAL bool pgm_timer_rate_create (pgm_sock_t*const);
+PGM_GNUC_INTERNAL void pgm_timer_rate_destroy (pgm_sock_t*const);
+PGM_GNUC_INTERNAL void pgm_timer_arm_rate (pgm_sock_t*const, const pgm_time_t);
+#endif
 
 static inline
 void
@@ -41,7 +49,7 @@ pgm_timer_lock (
 	pgm_sock_t* const sock
 	)
 {
-	if (sock->can_send_data)
+	if (sock->can_send_data && !sock->is_single_threaded)
 		pgm_mutex_lock (&sock->timer_mutex);
 }
 
@@ -51,10 +59,95 @@ pgm_timer_unlock (
 	pgm_sock_t* const sock
 	)
 {
-	if (sock->can_send_data)
+	if (sock->can_send_data && !sock->is_single_threaded)
 		pgm_mutex_unlock (&sock->timer_mutex);
 }
 
+/* re-arm the event socket timer from next_poll, and rate_expiry when non-zero.
+ */
+
+static inline
+void
+pgm_timer_arm_event (
+	pgm_sock_t* const	sock,
+	const pgm_time_t	rate_expiry
+	)
+{
+#ifdef HAVE_TIMERFD_CREATE
+	if (INVALID_SOCKET != sock->event_sock)
+		pgm_timer_arm (sock, rate_expiry);
+#else
+	(void)sock;
+	(void)rate_expiry;
+#endif
+}
+
+/* wake the event socket when the rate limit admits the blocked send of
+ * blocklen bytes.
+ */
+
+static inline
+void
+pgm_timer_arm_rate_event (
+	pgm_sock_t* const	sock,
+	pgm_rate_t* const	minor_bucket
+	)
+{
+#ifdef HAVE_TIMERFD_CREATE
+	if (INVALID_SOCKET != sock->event_sock) {
+		const pgm_time_t remaining = pgm_rate_remaining2 (&sock->rate_control, minor_bucket, sock->blocklen);
+/* ENOBUFS has no deadline, retry after a millisecond */
+		pgm_timer_arm (sock, pgm_time_cached() + (remaining ? remaining : pgm_msecs (1)));
+	}
+#else
+	(void)sock;
+	(void)minor_bucket;
+#endif
+}
+
+/* wake writers when the original data rate limit admits the blocked send of
+ * blocklen bytes, through both the rate timer and the event socket.  the ACK
+ * channel is cleared so that it only signals returning congestion tokens.
+ */
+
+static inline
+void
+pgm_timer_arm_send (
+	pgm_sock_t* const	sock
+	)
+{
+#ifdef HAVE_TIMERFD_CREATE
+	const pgm_time_t remaining = pgm_rate_remaining2 (&sock->rate_control, &sock->odata_rate_control, sock->blocklen);
+/* ENOBUFS has no deadline, retry after a millisecond */
+	const pgm_time_t rate_expiry = pgm_time_cached() + (remaining ? remaining : pgm_msecs (1));
+	if (-1 != sock->rate_timer)
+		pgm_timer_arm_rate (sock, rate_expiry);
+	if (INVALID_SOCKET != sock->event_sock)
+		pgm_timer_arm (sock, rate_expiry);
+#endif
+	if (sock->use_pgmcc)
+		pgm_notify_clear (&sock->ack_notify);
+}
+
+/* returns TRUE if a rate limited send is waiting on the rate timer.
+ */
+
+static inline
+bool
+pgm_timer_is_rate_limited (
+	pgm_sock_t* const	sock
+	)
+{
+#ifdef HAVE_TIMERFD_CREATE
+	return (-1 != sock->rate_timer &&
+		0 != sock->send_expiry &&
+		pgm_time_after (sock->send_expiry, pgm_time_cached()));
+#else
+	(void)sock;
+	return FALSE;
+#endif
+}
+
 PGM_END_DECLS
 
 #endif /* __PGM_IMPL_TIMER_H__ */
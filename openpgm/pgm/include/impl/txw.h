@@ -27,6 +27,7 @@
 
 typedef struct pgm_txw_state_t pgm_txw_state_t;
 typedef struct pgm_txw_t pgm_txw_t;
+typedef struct pgm_txw_history_t pgm_txw_history_t;
 
 #include <impl/framework.h>
 
@@ -42,6 +43,21 @@ struct pgm_txw_state_t {
 
 	uint8_t		pkt_cnt_requested;	/* # parity packets to send */
 	uint8_t		pkt_cnt_sent;		/* # parity packets already sent */
+
+	unsigned	is_history:1;		/* rebuilt from history */
+
+	pgm_time_t	nak_tstamp;		/* first NAK of pending request */
+};
+
+/* repair history beyond the transmit window, TPDUs evicted from the trail are
+ * copied into fixed slots of a memory-mapped file and rebuilt on request.
+ */
+struct pgm_txw_history_t {
+	int				fd;
+	char*				base;			/* mapping of file */
+	size_t				slot_len;		/* record and maximum TPDU */
+	uint32_t			alloc;			/* slots in file */
+	volatile uint32_t		trail;			/* oldest sequence in history */
 };
 
 struct pgm_txw_t {
@@ -66,6 +82,8 @@ struct pgm_txw_t {
 	unsigned			is_fec_enabled:1;
 	unsigned			adv_mode:1;		/* 0 = advance by time, 1 = advance by data */
 
+	pgm_txw_history_t*		history;		/* evicted TPDUs, or NULL */
+
 	size_t				size;			/* window content size in bytes */
 	unsigned			alloc;			/* length of pdata[] */
 /* C90 and older */
@@ -74,11 +92,12 @@ struct pgm_txw_t {
 
 PGM_GNUC_INTERNAL pgm_txw_t* pgm_txw_create (const pgm_tsi_t*const, const uint16_t, const uint32_t, const unsigned, const ssize_t, const bool, const uint8_t, const uint8_t) PGM_GNUC_WARN_UNUSED_RESULT;
 PGM_GNUC_INTERNAL void pgm_txw_shutdown (pgm_txw_t*const);
+PGM_GNUC_INTERNAL bool pgm_txw_history_create (pgm_txw_t*const, const uint16_t, const uint32_t) PGM_GNUC_WARN_UNUSED_RESULT;
 PGM_GNUC_INTERNAL void pgm_txw_add (pgm_txw_t*const restrict, struct pgm_sk_buff_t*const restrict);
 PGM_GNUC_INTERNAL struct pgm_sk_buff_t* pgm_txw_peek (const pgm_txw_t*const, const uint32_t) PGM_GNUC_WARN_UNUSED_RESULT;
-PGM_GNUC_INTERNAL bool pgm_txw_retransmit_push (pgm_txw_t*const, const uint32_t, const bool, const uint8_t) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL bool pgm_txw_retransmit_push (pgm_txw_t*const, const uint32_t, const bool, const uint8_t, const pgm_time_t) PGM_GNUC_WARN_UNUSED_RESULT;
 PGM_GNUC_INTERNAL struct pgm_sk_buff_t* pgm_txw_retransmit_try_peek (pgm_txw_t*const) PGM_GNUC_WARN_UNUSED_RESULT;
-PGM_GNUC_INTERNAL void pgm_txw_retransmit_remove_head (pgm_txw_t*const);
+PGM_GNUC_INTERNAL pgm_time_t pgm_txw_retransmit_remove_head (pgm_txw_t*const);
 PGM_GNUC_INTERNAL uint32_t pgm_txw_get_unfolded_checksum (const struct pgm_sk_buff_t*const) PGM_GNUC_PURE;
 PGM_GNUC_INTERNAL void pgm_txw_set_unfolded_checksum (struct pgm_sk_buff_t*const, const uint32_t);
 PGM_GNUC_INTERNAL void pgm_txw_inc_retransmit_count (struct pgm_sk_buff_t*const);
@@ -95,6 +114,7 @@ static inline uint32_t pgm_txw_lead_atomic (const pgm_txw_t* const) PGM_GNUC_WAR
 static inline uint32_t pgm_txw_next_lead (const pgm_txw_t* const) PGM_GNUC_WARN_UNUSED_RESULT;
 static inline uint32_t pgm_txw_trail (const pgm_txw_t* const) PGM_GNUC_WARN_UNUSED_RESULT;
 static inline uint32_t pgm_txw_trail_atomic (const pgm_txw_t* const) PGM_GNUC_WARN_UNUSED_RESULT;
+static inline uint32_t pgm_txw_repair_trail (const pgm_txw_t* const) PGM_GNUC_WARN_UNUSED_RESULT;
 
 static inline
 size_t
@@ -197,6 +217,19 @@ pgm_txw_trail_atomic (
 	return pgm_atomic_read32 (&window->trail);
 }
 
+/* oldest sequence available for repair, including the history */
+static inline
+uint32_t
+pgm_txw_repair_trail (
+	const pgm_txw_t*const window
+	)
+{
+	pgm_assert (NULL != window);
+	if (NULL == window->history)
+		return pgm_txw_trail_atomic (window);
+	return pgm_atomic_read32 (&window->history->trail);
+}
+
 PGM_END_DECLS
 
 #endif /* __PGM_IMPL_TXW_H__ */
@@ -224,4 +224,122 @@ pgm_atomic_write32 (
 	*atomic = val;
 }
 
+/* 64-bit word add, for counters that must not wrap.
+ *
+ * 	*atomic += val;
+ */
+
+static inline
+void
+pgm_atomic_add64 (
+	volatile uint64_t*	atomic,
+	const uint64_t		val
+	)
+{
+#if defined( __GNUC__ ) && defined( __x86_64__ )
+	__asm__ volatile ("lock; addq %1, %0"
+		        : "=m" (*atomic)
+		        : "er" (val), "m" (*atomic)
+		        : "memory", "cc"  );
+#elif defined( __sun ) || defined( __NetBSD__ )
+	atomic_add_64 (atomic, (int64_t)val);
+#elif defined( __APPLE__ )
+	OSAtomicAdd64Barrier ((int64_t)val, (volatile int64_t*)atomic);
+#elif defined( __GNUC__ ) && ( __GNUC__ * 100 + __GNUC_MINOR__ >= 401 )
+	__sync_add_and_fetch (atomic, val);
+#elif defined( _AIX ) && defined( __64BIT__ )
+	fetch_and_addlp ((atomic_l)atomic, val);
+#elif defined( _WIN32 )
+	LONGLONG oldval;
+	do {
+		oldval = *(volatile LONGLONG*)atomic;
+	} while (oldval != _InterlockedCompareExchange64 ((volatile LONGLONG*)atomic, oldval + val, oldval));
+#else
+#	error "No supported atomic operations for this platform."
+#endif
+}
+
+/* 64-bit word load, untorn on 32-bit platforms.
+ */
+
+static inline
+uint64_t
+pgm_atomic_read64 (
+	const volatile uint64_t* atomic
+	)
+{
+#if defined( __x86_64__ ) || defined( __amd64 ) || defined( _M_X64 ) || defined( __LP64__ ) || defined( _LP64 )
+	return *atomic;
+#elif defined( __sun ) || defined( __NetBSD__ )
+	return atomic_add_64_nv ((volatile uint64_t*)atomic, 0);
+#elif defined( __APPLE__ )
+	return (uint64_t)OSAtomicAdd64Barrier (0, (volatile int64_t*)atomic);
+#elif defined( __GNUC__ ) && ( __GNUC__ * 100 + __GNUC_MINOR__ >= 401 )
+	return __sync_fetch_and_add ((volatile uint64_t*)atomic, 0);
+#elif defined( _WIN32 )
+	return (uint64_t)_InterlockedCompareExchange64 ((volatile LONGLONG*)atomic, 0, 0);
+#else
+	return *atomic;
+#endif
+}
+
+/* pointer compare-and-swap, returns TRUE when the exchange was made.
+ *
+ * 	if (*atomic == oldval) { *atomic = newval; return TRUE; }
+ * 	return FALSE;
+ */
+
+static inline
+bool
+pgm_atomic_cas_pointer (
+	void* volatile*		atomic,
+	void*			oldval,
+	void*			newval
+	)
+{
+#if defined( __sun ) || defined( __NetBSD__ )
+	return oldval == atomic_cas_ptr (atomic, oldval, newval);
+#elif defined( __APPLE__ )
+	return OSAtomicCompareAndSwapPtrBarrier (oldval, newval, atomic);
+#elif defined( __GNUC__ ) && ( __GNUC__ * 100 + __GNUC_MINOR__ >= 401 )
+	return __sync_bool_compare_and_swap (atomic, oldval, newval);
+#elif defined( _AIX ) && defined( __64BIT__ )
+	return compare_and_swaplp ((atomic_l)atomic, (long*)&oldval, (long)newval);
+#elif defined( _AIX )
+	return compare_and_swap ((atomic_p)atomic, (int*)&oldval, (int)newval);
+#elif defined( _WIN32 )
+	return oldval == _InterlockedCompareExchangePointer (atomic, newval, oldval);
+#else
+#	error "No supported atomic operations for this platform."
+#endif
+}
+
+/* pointer exchange returning original value.
+ *
+ * 	void* tmp = *atomic;
+ * 	*atomic = newval;
+ * 	return tmp;
+ */
+
+static inline
+void*
+pgm_atomic_exchange_pointer (
+	void* volatile*		atomic,
+	void*			newval
+	)
+{
+#if defined( __sun ) || defined( __NetBSD__ )
+	return atomic_swap_ptr (atomic, newval);
+#elif defined( _WIN32 ) && !defined( __GNUC__ )
+	return _InterlockedExchangePointer (atomic, newval);
+#else
+/* __sync_lock_test_and_set is only an acquire barrier */
+	void* oldval;
+	do {
+		oldval = *atomic;
+	} while (!pgm_atomic_cas_pointer (atomic, oldval, newval));
+	return oldval;
+#endif
+}
+
 #endif /* __PGM_ATOMIC_H__ */
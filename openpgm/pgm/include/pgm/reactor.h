@@ -0,0 +1,52 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * Multi-socket event reactor.
+ *
+ * Copyright (c) 2006-2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#	pragma once
+#endif
+#ifndef __PGM_REACTOR_H__
+#define __PGM_REACTOR_H__
+
+typedef struct pgm_reactor_t pgm_reactor_t;
+
+#include <pgm/types.h>
+#include <pgm/error.h>
+#include <pgm/msgv.h>
+#include <pgm/socket.h>
+
+PGM_BEGIN_DECLS
+
+/* called with PGM_IO_STATUS_NORMAL and the messages read by pgm_recvmsgv(),
+ * or with PGM_IO_STATUS_RESET, PGM_IO_STATUS_EOF or PGM_IO_STATUS_ERROR, no
+ * messages, and zero length.
+ */
+typedef void (*pgm_reactor_func_t) (pgm_sock_t*, const int, struct pgm_msgv_t*, const size_t, void*);
+
+bool pgm_reactor_create (pgm_reactor_t**restrict, const unsigned, pgm_error_t**restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+bool pgm_reactor_add (pgm_reactor_t*restrict, pgm_sock_t*restrict, pgm_reactor_func_t, void*, pgm_error_t**restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+bool pgm_reactor_remove (pgm_reactor_t*restrict, pgm_sock_t*restrict);
+bool pgm_reactor_run (pgm_reactor_t*restrict, pgm_error_t**restrict);
+void pgm_reactor_stop (pgm_reactor_t*);
+void pgm_reactor_destroy (pgm_reactor_t*);
+
+PGM_END_DECLS
+
+#endif /* __PGM_REACTOR_H__ */
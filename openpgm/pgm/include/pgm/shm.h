@@ -0,0 +1,129 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * Shared memory statistics segment.
+ *
+ * Copyright (c) 2006-2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#	pragma once
+#endif
+#ifndef __PGM_SHM_H__
+#define __PGM_SHM_H__
+
+#include <pgm/types.h>
+#include <pgm/error.h>
+#include <pgm/socket.h>
+
+PGM_BEGIN_DECLS
+
+/* segment named PGM_SHM_PREFIX followed by the process id unless a name is
+ * given to pgm_shm_init().
+ */
+#define PGM_SHM_PREFIX		"/pgm."
+#define PGM_SHM_MAGIC		0x4d475050	/* "PPGM" */
+#define PGM_SHM_VERSION		1
+
+#define PGM_SHM_MAX_SOCKS	32
+#define PGM_SHM_MAX_PEERS	256
+
+/* sequence is odd while the publisher is writing, a reader copies the
+ * segment and retries when the sequence was odd or has changed.
+ */
+struct pgm_shm_header_t {
+	uint32_t				magic;
+	uint32_t				version;
+	volatile uint32_t			sequence;
+	uint32_t				pid;
+	uint32_t				interval;	/* milliseconds */
+	uint32_t				max_socks;
+	uint32_t				max_peers;
+	uint32_t				sock_count;
+	uint32_t				peer_count;
+	uint64_t				timestamp;	/* microseconds, pgm_time_t */
+};
+
+struct pgm_shm_sock_t {
+	struct pgm_stats_t			stats;		/* peers unused */
+	pgm_tsi_t				tsi;
+	uint16_t				dport;
+	uint8_t					can_send_data;
+	uint8_t					can_recv_data;
+	uint32_t				txw_lead;
+	uint32_t				txw_trail;
+	uint64_t				txw_bytes;
+	int64_t					txw_max_rte;	/* bytes per second, 0 unlimited */
+	int64_t					odata_max_rte;
+	int64_t					rdata_max_rte;
+	int64_t					rate_limit;	/* tokens remaining this interval */
+	int64_t					odata_rate_limit;
+	int64_t					rdata_rate_limit;
+	uint32_t				cwnd_size;	/* PGMCC */
+	uint32_t				tokens;
+	uint8_t					is_congested;
+	uint8_t					is_apdu_eagain;
+	uint32_t				peer_index;	/* first peer in segment */
+	uint32_t				peer_count;
+};
+
+struct pgm_shm_peer_t {
+	struct pgm_peer_stats_t			stats;
+	uint32_t				rxw_lead;
+	uint32_t				rxw_trail;
+	uint32_t				rxw_commit_lead;
+	uint32_t				rxw_losses;
+	uint64_t				rxw_bytes;
+	uint64_t				last_packet;	/* microseconds, pgm_time_t */
+};
+
+/* header, then max_socks sockets, then max_peers peers */
+static inline
+struct pgm_shm_sock_t*
+pgm_shm_socks (
+	const struct pgm_shm_header_t*	header
+	)
+{
+	return (struct pgm_shm_sock_t*)(header + 1);
+}
+
+static inline
+struct pgm_shm_peer_t*
+pgm_shm_peers (
+	const struct pgm_shm_header_t*	header
+	)
+{
+	return (struct pgm_shm_peer_t*)(pgm_shm_socks (header) + header->max_socks);
+}
+
+static inline
+size_t
+pgm_shm_size (
+	const unsigned	max_socks,
+	const unsigned	max_peers
+	)
+{
+	return sizeof (struct pgm_shm_header_t) +
+		max_socks * sizeof (struct pgm_shm_sock_t) +
+		max_peers * sizeof (struct pgm_shm_peer_t);
+}
+
+bool pgm_shm_init (const char*restrict, const unsigned, pgm_error_t**restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+bool pgm_shm_shutdown (void);
+
+PGM_END_DECLS
+
+#endif /* __PGM_SHM_H__ */
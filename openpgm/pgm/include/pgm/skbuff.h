@@ -28,6 +28,7 @@
 #include <string.h>
 
 struct pgm_sk_buff_t;
+struct pgm_skb_ref_t;
 
 #include <pgm/types.h>
 #include <pgm/atomic.h>
@@ -54,7 +55,8 @@ struct pgm_sk_buff_t {
 
 	uint16_t			len;		/* actual data */
 	unsigned			zero_padded:1;
-	unsigned			__padding2:31;	/* fix bit field */
+	unsigned			single_threaded:1;	/* users not atomic */
+	unsigned			__padding2:30;	/* fix bit field */
 
 	struct pgm_header*		pgm_header;
 	struct pgm_opt_fragment* 	pgm_opt_fragment;
@@ -70,11 +72,23 @@ struct pgm_sk_buff_t {
 				       *end;
 	uint32_t			truesize;
 	volatile uint32_t		users;		/* atomic */
+	struct pgm_skb_ref_t*		ref;		/* external payload, data to tail */
+};
+
+/* application owned payload referenced by one or more skbs, the release
+ * function is called when the last reference is dropped.
+ */
+struct pgm_skb_ref_t {
+	volatile uint32_t		users;		/* atomic */
+	pgm_release_func_t		release;
+	void*				buffer;
+	void*				user_data;
 };
 
 void pgm_skb_over_panic (const struct pgm_sk_buff_t*const, const uint16_t) PGM_GNUC_NORETURN;
 void pgm_skb_under_panic (const struct pgm_sk_buff_t*const, const uint16_t) PGM_GNUC_NORETURN;
 bool pgm_skb_is_valid (const struct pgm_sk_buff_t*const) PGM_GNUC_PURE PGM_GNUC_WARN_UNUSED_RESULT;
+void pgm_skb_ref_put (struct pgm_skb_ref_t*const);
 
 /* attribute __pure__ only valid for platforms with atomic ops.
  * attribute __malloc__ not used as only part of the memory should be aliased.
@@ -115,18 +129,87 @@ pgm_skb_get (
 	struct pgm_sk_buff_t*const skb
 	)
 {
-	pgm_atomic_inc32 (&skb->users);
+	if (skb->single_threaded)
+		skb->users++;
+	else
+		pgm_atomic_inc32 (&skb->users);
 	return skb;
 }
 
+/* decrease reference count, returns TRUE when the last reference is dropped */
+static inline
+bool
+pgm_skb_unref (
+	struct pgm_sk_buff_t*const skb
+	)
+{
+	const uint32_t users = skb->single_threaded ? skb->users-- : pgm_atomic_exchange_and_add32 (&skb->users, (uint32_t)-1);
+	return (users == 1);
+}
+
+/* free an skb without references and its hold on any external payload */
+static inline
+void
+pgm_skb_release (
+	struct pgm_sk_buff_t*const skb
+	)
+{
+	if (PGM_UNLIKELY(NULL != skb->ref))
+		pgm_skb_ref_put (skb->ref);
+	pgm_free (skb);
+}
+
 static inline
 void
 pgm_free_skb (
 	struct pgm_sk_buff_t*const skb
 	)
 {
-	if (pgm_atomic_exchange_and_add32 (&skb->users, (uint32_t)-1) == 1)
-		pgm_free (skb);
+	if (pgm_skb_unref (skb))
+		pgm_skb_release (skb);
+}
+
+/* attach external payload after the linear header, skb::data to skb::tail
+ * reference the application buffer.
+ */
+static inline
+void
+pgm_skb_attach_ref (
+	struct pgm_sk_buff_t*const	skb,
+	struct pgm_skb_ref_t*const	ref,
+	const void*			payload,
+	const uint16_t			len
+	)
+{
+	pgm_atomic_inc32 (&ref->users);
+	skb->ref  = ref;
+	skb->data = (void*)payload;
+	skb->tail = (char*)skb->data + len;
+	skb->len  = len;
+}
+
+/* length of the linear buffer to be sent, the header only for an external payload */
+static inline uint16_t pgm_skb_linear_length (const struct pgm_sk_buff_t*const) PGM_GNUC_PURE PGM_GNUC_WARN_UNUSED_RESULT;
+
+static inline
+uint16_t
+pgm_skb_linear_length (
+	const struct pgm_sk_buff_t*const skb
+	)
+{
+	return (uint16_t)(PGM_UNLIKELY(NULL != skb->ref) ? (char*)skb->end - (char*)skb->head : (char*)skb->tail - (char*)skb->head);
+}
+
+/* total length of header and payload */
+static inline uint16_t pgm_skb_tpdu_length (const struct pgm_sk_buff_t*const) PGM_GNUC_PURE PGM_GNUC_WARN_UNUSED_RESULT;
+
+static inline
+uint16_t
+pgm_skb_tpdu_length (
+	const struct pgm_sk_buff_t*const skb
+	)
+{
+	return (uint16_t)(PGM_UNLIKELY(NULL != skb->ref) ? pgm_skb_linear_length (skb) + skb->len : (char*)skb->tail - (char*)skb->head);
 }
 
 /* add data */
@@ -218,6 +301,7 @@ pgm_skb_copy (
 	newskb->zero_padded = 0;
 	newskb->truesize = skb->truesize;
 	pgm_atomic_write32 (&newskb->users, 1);
+	newskb->ref = NULL;
 	newskb->head = newskb + 1;
 	newskb->end  = (char*)newskb->head + ((char*)skb->end  - (char*)skb->head);
 	newskb->data = (char*)newskb->head + ((char*)skb->data - (char*)skb->head);
@@ -26,6 +26,7 @@
 #define __PGM_SOCKET_H__
 
 typedef struct pgm_sock_t pgm_sock_t;
+typedef void (*pgm_release_func_t) (void*, void*);
 struct pgm_sockaddr_t;
 struct pgm_addrinfo_t;
 struct pgm_fecinto_t;
@@ -94,6 +95,92 @@ struct pgm_pgmccinfo_t {
 	uint32_t				ack_c_p;
 };
 
+struct pgm_peerweight_t {
+	pgm_tsi_t				tsi;
+	uint32_t				weight;		/* quantum multiplier */
+};
+
+/* PGM_STATS snapshot, counters are cumulative since pgm_socket() */
+#define PGM_STATS_VERSION	1
+
+struct pgm_peer_stats_t {
+	pgm_tsi_t				tsi;
+	uint64_t				data_bytes_received;
+	uint64_t				data_msgs_received;
+	uint64_t				bytes_received;
+	uint64_t				malformed_spms;
+	uint64_t				malformed_odata;
+	uint64_t				malformed_ncfs;
+	uint64_t				packets_discarded;
+	uint64_t				dup_spms;
+	uint64_t				dup_datas;
+	uint64_t				parity_nak_packets_sent;
+	uint64_t				selective_nak_packets_sent;
+	uint64_t				parity_naks_sent;
+	uint64_t				selective_naks_sent;
+	uint64_t				naks_failed_ncf_retries_exceeded;
+	uint64_t				naks_failed_data_retries_exceeded;
+	uint64_t				naks_failed_gen_expired;
+	uint64_t				selective_naks_suppressed;
+	uint64_t				nak_errors;
+	uint64_t				acks_sent;
+};
+
+struct pgm_stats_t {
+	uint32_t				version;	/* PGM_STATS_VERSION */
+	uint32_t				peers_len;	/* capacity of peers */
+	struct pgm_peer_stats_t*		peers;		/* optional */
+	uint32_t				peer_count;	/* peers known, may exceed peers_len */
+	uint64_t				data_bytes_sent;
+	uint64_t				data_msgs_sent;
+	uint64_t				bytes_sent;
+	uint64_t				cksum_errors;
+	uint64_t				malformed_naks;
+	uint64_t				packets_discarded;
+	uint64_t				selective_bytes_retransmitted;
+	uint64_t				selective_msgs_retransmitted;
+	uint64_t				parity_naks_received;
+	uint64_t				selective_naks_received;
+	uint64_t				ack_packets_received;
+	uint64_t				ack_errors;
+	uint64_t				selective_nnak_packets_received;
+	uint64_t				selective_nnaks_received;
+	uint64_t				nnak_errors;
+};
+
+/* PGM_LATENCY histograms in microseconds, log-linear buckets of
+ * PGM_LATENCY_SUB_BUCKETS per power of two from 2^PGM_LATENCY_SUB_BUCKET_BITS
+ * giving 1/16 precision up to 2^32 μs, exact below.
+ */
+#define PGM_LATENCY_VERSION		1
+#define PGM_LATENCY_SUB_BUCKET_BITS	4
+#define PGM_LATENCY_SUB_BUCKETS		(1 << PGM_LATENCY_SUB_BUCKET_BITS)
+#define PGM_LATENCY_BUCKETS		((33 - PGM_LATENCY_SUB_BUCKET_BITS) * PGM_LATENCY_SUB_BUCKETS)
+
+enum {
+	PGM_LATENCY_SOURCE_NAK_SVC = 0,		/* NAK received to RDATA sent */
+	PGM_LATENCY_RECEIVER_NAK_SVC,		/* first NAK sent to RDATA received */
+	PGM_LATENCY_RECEIVER_REPAIR,		/* loss detected to repaired */
+	PGM_LATENCY_RECEIVER_DELIVERY,		/* received to delivered */
+	PGM_LATENCY_RECEIVER_FEC,		/* transmission group reconstruction */
+	PGM_LATENCY_MAX
+};
+
+struct pgm_latency_t {
+	uint64_t				count;
+	uint64_t				sum;
+	uint32_t				min;
+	uint32_t				max;
+	uint32_t				counts[PGM_LATENCY_BUCKETS];
+};
+
+/* a null TSI selects the socket, including peers since expired */
+struct pgm_latency_stats_t {
+	uint32_t				version;	/* PGM_LATENCY_VERSION */
+	pgm_tsi_t				tsi;
+	struct pgm_latency_t			latency[PGM_LATENCY_MAX];
+};
+
 /* socket options */
 enum {
 	PGM_SEND_SOCK		= 0x2000,
@@ -149,7 +236,29 @@ enum {
 	PGM_UNCONTROLLED_ODATA,
 	PGM_UNCONTROLLED_RDATA,
 	PGM_ODATA_MAX_RTE,
-	PGM_RDATA_MAX_RTE
+	PGM_RDATA_MAX_RTE,
+	PGM_RECV_BATCH,
+	PGM_UDP_GSO,
+	PGM_UDP_GRO,
+	PGM_ZEROCOPY,
+	PGM_RECV_TIMESTAMP,
+	PGM_RECV_LEASE,
+	PGM_RECV_UNORDERED,
+	PGM_RECV_DEADLINE,
+	PGM_RECV_QUANTUM,
+	PGM_PEER_WEIGHT,
+	PGM_RECV_RECLAIM,
+	PGM_RECV_REASSEMBLE,
+	PGM_LARGE_APDU,
+	PGM_RECV_SPILL,
+	PGM_TXW_HISTORY_SQNS,
+	PGM_LATE_JOIN,
+	PGM_EVENT_SOCK,
+	PGM_RATE_SOCK,
+	PGM_SINGLE_THREADED,
+	PGM_STATS,
+	PGM_LATENCY,
+	PGM_SEND_BATCH
 };
 
 /* IO status */
@@ -185,8 +294,13 @@ void pgm_freeaddrinfo (struct pgm_addrinfo_t*);
 int pgm_send (pgm_sock_t*const restrict, const void*restrict, const size_t, size_t*restrict);
 int pgm_sendv (pgm_sock_t*const restrict, const struct pgm_iovec*const restrict, const unsigned, const bool, size_t*restrict);
 int pgm_send_skbv (pgm_sock_t*const restrict, struct pgm_sk_buff_t**const restrict, const unsigned, const bool, size_t*restrict);
+int pgm_send_ref (pgm_sock_t*const restrict, const void*restrict, const size_t, pgm_release_func_t, void*, size_t*restrict);
 int pgm_recvmsg (pgm_sock_t*const restrict, struct pgm_msgv_t*const restrict, const int, size_t*restrict, pgm_error_t**restrict) PGM_GNUC_WARN_UNUSED_RESULT;
 int pgm_recvmsgv (pgm_sock_t*const restrict, struct pgm_msgv_t*const restrict, const size_t, const int, size_t*restrict, pgm_error_t**restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+void pgm_msgv_release (pgm_sock_t*const restrict, struct pgm_msgv_t*const restrict, const size_t);
+size_t pgm_msgv_apdu_length (const struct pgm_msgv_t*const);
+size_t pgm_msgv_apdu_offset (const struct pgm_msgv_t*const);
+unsigned pgm_reclaim (pgm_sock_t*const);
 int pgm_recv (pgm_sock_t*const restrict, void*restrict, const size_t, const int, size_t*const restrict, pgm_error_t**restrict) PGM_GNUC_WARN_UNUSED_RESULT;
 int pgm_recvfrom (pgm_sock_t*const restrict, void*restrict, const size_t, const int, size_t*restrict, struct pgm_sockaddr_t*restrict, socklen_t*restrict, pgm_error_t**restrict) PGM_GNUC_WARN_UNUSED_RESULT;
 
@@ -222,6 +336,7 @@ pgm_family_string (
 
 char* pgm_gsr_to_string (const struct pgm_group_source_req* gsr, char* text, size_t len);
 char* pgm_addrinfo_to_string (const struct pgm_addrinfo_t* addr, char* text, size_t len);
+uint32_t pgm_latency_percentile (const struct pgm_latency_t*, const double) PGM_GNUC_PURE;
 
 PGM_END_DECLS
 
@@ -248,6 +248,44 @@ pgm_malloc0_n (
 	return NULL;
 }
 
+/* cache-line aligned and zeroed, release with pgm_free_aligned().
+ */
+
+PGM_GNUC_INTERNAL
+void*
+pgm_malloc0_aligned (
+	const size_t	n_bytes,
+	const size_t	alignment
+	)
+{
+	if (PGM_LIKELY (n_bytes))
+	{
+		void* mem;
+#ifndef _WIN32
+		if (0 != posix_memalign (&mem, alignment, n_bytes))
+			mem = NULL;
+#else
+		mem = _aligned_malloc (n_bytes, alignment);
+#endif
+		if (mem) {
+			memset (mem, 0, n_bytes);
+			return mem;
+		}
+
+#ifdef __GNUC__
+		pgm_fatal ("file %s: line %d (%s): failed to allocate %" PRIzu " bytes",
+			__FILE__, __LINE__, __func__,
+			n_bytes);
+#else
+		pgm_fatal ("file %s: line %d: failed to allocate %" PRIzu " bytes",
+			__FILE__, __LINE__,
+			n_bytes);
+#endif
+		abort ();
+	}
+	return NULL;
+}
+
 void*
 pgm_memdup (
 	const void*	mem,
@@ -285,4 +323,18 @@ pgm_free (
 		free (mem);
 }
 
+PGM_GNUC_INTERNAL
+void
+pgm_free_aligned (
+	void*		mem
+	)
+{
+	if (PGM_LIKELY (NULL != mem))
+#ifndef _WIN32
+		free (mem);
+#else
+		_aligned_free (mem);
+#endif
+}
+
 /* eof */
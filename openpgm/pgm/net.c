@@ -22,6 +22,13 @@
 #ifdef HAVE_CONFIG_H
 #	include <config.h>
 #endif
+
+#ifdef HAVE_SENDMMSG
+#	ifndef _GNU_SOURCE
+#		define _GNU_SOURCE
+#	endif
+#endif
+
 #include <errno.h>
 #ifdef HAVE_POLL
 #	include <poll.h>
@@ -31,6 +38,13 @@
 #	include <netinet/in.h>
 #	include <arpa/inet.h>
 #endif
+#ifdef HAVE_UDP_SEGMENT
+#	include <netinet/udp.h>
+#endif
+#ifdef HAVE_MSG_ZEROCOPY
+#	include <unistd.h>
+#	include <linux/errqueue.h>
+#endif
 #include <impl/i18n.h>
 #include <impl/framework.h>
 #include <impl/net.h>
@@ -104,7 +118,7 @@ pgm_sendto_hops (
 	}
 
 	if (!use_router_alert && sock->can_send_data)
-		pgm_mutex_lock (&sock->send_mutex);
+		pgm_sock_mutex_lock (sock, &sock->send_mutex);
 	if (-1 != hops)
 		pgm_sockaddr_multicast_hops (send_sock, sock->send_gsr.gsr_group.ss_family, hops);
 
@@ -173,7 +187,491 @@ pgm_sendto_hops (
 	if (-1 != hops)
 		pgm_sockaddr_multicast_hops (send_sock, sock->send_gsr.gsr_group.ss_family, sock->hops);
 	if (!use_router_alert && sock->can_send_data)
-		pgm_mutex_unlock (&sock->send_mutex);
+		pgm_sock_mutex_unlock (sock, &sock->send_mutex);
+	return sent;
+}
+
+#ifdef HAVE_MSG_ZEROCOPY
+/* MSG_ZEROCOPY sends awaiting kernel completion, each notification id covers
+ * one sendmsg() of one or more transmit window skbs.  both rings are sized
+ * to a power of two as ids wrap at 32 bits.
+ */
+
+/* kernel MAX_SKB_FRAGS, pages a zero-copy datagram may reference */
+#define PGM_ZEROCOPY_MAX_FRAGS		17
+
+struct pgm_zerocopy_send_t {
+	unsigned			count;		/* skbs pinned by this send */
+	bool				is_complete;
+};
+
+struct pgm_zerocopy_t {
+	uint32_t			head_id;	/* oldest incomplete send */
+	uint32_t			next_id;	/* kernel id of next send */
+	uint32_t			skb_head, skb_tail;
+	uint32_t			mask;
+	uintptr_t			page_size;
+	struct pgm_zerocopy_send_t*	send;
+	struct pgm_sk_buff_t**		skb;
+};
+
+/* enable zero-copy transmit on the send socket and create completion tracking,
+ * one slot per transmit window entry plus one super-buffer.
+ *
+ * returns TRUE on success, returns FALSE if unsupported by the socket.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_zerocopy_create (
+	pgm_sock_t* const	sock
+	)
+{
+	struct pgm_zerocopy_t* zc;
+	const int optval = 1;
+	uint32_t size = 1;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != sock->window);
+	pgm_assert (NULL == sock->zerocopy);
+
+	if (SOCKET_ERROR == setsockopt (sock->send_sock, SOL_SOCKET, SO_ZEROCOPY, (const char*)&optval, sizeof(optval)))
+		return FALSE;
+
+	while (size < pgm_txw_max_length (sock->window) + PGM_UDP_MAX_SEGMENTS)
+		size <<= 1;
+	zc = pgm_malloc0 (sizeof(struct pgm_zerocopy_t) +
+			  size * (sizeof(struct pgm_zerocopy_send_t) + sizeof(struct pgm_sk_buff_t*)));
+	zc->mask = size - 1;
+	zc->page_size = (uintptr_t)sysconf (_SC_PAGESIZE);
+	zc->send = (struct pgm_zerocopy_send_t*)(zc + 1);
+	zc->skb  = (struct pgm_sk_buff_t**)(zc->send + size);
+	sock->zerocopy = zc;
+	return TRUE;
+}
+
+/* drop references on all pinned skbs, the send socket must already be closed.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_zerocopy_destroy (
+	pgm_sock_t* const	sock
+	)
+{
+	struct pgm_zerocopy_t* zc;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != sock->zerocopy);
+
+	zc = sock->zerocopy;
+	while (zc->skb_head != zc->skb_tail)
+		pgm_free_skb (zc->skb[ zc->skb_head++ & zc->mask ]);
+	pgm_free (zc);
+	sock->zerocopy = NULL;
+}
+
+/* read completions from the send socket error queue and release skbs in send
+ * order, caller must hold send_mutex.  repairs deferred whilst an skb was
+ * pinned are re-signalled.
+ *
+ * returns count of released skbs.
+ */
+
+static
+unsigned
+zerocopy_release (
+	pgm_sock_t* const	sock
+	)
+{
+	struct pgm_zerocopy_t* zc = sock->zerocopy;
+	unsigned released = 0;
+
+	if (zc->head_id == zc->next_id)
+		return released;
+
+	for (;;) {
+		char aux[ 128 ];
+		struct msghdr msg = {
+			.msg_control	= aux,
+			.msg_controllen = sizeof(aux)
+		};
+		if (recvmsg (sock->send_sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			break;
+		struct cmsghdr* cmsg;
+		for (cmsg = CMSG_FIRSTHDR(&msg);
+		     cmsg != NULL;
+		     cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			if (!(IPPROTO_IP == cmsg->cmsg_level && IP_RECVERR == cmsg->cmsg_type) &&
+			    !(IPPROTO_IPV6 == cmsg->cmsg_level && IPV6_RECVERR == cmsg->cmsg_type))
+				continue;
+			struct sock_extended_err serr;
+			memcpy (&serr, CMSG_DATA(cmsg), sizeof(serr));
+			if (0 != serr.ee_errno || SO_EE_ORIGIN_ZEROCOPY != serr.ee_origin)
+				continue;
+/* inclusive range of completed ids */
+			for (uint32_t id = serr.ee_info; id != serr.ee_data + 1; id++)
+				if ((uint32_t)(id - zc->head_id) < (uint32_t)(zc->next_id - zc->head_id))
+					zc->send[ id & zc->mask ].is_complete = TRUE;
+		}
+	}
+
+	while (zc->head_id != zc->next_id &&
+	       zc->send[ zc->head_id & zc->mask ].is_complete)
+	{
+		struct pgm_zerocopy_send_t* send = &zc->send[ zc->head_id++ & zc->mask ];
+		for (unsigned i = 0; i < send->count; i++)
+			pgm_free_skb (zc->skb[ zc->skb_head++ & zc->mask ]);
+		released += send->count;
+		send->is_complete = FALSE;
+	}
+
+	if (released && !pgm_queue_is_empty (&sock->window->retransmit_queue))
+		pgm_notify_send (&sock->rdata_notify);
+	return released;
+}
+
+/* count of pages spanned by the vector, the kernel fails zero-copy datagrams
+ * referencing more than PGM_ZEROCOPY_MAX_FRAGS with EMSGSIZE.
+ */
+
+static
+unsigned
+zerocopy_pages (
+	const struct pgm_zerocopy_t* const restrict zc,
+	const struct pgm_iovec*	     const restrict vector,
+	const unsigned				    count
+	)
+{
+	unsigned pages = 0;
+	for (unsigned i = 0; i < count; i++) {
+		const uintptr_t first = (uintptr_t)vector[i].iov_base / zc->page_size;
+		const uintptr_t last  = ((uintptr_t)vector[i].iov_base + vector[i].iov_len - 1) / zc->page_size;
+		pages += (unsigned)(last - first + 1);
+	}
+	return pages;
+}
+
+/* release transmit window skbs for completed zero-copy sends.
+ *
+ * returns count of released skbs.
+ */
+
+PGM_GNUC_INTERNAL
+unsigned
+pgm_zerocopy_reap (
+	pgm_sock_t* const	sock
+	)
+{
+	unsigned released;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != sock->zerocopy);
+
+	pgm_sock_mutex_lock (sock, &sock->send_mutex);
+	released = zerocopy_release (sock);
+	pgm_sock_mutex_unlock (sock, &sock->send_mutex);
+	return released;
+}
+#endif /* HAVE_MSG_ZEROCOPY */
+
+/* gather send of a vector to one destination with optional ancillary data.
+ *
+ * on success, returns number of bytes sent.  on error, -1 is returned, and
+ * errno set appropriately.
+ */
+
+static
+ssize_t
+sendvector (
+	const SOCKET			      s,
+	const struct pgm_iovec*	     restrict vector,
+	const unsigned			      vector_len,
+	PGM_GNUC_UNUSED void*	     restrict control,
+	PGM_GNUC_UNUSED const size_t	      controllen,
+	const int			      flags,
+	const struct sockaddr*	     restrict to,
+	const socklen_t			      tolen
+	)
+{
+#ifndef _WIN32
+	const struct msghdr msg = {
+		.msg_name	= (void*)to,
+		.msg_namelen	= tolen,
+		.msg_iov	= (struct iovec*)vector,
+		.msg_iovlen	= vector_len,
+		.msg_control	= control,
+		.msg_controllen = controllen,
+		.msg_flags	= 0
+	};
+	return sendmsg (s, &msg, flags);
+#else
+	DWORD bytes_sent;
+	if (SOCKET_ERROR == WSASendTo (s, (LPWSABUF)vector, vector_len, &bytes_sent, flags, to, tolen, NULL, NULL))
+		return (ssize_t)-1;
+	return (ssize_t)bytes_sent;
+#endif
+}
+
+/* send each skb of a vector as its own datagram, with one sendmmsg() call where
+ * available.  the vector holds the linear header and any external payload of
+ * each skb in order.  sending resumes from the skb at *done, which is advanced
+ * past each skb sent such that a failed batch can be retried without
+ * duplicates.
+ *
+ * on success, returns number of bytes sent of the entire batch.  on error,
+ * including after a partial send, -1 is returned, and errno set appropriately.
+ */
+
+static
+ssize_t
+sendvectors (
+	const SOCKET			      s,
+	const struct pgm_iovec*	     restrict vector,
+	struct pgm_sk_buff_t*const*  restrict skbs,
+	const unsigned			      count,
+	unsigned*		     restrict done,
+	const int			      flags,
+	const struct sockaddr*	     restrict to,
+	const socklen_t			      tolen
+	)
+{
+	ssize_t sent = 0;
+	unsigned i, j;
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr msgv[ PGM_UDP_MAX_SEGMENTS ];
+	for (i = 0, j = 0; i < count; i++) {
+		const unsigned tpdu_vector_len = (NULL != skbs[i]->ref) ? 2 : 1;
+		memset (&msgv[i], 0, sizeof (struct mmsghdr));
+		msgv[i].msg_hdr.msg_name	= (void*)to;
+		msgv[i].msg_hdr.msg_namelen	= tolen;
+		msgv[i].msg_hdr.msg_iov		= (struct iovec*)&vector[j];
+		msgv[i].msg_hdr.msg_iovlen	= tpdu_vector_len;
+		sent += vector[j].iov_len + (2 == tpdu_vector_len ? vector[j + 1].iov_len : 0);
+		j += tpdu_vector_len;
+	}
+	while (*done < count) {
+		const int n = sendmmsg (s, &msgv[*done], count - *done, flags);
+		if (n < 0)
+			return (ssize_t)-1;
+		*done += n;
+	}
+#else
+	for (i = 0, j = 0; i < count; i++) {
+		const unsigned tpdu_vector_len = (NULL != skbs[i]->ref) ? 2 : 1;
+		if (i >= *done) {
+			if (sendvector (s, &vector[j], tpdu_vector_len, NULL, 0, flags, to, tolen) < 0)
+				return (ssize_t)-1;
+			++*done;
+		}
+		sent += vector[j].iov_len + (2 == tpdu_vector_len ? vector[j + 1].iov_len : 0);
+		j += tpdu_vector_len;
+	}
+#endif
+	return sent;
+}
+
+/* locked and rate regulated gather send of transmit window skbs, the linear
+ * header and any external payload of each skb.  more than one skb is sent as
+ * a UDP segmentation offload super-buffer where all but the last must be equal
+ * length, or otherwise as a batch of datagrams.  sends of at least
+ * zerocopy_threshold bytes use MSG_ZEROCOPY and keep a reference on each skb
+ * until the kernel completes the send.
+ *
+ * on success, returns number of bytes sent.  on error, -1 is returned, and
+ * errno set appropriately.
+ */
+
+PGM_GNUC_INTERNAL
+ssize_t
+pgm_sendto_skbv (
+	pgm_sock_t*		    restrict sock,
+	bool				     use_rate_limit,
+	pgm_rate_t*		    restrict minor_rate_control,
+	bool				     use_router_alert,
+	struct pgm_sk_buff_t*const* restrict skbs,
+	unsigned			     count,
+	const struct sockaddr*	    restrict to,
+	socklen_t			     tolen
+	)
+{
+	struct pgm_iovec vector[ 2 * PGM_UDP_MAX_SEGMENTS ];
+	unsigned vector_len = 0;
+	size_t len = 0;
+	int flags = 0;
+
+	pgm_assert( NULL != sock );
+	pgm_assert( NULL != skbs );
+	pgm_assert( count > 0 );
+	pgm_assert( count <= PGM_UDP_MAX_SEGMENTS );
+	pgm_assert( NULL != to );
+	pgm_assert( tolen > 0 );
+
+	const SOCKET send_sock = use_router_alert ? sock->send_with_router_alert_sock : sock->send_sock;
+
+	for (unsigned i = 0; i < count; i++) {
+		vector[vector_len].iov_base = skbs[i]->head;
+		vector[vector_len].iov_len  = pgm_skb_linear_length (skbs[i]);
+		len += vector[vector_len++].iov_len;
+		if (NULL != skbs[i]->ref) {
+			vector[vector_len].iov_base = skbs[i]->data;
+			vector[vector_len].iov_len  = skbs[i]->len;
+			len += vector[vector_len++].iov_len;
+		}
+	}
+
+	if (use_rate_limit)
+	{
+/* bucket adds one IP header per check, add remainder for each further TPDU */
+		const size_t rate_len = len + (count - 1) * sock->iphdr_len;
+		if (NULL == minor_rate_control)
+		{
+			if (!pgm_rate_check (&sock->rate_control, rate_len, sock->is_nonblocking))
+			{
+				pgm_set_last_sock_error (PGM_SOCK_ENOBUFS);
+				return (const ssize_t)-1;
+			}
+		}
+		else
+		{
+			if (!pgm_rate_check2 (&sock->rate_control, minor_rate_control, rate_len, sock->is_nonblocking))
+			{
+				pgm_set_last_sock_error (PGM_SOCK_ENOBUFS);
+				return (const ssize_t)-1;
+			}
+		}
+	}
+
+	void* control = NULL;
+	size_t controllen = 0;
+	bool is_batch = (count > 1);
+	unsigned batch_done = 0;		/* datagrams of the batch sent */
+#ifdef HAVE_UDP_SEGMENT
+	char aux[ CMSG_SPACE(sizeof(uint16_t)) ];
+	if (count > 1 && sock->use_udp_gso) {
+		const uint16_t segment_size = pgm_skb_tpdu_length (skbs[0]);
+		struct msghdr msg = {
+			.msg_control	= aux,
+			.msg_controllen = sizeof(aux)
+		};
+		struct cmsghdr* cmsg	= CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level	= IPPROTO_UDP;
+		cmsg->cmsg_type		= UDP_SEGMENT;
+		cmsg->cmsg_len		= CMSG_LEN(sizeof(uint16_t));
+		memcpy (CMSG_DATA(cmsg), &segment_size, sizeof(uint16_t));
+		control		= aux;
+		controllen	= sizeof(aux);
+		is_batch	= FALSE;
+	}
+#endif
+
+	if (!use_router_alert && sock->can_send_data)
+		pgm_sock_mutex_lock (sock, &sock->send_mutex);
+#ifdef HAVE_MSG_ZEROCOPY
+	struct pgm_zerocopy_t* zc = use_router_alert ? NULL : sock->zerocopy;
+/* one notification per call, not per batched datagram */
+	if (NULL != zc && !is_batch && len >= sock->zerocopy_threshold) {
+		zerocopy_release (sock);
+/* copy when completions are too far behind or the super-buffer is too scattered */
+		if ((zc->skb_tail - zc->skb_head) + count <= zc->mask + 1 &&
+		    (zc->next_id - zc->head_id) < zc->mask + 1 &&
+		    zerocopy_pages (zc, vector, vector_len) <= PGM_ZEROCOPY_MAX_FRAGS)
+			flags |= MSG_ZEROCOPY;
+	}
+#endif
+	ssize_t sent = is_batch ? sendvectors (send_sock, vector, skbs, count, &batch_done, flags, to, tolen)
+				: sendvector (send_sock, vector, vector_len, control, controllen, flags, to, tolen);
+	pgm_debug ("sendmsg returned %" PRIzd, sent);
+#ifdef HAVE_UDP_SEGMENT
+/* TPDU larger than interface MTU requires IP fragmentation which cannot be
+ * offloaded, disable and send each TPDU individually.
+ */
+	if (sent < 0 && count > 1 && !is_batch && EMSGSIZE == pgm_get_last_sock_error()) {
+		pgm_warn (_("Disabling UDP segmentation offload as TPDU exceeds interface MTU."));
+		sock->use_udp_gso = FALSE;
+		is_batch = TRUE;
+		flags = 0;
+		control = NULL;
+		controllen = 0;
+		sent = sendvectors (send_sock, vector, skbs, count, &batch_done, flags, to, tolen);
+	}
+#endif
+	if (sent < 0) {
+		int save_errno = pgm_get_last_sock_error();
+		if (PGM_UNLIKELY(save_errno != PGM_SOCK_ENETUNREACH &&	/* Network is unreachable */
+		 		 save_errno != PGM_SOCK_EHOSTUNREACH &&	/* No route to host */
+		    		 save_errno != PGM_SOCK_EAGAIN))	/* would block on non-blocking send */
+		{
+#ifdef HAVE_POLL
+/* poll for cleared socket */
+			struct pollfd p = {
+				.fd		= send_sock,
+				.events		= POLLOUT,
+				.revents	= 0
+			};
+			const int ready = poll (&p, 1, 500 /* ms */);
+#else
+			fd_set writefds;
+			FD_ZERO(&writefds);
+			FD_SET(send_sock, &writefds);
+#	ifndef _WIN32
+			const int n_fds = send_sock + 1;	/* largest fd + 1 */
+#	else
+			const int n_fds = 1;			/* count of fds */
+#	endif
+			struct timeval tv = {
+				.tv_sec  = 0,
+				.tv_usec = 500 /* ms */ * 1000
+			};
+			const int ready = select (n_fds, NULL, &writefds, NULL, &tv);
+#endif /* HAVE_POLL */
+			if (ready > 0)
+			{
+				sent = is_batch ? sendvectors (send_sock, vector, skbs, count, &batch_done, flags, to, tolen)
+						: sendvector (send_sock, vector, vector_len, control, controllen, flags, to, tolen);
+				if ( sent < 0 )
+				{
+					char errbuf[1024];
+					char toaddr[INET6_ADDRSTRLEN];
+					save_errno = pgm_get_last_sock_error();
+					pgm_sockaddr_ntop (to, toaddr, sizeof(toaddr));
+					pgm_warn (_("sendmsg() %s failed: %s"),
+						toaddr,
+						pgm_sock_strerror_s (errbuf, sizeof (errbuf), save_errno));
+				}
+			}
+			else if (ready == 0)
+			{
+				char toaddr[INET6_ADDRSTRLEN];
+				pgm_sockaddr_ntop (to, toaddr, sizeof(toaddr));
+				pgm_warn (_("sendmsg() %s failed: socket timeout."), toaddr);
+			}
+			else
+			{
+				char errbuf[1024];
+				save_errno = pgm_get_last_sock_error();
+				pgm_warn (_("blocked socket failed: %s"),
+					  pgm_sock_strerror_s (errbuf, sizeof (errbuf), save_errno));
+			}
+		}
+	}
+
+#ifdef HAVE_MSG_ZEROCOPY
+/* successful sends take the next kernel notification id */
+	if (sent >= 0 && (flags & MSG_ZEROCOPY)) {
+		struct pgm_zerocopy_send_t* send = &zc->send[ zc->next_id++ & zc->mask ];
+		send->count		= count;
+		send->is_complete	= FALSE;
+		for (unsigned i = 0; i < count; i++)
+			zc->skb[ zc->skb_tail++ & zc->mask ] = pgm_skb_get (skbs[i]);
+	}
+#endif
+	if (!use_router_alert && sock->can_send_data)
+		pgm_sock_mutex_unlock (sock, &sock->send_mutex);
 	return sent;
 }
 
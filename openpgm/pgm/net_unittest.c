@@ -47,10 +47,21 @@ ssize_t mock_sendto (int, const void*, size_t, int, const struct sockaddr*, sock
 int mock_sendto (SOCKET, const char*, int, int, const struct sockaddr*, int);
 int mock_select (int, fd_set*, fd_set*, fd_set*, struct timeval*);
 #endif
+#ifdef HAVE_SENDMMSG
+struct mmsghdr;
+int mock_sendmmsg (int, struct mmsghdr*, unsigned int, int);
+static unsigned mock_sendmmsg_calls;
+static unsigned mock_sendmmsg_max_vlen[4];	/* datagrams accepted per call, 0 fails */
+static unsigned mock_sendmmsg_vlen[4];
+#endif
+static int mock_poll_ready = 0;
 
 
 #define pgm_rate_check		mock_pgm_rate_check
 #define sendto			mock_sendto
+#ifdef HAVE_SENDMMSG
+#	define sendmmsg		mock_sendmmsg
+#endif
 #define poll			mock_poll
 #define select			mock_select
 #define fcntl			mock_fcntl
@@ -202,6 +213,34 @@ mock_sendto (
 	return len;
 }
 
+#ifdef HAVE_SENDMMSG
+int
+mock_sendmmsg (
+	int			s,
+	struct mmsghdr*		msgvec,
+	unsigned int		vlen,
+	int			flags
+	)
+{
+	g_debug ("mock_sendmmsg (s:%i msgvec:%p vlen:%u flags:%s)",
+		s, (gpointer)msgvec, vlen, flags_string (flags));
+	g_assert (mock_sendmmsg_calls < G_N_ELEMENTS(mock_sendmmsg_vlen));
+	mock_sendmmsg_vlen[mock_sendmmsg_calls] = vlen;
+	const unsigned max_vlen = mock_sendmmsg_max_vlen[mock_sendmmsg_calls++];
+	if (0 == max_vlen) {
+		errno = ENOBUFS;
+		return -1;
+	}
+	const unsigned n = MIN(vlen, max_vlen);
+	for (unsigned i = 0; i < n; i++) {
+		msgvec[i].msg_len = 0;
+		for (size_t j = 0; j < msgvec[i].msg_hdr.msg_iovlen; j++)
+			msgvec[i].msg_len += msgvec[i].msg_hdr.msg_iov[j].iov_len;
+	}
+	return n;
+}
+#endif
+
 #ifdef HAVE_POLL
 int
 mock_poll (
@@ -212,7 +251,7 @@ mock_poll (
 {
 	g_debug ("mock_poll (fds:%p nfds:%d timeout:%d)",
 		(gpointer)fds, (int)nfds, timeout);
-	return 0;
+	return mock_poll_ready;
 }
 #else
 int
@@ -226,7 +265,7 @@ mock_select (
 {
 	g_debug ("mock_select (nfds:%d readfds:%p writefds:%p exceptfds:%p timeout:%p)",
 		nfds, (gpointer)readfds, (gpointer)writefds, (gpointer)exceptfds, (gpointer)timeout);
-	return 0;
+	return mock_poll_ready;
 }
 #endif
 
@@ -350,6 +389,128 @@ START_TEST (test_sendto_fail_005)
 }
 END_TEST
 
+/* target:
+ *	ssize_t
+ *	pgm_sendto_skbv (
+ *		pgm_sock_t*			sock,
+ *		bool				use_rate_limit,
+ *		pgm_rate_t*			minor_rate_control,
+ *		bool				use_router_alert,
+ *		struct pgm_sk_buff_t*const*	skbs,
+ *		unsigned			count,
+ *		const struct sockaddr*		to,
+ *		socklen_t			tolen
+ *	)
+ */
+
+#ifdef HAVE_SENDMMSG
+static
+struct pgm_sk_buff_t*
+generate_skb (
+	const uint16_t		len
+	)
+{
+	struct pgm_sk_buff_t* skb = pgm_alloc_skb (len);
+	pgm_skb_put (skb, len);
+	return skb;
+}
+
+/* batch of unequal length TPDUs in one call */
+START_TEST (test_sendto_skbv_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	struct pgm_sk_buff_t* skbs[3] = { generate_skb (100), generate_skb (100), generate_skb (42) };
+	struct sockaddr_in addr = {
+		.sin_family		= AF_INET,
+		.sin_addr.s_addr	= inet_addr ("172.12.90.1")
+	};
+	const unsigned max_vlen[] = { 3 };
+	memcpy (mock_sendmmsg_max_vlen, max_vlen, sizeof (max_vlen));
+	mock_sendmmsg_calls = 0;
+	gssize len = pgm_sendto_skbv (sock, FALSE, NULL, FALSE, skbs, G_N_ELEMENTS(skbs), (struct sockaddr*)&addr, sizeof(addr));
+	fail_unless (242 == len, "sendto_skbv underrun");
+	fail_unless (1 == mock_sendmmsg_calls, "sendmmsg calls");
+	fail_unless (3 == mock_sendmmsg_vlen[0], "sendmmsg vlen");
+}
+END_TEST
+
+/* partial batch is resubmitted from the first unsent TPDU */
+START_TEST (test_sendto_skbv_pass_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	struct pgm_sk_buff_t* skbs[3] = { generate_skb (100), generate_skb (100), generate_skb (42) };
+	struct sockaddr_in addr = {
+		.sin_family		= AF_INET,
+		.sin_addr.s_addr	= inet_addr ("172.12.90.1")
+	};
+	const unsigned max_vlen[] = { 2, 1 };
+	memcpy (mock_sendmmsg_max_vlen, max_vlen, sizeof (max_vlen));
+	mock_sendmmsg_calls = 0;
+	gssize len = pgm_sendto_skbv (sock, FALSE, NULL, FALSE, skbs, G_N_ELEMENTS(skbs), (struct sockaddr*)&addr, sizeof(addr));
+	fail_unless (242 == len, "sendto_skbv underrun");
+	fail_unless (2 == mock_sendmmsg_calls, "sendmmsg calls");
+	fail_unless (3 == mock_sendmmsg_vlen[0], "sendmmsg vlen");
+	fail_unless (1 == mock_sendmmsg_vlen[1], "sendmmsg vlen");
+}
+END_TEST
+
+/* error after a partial batch retries the unsent TPDUs once the socket clears */
+START_TEST (test_sendto_skbv_pass_003)
+{
+	pgm_sock_t* sock = generate_sock ();
+	struct pgm_sk_buff_t* skbs[3] = { generate_skb (100), generate_skb (100), generate_skb (42) };
+	struct sockaddr_in addr = {
+		.sin_family		= AF_INET,
+		.sin_addr.s_addr	= inet_addr ("172.12.90.1")
+	};
+	const unsigned max_vlen[] = { 2, 0, 3 };
+	memcpy (mock_sendmmsg_max_vlen, max_vlen, sizeof (max_vlen));
+	mock_sendmmsg_calls = 0;
+	mock_poll_ready = 1;
+	gssize len = pgm_sendto_skbv (sock, FALSE, NULL, FALSE, skbs, G_N_ELEMENTS(skbs), (struct sockaddr*)&addr, sizeof(addr));
+	mock_poll_ready = 0;
+	fail_unless (242 == len, "sendto_skbv underrun");
+	fail_unless (3 == mock_sendmmsg_calls, "sendmmsg calls");
+	fail_unless (1 == mock_sendmmsg_vlen[1], "sendmmsg vlen");
+	fail_unless (1 == mock_sendmmsg_vlen[2], "sendmmsg vlen");
+}
+END_TEST
+
+/* partial batch is an error when the socket does not clear */
+START_TEST (test_sendto_skbv_fail_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	struct pgm_sk_buff_t* skbs[3] = { generate_skb (100), generate_skb (100), generate_skb (42) };
+	struct sockaddr_in addr = {
+		.sin_family		= AF_INET,
+		.sin_addr.s_addr	= inet_addr ("172.12.90.1")
+	};
+	const unsigned max_vlen[] = { 2, 0 };
+	memcpy (mock_sendmmsg_max_vlen, max_vlen, sizeof (max_vlen));
+	mock_sendmmsg_calls = 0;
+	gssize len = pgm_sendto_skbv (sock, FALSE, NULL, FALSE, skbs, G_N_ELEMENTS(skbs), (struct sockaddr*)&addr, sizeof(addr));
+	fail_unless (-1 == len, "sendto_skbv succeeded");
+	fail_unless (2 == mock_sendmmsg_calls, "sendmmsg calls");
+}
+END_TEST
+
+/* nothing sent */
+START_TEST (test_sendto_skbv_fail_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	struct pgm_sk_buff_t* skbs[3] = { generate_skb (100), generate_skb (100), generate_skb (42) };
+	struct sockaddr_in addr = {
+		.sin_family		= AF_INET,
+		.sin_addr.s_addr	= inet_addr ("172.12.90.1")
+	};
+	memset (mock_sendmmsg_max_vlen, 0, sizeof (mock_sendmmsg_max_vlen));
+	mock_sendmmsg_calls = 0;
+	gssize len = pgm_sendto_skbv (sock, FALSE, NULL, FALSE, skbs, G_N_ELEMENTS(skbs), (struct sockaddr*)&addr, sizeof(addr));
+	fail_unless (-1 == len, "sendto_skbv succeeded");
+}
+END_TEST
+#endif /* HAVE_SENDMMSG */
+
 /* target:
  * 	int
  * 	pgm_set_nonblocking (
@@ -392,6 +553,16 @@ make_test_suite (void)
 	tcase_add_test_raise_signal (tc_sendto, test_sendto_fail_005, SIGABRT);
 #endif
 
+#ifdef HAVE_SENDMMSG
+	TCase* tc_sendto_skbv = tcase_create ("sendto-skbv");
+	suite_add_tcase (s, tc_sendto_skbv);
+	tcase_add_test (tc_sendto_skbv, test_sendto_skbv_pass_001);
+	tcase_add_test (tc_sendto_skbv, test_sendto_skbv_pass_002);
+	tcase_add_test (tc_sendto_skbv, test_sendto_skbv_pass_003);
+	tcase_add_test (tc_sendto_skbv, test_sendto_skbv_fail_001);
+	tcase_add_test (tc_sendto_skbv, test_sendto_skbv_fail_002);
+#endif
+
 	TCase* tc_set_nonblocking = tcase_create ("set-nonblocking");
 	suite_add_tcase (s, tc_set_nonblocking);
 	tcase_add_test (tc_set_nonblocking, test_set_nonblocking_pass_001);
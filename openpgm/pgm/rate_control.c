@@ -25,6 +25,21 @@
 #include <impl/framework.h>
 
 
+/* cached time stamp, not before the last check of a bucket shared with
+ * another thread.
+ */
+
+static inline
+pgm_time_t
+pgm_rate_now (
+	const pgm_rate_t*	bucket
+	)
+{
+	const pgm_time_t now = pgm_time_cached();
+	return pgm_time_after (bucket->last_rate_check, now) ? bucket->last_rate_check : now;
+}
+
+
 /* create machinery for rate regulation.
  * the rate_per_sec is ammortized over millisecond time periods.
  *
@@ -98,7 +113,7 @@ pgm_rate_check2 (
 	if (0 != major_bucket->rate_per_sec)
 	{
 		pgm_spinlock_lock (&major_bucket->spinlock);
-		now = pgm_time_update_now();
+		now = pgm_rate_now (major_bucket);
 
 		if (major_bucket->rate_per_msec)
 		{
@@ -134,7 +149,7 @@ pgm_rate_check2 (
 			ssize_t sleep_amount;
 			do {
 				pgm_thread_yield();
-				now = pgm_time_update_now();
+				now = pgm_time_refresh();
 				sleep_amount = (ssize_t)pgm_to_secs (major_bucket->rate_per_sec * (now - wait_start));
 			} while (sleep_amount + new_major_limit < 0);
 			new_major_limit += sleep_amount;
@@ -143,11 +158,13 @@ pgm_rate_check2 (
 	else
 	{
 /* ensure we have a timestamp */
-		now = pgm_time_update_now();
+		now = pgm_time_cached();
 	}
 
 	if (0 != minor_bucket->rate_per_sec)
 	{
+		if (PGM_UNLIKELY(pgm_time_after (minor_bucket->last_rate_check, now)))
+			now = minor_bucket->last_rate_check;
 		if (minor_bucket->rate_per_msec)
 		{
 			const pgm_time_t time_since_last_rate_check = now - minor_bucket->last_rate_check;
@@ -194,7 +211,7 @@ pgm_rate_check2 (
 		ssize_t sleep_amount;
 		do {
 			pgm_thread_yield();
-			now = pgm_time_update_now();
+			now = pgm_time_refresh();
 			sleep_amount = (ssize_t)pgm_to_secs (minor_bucket->rate_per_sec * (now - minor_bucket->last_rate_check));
 		} while (sleep_amount + minor_bucket->rate_limit < 0);
 		minor_bucket->rate_limit += sleep_amount;
@@ -222,7 +239,7 @@ pgm_rate_check (
 		return TRUE;
 
 	pgm_spinlock_lock (&bucket->spinlock);
-	pgm_time_t now = pgm_time_update_now();
+	pgm_time_t now = pgm_rate_now (bucket);
 
 	if (bucket->rate_per_msec)
 	{
@@ -259,7 +276,7 @@ pgm_rate_check (
 		ssize_t sleep_amount;
 		do {
 			pgm_thread_yield();
-			now = pgm_time_update_now();
+			now = pgm_time_refresh();
 			sleep_amount = (ssize_t)pgm_to_secs (bucket->rate_per_sec * (now - bucket->last_rate_check));
 		} while (sleep_amount + bucket->rate_limit < 0);
 		bucket->rate_limit += sleep_amount;
@@ -44,6 +44,7 @@
 static pgm_time_t mock_pgm_time_now = 0x1;
 static pgm_time_t _mock_pgm_time_update_now (void);
 pgm_time_update_func mock_pgm_time_update_now = _mock_pgm_time_update_now;
+PGM_THREAD_LOCAL struct pgm_time_cache_t pgm_time_cache;
 
 
 /* mock functions for external references */
@@ -0,0 +1,702 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * Multi-socket event reactor.  Each worker thread owns one epoll set and one
+ * timer heap ordered on every socket's next_poll, sockets are pinned to the
+ * least loaded worker when added.
+ *
+ * Copyright (c) 2006-2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+#include <errno.h>
+#include <limits.h>
+#ifdef HAVE_EPOLL_CTL
+#	include <sys/epoll.h>
+#endif
+#include <impl/i18n.h>
+#include <impl/framework.h>
+#include <impl/socket.h>
+#include <impl/timer.h>
+#include <pgm/reactor.h>
+
+
+//#define REACTOR_DEBUG
+
+/* messages returned by one pgm_recvmsgv() call */
+#define PGM_REACTOR_MSGV_LEN		64
+
+/* pgm_recvmsgv() calls per socket before servicing the next ready socket */
+#define PGM_REACTOR_QUANTUM		4
+
+/* events returned by one epoll_wait() call */
+#define PGM_REACTOR_MAX_EVENTS		256
+
+/* re-check interval for a socket whose timer could not advance, e.g. blocked
+ * on the rate limit.
+ */
+#define PGM_REACTOR_MIN_IVL		pgm_msecs (1)
+
+#ifdef HAVE_EPOLL_CTL
+struct pgm_reactor_worker_t;
+
+struct pgm_reactor_entry_t {
+	pgm_sock_t*			sock;
+	pgm_reactor_func_t		func;
+	void*				user_data;
+	pgm_time_t			expiry;		/* heap key from next_poll */
+	unsigned			heap_index;
+	bool				is_removed;
+	struct pgm_reactor_entry_t*	next;		/* removed list */
+};
+
+struct pgm_reactor_worker_t {
+	pgm_reactor_t*			reactor;
+	int				epfd;
+	pgm_notify_t			wake_notify;
+	pgm_mutex_t			mutex;		/* heap and entry state */
+	pgm_cond_t			dispatch_cond;	/* busy entry released */
+	struct pgm_reactor_entry_t*	busy_entry;	/* dispatch in progress */
+	struct pgm_reactor_entry_t**	heap;		/* binary min-heap on expiry */
+	unsigned			heap_len;
+	unsigned			heap_size;
+	struct pgm_reactor_entry_t*	removed;	/* freed before the next wait */
+	pthread_t			thread;
+	struct pgm_msgv_t		msgv[PGM_REACTOR_MSGV_LEN];
+};
+
+struct pgm_reactor_t {
+	unsigned			n_workers;
+	volatile uint32_t		is_running;
+	struct pgm_reactor_worker_t*	workers;
+};
+
+/* worker running on the calling thread */
+static PGM_THREAD_LOCAL struct pgm_reactor_worker_t* pgm_reactor_self;
+
+static
+void
+heap_swap (
+	struct pgm_reactor_worker_t* const	worker,
+	const unsigned				i,
+	const unsigned				j
+	)
+{
+	struct pgm_reactor_entry_t* entry = worker->heap[i];
+	worker->heap[i] = worker->heap[j];
+	worker->heap[j] = entry;
+	worker->heap[i]->heap_index = i;
+	worker->heap[j]->heap_index = j;
+}
+
+static
+void
+heap_sift_up (
+	struct pgm_reactor_worker_t* const	worker,
+	unsigned				i
+	)
+{
+	while (i > 0) {
+		const unsigned parent = (i - 1) / 2;
+		if (!pgm_time_after (worker->heap[parent]->expiry, worker->heap[i]->expiry))
+			break;
+		heap_swap (worker, i, parent);
+		i = parent;
+	}
+}
+
+static
+void
+heap_sift_down (
+	struct pgm_reactor_worker_t* const	worker,
+	unsigned				i
+	)
+{
+	for (;;) {
+		const unsigned left = (2 * i) + 1, right = left + 1;
+		unsigned next = i;
+		if (left < worker->heap_len &&
+		    pgm_time_after (worker->heap[next]->expiry, worker->heap[left]->expiry))
+			next = left;
+		if (right < worker->heap_len &&
+		    pgm_time_after (worker->heap[next]->expiry, worker->heap[right]->expiry))
+			next = right;
+		if (next == i)
+			break;
+		heap_swap (worker, i, next);
+		i = next;
+	}
+}
+
+static
+void
+heap_push (
+	struct pgm_reactor_worker_t* const	worker,
+	struct pgm_reactor_entry_t* const	entry
+	)
+{
+	if (worker->heap_len == worker->heap_size) {
+		worker->heap_size = worker->heap_size ? (2 * worker->heap_size) : 64;
+		worker->heap = pgm_realloc (worker->heap, worker->heap_size * sizeof (struct pgm_reactor_entry_t*));
+	}
+	entry->heap_index = worker->heap_len;
+	worker->heap[worker->heap_len++] = entry;
+	heap_sift_up (worker, entry->heap_index);
+}
+
+static
+void
+heap_remove (
+	struct pgm_reactor_worker_t* const	worker,
+	struct pgm_reactor_entry_t* const	entry
+	)
+{
+	const unsigned i = entry->heap_index;
+	const unsigned last = --worker->heap_len;
+	if (i != last) {
+		worker->heap[i] = worker->heap[last];
+		worker->heap[i]->heap_index = i;
+		heap_sift_down (worker, i);
+		heap_sift_up (worker, i);
+	}
+}
+
+static
+void
+heap_update (
+	struct pgm_reactor_worker_t* const	worker,
+	struct pgm_reactor_entry_t* const	entry,
+	const pgm_time_t			expiry
+	)
+{
+	const bool is_earlier = pgm_time_after (entry->expiry, expiry);
+	entry->expiry = expiry;
+	if (is_earlier)
+		heap_sift_up (worker, entry->heap_index);
+	else
+		heap_sift_down (worker, entry->heap_index);
+}
+
+/* register the receive socket and notification channels of a PGM socket,
+ * level-triggered as pgm_recvmsgv() leaves the pending channel set while
+ * data remains.
+ *
+ * returns 0 on success, -1 on failure and sets errno appropriately.
+ */
+
+static
+int
+reactor_epoll_ctl (
+	struct pgm_reactor_worker_t* const	worker,
+	struct pgm_reactor_entry_t* const	entry,
+	const int				op	/* EPOLL_CTL_ADD, EPOLL_CTL_DEL */
+	)
+{
+	pgm_sock_t* const sock = entry->sock;
+	struct epoll_event event;
+	int retval;
+
+	event.events = EPOLLIN;
+	event.data.ptr = entry;
+	retval = epoll_ctl (worker->epfd, op, sock->recv_sock, &event);
+	if (retval && EPOLL_CTL_DEL != op)
+		return retval;
+	if (sock->can_send_data) {
+		retval = epoll_ctl (worker->epfd, op, pgm_notify_get_socket (&sock->rdata_notify), &event);
+		if (retval && EPOLL_CTL_DEL != op)
+			return retval;
+	}
+	return epoll_ctl (worker->epfd, op, pgm_notify_get_socket (&sock->pending_notify), &event);
+}
+
+/* move the socket in the timer heap to its next timer expiration, worker
+ * mutex held.
+ */
+
+static
+void
+reactor_rekey (
+	struct pgm_reactor_worker_t* const	worker,
+	struct pgm_reactor_entry_t* const	entry,
+	const pgm_time_t			now
+	)
+{
+	pgm_sock_t* const sock = entry->sock;
+	pgm_time_t expiry;
+
+	pgm_timer_lock (sock);
+	expiry = sock->next_poll;
+	pgm_timer_unlock (sock);
+	if (!pgm_time_after (expiry, now))
+		expiry = now + PGM_REACTOR_MIN_IVL;
+	heap_update (worker, entry, expiry);
+}
+
+/* read a batch of messages from one socket, pgm_recvmsgv() also runs any
+ * expired timers.
+ */
+
+static
+void
+reactor_dispatch (
+	struct pgm_reactor_worker_t* const	worker,
+	struct pgm_reactor_entry_t* const	entry
+	)
+{
+	pgm_sock_t* const sock = entry->sock;
+
+	pgm_mutex_lock (&worker->mutex);
+	if (entry->is_removed) {
+		pgm_mutex_unlock (&worker->mutex);
+		return;
+	}
+	worker->busy_entry = entry;
+	pgm_mutex_unlock (&worker->mutex);
+
+	for (unsigned i = 0; i < PGM_REACTOR_QUANTUM && !entry->is_removed; i++)
+	{
+		size_t bytes_read = 0;
+		const int status = pgm_recvmsgv (sock,
+						 worker->msgv,
+						 PGM_N_ELEMENTS(worker->msgv),
+						 MSG_DONTWAIT,
+						 &bytes_read,
+						 NULL);
+		if (PGM_IO_STATUS_NORMAL == status) {
+			entry->func (sock, status, worker->msgv, bytes_read, entry->user_data);
+			continue;
+		}
+		if (PGM_IO_STATUS_RESET == status ||
+		    PGM_IO_STATUS_EOF == status ||
+		    PGM_IO_STATUS_ERROR == status)
+		{
+			entry->func (sock, status, NULL, 0, entry->user_data);
+		}
+		break;
+	}
+
+	pgm_mutex_lock (&worker->mutex);
+	worker->busy_entry = NULL;
+	if (entry->is_removed)
+		pgm_cond_broadcast (&worker->dispatch_cond);
+	else
+		reactor_rekey (worker, entry, pgm_time_update_now());
+	pgm_mutex_unlock (&worker->mutex);
+}
+
+/* release sockets removed since the last wait, no events can reference them
+ * any more.  worker mutex held.
+ */
+
+static
+void
+reactor_free_removed (
+	struct pgm_reactor_worker_t* const	worker
+	)
+{
+	while (worker->removed) {
+		struct pgm_reactor_entry_t* next = worker->removed->next;
+		pgm_free (worker->removed);
+		worker->removed = next;
+	}
+}
+
+static
+void
+reactor_worker_run (
+	struct pgm_reactor_worker_t* const	worker
+	)
+{
+	struct epoll_event events[PGM_REACTOR_MAX_EVENTS];
+
+	pgm_reactor_self = worker;
+	while (pgm_atomic_read32 (&worker->reactor->is_running))
+	{
+		int timeout = -1;
+
+		pgm_mutex_lock (&worker->mutex);
+		reactor_free_removed (worker);
+		if (worker->heap_len > 0) {
+			const pgm_time_t now = pgm_time_update_now();
+			const pgm_time_t expiry = worker->heap[0]->expiry;
+/* round up to avoid waking before the timer */
+			timeout = pgm_time_after (expiry, now) ? (int)MIN(INT_MAX, pgm_to_msecs (expiry - now + 999)) : 0;
+		}
+		pgm_mutex_unlock (&worker->mutex);
+
+		const int ready = epoll_wait (worker->epfd, events, PGM_N_ELEMENTS(events), timeout);
+		if (ready < 0 && EINTR != errno) {
+			char errbuf[1024];
+			pgm_warn (_("Waiting for reactor events: %s"),
+				  pgm_strerror_s (errbuf, sizeof (errbuf), errno));
+			break;
+		}
+		for (int i = 0; i < ready; i++) {
+			struct pgm_reactor_entry_t* entry = events[i].data.ptr;
+			if (NULL == entry) {
+				pgm_notify_clear (&worker->wake_notify);
+				continue;
+			}
+			reactor_dispatch (worker, entry);
+		}
+
+/* expired timers, dispatch always moves a socket past now */
+		const pgm_time_t now = pgm_time_update_now();
+		pgm_mutex_lock (&worker->mutex);
+		while (worker->heap_len > 0 &&
+		       !pgm_time_after (worker->heap[0]->expiry, now))
+		{
+			struct pgm_reactor_entry_t* entry = worker->heap[0];
+			pgm_mutex_unlock (&worker->mutex);
+			reactor_dispatch (worker, entry);
+			pgm_mutex_lock (&worker->mutex);
+		}
+		pgm_mutex_unlock (&worker->mutex);
+	}
+	pgm_reactor_self = NULL;
+}
+
+static
+void*
+reactor_routine (
+	void*		arg
+	)
+{
+	reactor_worker_run ((struct pgm_reactor_worker_t*)arg);
+	return NULL;
+}
+
+/* create a reactor with a number of workers, each running on its own thread
+ * from pgm_reactor_run().
+ *
+ * returns TRUE on success, returns FALSE on failure and sets error appropriately.
+ */
+
+bool
+pgm_reactor_create (
+	pgm_reactor_t**	     restrict reactor,
+	const unsigned		      workers,
+	pgm_error_t**	     restrict error
+	)
+{
+	pgm_reactor_t* new_reactor;
+
+	pgm_return_val_if_fail (NULL != reactor, FALSE);
+	pgm_return_val_if_fail (workers > 0, FALSE);
+
+	new_reactor = pgm_new0 (pgm_reactor_t, 1);
+	new_reactor->workers = pgm_new0 (struct pgm_reactor_worker_t, workers);
+	for (unsigned i = 0; i < workers; i++)
+	{
+		struct pgm_reactor_worker_t* worker = &new_reactor->workers[i];
+		struct epoll_event event;
+
+		worker->reactor = new_reactor;
+		worker->epfd = epoll_create1 (EPOLL_CLOEXEC);
+		if (-1 == worker->epfd) {
+			const int save_errno = errno;
+			char errbuf[1024];
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_ENGINE,
+				       pgm_error_from_errno (save_errno),
+				       _("Creating reactor event set: %s"),
+				       pgm_strerror_s (errbuf, sizeof (errbuf), save_errno));
+			goto err_destroy;
+		}
+		if (0 != pgm_notify_init (&worker->wake_notify)) {
+			const int save_errno = pgm_get_last_sock_error();
+			char errbuf[1024];
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_ENGINE,
+				       pgm_error_from_sock_errno (save_errno),
+				       _("Creating reactor notification channel: %s"),
+				       pgm_sock_strerror_s (errbuf, sizeof (errbuf), save_errno));
+			close (worker->epfd);
+			goto err_destroy;
+		}
+		event.events = EPOLLIN;
+		event.data.ptr = NULL;
+		if (0 != epoll_ctl (worker->epfd, EPOLL_CTL_ADD, pgm_notify_get_socket (&worker->wake_notify), &event)) {
+			const int save_errno = errno;
+			char errbuf[1024];
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_ENGINE,
+				       pgm_error_from_errno (save_errno),
+				       _("Adding reactor notification channel: %s"),
+				       pgm_strerror_s (errbuf, sizeof (errbuf), save_errno));
+			pgm_notify_destroy (&worker->wake_notify);
+			close (worker->epfd);
+			goto err_destroy;
+		}
+		pgm_mutex_init (&worker->mutex);
+		pgm_cond_init (&worker->dispatch_cond);
+		new_reactor->n_workers++;
+	}
+	*reactor = new_reactor;
+	return TRUE;
+
+err_destroy:
+	pgm_reactor_destroy (new_reactor);
+	return FALSE;
+}
+
+/* add a connected PGM socket, received messages, resets and errors are passed
+ * to func with user_data on a worker thread.  the socket must not be read
+ * elsewhere until removed.
+ *
+ * returns TRUE on success, returns FALSE on failure and sets error appropriately.
+ */
+
+bool
+pgm_reactor_add (
+	pgm_reactor_t*	     restrict reactor,
+	pgm_sock_t*	     restrict sock,
+	pgm_reactor_func_t	      func,
+	void*			      user_data,
+	pgm_error_t**	     restrict error
+	)
+{
+	struct pgm_reactor_worker_t* worker;
+	struct pgm_reactor_entry_t* entry;
+
+	pgm_return_val_if_fail (NULL != reactor, FALSE);
+	pgm_return_val_if_fail (NULL != sock, FALSE);
+	pgm_return_val_if_fail (NULL != func, FALSE);
+	pgm_return_val_if_fail (sock->is_connected, FALSE);
+
+/* pin to the least loaded worker */
+	worker = &reactor->workers[0];
+	for (unsigned i = 1; i < reactor->n_workers; i++)
+		if (reactor->workers[i].heap_len < worker->heap_len)
+			worker = &reactor->workers[i];
+
+	entry = pgm_new0 (struct pgm_reactor_entry_t, 1);
+	entry->sock	 = sock;
+	entry->func	 = func;
+	entry->user_data = user_data;
+
+	pgm_mutex_lock (&worker->mutex);
+	if (0 != reactor_epoll_ctl (worker, entry, EPOLL_CTL_ADD)) {
+		const int save_errno = errno;
+		char errbuf[1024];
+		reactor_epoll_ctl (worker, entry, EPOLL_CTL_DEL);
+		pgm_mutex_unlock (&worker->mutex);
+		pgm_free (entry);
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       pgm_error_from_errno (save_errno),
+			       _("Adding socket to reactor: %s"),
+			       pgm_strerror_s (errbuf, sizeof (errbuf), save_errno));
+		return FALSE;
+	}
+	pgm_timer_lock (sock);
+	entry->expiry = sock->next_poll;
+	pgm_timer_unlock (sock);
+	heap_push (worker, entry);
+	pgm_mutex_unlock (&worker->mutex);
+
+/* recalculate the worker timeout */
+	pgm_notify_send (&worker->wake_notify);
+	return TRUE;
+}
+
+/* remove a socket before closing it.  waits for a callback in progress on
+ * another worker thread, a callback may remove its own socket.
+ *
+ * returns TRUE on success, returns FALSE if the socket was not found.
+ */
+
+bool
+pgm_reactor_remove (
+	pgm_reactor_t*	     restrict reactor,
+	pgm_sock_t*	     restrict sock
+	)
+{
+	pgm_return_val_if_fail (NULL != reactor, FALSE);
+	pgm_return_val_if_fail (NULL != sock, FALSE);
+
+	for (unsigned i = 0; i < reactor->n_workers; i++)
+	{
+		struct pgm_reactor_worker_t* worker = &reactor->workers[i];
+
+		pgm_mutex_lock (&worker->mutex);
+		for (unsigned j = 0; j < worker->heap_len; j++)
+		{
+			struct pgm_reactor_entry_t* entry = worker->heap[j];
+			if (entry->sock != sock)
+				continue;
+			reactor_epoll_ctl (worker, entry, EPOLL_CTL_DEL);
+			heap_remove (worker, entry);
+			entry->is_removed = TRUE;
+			entry->next = worker->removed;
+			worker->removed = entry;
+			while (entry == worker->busy_entry && pgm_reactor_self != worker)
+				pgm_cond_wait_mutex (&worker->dispatch_cond, &worker->mutex);
+			pgm_mutex_unlock (&worker->mutex);
+			return TRUE;
+		}
+		pgm_mutex_unlock (&worker->mutex);
+	}
+	return FALSE;
+}
+
+/* run the first worker on the calling thread and the remainder on new threads
+ * until pgm_reactor_stop() is called.
+ *
+ * returns TRUE on success, returns FALSE on failure and sets error appropriately.
+ */
+
+bool
+pgm_reactor_run (
+	pgm_reactor_t*	     restrict reactor,
+	pgm_error_t**	     restrict error
+	)
+{
+	unsigned started;
+
+	pgm_return_val_if_fail (NULL != reactor, FALSE);
+
+	pgm_atomic_write32 (&reactor->is_running, 1);
+	for (started = 1; started < reactor->n_workers; started++)
+	{
+		const int status = pthread_create (&reactor->workers[started].thread, NULL, &reactor_routine, &reactor->workers[started]);
+		if (0 != status) {
+			char errbuf[1024];
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_ENGINE,
+				       pgm_error_from_errno (status),
+				       _("Creating reactor thread: %s"),
+				       pgm_strerror_s (errbuf, sizeof (errbuf), status));
+			pgm_reactor_stop (reactor);
+			break;
+		}
+	}
+	if (started == reactor->n_workers)
+		reactor_worker_run (&reactor->workers[0]);
+	for (unsigned i = 1; i < started; i++)
+		pthread_join (reactor->workers[i].thread, NULL);
+	return (started == reactor->n_workers);
+}
+
+/* stop all workers, pgm_reactor_run() returns once each has finished its
+ * current pass.  safe to call from a callback.
+ */
+
+void
+pgm_reactor_stop (
+	pgm_reactor_t*		reactor
+	)
+{
+	pgm_return_if_fail (NULL != reactor);
+
+	pgm_atomic_write32 (&reactor->is_running, 0);
+	for (unsigned i = 0; i < reactor->n_workers; i++)
+		pgm_notify_send (&reactor->workers[i].wake_notify);
+}
+
+/* destroy a stopped reactor, sockets remaining are not closed.
+ */
+
+void
+pgm_reactor_destroy (
+	pgm_reactor_t*		reactor
+	)
+{
+	pgm_return_if_fail (NULL != reactor);
+
+	for (unsigned i = 0; i < reactor->n_workers; i++)
+	{
+		struct pgm_reactor_worker_t* worker = &reactor->workers[i];
+		for (unsigned j = 0; j < worker->heap_len; j++)
+			pgm_free (worker->heap[j]);
+		reactor_free_removed (worker);
+		pgm_free (worker->heap);
+		pgm_cond_free (&worker->dispatch_cond);
+		pgm_mutex_free (&worker->mutex);
+		pgm_notify_destroy (&worker->wake_notify);
+		close (worker->epfd);
+	}
+	pgm_free (reactor->workers);
+	pgm_free (reactor);
+}
+
+#else /* !HAVE_EPOLL_CTL */
+
+bool
+pgm_reactor_create (
+	pgm_reactor_t**	     restrict reactor,
+	const unsigned		      workers,
+	pgm_error_t**	     restrict error
+	)
+{
+	pgm_return_val_if_fail (NULL != reactor, FALSE);
+	pgm_set_error (error,
+		       PGM_ERROR_DOMAIN_ENGINE,
+		       PGM_ERROR_NOSYS,
+		       _("Reactor requires epoll."));
+	return FALSE;
+}
+
+bool
+pgm_reactor_add (
+	pgm_reactor_t*	     restrict reactor,
+	pgm_sock_t*	     restrict sock,
+	pgm_reactor_func_t	      func,
+	void*			      user_data,
+	pgm_error_t**	     restrict error
+	)
+{
+	pgm_return_val_if_reached (FALSE);
+}
+
+bool
+pgm_reactor_remove (
+	pgm_reactor_t*	     restrict reactor,
+	pgm_sock_t*	     restrict sock
+	)
+{
+	pgm_return_val_if_reached (FALSE);
+}
+
+bool
+pgm_reactor_run (
+	pgm_reactor_t*	     restrict reactor,
+	pgm_error_t**	     restrict error
+	)
+{
+	pgm_return_val_if_reached (FALSE);
+}
+
+void
+pgm_reactor_stop (
+	pgm_reactor_t*		reactor
+	)
+{
+	pgm_return_if_reached ();
+}
+
+void
+pgm_reactor_destroy (
+	pgm_reactor_t*		reactor
+	)
+{
+	pgm_return_if_reached ();
+}
+#endif /* HAVE_EPOLL_CTL */
+
+/* eof */
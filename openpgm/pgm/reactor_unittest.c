@@ -0,0 +1,643 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * unit tests for multi-socket event reactor.
+ *
+ * Copyright (c) 2006-2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <glib.h>
+#include <check.h>
+
+
+/* mock state */
+
+static int mock_recvmsgv_status;
+static unsigned mock_recvmsgv_calls;
+static unsigned mock_func_calls;
+static int mock_func_status;
+
+#define pgm_recvmsgv		mock_pgm_recvmsgv
+#define pgm_time_update_now	mock_pgm_time_update_now
+
+#define REACTOR_DEBUG
+#include "reactor.c"
+
+static pgm_reactor_t* mock_reactor;
+
+static pgm_time_t _mock_pgm_time_update_now(void);
+pgm_time_update_func mock_pgm_time_update_now = _mock_pgm_time_update_now;
+PGM_THREAD_LOCAL struct pgm_time_cache_t pgm_time_cache;
+static pgm_time_t mock_pgm_time_now = 0x1;
+
+/* socket pair per mock socket, the peer end makes the receive socket readable */
+static int mock_peer_sock[8];
+static unsigned mock_sock_count;
+
+static
+void
+mock_setup (void)
+{
+	mock_recvmsgv_status = PGM_IO_STATUS_WOULD_BLOCK;
+	mock_recvmsgv_calls = 0;
+	mock_func_calls = 0;
+	mock_func_status = -1;
+	mock_pgm_time_now = 0x1;
+	mock_sock_count = 0;
+	mock_reactor = NULL;
+}
+
+static
+void
+mock_teardown (void)
+{
+	for (unsigned i = 0; i < mock_sock_count; i++)
+		close (mock_peer_sock[i]);
+}
+
+static
+pgm_sock_t*
+generate_sock (
+	const pgm_time_t	next_poll
+	)
+{
+	int sv[2];
+	pgm_sock_t* sock = g_new0 (pgm_sock_t, 1);
+	g_assert (0 == socketpair (AF_UNIX, SOCK_DGRAM, 0, sv));
+	g_assert (mock_sock_count < G_N_ELEMENTS(mock_peer_sock));
+	sock->recv_sock = sv[0];
+	mock_peer_sock[mock_sock_count++] = sv[1];
+	g_assert (0 == pgm_notify_init (&sock->pending_notify));
+	sock->is_connected = TRUE;
+	sock->next_poll = next_poll;
+	return sock;
+}
+
+static
+void
+free_sock (
+	pgm_sock_t*		sock
+	)
+{
+	pgm_notify_destroy (&sock->pending_notify);
+	close (sock->recv_sock);
+	g_free (sock);
+}
+
+static
+struct pgm_reactor_entry_t*
+generate_entry (
+	const pgm_time_t	expiry
+	)
+{
+	struct pgm_reactor_entry_t* entry = g_new0 (struct pgm_reactor_entry_t, 1);
+	entry->expiry = expiry;
+	return entry;
+}
+
+/* every parent expires no later than its children */
+static
+bool
+is_heap (
+	const struct pgm_reactor_worker_t*	worker
+	)
+{
+	for (unsigned i = 0; i < worker->heap_len; i++) {
+		if (worker->heap[i]->heap_index != i)
+			return FALSE;
+		if (i > 0 && pgm_time_after (worker->heap[(i - 1) / 2]->expiry, worker->heap[i]->expiry))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* mock functions for external references */
+
+static
+pgm_time_t
+_mock_pgm_time_update_now (void)
+{
+	return mock_pgm_time_now;
+}
+
+int
+mock_pgm_recvmsgv (
+	pgm_sock_t* const restrict	sock,
+	struct pgm_msgv_t* const restrict msg_start,
+	const size_t			msg_len,
+	const int			flags,
+	size_t*	restrict		bytes_read,
+	pgm_error_t** restrict		error
+	)
+{
+	g_assert (NULL != sock);
+	g_assert (NULL != msg_start);
+	g_assert (msg_len > 0);
+	mock_recvmsgv_calls++;
+	if (PGM_IO_STATUS_NORMAL == mock_recvmsgv_status)
+		*bytes_read = 1;
+	return mock_recvmsgv_status;
+}
+
+static
+void
+mock_func (
+	pgm_sock_t*		sock,
+	const int		status,
+	struct pgm_msgv_t*	msgv,
+	const size_t		len,
+	void*			user_data
+	)
+{
+	mock_func_calls++;
+	mock_func_status = status;
+}
+
+/* callback removing its own socket */
+static
+void
+mock_remove_func (
+	pgm_sock_t*		sock,
+	const int		status,
+	struct pgm_msgv_t*	msgv,
+	const size_t		len,
+	void*			user_data
+	)
+{
+	mock_func_calls++;
+	fail_unless (TRUE == pgm_reactor_remove (mock_reactor, sock), "remove failed");
+}
+
+/* callback stopping the reactor, the socket then runs dry */
+static
+void
+mock_stop_func (
+	pgm_sock_t*		sock,
+	const int		status,
+	struct pgm_msgv_t*	msgv,
+	const size_t		len,
+	void*			user_data
+	)
+{
+	mock_func_calls++;
+	mock_recvmsgv_status = PGM_IO_STATUS_WOULD_BLOCK;
+	pgm_reactor_stop (mock_reactor);
+}
+
+
+/* target:
+ *	void
+ *	heap_push (
+ *		struct pgm_reactor_worker_t*	worker,
+ *		struct pgm_reactor_entry_t*	entry
+ *	)
+ */
+
+START_TEST (test_heap_push_pass_001)
+{
+	const pgm_time_t expiry[] = { 50, 10, 40, 20, 30, 10, 60 };
+	const pgm_time_t minimum[] = { 50, 10, 10, 10, 10, 10, 10 };
+	struct pgm_reactor_worker_t* worker = g_new0 (struct pgm_reactor_worker_t, 1);
+	for (unsigned i = 0; i < G_N_ELEMENTS(expiry); i++) {
+		heap_push (worker, generate_entry (expiry[i]));
+		fail_unless ((i + 1) == worker->heap_len, "heap_len mismatch");
+		fail_unless (minimum[i] == worker->heap[0]->expiry, "minimum not at root");
+		fail_unless (is_heap (worker), "heap order broken");
+	}
+}
+END_TEST
+
+/* grow past the initial allocation */
+START_TEST (test_heap_push_pass_002)
+{
+	struct pgm_reactor_worker_t* worker = g_new0 (struct pgm_reactor_worker_t, 1);
+	for (unsigned i = 200; i > 0; i--)
+		heap_push (worker, generate_entry (i));
+	fail_unless (200 == worker->heap_len, "heap_len mismatch");
+	fail_unless (worker->heap_size >= worker->heap_len, "heap_size mismatch");
+	fail_unless (1 == worker->heap[0]->expiry, "minimum not at root");
+	fail_unless (is_heap (worker), "heap order broken");
+}
+END_TEST
+
+/* target:
+ *	void
+ *	heap_remove (
+ *		struct pgm_reactor_worker_t*	worker,
+ *		struct pgm_reactor_entry_t*	entry
+ *	)
+ */
+
+/* popping the root yields ascending expiry */
+START_TEST (test_heap_remove_pass_001)
+{
+	const pgm_time_t expiry[] = { 70, 30, 50, 10, 60, 20, 40 };
+	struct pgm_reactor_worker_t* worker = g_new0 (struct pgm_reactor_worker_t, 1);
+	for (unsigned i = 0; i < G_N_ELEMENTS(expiry); i++)
+		heap_push (worker, generate_entry (expiry[i]));
+	for (pgm_time_t next = 10; next <= 70; next += 10) {
+		struct pgm_reactor_entry_t* entry = worker->heap[0];
+		fail_unless (next == entry->expiry, "expiry out of order");
+		heap_remove (worker, entry);
+		fail_unless (is_heap (worker), "heap order broken");
+	}
+	fail_unless (0 == worker->heap_len, "heap not empty");
+}
+END_TEST
+
+/* remove from the middle and the tail */
+START_TEST (test_heap_remove_pass_002)
+{
+	const pgm_time_t expiry[] = { 10, 60, 20, 70, 80, 30, 40 };
+	struct pgm_reactor_entry_t* entries[G_N_ELEMENTS(expiry)];
+	struct pgm_reactor_worker_t* worker = g_new0 (struct pgm_reactor_worker_t, 1);
+	for (unsigned i = 0; i < G_N_ELEMENTS(expiry); i++)
+		heap_push (worker, entries[i] = generate_entry (expiry[i]));
+	heap_remove (worker, entries[1]);
+	fail_unless (6 == worker->heap_len, "heap_len mismatch");
+	fail_unless (is_heap (worker), "heap order broken");
+	heap_remove (worker, worker->heap[worker->heap_len - 1]);
+	fail_unless (5 == worker->heap_len, "heap_len mismatch");
+	fail_unless (is_heap (worker), "heap order broken");
+	fail_unless (10 == worker->heap[0]->expiry, "minimum not at root");
+}
+END_TEST
+
+/* target:
+ *	void
+ *	heap_update (
+ *		struct pgm_reactor_worker_t*	worker,
+ *		struct pgm_reactor_entry_t*	entry,
+ *		const pgm_time_t		expiry
+ *	)
+ */
+
+START_TEST (test_heap_update_pass_001)
+{
+	const pgm_time_t expiry[] = { 10, 20, 30, 40, 50 };
+	struct pgm_reactor_entry_t* entries[G_N_ELEMENTS(expiry)];
+	struct pgm_reactor_worker_t* worker = g_new0 (struct pgm_reactor_worker_t, 1);
+	for (unsigned i = 0; i < G_N_ELEMENTS(expiry); i++)
+		heap_push (worker, entries[i] = generate_entry (expiry[i]));
+/* later */
+	heap_update (worker, entries[0], 45);
+	fail_unless (20 == worker->heap[0]->expiry, "minimum not at root");
+	fail_unless (is_heap (worker), "heap order broken");
+/* earlier */
+	heap_update (worker, entries[4], 5);
+	fail_unless (entries[4] == worker->heap[0], "minimum not at root");
+	fail_unless (is_heap (worker), "heap order broken");
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_reactor_create (
+ *		pgm_reactor_t**		reactor,
+ *		const unsigned		workers,
+ *		pgm_error_t**		error
+ *	)
+ */
+
+START_TEST (test_create_pass_001)
+{
+	pgm_reactor_t* reactor = NULL;
+	pgm_error_t* err = NULL;
+	fail_unless (TRUE == pgm_reactor_create (&reactor, 2, &err), "create failed");
+	fail_unless (NULL == err, "create failed");
+	fail_unless (NULL != reactor, "create failed");
+	fail_unless (2 == reactor->n_workers, "n_workers mismatch");
+	pgm_reactor_destroy (reactor);
+}
+END_TEST
+
+/* no workers */
+START_TEST (test_create_fail_001)
+{
+	pgm_reactor_t* reactor = NULL;
+	fail_unless (FALSE == pgm_reactor_create (&reactor, 0, NULL), "create failed");
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_reactor_add (
+ *		pgm_reactor_t*		reactor,
+ *		pgm_sock_t*		sock,
+ *		pgm_reactor_func_t	func,
+ *		void*			user_data,
+ *		pgm_error_t**		error
+ *	)
+ */
+
+/* sockets spread over the least loaded worker, keyed on next_poll */
+START_TEST (test_add_pass_001)
+{
+	pgm_reactor_t* reactor = NULL;
+	fail_unless (TRUE == pgm_reactor_create (&reactor, 2, NULL), "create failed");
+	pgm_sock_t* socks[] = { generate_sock (300), generate_sock (100), generate_sock (200) };
+	for (unsigned i = 0; i < G_N_ELEMENTS(socks); i++)
+		fail_unless (TRUE == pgm_reactor_add (reactor, socks[i], mock_func, NULL, NULL), "add failed");
+	fail_unless (2 == reactor->workers[0].heap_len, "worker 0 heap_len mismatch");
+	fail_unless (1 == reactor->workers[1].heap_len, "worker 1 heap_len mismatch");
+	fail_unless (200 == reactor->workers[0].heap[0]->expiry, "worker 0 root mismatch");
+	fail_unless (100 == reactor->workers[1].heap[0]->expiry, "worker 1 root mismatch");
+	for (unsigned i = 0; i < G_N_ELEMENTS(socks); i++)
+		fail_unless (TRUE == pgm_reactor_remove (reactor, socks[i]), "remove failed");
+	pgm_reactor_destroy (reactor);
+	for (unsigned i = 0; i < G_N_ELEMENTS(socks); i++)
+		free_sock (socks[i]);
+}
+END_TEST
+
+/* socket not connected */
+START_TEST (test_add_fail_001)
+{
+	pgm_reactor_t* reactor = NULL;
+	fail_unless (TRUE == pgm_reactor_create (&reactor, 1, NULL), "create failed");
+	pgm_sock_t* sock = generate_sock (100);
+	sock->is_connected = FALSE;
+	fail_unless (FALSE == pgm_reactor_add (reactor, sock, mock_func, NULL, NULL), "add failed");
+	fail_unless (0 == reactor->workers[0].heap_len, "heap_len mismatch");
+	pgm_reactor_destroy (reactor);
+	free_sock (sock);
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_reactor_remove (
+ *		pgm_reactor_t*		reactor,
+ *		pgm_sock_t*		sock
+ *	)
+ */
+
+START_TEST (test_remove_pass_001)
+{
+	pgm_reactor_t* reactor = NULL;
+	fail_unless (TRUE == pgm_reactor_create (&reactor, 1, NULL), "create failed");
+	pgm_sock_t* socks[] = { generate_sock (100), generate_sock (200) };
+	for (unsigned i = 0; i < G_N_ELEMENTS(socks); i++)
+		fail_unless (TRUE == pgm_reactor_add (reactor, socks[i], mock_func, NULL, NULL), "add failed");
+	struct pgm_reactor_worker_t* worker = &reactor->workers[0];
+	fail_unless (TRUE == pgm_reactor_remove (reactor, socks[0]), "remove failed");
+	fail_unless (1 == worker->heap_len, "heap_len mismatch");
+	fail_unless (socks[1] == worker->heap[0]->sock, "wrong socket removed");
+	fail_unless (NULL != worker->removed, "entry not deferred");
+	fail_unless (TRUE == worker->removed->is_removed, "entry not marked");
+/* second remove finds nothing */
+	fail_unless (FALSE == pgm_reactor_remove (reactor, socks[0]), "remove failed");
+	fail_unless (TRUE == pgm_reactor_remove (reactor, socks[1]), "remove failed");
+	pgm_reactor_destroy (reactor);
+	for (unsigned i = 0; i < G_N_ELEMENTS(socks); i++)
+		free_sock (socks[i]);
+}
+END_TEST
+
+/* callback removes its own socket during dispatch */
+START_TEST (test_remove_pass_002)
+{
+	pgm_reactor_t* reactor = NULL;
+	fail_unless (TRUE == pgm_reactor_create (&reactor, 1, NULL), "create failed");
+	pgm_sock_t* sock = generate_sock (100);
+	mock_reactor = reactor;
+	fail_unless (TRUE == pgm_reactor_add (reactor, sock, mock_remove_func, NULL, NULL), "add failed");
+	struct pgm_reactor_worker_t* worker = &reactor->workers[0];
+	struct pgm_reactor_entry_t* entry = worker->heap[0];
+	mock_recvmsgv_status = PGM_IO_STATUS_NORMAL;
+	pgm_reactor_self = worker;
+	reactor_dispatch (worker, entry);
+	pgm_reactor_self = NULL;
+/* quantum cut short by the removal */
+	fail_unless (1 == mock_recvmsgv_calls, "recvmsgv calls mismatch");
+	fail_unless (1 == mock_func_calls, "callback calls mismatch");
+	fail_unless (0 == worker->heap_len, "heap_len mismatch");
+	fail_unless (NULL == worker->busy_entry, "busy_entry not released");
+	fail_unless (entry == worker->removed, "entry not deferred");
+/* a stale event for the removed entry is ignored */
+	reactor_dispatch (worker, entry);
+	fail_unless (1 == mock_recvmsgv_calls, "recvmsgv calls mismatch");
+	pgm_reactor_destroy (reactor);
+	free_sock (sock);
+}
+END_TEST
+
+struct mock_remove_t {
+	pgm_reactor_t*		reactor;
+	pgm_sock_t*		sock;
+	volatile uint32_t	is_done;
+	bool			retval;
+};
+
+static
+void*
+mock_remove_routine (
+	void*			arg
+	)
+{
+	struct mock_remove_t* remove = arg;
+	remove->retval = pgm_reactor_remove (remove->reactor, remove->sock);
+	pgm_atomic_write32 (&remove->is_done, 1);
+	return NULL;
+}
+
+/* remove from another thread waits for the dispatch in progress */
+START_TEST (test_remove_pass_003)
+{
+	pgm_reactor_t* reactor = NULL;
+	fail_unless (TRUE == pgm_reactor_create (&reactor, 1, NULL), "create failed");
+	pgm_sock_t* sock = generate_sock (100);
+	fail_unless (TRUE == pgm_reactor_add (reactor, sock, mock_func, NULL, NULL), "add failed");
+	struct pgm_reactor_worker_t* worker = &reactor->workers[0];
+	struct mock_remove_t remove = { .reactor = reactor, .sock = sock };
+	pthread_t thread;
+	worker->busy_entry = worker->heap[0];
+	fail_unless (0 == pthread_create (&thread, NULL, mock_remove_routine, &remove), "pthread_create failed");
+	usleep (50 * 1000);
+	fail_unless (0 == pgm_atomic_read32 (&remove.is_done), "remove did not wait");
+	pgm_mutex_lock (&worker->mutex);
+	worker->busy_entry = NULL;
+	pgm_cond_broadcast (&worker->dispatch_cond);
+	pgm_mutex_unlock (&worker->mutex);
+	pthread_join (thread, NULL);
+	fail_unless (1 == pgm_atomic_read32 (&remove.is_done), "remove not finished");
+	fail_unless (TRUE == remove.retval, "remove failed");
+	fail_unless (0 == worker->heap_len, "heap_len mismatch");
+	pgm_reactor_destroy (reactor);
+	free_sock (sock);
+}
+END_TEST
+
+/* target:
+ *	void
+ *	reactor_dispatch (
+ *		struct pgm_reactor_worker_t*	worker,
+ *		struct pgm_reactor_entry_t*	entry
+ *	)
+ */
+
+/* full quantum then re-keyed past now */
+START_TEST (test_dispatch_pass_001)
+{
+	pgm_reactor_t* reactor = NULL;
+	fail_unless (TRUE == pgm_reactor_create (&reactor, 1, NULL), "create failed");
+	pgm_sock_t* sock = generate_sock (100);
+	fail_unless (TRUE == pgm_reactor_add (reactor, sock, mock_func, NULL, NULL), "add failed");
+	struct pgm_reactor_worker_t* worker = &reactor->workers[0];
+	mock_recvmsgv_status = PGM_IO_STATUS_NORMAL;
+	mock_pgm_time_now = 1000;
+	reactor_dispatch (worker, worker->heap[0]);
+	fail_unless (PGM_REACTOR_QUANTUM == mock_recvmsgv_calls, "recvmsgv calls mismatch");
+	fail_unless (PGM_REACTOR_QUANTUM == mock_func_calls, "callback calls mismatch");
+	fail_unless (1000 + PGM_REACTOR_MIN_IVL == worker->heap[0]->expiry, "expiry not advanced");
+/* reset reported once and ends the quantum */
+	mock_recvmsgv_calls = mock_func_calls = 0;
+	mock_recvmsgv_status = PGM_IO_STATUS_RESET;
+	sock->next_poll = 5000;
+	reactor_dispatch (worker, worker->heap[0]);
+	fail_unless (1 == mock_recvmsgv_calls, "recvmsgv calls mismatch");
+	fail_unless (1 == mock_func_calls, "callback calls mismatch");
+	fail_unless (PGM_IO_STATUS_RESET == mock_func_status, "callback status mismatch");
+	fail_unless (5000 == worker->heap[0]->expiry, "expiry not from next_poll");
+	fail_unless (TRUE == pgm_reactor_remove (reactor, sock), "remove failed");
+	pgm_reactor_destroy (reactor);
+	free_sock (sock);
+}
+END_TEST
+
+/* target:
+ *	void
+ *	pgm_reactor_stop (
+ *		pgm_reactor_t*		reactor
+ *	)
+ */
+
+/* callback stops a single worker reactor */
+START_TEST (test_stop_pass_001)
+{
+	pgm_reactor_t* reactor = NULL;
+	fail_unless (TRUE == pgm_reactor_create (&reactor, 1, NULL), "create failed");
+	pgm_sock_t* sock = generate_sock (pgm_msecs (60 * 1000));
+	mock_reactor = reactor;
+	fail_unless (TRUE == pgm_reactor_add (reactor, sock, mock_stop_func, NULL, NULL), "add failed");
+	mock_recvmsgv_status = PGM_IO_STATUS_NORMAL;
+	fail_unless (1 == write (mock_peer_sock[0], "x", 1), "write failed");
+	fail_unless (TRUE == pgm_reactor_run (reactor, NULL), "run failed");
+	fail_unless (0 == pgm_atomic_read32 (&reactor->is_running), "still running");
+	fail_unless (1 == mock_func_calls, "callback calls mismatch");
+	fail_unless (TRUE == pgm_reactor_remove (reactor, sock), "remove failed");
+	pgm_reactor_destroy (reactor);
+	free_sock (sock);
+}
+END_TEST
+
+/* stop on one worker wakes idle workers on other threads */
+START_TEST (test_stop_pass_002)
+{
+	pgm_reactor_t* reactor = NULL;
+	fail_unless (TRUE == pgm_reactor_create (&reactor, 3, NULL), "create failed");
+	pgm_sock_t* sock = generate_sock (pgm_msecs (60 * 1000));
+	mock_reactor = reactor;
+	fail_unless (TRUE == pgm_reactor_add (reactor, sock, mock_stop_func, NULL, NULL), "add failed");
+	fail_unless (1 == reactor->workers[0].heap_len, "socket not on first worker");
+	mock_recvmsgv_status = PGM_IO_STATUS_NORMAL;
+	fail_unless (1 == write (mock_peer_sock[0], "x", 1), "write failed");
+	fail_unless (TRUE == pgm_reactor_run (reactor, NULL), "run failed");
+	fail_unless (1 == mock_func_calls, "callback calls mismatch");
+	fail_unless (TRUE == pgm_reactor_remove (reactor, sock), "remove failed");
+	pgm_reactor_destroy (reactor);
+	free_sock (sock);
+}
+END_TEST
+
+
+static
+Suite*
+make_test_suite (void)
+{
+	Suite* s;
+
+	s = suite_create (__FILE__);
+
+	TCase* tc_heap = tcase_create ("heap");
+	suite_add_tcase (s, tc_heap);
+	tcase_add_test (tc_heap, test_heap_push_pass_001);
+	tcase_add_test (tc_heap, test_heap_push_pass_002);
+	tcase_add_test (tc_heap, test_heap_remove_pass_001);
+	tcase_add_test (tc_heap, test_heap_remove_pass_002);
+	tcase_add_test (tc_heap, test_heap_update_pass_001);
+
+	TCase* tc_create = tcase_create ("create");
+	suite_add_tcase (s, tc_create);
+	tcase_add_checked_fixture (tc_create, mock_setup, mock_teardown);
+	tcase_add_test (tc_create, test_create_pass_001);
+	tcase_add_test (tc_create, test_create_fail_001);
+
+	TCase* tc_add = tcase_create ("add");
+	suite_add_tcase (s, tc_add);
+	tcase_add_checked_fixture (tc_add, mock_setup, mock_teardown);
+	tcase_add_test (tc_add, test_add_pass_001);
+	tcase_add_test (tc_add, test_add_fail_001);
+
+	TCase* tc_remove = tcase_create ("remove");
+	suite_add_tcase (s, tc_remove);
+	tcase_add_checked_fixture (tc_remove, mock_setup, mock_teardown);
+	tcase_add_test (tc_remove, test_remove_pass_001);
+	tcase_add_test (tc_remove, test_remove_pass_002);
+	tcase_add_test (tc_remove, test_remove_pass_003);
+
+	TCase* tc_dispatch = tcase_create ("dispatch");
+	suite_add_tcase (s, tc_dispatch);
+	tcase_add_checked_fixture (tc_dispatch, mock_setup, mock_teardown);
+	tcase_add_test (tc_dispatch, test_dispatch_pass_001);
+
+	TCase* tc_stop = tcase_create ("stop");
+	suite_add_tcase (s, tc_stop);
+	tcase_add_checked_fixture (tc_stop, mock_setup, mock_teardown);
+	tcase_add_test (tc_stop, test_stop_pass_001);
+	tcase_add_test (tc_stop, test_stop_pass_002);
+	tcase_set_timeout (tc_stop, 10);
+
+	return s;
+}
+
+static
+Suite*
+make_master_suite (void)
+{
+	Suite* s = suite_create ("Master");
+	return s;
+}
+
+int
+main (void)
+{
+	pgm_messages_init();
+	SRunner* sr = srunner_create (make_master_suite ());
+	srunner_add_suite (sr, make_test_suite ());
+	srunner_run_all (sr, CK_ENV);
+	int number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	pgm_messages_shutdown();
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
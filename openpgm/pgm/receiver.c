@@ -23,6 +23,7 @@
 #	include <config.h>
 #endif
 #include <errno.h>
+#include <limits.h>
 #include <impl/i18n.h>
 #include <impl/framework.h>
 #include <impl/receiver.h>
@@ -39,6 +40,9 @@
 #	define PGM_DISABLE_ASSERT
 #endif
 
+/* upper bound of options walked in a SPM */
+#define PGM_MAX_SPM_OPTIONS	16
+
 
 static bool send_spmr (pgm_sock_t*const restrict, pgm_peer_t*const restrict);
 static bool send_nak (pgm_sock_t*const restrict, pgm_peer_t*const restrict, const uint32_t);
@@ -47,6 +51,7 @@ static bool send_nak_list (pgm_sock_t*const restrict, pgm_peer_t*const restrict,
 static bool nak_rb_state (pgm_sock_t*restrict, pgm_peer_t*restrict, const pgm_time_t);
 static void nak_rpt_state (pgm_sock_t*restrict, pgm_peer_t*restrict, const pgm_time_t);
 static void nak_rdata_state (pgm_sock_t*restrict, pgm_peer_t*restrict, const pgm_time_t);
+static void deadline_state (pgm_sock_t*restrict, pgm_peer_t*restrict, const pgm_time_t);
 static inline pgm_peer_t* _pgm_peer_ref (pgm_peer_t*);
 static bool on_general_poll (pgm_sock_t*const restrict, pgm_peer_t*const restrict, struct pgm_sk_buff_t*const restrict);
 static bool on_dlr_poll (pgm_sock_t*const restrict, pgm_peer_t*const restrict, struct pgm_sk_buff_t*const restrict);
@@ -416,10 +421,28 @@ pgm_new_peer (
 					sock->rxw_secs,
 					sock->rxw_max_rte,
 					sock->ack_c_p);
+	peer->window->is_unordered = sock->use_unordered_recv ? 1 : 0;
+	peer->window->is_reassemble = sock->use_recv_reassemble ? 1 : 0;
+	if (sock->large_apdu) {
+		peer->window->max_apdu = sock->large_apdu;
+		peer->window->max_fragments = pgm_rxw_max_length (peer->window);
+	}
+	if (sock->reclaim_max)
+		peer->window->reclaim = &sock->reclaim;
+	peer->window->spill_threshold = sock->spill_threshold;
 	peer->spmr_expiry = now + sock->spmr_expiry;
 
 /* add peer to hash table and linked list */
 	pgm_rwlock_writer_lock (&sock->peers_lock);
+	peer->weight = 1;
+	for (const pgm_slist_t* it = sock->peer_weights; NULL != it; it = it->next)
+	{
+		const struct pgm_peerweight_t* peerweight = it->data;
+		if (pgm_tsi_equal (&peerweight->tsi, &peer->tsi)) {
+			peer->weight = peerweight->weight;
+			break;
+		}
+	}
 	pgm_hashtable_insert (sock->peers_hashtable, &peer->tsi, _pgm_peer_ref (peer));
 	peer->peers_link.data = peer;
 	sock->peers_list = pgm_list_prepend_link (sock->peers_list, &peer->peers_link);
@@ -432,8 +455,55 @@ pgm_new_peer (
 	return peer;
 }
 
+/* move the peer at the head of the pending list to the tail.
+ */
+
+static inline
+void
+_pgm_peer_rotate_pending (
+	pgm_sock_t* const	sock
+	)
+{
+	pgm_slist_t* link_ = sock->peers_pending;
+	sock->peers_pending = pgm_slist_append_link (link_->next, link_);
+}
+
+/* record time from arrival of each APDU to delivery to the application.
+ */
+
+static
+void
+_pgm_peer_update_lag (
+	pgm_peer_t*		       const restrict peer,
+	const struct pgm_msgv_t*	     restrict msg,
+	const struct pgm_msgv_t* const	     restrict msg_end,
+	const pgm_time_t			      now
+	)
+{
+	for (; msg < msg_end; msg++)
+	{
+		const pgm_time_t tstamp = msg->msgv_skb[0]->tstamp;
+		const uint32_t lag = pgm_time_after (now, tstamp) ? (uint32_t)(now - tstamp) : 0;
+		if (!peer->delivery_lag_count)
+			peer->max_delivery_lag = peer->min_delivery_lag = lag;
+		else if (lag > peer->max_delivery_lag)
+			peer->max_delivery_lag = lag;
+		else if (lag < peer->min_delivery_lag)
+			peer->min_delivery_lag = lag;
+		peer->delivery_lag_sum += lag;
+		peer->delivery_lag_count++;
+		PGM_HISTOGRAM_TIMES("Rx.DeliveryLag", lag);
+		pgm_latency_add (&peer->window->latency[PGM_LATENCY_RECEIVER_DELIVERY], lag);
+	}
+}
+
 /* copy any contiguous buffers in the peer list to the provided 
  * message vector.
+ *
+ * with a receive quantum peers are served deficit round-robin, each visit
+ * adding the quantum scaled by the peer weight to the messages it may read.
+ * a peer that spends its deficit is moved to the back of the pending list.
+ *
  * returns -PGM_SOCK_ENOBUFS if the vector is full, returns -PGM_SOCK_ECONNRESET if
  * data loss is detected, returns 0 when all peers flushed.
  */
@@ -448,6 +518,7 @@ pgm_flush_peers_pending (
 	unsigned*	 	 const restrict	data_read
 	)
 {
+	pgm_time_t now = 0;
 	int retval = 0;
 
 /* pre-conditions */
@@ -464,9 +535,30 @@ pgm_flush_peers_pending (
 	while (sock->peers_pending)
 	{
 		pgm_peer_t* peer = sock->peers_pending->data;
+		const struct pgm_msgv_t* peer_msg = *pmsg;
+		unsigned peer_msglen = (unsigned)(msg_end - *pmsg + 1);
+		if (sock->recv_quantum) {
+/* a peer left at the head by a full vector keeps its deficit across calls,
+ * saturate rather than wrap to a short quantum.
+ */
+			const uint64_t deficit = (uint64_t)peer->deficit + ((uint64_t)sock->recv_quantum * peer->weight);
+			peer->deficit = (unsigned)MIN(deficit, (uint64_t)UINT_MAX);
+			if (peer->deficit < peer_msglen)
+				peer_msglen = peer->deficit;
+		}
 		if (peer->last_commit && peer->last_commit < sock->last_commit)
 			pgm_rxw_remove_commit (peer->window);
-		const ssize_t peer_bytes = pgm_rxw_readv (peer->window, pmsg, (unsigned)(msg_end - *pmsg + 1));
+		const ssize_t peer_bytes = pgm_rxw_readv (peer->window, pmsg, peer_msglen);
+		if (peer_bytes >= 0) {
+/* application returns skbs with pgm_msgv_release() */
+			if (sock->use_recv_lease)
+				pgm_rxw_lease (peer->window, peer_msg, *pmsg);
+			if (0 == now)
+				now = pgm_time_cached();
+			_pgm_peer_update_lag (peer, peer_msg, *pmsg, now);
+			if (sock->recv_quantum)
+				peer->deficit -= (unsigned)(*pmsg - peer_msg);
+		}
 
 		if (peer->last_cumulative_losses != ((pgm_rxw_t*)peer->window)->cumulative_losses)
 		{
@@ -481,15 +573,32 @@ pgm_flush_peers_pending (
 			(*data_read)  ++;
 			peer->last_commit = sock->last_commit;
 			if (*pmsg > msg_end) {			/* commit full */
+				if (sock->recv_quantum && 0 == peer->deficit &&
+				    0 == peer->window->apdu_remaining)
+					_pgm_peer_rotate_pending (sock);
 				retval = -PGM_SOCK_ENOBUFS;
 				break;
 			}
-		} else
+		} else if (peer->window->committed_count)
+/* committed earlier in this call or read ahead APDUs committed without
+ * reading, a lost trail stays locked until these are removed.
+ */
+			peer->last_commit = sock->last_commit;
+		else
 			peer->last_commit = 0;
 		if (PGM_UNLIKELY(sock->is_reset)) {
 			retval = -PGM_SOCK_ECONNRESET;
 			break;
 		}
+/* quantum spent with data possibly remaining, an APDU part read stays at
+ * the head until completely read.
+ */
+		if (sock->recv_quantum && 0 == peer->deficit && peer_bytes >= 0) {
+			if (0 == peer->window->apdu_remaining)
+				_pgm_peer_rotate_pending (sock);
+			continue;
+		}
+		peer->deficit = 0;
 /* clear this reference and move to next */
 		sock->peers_pending = pgm_slist_remove_first (sock->peers_pending);
 	}
@@ -532,7 +641,12 @@ pgm_peer_set_pending (
 
 	if (peer->pending_link.data) return;
 	peer->pending_link.data = peer;
-	sock->peers_pending = pgm_slist_prepend_link (sock->peers_pending, &peer->pending_link);
+/* an APDU part read stays at the head until completely read */
+	if (sock->peers_pending &&
+	    ((pgm_peer_t*)sock->peers_pending->data)->window->apdu_remaining)
+		sock->peers_pending->next = pgm_slist_prepend_link (sock->peers_pending->next, &peer->pending_link);
+	else
+		sock->peers_pending = pgm_slist_prepend_link (sock->peers_pending, &peer->pending_link);
 }
 
 /* Create a new error SKB detailing data loss.
@@ -555,13 +669,81 @@ pgm_set_reset_error (
 
 	error_skb = pgm_alloc_skb (0);
 	error_skb->sock	= sock;
-	error_skb->tstamp	= pgm_time_update_now ();
+	error_skb->tstamp	= pgm_time_cached();
 	memcpy (&error_skb->tsi, &source->tsi, sizeof(pgm_tsi_t));
 	error_skb->sequence	= source->lost_count;
 	msgv->msgv_skb[0]	= error_skb;
 	msgv->msgv_len		= 1;
 }
 
+/* check an option header and its payload lie within the packet.
+ */
+
+static inline
+bool
+_pgm_opt_is_valid (
+	const struct pgm_sk_buff_t*  const restrict skb,
+	const struct pgm_opt_header* const restrict opt_header
+	)
+{
+	const char* end = (const char*)skb->data + skb->len;
+
+	return ((const char*)(opt_header + 1) <= end &&
+		opt_header->opt_length >= sizeof(struct pgm_opt_header) &&
+		(const char*)opt_header + opt_header->opt_length <= end);
+}
+
+/* find OPT_JOIN in a SPM, walking at most PGM_MAX_SPM_OPTIONS options bounded by
+ * the packet length.
+ *
+ * returns TRUE on a well-formed option list, setting has_join and join_min if
+ * OPT_JOIN is present, returns FALSE on a malformed option list.
+ */
+
+static
+bool
+_pgm_spm_join_min (
+	const struct pgm_sk_buff_t* const restrict skb,
+	bool*			    const restrict has_join,
+	uint32_t*		    const restrict join_min
+	)
+{
+	const struct pgm_spm* spm = (const struct pgm_spm*)skb->data;
+	const struct pgm_opt_header* opt_header;
+	const struct pgm_opt_length* opt_len;
+	unsigned count = 0;
+
+	*has_join = FALSE;
+	if (!(skb->pgm_header->pgm_options & PGM_OPT_PRESENT))
+		return TRUE;
+/* SPM NLA is not yet copied to the peer */
+	opt_len = (AFI_IP6 == pgm_ntohs (spm->spm_nla_afi)) ?
+			(const struct pgm_opt_length*)((const struct pgm_spm6*)spm + 1) :
+			(const struct pgm_opt_length*)(spm + 1);
+	if (PGM_UNLIKELY((const char*)(opt_len + 1) > (const char*)skb->data + skb->len ||
+			 opt_len->opt_type != PGM_OPT_LENGTH ||
+			 opt_len->opt_length != sizeof(struct pgm_opt_length)))
+		return FALSE;
+	opt_header = (const struct pgm_opt_header*)(opt_len + 1);
+	for (;;) {
+		if (PGM_UNLIKELY(++count > PGM_MAX_SPM_OPTIONS ||
+				 !_pgm_opt_is_valid (skb, opt_header)))
+			return FALSE;
+		if ((opt_header->opt_type & PGM_OPT_MASK) == PGM_OPT_JOIN)
+		{
+			const struct pgm_opt_join* opt_join = (const struct pgm_opt_join*)(opt_header + 1);
+			if (PGM_UNLIKELY(opt_header->opt_length < sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_join)))
+				return FALSE;
+			*join_min = pgm_ntohl (opt_join->opt_join_min);
+			*has_join = TRUE;
+			return TRUE;
+		}
+		if (opt_header->opt_type & PGM_OPT_END)
+			return TRUE;
+		opt_header = (const struct pgm_opt_header*)((const char*)opt_header + opt_header->opt_length);
+	}
+}
+
 /* SPM indicate start of a session, continued presence of a session, or flushing final packets
  * of a session.
  *
@@ -589,7 +771,7 @@ pgm_on_spm (
 
 	if (PGM_UNLIKELY(!pgm_verify_spm (skb))) {
 		pgm_trace(PGM_LOG_ROLE_NETWORK,_("Discarded invalid SPM."));
-		source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS]++;
+		pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS]);
 		return FALSE;
 	}
 
@@ -600,6 +782,18 @@ pgm_on_spm (
 /* check for advancing sequence number, or first SPM */
 	if (PGM_LIKELY(pgm_uint32_gte (spm_sqn, source->spm_sqn)))
 	{
+/* late join defines the window at the advertised join point */
+		bool has_join = FALSE;
+		uint32_t join_min;
+		if (sock->late_join &&
+		    !source->window->is_defined &&
+		    PGM_UNLIKELY(!_pgm_spm_join_min (skb, &has_join, &join_min)))
+		{
+			pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded malformed SPM."));
+			pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS]);
+			return FALSE;
+		}
+
 /* copy NLA for replies */
 		pgm_nla_to_sockaddr (&spm->spm_nla_afi, (struct sockaddr*)&source->nla);
 
@@ -608,6 +802,34 @@ pgm_on_spm (
 
 /* update receive window */
 		const pgm_time_t nak_rb_expiry = skb->tstamp + nak_rb_ivl (sock);
+
+/* bounded by the option and window size, for the update to request the
+ * retained data.
+ */
+		if (has_join)
+		{
+			const uint32_t spm_lead = pgm_ntohl (spm->spm_lead);
+			const uint32_t max_join = (uint32_t)MIN( sock->late_join, pgm_rxw_max_length (source->window) );
+			uint32_t join_len = spm_lead + 1 - join_min;
+			if (PGM_UNLIKELY(join_len > ((UINT32_MAX/2)-1)))
+				join_len = 0;
+			else if (join_len > max_join)
+				join_len = max_join;
+			pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Late join at #%" PRIu32 " with %" PRIu32 " retained sequences."),
+				spm_lead + 1 - join_len, join_len);
+			const unsigned join_naks = pgm_rxw_update (source->window,
+								   spm_lead - join_len,
+								   pgm_ntohl (spm->spm_trail),
+								   skb->tstamp,
+								   nak_rb_expiry);
+			if (join_naks) {
+				pgm_timer_lock (sock);
+				if (pgm_time_after (sock->next_poll, nak_rb_expiry))
+					sock->next_poll = nak_rb_expiry;
+				pgm_timer_unlock (sock);
+			}
+		}
+
 		const unsigned naks = pgm_rxw_update (source->window,
 						      pgm_ntohl (spm->spm_lead),
 						      pgm_ntohl (spm->spm_trail),
@@ -633,7 +855,7 @@ pgm_on_spm (
 	else
 	{	/* does not advance SPM sequence number */
 		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded duplicate SPM."));
-		source->cumulative_stats[PGM_PC_RECEIVER_DUP_SPMS]++;
+		pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_DUP_SPMS]);
 		return FALSE;
 	}
 
@@ -646,31 +868,40 @@ pgm_on_spm (
 		opt_len = (AF_INET6 == source->nla.ss_family) ?
 				(const struct pgm_opt_length*)(spm6 + 1) :
 				(const struct pgm_opt_length*)(spm  + 1);
-		if (PGM_UNLIKELY(opt_len->opt_type != PGM_OPT_LENGTH))
+		if (PGM_UNLIKELY((const char*)(opt_len + 1) > (const char*)skb->data + skb->len ||
+				 opt_len->opt_type != PGM_OPT_LENGTH))
 		{
 			pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded malformed SPM."));
-			source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS]++;
+			pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS]);
 			return FALSE;
 		}
 		if (PGM_UNLIKELY(opt_len->opt_length != sizeof(struct pgm_opt_length)))
 		{
 			pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded malformed SPM."));
-			source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS]++;
+			pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS]);
 			return FALSE;
 		}
-/* TODO: check for > 16 options & past packet end */
 		opt_header = (const struct pgm_opt_header*)opt_len;
+		unsigned count = 0;
 		do {
 			opt_header = (const struct pgm_opt_header*)((const char*)opt_header + opt_header->opt_length);
+			if (PGM_UNLIKELY(++count > PGM_MAX_SPM_OPTIONS ||
+					 !_pgm_opt_is_valid (skb, opt_header)))
+			{
+				pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded malformed SPM."));
+				pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS]);
+				return FALSE;
+			}
 			if ((opt_header->opt_type & PGM_OPT_MASK) == PGM_OPT_PARITY_PRM)
 			{
 				const struct pgm_opt_parity_prm* opt_parity_prm;
 
 				opt_parity_prm = (const struct pgm_opt_parity_prm*)(opt_header + 1);
-				if (PGM_UNLIKELY((opt_parity_prm->opt_reserved & PGM_PARITY_PRM_MASK) == 0))
+				if (PGM_UNLIKELY(opt_header->opt_length < sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_parity_prm) ||
+						 (opt_parity_prm->opt_reserved & PGM_PARITY_PRM_MASK) == 0))
 				{
 					pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded malformed SPM."));
-					source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS]++;
+					pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS]);
 					return FALSE;
 				}
 
@@ -678,7 +909,7 @@ pgm_on_spm (
 				if (PGM_UNLIKELY(parity_prm_tgs < 2 || parity_prm_tgs > 128))
 				{
 					pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded malformed SPM."));
-					source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS]++;
+					pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS]);
 					return FALSE;
 				}
 			
@@ -732,7 +963,7 @@ pgm_on_peer_nak (
 	if (PGM_UNLIKELY(!pgm_verify_nak (skb)))
 	{
 		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded invalid multicast NAK."));
-		peer->cumulative_stats[PGM_PC_RECEIVER_NAK_ERRORS]++;
+		pgm_stats_inc (&peer->cumulative_stats[PGM_PC_RECEIVER_NAK_ERRORS]);
 		return FALSE;
 	}
 
@@ -770,7 +1001,7 @@ pgm_on_peer_nak (
 				      skb->tstamp + sock->nak_rdata_ivl,
 				      skb->tstamp + nak_rb_ivl(sock));
 	if (PGM_RXW_UPDATED == ncf_status || PGM_RXW_APPENDED == ncf_status)
-		peer->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAKS_SUPPRESSED]++;
+		pgm_stats_inc (&peer->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAKS_SUPPRESSED]);
 
 /* check NAK list */
 	if (skb->pgm_header->pgm_options & PGM_OPT_PRESENT)
@@ -786,13 +1017,13 @@ pgm_on_peer_nak (
 		if (PGM_UNLIKELY(opt_len->opt_type != PGM_OPT_LENGTH))
 		{
 			pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded malformed multicast NAK."));
-			peer->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_NCFS]++;
+			pgm_stats_inc (&peer->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_NCFS]);
 			return FALSE;
 		}
 		if (PGM_UNLIKELY(opt_len->opt_length != sizeof(struct pgm_opt_length)))
 		{
 			pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded malformed multicast NAK."));
-			peer->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_NCFS]++;
+			pgm_stats_inc (&peer->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_NCFS]);
 			return FALSE;
 		}
 /* TODO: check for > 16 options & past packet end */
@@ -814,7 +1045,7 @@ pgm_on_peer_nak (
 						      skb->tstamp + sock->nak_rdata_ivl,
 						      skb->tstamp + nak_rb_ivl(sock));
 			if (PGM_RXW_UPDATED == ncf_status || PGM_RXW_APPENDED == ncf_status)
-				peer->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAKS_SUPPRESSED]++;
+				pgm_stats_inc (&peer->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAKS_SUPPRESSED]);
 			nak_list++;
 			nak_list_len--;
 		}
@@ -863,7 +1094,7 @@ pgm_on_ncf (
 	if (PGM_UNLIKELY(!pgm_verify_ncf (skb)))
 	{
 		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded invalid NCF."));
-		source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_NCFS]++;
+		pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_NCFS]);
 		return FALSE;
 	}
 
@@ -876,7 +1107,7 @@ pgm_on_ncf (
 #if 0
 	if (PGM(pgm_sockaddr_cmp ((struct sockaddr*)&ncf_src_nla, (struct sockaddr*)&sock->send_addr) != 0)) {
 		g_trace ("INFO", "Discarded NCF on NLA mismatch.");
-		peer->cumulative_stats[PGM_PC_RECEIVER_PACKETS_DISCARDED]++;
+		pgm_stats_inc (&peer->cumulative_stats[PGM_PC_RECEIVER_PACKETS_DISCARDED]);
 		return FALSE;
 	}
 #endif
@@ -911,7 +1142,7 @@ pgm_on_ncf (
 			sock->next_poll = ncf_ivl;
 		}
 		pgm_timer_unlock (sock);
-		source->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAKS_SUPPRESSED]++;
+		pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAKS_SUPPRESSED]);
 	}
 
 /* check NCF list */
@@ -928,13 +1159,13 @@ pgm_on_ncf (
 		if (PGM_UNLIKELY(opt_len->opt_type != PGM_OPT_LENGTH))
 		{
 			pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded malformed NCF."));
-			source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_NCFS]++;
+			pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_NCFS]);
 			return FALSE;
 		}
 		if (PGM_UNLIKELY(opt_len->opt_length != sizeof(struct pgm_opt_length)))
 		{
 			pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded malformed NCF."));
-			source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_NCFS]++;
+			pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_NCFS]);
 			return FALSE;
 		}
 /* TODO: check for > 16 options & past packet end */
@@ -958,7 +1189,7 @@ pgm_on_ncf (
 						      ncf_rdata_ivl,
 						      ncf_rb_ivl);
 			if (PGM_RXW_UPDATED == ncf_status || PGM_RXW_APPENDED == ncf_status)
-				source->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAKS_SUPPRESSED]++;
+				pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAKS_SUPPRESSED]);
 			ncf_list++;
 			ncf_list_len--;
 		}
@@ -1038,7 +1269,7 @@ send_spmr (
 	if (sent < 0 && PGM_LIKELY(PGM_SOCK_EAGAIN == pgm_get_last_sock_error()))
 		return FALSE;
 
-	sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT] += tpdu_length * 2;
+	pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], tpdu_length * 2);
 	return TRUE;
 }
 
@@ -1111,8 +1342,8 @@ send_nak (
 	if (sent < 0 && PGM_LIKELY(PGM_SOCK_EAGAIN == pgm_get_last_sock_error()))
 		return FALSE;
 
-	source->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAK_PACKETS_SENT]++;
-	source->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAKS_SENT]++;
+	pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAK_PACKETS_SENT]);
+	pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAKS_SENT]);
 	return TRUE;
 }
 
@@ -1186,8 +1417,8 @@ send_parity_nak (
 	if (sent < 0 && PGM_LIKELY(PGM_SOCK_EAGAIN == pgm_get_last_sock_error()))
 		return FALSE;
 
-	source->cumulative_stats[PGM_PC_RECEIVER_PARITY_NAK_PACKETS_SENT]++;
-	source->cumulative_stats[PGM_PC_RECEIVER_PARITY_NAKS_SENT]++;
+	pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_PARITY_NAK_PACKETS_SENT]);
+	pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_PARITY_NAKS_SENT]);
 	return TRUE;
 }
 
@@ -1301,8 +1532,8 @@ send_nak_list (
 	if (sent < 0 && PGM_LIKELY(PGM_SOCK_EAGAIN == pgm_get_last_sock_error()))
 		return FALSE;
 
-	source->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAK_PACKETS_SENT]++;
-	source->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAKS_SENT] += 1 + sqn_list->len;
+	pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAK_PACKETS_SENT]);
+	pgm_stats_add (&source->cumulative_stats[PGM_PC_RECEIVER_SELECTIVE_NAKS_SENT], 1 + sqn_list->len);
 	return TRUE;
 }
 
@@ -1398,7 +1629,7 @@ send_ack (
 	if (sent < 0 && PGM_LIKELY(PGM_SOCK_EAGAIN == pgm_get_last_sock_error()))
 		return FALSE;
 
-	source->cumulative_stats[PGM_PC_RECEIVER_ACKS_SENT]++;
+	pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_ACKS_SENT]);
 	return TRUE;
 }
 
@@ -1579,7 +1810,8 @@ nak_rb_state (
 
 					if (!nak_pkt_cnt++)
 						nak_tg_sqn = tg_sqn;
-					state->nak_transmit_count++;
+					if (0 == state->nak_transmit_count++)
+						state->nak_tstamp = now;
 
 #ifdef PGM_ABSOLUTE_EXPIRY
 					state->timer_expiry += sock->nak_rpt_ivl;
@@ -1637,7 +1869,8 @@ nak_rb_state (
 
 				pgm_rxw_state (peer->window, skb, PGM_PKT_STATE_WAIT_NCF);
 				nak_list.sqn[nak_list.len++] = skb->sequence;
-				state->nak_transmit_count++;
+				if (0 == state->nak_transmit_count++)
+					state->nak_tstamp = now;
 
 /* we have two options here, calculate the expiry time in the new state relative to the current
  * state execution time, skipping missed expirations due to delay in state processing, or base
@@ -1793,6 +2026,9 @@ pgm_check_peer_state (
 				nak_rdata_state (sock, peer, now);
 		}
 
+		if (sock->recv_deadline)
+			deadline_state (sock, peer, now);
+
 /* expired, remove from hash table and linked list */
 		if (pgm_time_after_eq (now, peer->expiry))
 		{
@@ -1806,9 +2042,17 @@ pgm_check_peer_state (
 				pgm_trace (PGM_LOG_ROLE_SESSION,_("Peer expiration postponed due to committed data, tsi %s"), pgm_tsi_print (&peer->tsi));
 				peer->expiry += sock->peer_expiry;
 			}
+			else if (pgm_atomic_read32 (&peer->window->lease_count))
+			{
+				pgm_trace (PGM_LOG_ROLE_SESSION,_("Peer expiration postponed due to leased data, tsi %s"), pgm_tsi_print (&peer->tsi));
+				peer->expiry += sock->peer_expiry;
+			}
 			else
 			{
 				pgm_trace (PGM_LOG_ROLE_SESSION,_("Peer expired, tsi %s"), pgm_tsi_print (&peer->tsi));
+/* keep socket latency across peer lifetimes */
+				for (unsigned i = 0; i < PGM_LATENCY_MAX; i++)
+					pgm_latency_merge (&sock->latency[i], &peer->window->latency[i]);
 				pgm_hashtable_remove (sock->peers_hashtable, &peer->tsi);
 				sock->peers_list = pgm_list_remove_link (sock->peers_list, &peer->peers_link);
 				if (sock->last_hash_value == peer)
@@ -1890,6 +2134,13 @@ pgm_min_receiver_expiry (
 				expiration = next_nak_rdata_expiry (peer->window);
 		}
 
+		if (sock->recv_deadline)
+		{
+			const struct pgm_sk_buff_t* skb = pgm_rxw_first_missing (peer->window, peer->window->commit_lead);
+			if (NULL != skb && pgm_time_after_eq (expiration, skb->tstamp + sock->recv_deadline))
+				expiration = skb->tstamp + sock->recv_deadline;
+		}
+
 	}
 
 	return expiration;
@@ -1949,7 +2200,7 @@ nak_rpt_state (
 			{
 				dropped++;
 				cancel_skb (sock, peer, skb, now);
-				peer->cumulative_stats[PGM_PC_RECEIVER_NAKS_FAILED_NCF_RETRIES_EXCEEDED]++;
+				pgm_stats_inc (&peer->cumulative_stats[PGM_PC_RECEIVER_NAKS_FAILED_NCF_RETRIES_EXCEEDED]);
 			}
 			else
 			{
@@ -2082,7 +2333,7 @@ nak_rdata_state (
 			{
 				dropped++;
 				cancel_skb (sock, peer, rdata_skb, now);
-				peer->cumulative_stats[PGM_PC_RECEIVER_NAKS_FAILED_DATA_RETRIES_EXCEEDED]++;
+				pgm_stats_inc (&peer->cumulative_stats[PGM_PC_RECEIVER_NAKS_FAILED_DATA_RETRIES_EXCEEDED]);
 				continue;
 			}
 
@@ -2137,6 +2388,45 @@ nak_rdata_state (
 	}
 }
 
+/* cancel any sequence outstanding longer than the receive deadline regardless
+ * of recovery state such that following data is delivered immediately and no
+ * further NAKs are sent.
+ */
+
+static
+void
+deadline_state (
+	pgm_sock_t*restrict	sock,
+	pgm_peer_t*restrict	peer,
+	const pgm_time_t	now
+	)
+{
+	struct pgm_sk_buff_t* skb;
+	unsigned dropped = 0;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != peer);
+	pgm_assert (NULL != peer->window);
+	pgm_assert (sock->recv_deadline > 0);
+
+	pgm_debug ("deadline_state (sock:%p peer:%p now:%" PGM_TIME_FORMAT ")",
+		(void*)sock, (void*)peer, now);
+
+	for (skb = pgm_rxw_first_missing (peer->window, peer->window->commit_lead);
+	     NULL != skb && pgm_time_after_eq (now, skb->tstamp + sock->recv_deadline);
+	     skb = pgm_rxw_first_missing (peer->window, skb->sequence + 1))
+	{
+		dropped++;
+		cancel_skb (sock, peer, skb, now);
+		pgm_stats_inc (&peer->cumulative_stats[PGM_PC_RECEIVER_NAKS_FAILED_GEN_EXPIRED]);
+	}
+
+	if (PGM_UNLIKELY(dropped)) {
+		pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Dropped %u messages due to receive deadline."), dropped);
+	}
+}
+
 /* ODATA or RDATA packet with any of the following options:
  *
  * OPT_FRAGMENT - this TPDU part of a larger APDU.
@@ -2169,6 +2459,12 @@ pgm_on_data (
 	const pgm_time_t nak_rb_expiry = skb->tstamp + nak_rb_ivl (sock);
 	const uint_fast16_t tsdu_length = pgm_ntohs (skb->pgm_header->pgm_tsdu_length);
 
+/* late join waits for an SPM to define the window, data is repaired later */
+	if (PGM_UNLIKELY(sock->late_join && !source->window->is_defined)) {
+		pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Discarded data before late join point."));
+		return FALSE;
+	}
+
 	skb->pgm_data = skb->data;
 
 	const uint_fast16_t opt_total_length = (skb->pgm_header->pgm_options & PGM_OPT_PRESENT) ?
@@ -2197,14 +2493,17 @@ pgm_on_data (
 	case PGM_RXW_INSERTED:
 	case PGM_RXW_APPENDED:
 		msg_count++;
+		if (source->window->spill_threshold &&
+		    pgm_rxw_size (source->window) > source->window->spill_threshold)
+			pgm_rxw_spill (source->window);
 		break;
 
 	case PGM_RXW_DUPLICATE:
-		source->cumulative_stats[PGM_PC_RECEIVER_DUP_DATAS]++;
+		pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_DUP_DATAS]);
 		goto discarded;
 
 	case PGM_RXW_MALFORMED:
-		source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_ODATA]++;
+		pgm_stats_inc (&source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_ODATA]);
 /* fall through */
 	case PGM_RXW_BOUNDS:
 discarded:
@@ -2215,8 +2514,8 @@ discarded:
 
 /* valid data */
 	PGM_HISTOGRAM_COUNTS("Rx.DataBytesReceived", tsdu_length);
-	source->cumulative_stats[PGM_PC_RECEIVER_DATA_BYTES_RECEIVED] += tsdu_length;
-	source->cumulative_stats[PGM_PC_RECEIVER_DATA_MSGS_RECEIVED]  += msg_count;
+	pgm_stats_add (&source->cumulative_stats[PGM_PC_RECEIVER_DATA_BYTES_RECEIVED], tsdu_length);
+	pgm_stats_add (&source->cumulative_stats[PGM_PC_RECEIVER_DATA_MSGS_RECEIVED], msg_count);
 
 /* congestion control */
 	if (0 != ack_rb_expiry)
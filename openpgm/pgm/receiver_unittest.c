@@ -24,6 +24,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <glib.h>
 #include <check.h>
 
@@ -50,6 +51,23 @@
 #define TEST_NAK_DATA_RETRIES	5
 #define TEST_NAK_NCF_RETRIES	2
 
+static unsigned mock_rxw_update_count = 0;
+static guint32 mock_rxw_update_lead[2];
+static unsigned mock_rxw_update_naks = 0;
+
+/* scripted receive window contents, TPDUs per APDU for each window */
+struct mock_rxw_data_t {
+	const void*		window;
+	char			name;
+	unsigned		apdus;
+	unsigned		tpdus;
+	unsigned		tpdus_left;
+};
+static struct mock_rxw_data_t mock_rxw_data[2];
+static char mock_readv_log[64];
+static unsigned mock_readv_count = 0;
+static struct pgm_sk_buff_t mock_readv_skb;
+
 
 #define pgm_histogram_add	mock_pgm_histogram_add
 #define pgm_verify_spm		mock_pgm_verify_spm
@@ -69,6 +87,9 @@
 #define pgm_rxw_add		mock_pgm_rxw_add
 #define pgm_rxw_remove_commit	mock_pgm_rxw_remove_commit
 #define pgm_rxw_readv		mock_pgm_rxw_readv
+#define pgm_rxw_lease		mock_pgm_rxw_lease
+#define pgm_rxw_spill		mock_pgm_rxw_spill
+#define pgm_rxw_first_missing	mock_pgm_rxw_first_missing
 #define pgm_csum_fold		mock_pgm_csum_fold
 #define pgm_compat_csum_partial	mock_pgm_compat_csum_partial
 #define pgm_histogram_init	mock_pgm_histogram_init
@@ -94,6 +115,34 @@ generate_sock (void)
 	return sock;
 }
 
+/* SPM with lead 100, trail 0, and the provided options.
+ */
+
+static
+struct pgm_sk_buff_t*
+generate_spm (
+	const void*		options,
+	const size_t		options_len
+	)
+{
+	const size_t spm_len = sizeof(struct pgm_spm) + options_len;
+	struct pgm_sk_buff_t* skb = pgm_alloc_skb (sizeof(struct pgm_header) + spm_len);
+	skb->pgm_header = (struct pgm_header*)skb->head;
+	memset (skb->pgm_header, 0, sizeof(struct pgm_header));
+	skb->pgm_header->pgm_type = PGM_SPM;
+	if (options_len > 0)
+		skb->pgm_header->pgm_options = PGM_OPT_PRESENT;
+	pgm_skb_reserve (skb, sizeof(struct pgm_header));
+	struct pgm_spm* spm = (struct pgm_spm*)pgm_skb_put (skb, spm_len);
+	memset (spm, 0, sizeof(struct pgm_spm));
+	spm->spm_sqn	 = pgm_htonl (1);
+	spm->spm_lead	 = pgm_htonl (100);
+	spm->spm_nla_afi = pgm_htons (AFI_IP);
+	memcpy (spm + 1, options, options_len);
+	skb->tstamp = 0x1;
+	return skb;
+}
+
 static
 pgm_peer_t*
 generate_peer (void)
@@ -170,6 +219,7 @@ mock_pgm_sendto_hops (
 static pgm_time_t mock_pgm_time_now = 0x1;
 static pgm_time_t _mock_pgm_time_update_now (void);
 pgm_time_update_func mock_pgm_time_update_now = _mock_pgm_time_update_now;
+PGM_THREAD_LOCAL struct pgm_time_cache_t pgm_time_cache;
 
 pgm_time_t
 _mock_pgm_time_update_now (void)
@@ -271,7 +321,10 @@ mock_pgm_rxw_update (
 	const pgm_time_t		nak_rb_expiry
 	)
 {
-	return 0;
+	if (mock_rxw_update_count < G_N_ELEMENTS(mock_rxw_update_lead))
+		mock_rxw_update_lead[mock_rxw_update_count] = txw_lead;
+	mock_rxw_update_count++;
+	return mock_rxw_update_naks;
 }
 
 void
@@ -306,6 +359,58 @@ mock_pgm_rxw_readv (
 	struct pgm_msgv_t**		pmsg,
 	const unsigned			pmsglen
 	)
+{
+	struct mock_rxw_data_t* data = NULL;
+	const struct pgm_msgv_t* msg_end = *pmsg + pmsglen;
+	ssize_t bytes_read = -1;
+
+	for (unsigned i = 0; i < G_N_ELEMENTS(mock_rxw_data); i++)
+		if (window == mock_rxw_data[i].window)
+			data = &mock_rxw_data[i];
+	if (NULL == data)
+		return -1;
+/* one message per APDU, or per PGM_MAX_FRAGMENTS TPDUs of a larger APDU */
+	while (*pmsg < msg_end && (data->tpdus_left || data->apdus))
+	{
+		if (0 == data->tpdus_left) {
+			data->tpdus_left = data->tpdus;
+			data->apdus--;
+		}
+		const unsigned count = MIN(data->tpdus_left, PGM_MAX_FRAGMENTS);
+		data->tpdus_left -= count;
+		window->apdu_remaining = data->tpdus_left;
+		(*pmsg)->msgv_len = count;
+		(*pmsg)->msgv_skb[0] = &mock_readv_skb;
+		(*pmsg)++;
+		if (mock_readv_count < sizeof(mock_readv_log) - 1)
+			mock_readv_log[mock_readv_count++] = data->name;
+		bytes_read = (bytes_read > 0 ? bytes_read : 0) + count;
+	}
+	return bytes_read;
+}
+
+struct pgm_sk_buff_t*
+mock_pgm_rxw_first_missing (
+	pgm_rxw_t* const		window,
+	uint32_t			sequence
+	)
+{
+	return NULL;
+}
+
+void
+mock_pgm_rxw_lease (
+	pgm_rxw_t* const		window,
+	const struct pgm_msgv_t*	msg,
+	const struct pgm_msgv_t* const	msg_end
+	)
+{
+}
+
+unsigned
+mock_pgm_rxw_spill (
+	pgm_rxw_t* const		window
+	)
 {
 	return 0;
 }
@@ -455,6 +560,212 @@ START_TEST (test_min_receiver_expiry_fail_001)
 }
 END_TEST
 
+/* target:
+ *	int
+ *	pgm_flush_peers_pending (
+ *		pgm_sock_t* const		sock,
+ *		struct pgm_msgv_t**		pmsg,
+ *		const struct pgm_msgv_t* const	msg_end,
+ *		size_t* const			bytes_read,
+ *		unsigned* const			data_read
+ *		)
+ */
+
+static
+void
+generate_pending_peer (
+	pgm_sock_t* const	sock,
+	const unsigned		i,
+	const char		name,
+	const unsigned		apdus,
+	const unsigned		tpdus
+	)
+{
+	pgm_peer_t* peer = generate_peer ();
+	peer->weight = 1;
+	mock_rxw_data[i].window	    = peer->window;
+	mock_rxw_data[i].name	    = name;
+	mock_rxw_data[i].apdus	    = apdus;
+	mock_rxw_data[i].tpdus	    = tpdus;
+	mock_rxw_data[i].tpdus_left = 0;
+	pgm_peer_set_pending (sock, peer);
+}
+
+/* an APDU beyond PGM_MAX_FRAGMENTS is read whole before rotating peers */
+START_TEST (test_flush_peers_pending_pass_001)
+{
+	struct pgm_msgv_t msgv[8], *pmsg = msgv;
+	size_t bytes_read = 0;
+	unsigned data_read = 0;
+	pgm_sock_t* sock = generate_sock ();
+	sock->recv_quantum = 1;
+	memset (mock_readv_log, 0, sizeof(mock_readv_log));
+	mock_readv_count = 0;
+	generate_pending_peer (sock, 1, 'B', 3, 1);
+	generate_pending_peer (sock, 0, 'A', 1, 40);
+	fail_unless (0 == pgm_flush_peers_pending (sock, &pmsg, msgv + G_N_ELEMENTS(msgv) - 1, &bytes_read, &data_read), "flush_peers_pending failed");
+	fail_unless (0 == strcmp ("AAABBB", mock_readv_log), "unexpected order");
+	fail_unless (43 == bytes_read, "unexpected bytes_read");
+	fail_unless (NULL == sock->peers_pending, "peers still pending");
+}
+END_TEST
+
+/* each visit reads the quantum scaled by the peer weight */
+START_TEST (test_flush_peers_pending_pass_002)
+{
+	struct pgm_msgv_t msgv[8], *pmsg = msgv;
+	size_t bytes_read = 0;
+	unsigned data_read = 0;
+	pgm_sock_t* sock = generate_sock ();
+	sock->recv_quantum = 1;
+	memset (mock_readv_log, 0, sizeof(mock_readv_log));
+	mock_readv_count = 0;
+	generate_pending_peer (sock, 1, 'B', 3, 1);
+	generate_pending_peer (sock, 0, 'A', 3, 1);
+	((pgm_peer_t*)sock->peers_pending->data)->weight = 2;
+	fail_unless (0 == pgm_flush_peers_pending (sock, &pmsg, msgv + G_N_ELEMENTS(msgv) - 1, &bytes_read, &data_read), "flush_peers_pending failed");
+	fail_unless (0 == strcmp ("AABABB", mock_readv_log), "unexpected order");
+	fail_unless (6 == bytes_read, "unexpected bytes_read");
+	fail_unless (NULL == sock->peers_pending, "peers still pending");
+}
+END_TEST
+
+/* deficit carried over a full vector saturates at the maximum weight */
+START_TEST (test_flush_peers_pending_pass_003)
+{
+	struct pgm_msgv_t msgv[2], *pmsg = msgv;
+	size_t bytes_read = 0;
+	unsigned data_read = 0;
+	pgm_sock_t* sock = generate_sock ();
+	sock->recv_quantum = UINT16_MAX;
+	memset (mock_readv_log, 0, sizeof(mock_readv_log));
+	mock_readv_count = 0;
+	generate_pending_peer (sock, 0, 'A', 10, 1);
+	pgm_peer_t* peer = sock->peers_pending->data;
+	peer->weight = UINT16_MAX;
+	peer->deficit = UINT_MAX - 1;
+	fail_unless (-PGM_SOCK_ENOBUFS == pgm_flush_peers_pending (sock, &pmsg, msgv + G_N_ELEMENTS(msgv) - 1, &bytes_read, &data_read), "flush_peers_pending failed");
+	fail_unless (2 == bytes_read, "unexpected bytes_read");
+	fail_unless (peer == sock->peers_pending->data, "peer not left at head");
+	fail_unless (UINT_MAX - 2 == peer->deficit, "deficit wrapped");
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_on_spm (
+ *		pgm_sock_t* const		sock,
+ *		pgm_peer_t* const		source,
+ *		struct pgm_sk_buff_t* const	skb
+ *		)
+ */
+
+static
+const guint8 test_opt_join[] = {
+	PGM_OPT_LENGTH, sizeof(struct pgm_opt_length), 0, sizeof(struct pgm_opt_length) + sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_join),
+	PGM_OPT_JOIN | PGM_OPT_END, sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_join), 0,
+	0, 0, 0, 0, 95
+};
+
+/* late join starts the window at the advertised join point */
+START_TEST (test_on_spm_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	pgm_peer_t* peer = generate_peer ();
+	struct pgm_sk_buff_t* skb = generate_spm (test_opt_join, sizeof(test_opt_join));
+	sock->late_join = 10;
+	sock->nak_bo_ivl = TEST_NAK_BO_IVL;
+	sock->next_poll = -1;
+	peer->window->alloc = TEST_RXW_SQNS;
+	mock_rxw_update_count = 0;
+	mock_rxw_update_naks = 1;
+	fail_unless (TRUE == pgm_on_spm (sock, peer, skb), "on_spm failed");
+	fail_unless (2 == mock_rxw_update_count, "unexpected update count");
+	fail_unless (94 == mock_rxw_update_lead[0], "unexpected join lead");
+	fail_unless (100 == mock_rxw_update_lead[1], "unexpected lead");
+	fail_unless (sock->next_poll <= skb->tstamp + sock->nak_bo_ivl, "next_poll not scheduled");
+	fail_unless (0 == peer->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS], "counted malformed");
+}
+END_TEST
+
+/* late join bounded by the socket option */
+START_TEST (test_on_spm_pass_002)
+{
+	guint8 options[sizeof(test_opt_join)];
+	pgm_sock_t* sock = generate_sock ();
+	pgm_peer_t* peer = generate_peer ();
+	memcpy (options, test_opt_join, sizeof(options));
+	options[sizeof(options) - 1] = 0;
+	struct pgm_sk_buff_t* skb = generate_spm (options, sizeof(options));
+	sock->late_join = 10;
+	sock->nak_bo_ivl = TEST_NAK_BO_IVL;
+	peer->window->alloc = TEST_RXW_SQNS;
+	mock_rxw_update_count = 0;
+	mock_rxw_update_naks = 0;
+	fail_unless (TRUE == pgm_on_spm (sock, peer, skb), "on_spm failed");
+	fail_unless (2 == mock_rxw_update_count, "unexpected update count");
+	fail_unless (90 == mock_rxw_update_lead[0], "unexpected join lead");
+}
+END_TEST
+
+/* OPT_JOIN ignored without late join */
+START_TEST (test_on_spm_pass_003)
+{
+	pgm_sock_t* sock = generate_sock ();
+	pgm_peer_t* peer = generate_peer ();
+	struct pgm_sk_buff_t* skb = generate_spm (test_opt_join, sizeof(test_opt_join));
+	sock->nak_bo_ivl = TEST_NAK_BO_IVL;
+	peer->window->alloc = TEST_RXW_SQNS;
+	mock_rxw_update_count = 0;
+	mock_rxw_update_naks = 0;
+	fail_unless (TRUE == pgm_on_spm (sock, peer, skb), "on_spm failed");
+	fail_unless (1 == mock_rxw_update_count, "unexpected update count");
+	fail_unless (100 == mock_rxw_update_lead[0], "unexpected lead");
+}
+END_TEST
+
+/* zero length option */
+START_TEST (test_on_spm_fail_001)
+{
+	guint8 options[sizeof(test_opt_join)];
+	pgm_sock_t* sock = generate_sock ();
+	pgm_peer_t* peer = generate_peer ();
+	memcpy (options, test_opt_join, sizeof(options));
+	options[5] = 0;
+	struct pgm_sk_buff_t* skb = generate_spm (options, sizeof(options));
+	sock->late_join = 10;
+	sock->nak_bo_ivl = TEST_NAK_BO_IVL;
+	peer->window->alloc = TEST_RXW_SQNS;
+	mock_rxw_update_count = 0;
+	fail_unless (FALSE == pgm_on_spm (sock, peer, skb), "on_spm failed");
+	fail_unless (0 == mock_rxw_update_count, "unexpected update");
+	fail_unless (1 == peer->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS], "malformed not counted");
+/* also rejected by the option walk without late join */
+	sock->late_join = 0;
+	fail_unless (FALSE == pgm_on_spm (sock, peer, skb), "on_spm failed");
+	fail_unless (2 == peer->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS], "malformed not counted");
+}
+END_TEST
+
+/* OPT_JOIN truncated, without OPT_END */
+START_TEST (test_on_spm_fail_002)
+{
+	guint8 options[sizeof(test_opt_join)];
+	pgm_sock_t* sock = generate_sock ();
+	pgm_peer_t* peer = generate_peer ();
+	memcpy (options, test_opt_join, sizeof(options));
+	options[4] = PGM_OPT_SYN;
+	struct pgm_sk_buff_t* skb = generate_spm (options, sizeof(options) - 2);
+	sock->late_join = 10;
+	sock->nak_bo_ivl = TEST_NAK_BO_IVL;
+	peer->window->alloc = TEST_RXW_SQNS;
+	mock_rxw_update_count = 0;
+	fail_unless (FALSE == pgm_on_spm (sock, peer, skb), "on_spm failed");
+	fail_unless (0 == mock_rxw_update_count, "unexpected update");
+	fail_unless (1 == peer->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_SPMS], "malformed not counted");
+}
+END_TEST
+
 /* target:
  *	bool
  *	pgm_setsockopt (
@@ -836,6 +1147,22 @@ make_test_suite (void)
 	tcase_add_test_raise_signal (tc_min_receiver_expiry, test_min_receiver_expiry_fail_001, SIGABRT);
 #endif
 
+	TCase* tc_flush_peers_pending = tcase_create ("flush-peers-pending");
+	suite_add_tcase (s, tc_flush_peers_pending);
+	tcase_add_checked_fixture (tc_flush_peers_pending, mock_setup, NULL);
+	tcase_add_test (tc_flush_peers_pending, test_flush_peers_pending_pass_001);
+	tcase_add_test (tc_flush_peers_pending, test_flush_peers_pending_pass_002);
+	tcase_add_test (tc_flush_peers_pending, test_flush_peers_pending_pass_003);
+
+	TCase* tc_on_spm = tcase_create ("on-spm");
+	suite_add_tcase (s, tc_on_spm);
+	tcase_add_checked_fixture (tc_on_spm, mock_setup, NULL);
+	tcase_add_test (tc_on_spm, test_on_spm_pass_001);
+	tcase_add_test (tc_on_spm, test_on_spm_pass_002);
+	tcase_add_test (tc_on_spm, test_on_spm_pass_003);
+	tcase_add_test (tc_on_spm, test_on_spm_fail_001);
+	tcase_add_test (tc_on_spm, test_on_spm_fail_002);
+
 	TCase* tc_set_rxw_sqns = tcase_create ("set-rxw_sqns");
 	suite_add_tcase (s, tc_set_rxw_sqns);
 	tcase_add_checked_fixture (tc_set_rxw_sqns, mock_setup, NULL);
@@ -32,16 +32,21 @@
 #	include <sys/types.h>
 #	include <sys/socket.h>
 #	include <netinet/in.h>		/* _GNU_SOURCE for in6_pktinfo */
+#	ifdef HAVE_UDP_GRO
+#		include <netinet/udp.h>
+#	endif
 #else
 #	include <ws2tcpip.h>
 #	include <mswsock.h>
 #endif
 #include <impl/i18n.h>
 #include <impl/framework.h>
+#include <impl/net.h>
 #include <impl/source.h>
 #include <impl/packet_parse.h>
 #include <impl/timer.h>
 #include <impl/engine.h>
+#include <impl/recv.h>
 
 
 //#define RECV_DEBUG
@@ -75,6 +80,432 @@
 #	define pgm_cmsghdr			cmsghdr
 #endif
 
+#ifndef _WIN32
+#	define pgm_msghdr			msghdr
+#else
+#	define pgm_msghdr			_WSAMSG
+#endif
+
+/* datagrams read into the receive windows with a full message vector and an
+ * overflow log.
+ */
+#define PGM_RECV_READ_AHEAD			1024
+
+#ifdef HAVE_RECVMMSG
+/* control buffer per datagram only needs to carry packet info */
+#	define PGM_RX_BATCH_AUXLEN		256
+
+struct pgm_rx_batch_slot_t {
+	struct pgm_sk_buff_t*		skb;
+	struct iovec			iov;
+	struct sockaddr_storage		src_addr;
+	char				aux[ PGM_RX_BATCH_AUXLEN ];
+};
+
+struct pgm_rx_batch_t {
+	unsigned			size;		/* maximum datagrams per recvmmsg() */
+	unsigned			count;		/* datagrams read by last recvmmsg() */
+	unsigned			next;		/* next datagram to deliver */
+	pgm_time_t			tstamp;		/* time of last recvmmsg() */
+	struct mmsghdr*			mmsg;
+	struct pgm_rx_batch_slot_t*	slot;
+#	ifdef HAVE_UDP_GRO
+	size_t				segment_size;	/* expected length of coalesced segments */
+	struct iovec*			gro_iov;	/* one element per slot */
+	char*				gro_buffer;	/* realignment of mismatched segments */
+#	endif
+};
+#endif /* HAVE_RECVMMSG */
+
+/* returns TRUE if datagrams remain from the last batched read.
+ */
+
+static inline
+bool
+pgm_rx_batch_is_pending (
+	const pgm_sock_t* const	sock
+	)
+{
+#ifdef HAVE_RECVMMSG
+	return (NULL != sock->rx_batch && sock->rx_batch->next != sock->rx_batch->count);
+#else
+	(void)sock;
+	return FALSE;
+#endif
+}
+
+
+/* read destination address from packet info ancillary data.
+ *
+ * returns TRUE on success, returns FALSE on invalid control message.
+ */
+
+static
+bool
+recvskb_pktinfo (
+	struct pgm_msghdr* const restrict msg,
+	struct sockaddr*   const restrict dst_addr
+	)
+{
+	struct pgm_cmsghdr* cmsg;
+	for (cmsg = PGM_CMSG_FIRSTHDR(msg);
+	     cmsg != NULL;
+	     cmsg = PGM_CMSG_NXTHDR(msg, cmsg))
+	{
+/* both IP_PKTINFO and IP_RECVDSTADDR exist on OpenSolaris, so capture
+ * each type if defined.
+ */
+#ifdef IP_PKTINFO
+		if (IPPROTO_IP == cmsg->cmsg_level && 
+		    IP_PKTINFO == cmsg->cmsg_type)
+		{
+			const void* pktinfo		= PGM_CMSG_DATA(cmsg);
+/* discard on invalid address */
+			if (PGM_UNLIKELY(NULL == pktinfo)) {
+				pgm_debug ("in_pktinfo is NULL");
+				return FALSE;
+			}
+			const struct in_pktinfo* in	= pktinfo;
+			struct sockaddr_in s4;
+			memset (&s4, 0, sizeof(s4));
+			s4.sin_family			= AF_INET;
+			s4.sin_addr.s_addr		= in->ipi_addr.s_addr;
+			memcpy (dst_addr, &s4, sizeof(s4));
+			break;
+		}
+#endif
+#ifdef IP_RECVDSTADDR
+		if (IPPROTO_IP == cmsg->cmsg_level &&
+		    IP_RECVDSTADDR == cmsg->cmsg_type)
+		{
+			const void* recvdstaddr		= PGM_CMSG_DATA(cmsg);
+/* discard on invalid address */
+			if (PGM_UNLIKELY(NULL == recvdstaddr)) {
+				pgm_debug ("in_recvdstaddr is NULL");
+				return FALSE;
+			}
+			const struct in_addr* in	= recvdstaddr;
+			struct sockaddr_in s4;
+			memset (&s4, 0, sizeof(s4));
+			s4.sin_family			= AF_INET;
+			s4.sin_addr.s_addr		= in->s_addr;
+			memcpy (dst_addr, &s4, sizeof(s4));
+			break;
+		}
+#endif
+#if !defined(IP_PKTINFO) && !defined(IP_RECVDSTADDR)
+#	error "No defined CMSG type for IPv4 destination address."
+#endif
+
+		if (IPPROTO_IPV6 == cmsg->cmsg_level && 
+		    IPV6_PKTINFO == cmsg->cmsg_type)
+		{
+			const void* pktinfo		= PGM_CMSG_DATA(cmsg);
+/* discard on invalid address */
+			if (PGM_UNLIKELY(NULL == pktinfo)) {
+				pgm_debug ("in6_pktinfo is NULL");
+				return FALSE;
+			}
+			const struct in6_pktinfo* in6	= pktinfo;
+			struct sockaddr_in6 s6;
+			memset (&s6, 0, sizeof(s6));
+			s6.sin6_family			= AF_INET6;
+			s6.sin6_addr			= in6->ipi6_addr;
+			s6.sin6_scope_id		= in6->ipi6_ifindex;
+			memcpy (dst_addr, &s6, sizeof(s6));
+/* does not set flow id */
+			break;
+		}
+	}
+	return TRUE;
+}
+
+#if defined(HAVE_SO_TIMESTAMPNS) && defined(HAVE_GETTIMEOFDAY)
+/* read arrival time from kernel time stamp ancillary data.
+ *
+ * returns time stamp in the active time source, returns 0 if not present.
+ */
+
+static
+pgm_time_t
+recvskb_tstamp (
+	struct msghdr* const	msg
+	)
+{
+	struct cmsghdr* cmsg;
+	for (cmsg = CMSG_FIRSTHDR(msg);
+	     cmsg != NULL;
+	     cmsg = CMSG_NXTHDR(msg, cmsg))
+	{
+		if (SOL_SOCKET == cmsg->cmsg_level &&
+		    SCM_TIMESTAMPNS == cmsg->cmsg_type)
+		{
+			struct timespec ts;
+			memcpy (&ts, CMSG_DATA(cmsg), sizeof(ts));
+			return pgm_time_from_realtime (pgm_secs (ts.tv_sec) + ts.tv_nsec / 1000);
+		}
+	}
+	return 0;
+}
+#endif
+
+#ifdef HAVE_RECVMMSG
+/* create batch of receive buffers for recvmmsg(), one spare skb per datagram.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_rx_batch_create (
+	pgm_sock_t* const	sock
+	)
+{
+	struct pgm_rx_batch_t* batch;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL == sock->rx_batch);
+	pgm_assert_cmpuint (sock->rx_batch_size, >, 1);
+	pgm_assert_cmpuint (sock->max_tpdu, >, 0);
+
+	size_t len = sizeof(struct pgm_rx_batch_t) +
+		     sock->rx_batch_size * (sizeof(struct mmsghdr) + sizeof(struct pgm_rx_batch_slot_t));
+#	ifdef HAVE_UDP_GRO
+	if (sock->use_udp_gro)
+		len += sock->rx_batch_size * sizeof(struct iovec) + UINT16_MAX;
+#	endif
+	batch = pgm_malloc0 (len);
+	batch->size = sock->rx_batch_size;
+	batch->mmsg = (struct mmsghdr*)(batch + 1);
+	batch->slot = (struct pgm_rx_batch_slot_t*)(batch->mmsg + batch->size);
+#	ifdef HAVE_UDP_GRO
+	if (sock->use_udp_gro) {
+/* full-sized TPDUs from a peer with matching configuration */
+		batch->segment_size = sock->max_tpdu - sock->iphdr_len;
+		batch->gro_iov	    = (struct iovec*)(batch->slot + batch->size);
+		batch->gro_buffer   = (char*)(batch->gro_iov + batch->size);
+	}
+#	endif
+	for (unsigned i = 0; i < batch->size; i++) {
+		struct pgm_rx_batch_slot_t* slot = &batch->slot[ i ];
+		slot->skb			= pgm_sock_alloc_skb (sock, sock->max_tpdu);
+		slot->iov.iov_base		= slot->skb->head;
+		slot->iov.iov_len		= sock->max_tpdu;
+		batch->mmsg[ i ].msg_hdr.msg_iov	= &slot->iov;
+		batch->mmsg[ i ].msg_hdr.msg_iovlen	= 1;
+	}
+	sock->rx_batch = batch;
+}
+
+PGM_GNUC_INTERNAL
+void
+pgm_rx_batch_destroy (
+	pgm_sock_t* const	sock
+	)
+{
+	struct pgm_rx_batch_t* batch;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != sock->rx_batch);
+
+	batch = sock->rx_batch;
+	for (unsigned i = 0; i < batch->size; i++)
+		pgm_free_skb (batch->slot[ i ].skb);
+	pgm_free (batch);
+	sock->rx_batch = NULL;
+}
+
+#	ifdef HAVE_UDP_GRO
+/* fill the batch with one coalesced read, scattering segments of the expected
+ * length directly into one skb each.  segments of any other length are
+ * realigned through a bounce buffer and the expected length updated.
+ *
+ * returns count of datagrams read, on closed socket returns 0, on error
+ * returns -1.
+ */
+
+static
+int
+rx_batch_read_gro (
+	pgm_sock_t*	       const restrict sock,
+	struct pgm_rx_batch_t* const restrict batch,
+	const int			      flags
+	)
+{
+	struct pgm_rx_batch_slot_t* slot = batch->slot;
+
+	for (unsigned i = 0; i < batch->size; i++) {
+		batch->gro_iov[ i ].iov_base	= slot[ i ].skb->head;
+		batch->gro_iov[ i ].iov_len	= batch->segment_size;
+	}
+	struct msghdr msg = {
+		.msg_name	= &slot[ 0 ].src_addr,
+		.msg_namelen	= sizeof(struct sockaddr_storage),
+		.msg_iov	= batch->gro_iov,
+		.msg_iovlen	= batch->size,
+		.msg_control	= slot[ 0 ].aux,
+		.msg_controllen = sizeof(slot[ 0 ].aux),
+		.msg_flags	= 0
+	};
+	const ssize_t len = recvmsg (sock->recv_sock, &msg, flags);
+	if (len <= 0)
+		return (int)len;
+
+/* segment length of coalesced datagrams, otherwise one datagram */
+	size_t gso_size = len;
+	struct cmsghdr* cmsg;
+	for (cmsg = CMSG_FIRSTHDR(&msg);
+	     cmsg != NULL;
+	     cmsg = CMSG_NXTHDR(&msg, cmsg))
+	{
+		if (IPPROTO_UDP == cmsg->cmsg_level &&
+		    UDP_GRO == cmsg->cmsg_type)
+		{
+			int gso;
+			memcpy (&gso, CMSG_DATA(cmsg), sizeof(gso));
+			if (PGM_LIKELY(gso > 0))
+				gso_size = gso;
+			break;
+		}
+	}
+	if (PGM_UNLIKELY(gso_size > sock->max_tpdu)) {
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded coalesced datagrams larger than maximum TPDU."));
+		pgm_set_last_sock_error (PGM_SOCK_EAGAIN);
+		return SOCKET_ERROR;
+	}
+	const unsigned count = (unsigned)MIN( (len + gso_size - 1) / gso_size, batch->size );
+
+	if (( 1 == count && (size_t)len > batch->segment_size) ||
+	    ( 1 < count && gso_size != batch->segment_size))
+	{
+		size_t offset = 0;
+		for (unsigned i = 0; offset < (size_t)len; i++) {
+			const size_t copy_len = MIN( batch->segment_size, (size_t)len - offset );
+			memcpy (batch->gro_buffer + offset, batch->gro_iov[ i ].iov_base, copy_len);
+			offset += copy_len;
+		}
+		for (unsigned i = 0; i < count; i++)
+			memcpy (slot[ i ].skb->head,
+				batch->gro_buffer + (i * gso_size),
+				MIN( gso_size, (size_t)len - (i * gso_size) ));
+		if (count > 1)
+			batch->segment_size = gso_size;
+	}
+
+/* every segment shares source address and packet info */
+	for (unsigned i = 0; i < count; i++) {
+		struct mmsghdr* mmsg		= &batch->mmsg[ i ];
+		mmsg->msg_len			= (unsigned)MIN( gso_size, (size_t)len - (i * gso_size) );
+		mmsg->msg_hdr.msg_namelen	= msg.msg_namelen;
+		mmsg->msg_hdr.msg_control	= msg.msg_control;
+		mmsg->msg_hdr.msg_controllen	= msg.msg_controllen;
+		if (i > 0)
+			memcpy (&slot[ i ].src_addr, &slot[ 0 ].src_addr, msg.msg_namelen);
+	}
+	return (int)count;
+}
+#	endif /* HAVE_UDP_GRO */
+
+/* read a packet from the current batch, refilling the batch with one
+ * recvmmsg() call when exhausted.  the filled skb is swapped with the
+ * sockets spare receive buffer.
+ *
+ * on success returns packet length, on closed socket returns 0,
+ * on error returns -1.
+ */
+
+static
+ssize_t
+recvmmskb (
+	pgm_sock_t*           const restrict sock,
+	const int			     flags,
+	struct sockaddr*      const restrict src_addr,
+	const socklen_t			     src_addrlen,
+	struct sockaddr*      const restrict dst_addr
+	)
+{
+	struct pgm_rx_batch_t* batch = sock->rx_batch;
+
+	if (batch->next == batch->count)
+	{
+		int count;
+#	ifdef HAVE_UDP_GRO
+		if (sock->use_udp_gro)
+			count = rx_batch_read_gro (sock, batch, flags);
+		else
+#	endif
+		{
+			for (unsigned i = 0; i < batch->size; i++) {
+				struct msghdr* msg	= &batch->mmsg[ i ].msg_hdr;
+				msg->msg_name		= &batch->slot[ i ].src_addr;
+				msg->msg_namelen	= sizeof(struct sockaddr_storage);
+				msg->msg_control	= batch->slot[ i ].aux;
+				msg->msg_controllen	= sizeof(batch->slot[ i ].aux);
+				msg->msg_flags		= 0;
+			}
+			count = recvmmsg (sock->recv_sock, batch->mmsg, batch->size, flags, NULL);
+		}
+		if (count <= 0) {
+			batch->count = batch->next = 0;
+			return count;
+		}
+		batch->count	= count;
+		batch->next	= 0;
+/* one clock read per batch unless stamped by the kernel */
+		if (!sock->use_kernel_tstamp)
+			batch->tstamp	= pgm_time_refresh();
+	}
+
+	struct mmsghdr* mmsg = &batch->mmsg[ batch->next ];
+	struct pgm_rx_batch_slot_t* slot = &batch->slot[ batch->next ];
+	batch->next++;
+
+/* swap filled buffer with spare receive buffer */
+	struct pgm_sk_buff_t* skb = slot->skb;
+	slot->skb		= sock->rx_buffer;
+	slot->iov.iov_base	= slot->skb->head;
+	sock->rx_buffer		= skb;
+
+	const ssize_t len = mmsg->msg_len;
+	if (PGM_UNLIKELY(0 == len))
+		return len;
+	memcpy (src_addr, &slot->src_addr, MIN(src_addrlen, mmsg->msg_hdr.msg_namelen));
+
+#ifdef PGM_DEBUG
+	if (PGM_UNLIKELY(pgm_loss_rate > 0)) {
+		const unsigned percent = pgm_rand_int_range (&sock->rand_, 0, 100);
+		if (percent <= pgm_loss_rate) {
+			pgm_debug ("Simulated packet loss");
+			pgm_set_last_sock_error (PGM_SOCK_EAGAIN);
+			return SOCKET_ERROR;
+		}
+	}
+#endif
+
+	skb->sock		= sock;
+#if defined(HAVE_SO_TIMESTAMPNS) && defined(HAVE_GETTIMEOFDAY)
+	if (sock->use_kernel_tstamp) {
+		skb->tstamp		= recvskb_tstamp (&mmsg->msg_hdr);
+		if (PGM_UNLIKELY(0 == skb->tstamp))
+			skb->tstamp	= pgm_time_refresh();
+	} else
+#endif
+		skb->tstamp		= batch->tstamp;
+	skb->data		= skb->head;
+	skb->len		= (uint16_t)len;
+	skb->zero_padded	= 0;
+	skb->tail		= (char*)skb->data + len;
+
+	if (sock->udp_encap_ucast_port ||
+	    AF_INET6 == pgm_sockaddr_family (src_addr))
+	{
+		if (PGM_UNLIKELY(!recvskb_pktinfo (&mmsg->msg_hdr, dst_addr)))
+			return -1;
+	}
+	return len;
+}
+#endif /* HAVE_RECVMMSG */
+
 
 /* read a packet into a PGM skbuff
  * on success returns packet length, on closed socket returns 0,
@@ -107,6 +538,13 @@ recvskb (
 	if (PGM_UNLIKELY(sock->is_destroyed))
 		return 0;
 
+#ifdef HAVE_RECVMMSG
+	if (NULL != sock->rx_batch) {
+		pgm_assert (skb == sock->rx_buffer);
+		return recvmmskb (sock, flags, src_addr, src_addrlen, dst_addr);
+	}
+#endif
+
 	struct pgm_iovec iov = {
 		.iov_base	= skb->head,
 		.iov_len	= sock->max_tpdu
@@ -153,7 +591,15 @@ recvskb (
 #endif
 
 	skb->sock		= sock;
-	skb->tstamp		= pgm_time_update_now();
+#if defined(HAVE_SO_TIMESTAMPNS) && defined(HAVE_GETTIMEOFDAY)
+	if (sock->use_kernel_tstamp) {
+		skb->tstamp		= recvskb_tstamp (&msg);
+		if (PGM_UNLIKELY(0 == skb->tstamp))
+			skb->tstamp	= pgm_time_refresh();
+	} else
+#endif
+/* one clock read per datagram, the read ahead may span many */
+		skb->tstamp		= pgm_time_refresh();
 	skb->data		= skb->head;
 	skb->len		= (uint16_t)len;
 	skb->zero_padded	= 0;
@@ -162,76 +608,8 @@ recvskb (
 	if (sock->udp_encap_ucast_port ||
 	    AF_INET6 == pgm_sockaddr_family (src_addr))
 	{
-		struct pgm_cmsghdr* cmsg;
-		for (cmsg = PGM_CMSG_FIRSTHDR(&msg);
-		     cmsg != NULL;
-		     cmsg = PGM_CMSG_NXTHDR(&msg, cmsg))
-		{
-/* both IP_PKTINFO and IP_RECVDSTADDR exist on OpenSolaris, so capture
- * each type if defined.
- */
-#ifdef IP_PKTINFO
-			if (IPPROTO_IP == cmsg->cmsg_level && 
-			    IP_PKTINFO == cmsg->cmsg_type)
-			{
-				const void* pktinfo		= PGM_CMSG_DATA(cmsg);
-/* discard on invalid address */
-				if (PGM_UNLIKELY(NULL == pktinfo)) {
-					pgm_debug ("in_pktinfo is NULL");
-					return -1;
-				}
-				const struct in_pktinfo* in	= pktinfo;
-				struct sockaddr_in s4;
-				memset (&s4, 0, sizeof(s4));
-				s4.sin_family			= AF_INET;
-				s4.sin_addr.s_addr		= in->ipi_addr.s_addr;
-				memcpy (dst_addr, &s4, sizeof(s4));
-				break;
-			}
-#endif
-#ifdef IP_RECVDSTADDR
-			if (IPPROTO_IP == cmsg->cmsg_level &&
-			    IP_RECVDSTADDR == cmsg->cmsg_type)
-			{
-				const void* recvdstaddr		= PGM_CMSG_DATA(cmsg);
-/* discard on invalid address */
-				if (PGM_UNLIKELY(NULL == recvdstaddr)) {
-					pgm_debug ("in_recvdstaddr is NULL");
-					return -1;
-				}
-				const struct in_addr* in	= recvdstaddr;
-				struct sockaddr_in s4;
-				memset (&s4, 0, sizeof(s4));
-				s4.sin_family			= AF_INET;
-				s4.sin_addr.s_addr		= in->s_addr;
-				memcpy (dst_addr, &s4, sizeof(s4));
-				break;
-			}
-#endif
-#if !defined(IP_PKTINFO) && !defined(IP_RECVDSTADDR)
-#	error "No defined CMSG type for IPv4 destination address."
-#endif
-
-			if (IPPROTO_IPV6 == cmsg->cmsg_level && 
-			    IPV6_PKTINFO == cmsg->cmsg_type)
-			{
-				const void* pktinfo		= PGM_CMSG_DATA(cmsg);
-/* discard on invalid address */
-				if (PGM_UNLIKELY(NULL == pktinfo)) {
-					pgm_debug ("in6_pktinfo is NULL");
-					return -1;
-				}
-				const struct in6_pktinfo* in6	= pktinfo;
-				struct sockaddr_in6 s6;
-				memset (&s6, 0, sizeof(s6));
-				s6.sin6_family			= AF_INET6;
-				s6.sin6_addr			= in6->ipi6_addr;
-				s6.sin6_scope_id		= in6->ipi6_ifindex;
-				memcpy (dst_addr, &s6, sizeof(s6));
-/* does not set flow id */
-				break;
-			}
-		}
+		if (PGM_UNLIKELY(!recvskb_pktinfo ((struct pgm_msghdr*)&msg, dst_addr)))
+			return -1;
 	}
 	return len;
 }
@@ -310,7 +688,7 @@ on_upstream (
 
 	return TRUE;
 out_discarded:
-	sock->cumulative_stats[PGM_PC_SOURCE_PACKETS_DISCARDED]++;
+	pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_PACKETS_DISCARDED]);
 	return FALSE;
 }
 
@@ -354,9 +732,9 @@ on_peer (
 	memcpy (&upstream_tsi.gsi, &skb->tsi.gsi, sizeof(pgm_gsi_t));
 	upstream_tsi.sport = skb->pgm_header->pgm_dport;
 
-	pgm_rwlock_reader_lock (&sock->peers_lock);
+	pgm_sock_reader_lock (sock, &sock->peers_lock);
 	*source = pgm_hashtable_lookup (sock->peers_hashtable, &upstream_tsi);
-	pgm_rwlock_reader_unlock (&sock->peers_lock);
+	pgm_sock_reader_unlock (sock, &sock->peers_lock);
 	if (PGM_UNLIKELY(NULL == *source)) {
 /* this source is unknown, we don't care about messages about it */
 		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded peer packet about new source."));
@@ -388,9 +766,9 @@ on_peer (
 	return TRUE;
 out_discarded:
 	if (*source)
-		(*source)->cumulative_stats[PGM_PC_RECEIVER_PACKETS_DISCARDED]++;
+		pgm_stats_inc (&(*source)->cumulative_stats[PGM_PC_RECEIVER_PACKETS_DISCARDED]);
 	else if (sock->can_send_data)
-		sock->cumulative_stats[PGM_PC_SOURCE_PACKETS_DISCARDED]++;
+		pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_PACKETS_DISCARDED]);
 	return FALSE;
 }
 
@@ -443,9 +821,9 @@ on_downstream (
 	}
 	else
 	{
-		pgm_rwlock_reader_lock (&sock->peers_lock);
+		pgm_sock_reader_lock (sock, &sock->peers_lock);
 		*source = pgm_hashtable_lookup_extended (sock->peers_hashtable, &skb->tsi, &sock->last_hash_key);
-		pgm_rwlock_reader_unlock (&sock->peers_lock);
+		pgm_sock_reader_unlock (sock, &sock->peers_lock);
 		if (PGM_UNLIKELY(NULL == *source)) {
 			*source = pgm_new_peer (sock,
 					       &skb->tsi,
@@ -456,7 +834,7 @@ on_downstream (
 		sock->last_hash_value = *source;
 	}
 
-	(*source)->cumulative_stats[PGM_PC_RECEIVER_BYTES_RECEIVED] += skb->len;
+	pgm_stats_add (&(*source)->cumulative_stats[PGM_PC_RECEIVER_BYTES_RECEIVED], skb->len);
 	(*source)->last_packet = skb->tstamp;
 
 	skb->data       = (void*)( skb->pgm_header + 1 );
@@ -468,7 +846,7 @@ on_downstream (
 	case PGM_RDATA:
 		if (PGM_UNLIKELY(!pgm_on_data (sock, *source, skb)))
 			goto out_discarded;
-		sock->rx_buffer = pgm_alloc_skb (sock->max_tpdu);
+		sock->rx_buffer = pgm_sock_alloc_skb (sock, sock->max_tpdu);
 		break;
 
 	case PGM_NCF:
@@ -500,9 +878,9 @@ on_downstream (
 	return TRUE;
 out_discarded:
 	if (*source)
-		(*source)->cumulative_stats[PGM_PC_RECEIVER_PACKETS_DISCARDED]++;
+		pgm_stats_inc (&(*source)->cumulative_stats[PGM_PC_RECEIVER_PACKETS_DISCARDED]);
 	else if (sock->can_send_data)
-		sock->cumulative_stats[PGM_PC_SOURCE_PACKETS_DISCARDED]++;
+		pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_PACKETS_DISCARDED]);
 	return FALSE;
 }
 
@@ -550,10 +928,26 @@ on_pgm (
 
 	pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded unknown PGM packet."));
 	if (sock->can_send_data)
-		sock->cumulative_stats[PGM_PC_SOURCE_PACKETS_DISCARDED]++;
+		pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_PACKETS_DISCARDED]);
 	return FALSE;
 }
 
+/* data loss is reported once the remainder of an APDU spanning several
+ * messages has been returned.
+ */
+
+static inline
+bool
+_pgm_is_reset_pending (
+	const pgm_sock_t* const	sock
+	)
+{
+	if (PGM_LIKELY(!sock->is_reset))
+		return FALSE;
+	const pgm_peer_t* peer = sock->peers_pending->data;
+	return 0 == ((const pgm_rxw_t*)peer->window)->apdu_remaining;
+}
+
 /* block on receiving socket whilst holding sock::waiting-mutex
  * returns EAGAIN for waiting data, returns EINTR for waiting timer event,
  * returns ENOENT on closed sock, and returns EFAULT for libc error.
@@ -662,13 +1056,13 @@ pgm_recvmsgv (
 	if (PGM_LIKELY(msg_len)) pgm_return_val_if_fail (NULL != msg_start, PGM_IO_STATUS_ERROR);
 
 /* shutdown */
-	if (PGM_UNLIKELY(!pgm_rwlock_reader_trylock (&sock->lock)))
+	if (PGM_UNLIKELY(!pgm_sock_reader_trylock (sock, &sock->lock)))
 		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
 
 /* state */
 	if (PGM_UNLIKELY(!sock->is_bound || sock->is_destroyed))
 	{
-		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_sock_reader_unlock (sock, &sock->lock);
 		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
 	}
 
@@ -682,9 +1076,11 @@ pgm_recvmsgv (
 	}
 
 /* receiver */
-	pgm_mutex_lock (&sock->receiver_mutex);
+	pgm_sock_mutex_lock (sock, &sock->receiver_mutex);
+/* one clock read shared by timers, rate control, and packet time stamps */
+	pgm_time_cache_begin ();
 
-	if (PGM_UNLIKELY(sock->is_reset)) {
+	if (PGM_UNLIKELY(_pgm_is_reset_pending (sock))) {
 		pgm_assert (NULL != sock->peers_pending);
 		pgm_assert (NULL != sock->peers_pending->data);
 		pgm_peer_t* peer = sock->peers_pending->data;
@@ -701,8 +1097,9 @@ pgm_recvmsgv (
 		}
 		if (!sock->is_abort_on_reset)
 			sock->is_reset = !sock->is_reset;
-		pgm_mutex_unlock (&sock->receiver_mutex);
-		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_time_cache_end ();
+		pgm_sock_mutex_unlock (sock, &sock->receiver_mutex);
+		pgm_sock_reader_unlock (sock, &sock->lock);
 		return PGM_IO_STATUS_RESET;
 	}
 
@@ -716,10 +1113,23 @@ pgm_recvmsgv (
 /* NAK status */
 	else if (sock->can_send_data)
 	{
+#ifdef HAVE_MSG_ZEROCOPY
+/* release repair candidates pinned by completed zero-copy sends */
+		if (NULL != sock->zerocopy)
+			pgm_zerocopy_reap (sock);
+#endif
 		if (!pgm_txw_retransmit_is_empty (sock->window))
 		{
-			if (!pgm_on_deferred_nak (sock))
+			if (!pgm_on_deferred_nak (sock)) {
 				status = PGM_IO_STATUS_RATE_LIMITED;
+#ifdef HAVE_TIMERFD_CREATE
+/* the event socket waits on the repair rate limit, not the repair channel */
+				if (INVALID_SOCKET != sock->event_sock) {
+					pgm_notify_clear (&sock->rdata_notify);
+					pgm_timer_arm_rate_event (sock, &sock->rdata_rate_control);
+				}
+#endif
+			}
 		}
 		else
 			pgm_notify_clear (&sock->rdata_notify);
@@ -727,6 +1137,8 @@ pgm_recvmsgv (
 
 	size_t bytes_read = 0;
 	unsigned data_read = 0;
+	unsigned read_ahead = 0;
+	bool is_read_ahead = FALSE;
 	struct pgm_msgv_t* pmsg = msg_start;
 	const struct pgm_msgv_t* msg_end = msg_start + msg_len - 1;
 
@@ -735,9 +1147,14 @@ pgm_recvmsgv (
 
 	/* second, flush any remaining contiguous messages from previous call(s) */
 	if (sock->peers_pending) {
-		if (0 != pgm_flush_peers_pending (sock, &pmsg, msg_end, &bytes_read, &data_read))
+		const int flush_status = pgm_flush_peers_pending (sock, &pmsg, msg_end, &bytes_read, &data_read);
+/* returns on: reset or full buffer, with an overflow log continue reading
+ * into the receive windows.
+ */
+		if (-PGM_SOCK_ENOBUFS == flush_status && sock->spill_threshold)
+			is_read_ahead = TRUE;
+		else if (0 != flush_status)
 			goto out;
-/* returns on: reset or full buffer */
 	}
 
 /* read the data:
@@ -762,8 +1179,12 @@ recv_again:
 		const int save_errno = pgm_get_last_sock_error();
 		char errbuf[1024];
 		if (PGM_LIKELY(PGM_SOCK_EAGAIN == save_errno)) {
+			if (is_read_ahead)
+				goto out;
 			goto check_for_repeat;
 		}
+		if (is_read_ahead)
+			goto out;
 		status = PGM_IO_STATUS_ERROR;
 		pgm_set_error (error,
 			     PGM_ERROR_DOMAIN_RECV,
@@ -774,6 +1195,8 @@ recv_again:
 	}
 	else if (0 == len)
 	{
+		if (is_read_ahead)
+			goto out;
 /* cannot return NORMAL/0 as that is valid payload with SKB */
 		status = PGM_IO_STATUS_EOF;
 		goto out;
@@ -796,8 +1219,8 @@ recv_again:
 		pgm_error_free (err);
 		if (sock->can_send_data) {
 			if (err && PGM_ERROR_CKSUM == err->code)
-				sock->cumulative_stats[PGM_PC_SOURCE_CKSUM_ERRORS]++;
-			sock->cumulative_stats[PGM_PC_SOURCE_PACKETS_DISCARDED]++;
+				pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_CKSUM_ERRORS]);
+			pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_PACKETS_DISCARDED]);
 		}
 		goto recv_again;
 	}
@@ -812,11 +1235,23 @@ recv_again:
 		pgm_peer_set_pending (sock, source);
 	}
 
+/* read ahead into the receive windows, spilling to the overflow logs */
+	if (is_read_ahead) {
+		if (++read_ahead < PGM_RECV_READ_AHEAD)
+			goto recv_again;
+		goto out;
+	}
+
 flush_pending:
 /* flush any congtiguous packets generated by the receipt of this packet */
 	if (sock->peers_pending)
 	{
-		if (0 != pgm_flush_peers_pending (sock, &pmsg, msg_end, &bytes_read, &data_read))
+		const int flush_status = pgm_flush_peers_pending (sock, &pmsg, msg_end, &bytes_read, &data_read);
+		if (-PGM_SOCK_ENOBUFS == flush_status && sock->spill_threshold) {
+			is_read_ahead = TRUE;
+			goto recv_again;
+		}
+		if (0 != flush_status)
 		{
 /* recv vector is now full */
 			goto out;
@@ -838,7 +1273,14 @@ check_for_repeat:
 /* repeat if blocking and empty, i.e. received non data packet.
  */
 		if (0 == data_read) {
+/* drain batched datagrams before waiting on the socket */
+			if (pgm_rx_batch_is_pending (sock))
+				goto recv_again;
+/* idle, release deferred buffers */
+			if (sock->reclaim_max)
+				pgm_rxw_reclaim (&sock->reclaim);
 			const int wait_status = wait_for_event (sock);
+			pgm_time_refresh();
 			switch (wait_status) {
 			case EAGAIN:
 				goto recv_again;
@@ -847,8 +1289,9 @@ check_for_repeat:
 					goto check_for_repeat;
 				goto flush_pending;
 			case ENOENT:
-				pgm_mutex_unlock (&sock->receiver_mutex);
-				pgm_rwlock_reader_unlock (&sock->lock);
+				pgm_time_cache_end ();
+				pgm_sock_mutex_unlock (sock, &sock->receiver_mutex);
+				pgm_sock_reader_unlock (sock, &sock->lock);
 				return PGM_IO_STATUS_EOF;
 			case EFAULT: {
 				const int save_errno = pgm_get_last_sock_error();
@@ -859,8 +1302,9 @@ check_for_repeat:
 						_("Waiting for event: %s"),
 						pgm_sock_strerror_s (errbuf, sizeof (errbuf), save_errno)
 						);
-				pgm_mutex_unlock (&sock->receiver_mutex);
-				pgm_rwlock_reader_unlock (&sock->lock);
+				pgm_time_cache_end ();
+				pgm_sock_mutex_unlock (sock, &sock->receiver_mutex);
+				pgm_sock_reader_unlock (sock, &sock->lock);
 				return PGM_IO_STATUS_ERROR;
 			}
 			default:
@@ -895,12 +1339,18 @@ out:
 			}
 			if (!sock->is_abort_on_reset)
 				sock->is_reset = !sock->is_reset;
-			pgm_mutex_unlock (&sock->receiver_mutex);
-			pgm_rwlock_reader_unlock (&sock->lock);
+			pgm_time_cache_end ();
+			pgm_sock_mutex_unlock (sock, &sock->receiver_mutex);
+			pgm_sock_reader_unlock (sock, &sock->lock);
 			return PGM_IO_STATUS_RESET;
 		}
-		pgm_mutex_unlock (&sock->receiver_mutex);
-		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_timer_arm_event (sock, 0);
+		pgm_time_cache_end ();
+		pgm_sock_mutex_unlock (sock, &sock->receiver_mutex);
+/* idle, release deferred buffers */
+		if (sock->reclaim_max)
+			pgm_rxw_reclaim (&sock->reclaim);
+		pgm_sock_reader_unlock (sock, &sock->lock);
 		if (PGM_IO_STATUS_WOULD_BLOCK == status &&
 		    ( sock->can_send_data ||
 		      ( sock->can_recv_data && NULL != sock->peers_list )))
@@ -910,7 +1360,7 @@ out:
 		return status;
 	}
 
-	if (sock->peers_pending)
+	if (sock->peers_pending || pgm_rx_batch_is_pending (sock))
 	{
 /* set event notification for additional available data */
 		if (sock->is_pending_read && sock->is_edge_triggered_recv)
@@ -929,13 +1379,21 @@ out:
 
 	if (NULL != _bytes_read)
 		*_bytes_read = bytes_read;
-	pgm_mutex_unlock (&sock->receiver_mutex);
-	pgm_rwlock_reader_unlock (&sock->lock);
+/* bound deferred buffers when never idle */
+	const bool is_reclaim = sock->reclaim_max &&
+				pgm_rxw_reclaim_backlog (&sock->reclaim) > sock->reclaim_max;
+	pgm_timer_arm_event (sock, 0);
+	pgm_time_cache_end ();
+	pgm_sock_mutex_unlock (sock, &sock->receiver_mutex);
+	if (is_reclaim)
+		pgm_rxw_reclaim (&sock->reclaim);
+	pgm_sock_reader_unlock (sock, &sock->lock);
 	return PGM_IO_STATUS_NORMAL;
 }
 
 /* read one contiguous apdu and return as a IO scatter/gather array.  msgv is owned by
- * the caller, tpdu contents are owned by the receive window.
+ * the caller, tpdu contents are owned by the receive window, or leased to the caller
+ * with PGM_RECV_LEASE.
  *
  * on success, returns PGM_IO_STATUS_NORMAL.
  */
@@ -958,9 +1416,119 @@ pgm_recvmsg (
 	return pgm_recvmsgv (sock, msgv, 1, flags, bytes_read, error);
 }
 
+/* return messages leased by pgm_recvmsgv() with PGM_RECV_LEASE enabled, dropping
+ * the reference on each skb and the count of outstanding leases of the peer.
+ * must be called before pgm_close() but may be called from any thread.
+ */
+
+void
+pgm_msgv_release (
+	pgm_sock_t*	   const restrict sock,
+	struct pgm_msgv_t* const restrict msgv,
+	const size_t			  count
+	)
+{
+	pgm_peer_t* peer = NULL;
+
+	pgm_return_if_fail (NULL != sock);
+	if (PGM_LIKELY(count)) pgm_return_if_fail (NULL != msgv);
+
+	pgm_debug ("pgm_msgv_release (sock:%p msgv:%p count:%" PRIzu ")",
+		(const void*)sock, (const void*)msgv, count);
+
+/* on shutdown peers are already destroyed, only drop the references */
+	pgm_sock_reader_lock (sock, &sock->lock);
+	const bool is_running = !sock->is_destroyed;
+	if (is_running)
+		pgm_sock_reader_lock (sock, &sock->peers_lock);
+	for (size_t i = 0; i < count; i++)
+	{
+		if (PGM_UNLIKELY(0 == msgv[i].msgv_len))
+			continue;
+/* all fragments of one APDU are from the same peer */
+		const pgm_tsi_t* tsi = &msgv[i].msgv_skb[0]->tsi;
+		if (is_running && NULL != sock->peers_hashtable) {
+			if (NULL == peer || !pgm_tsi_equal (tsi, &peer->tsi))
+				peer = pgm_hashtable_lookup (sock->peers_hashtable, tsi);
+			if (PGM_LIKELY(NULL != peer))
+				pgm_rxw_release_lease (peer->window, msgv[i].msgv_len);
+		}
+		for (unsigned j = 0; j < msgv[i].msgv_len; j++)
+			pgm_free_skb (msgv[i].msgv_skb[j]);
+		msgv[i].msgv_len = 0;
+	}
+	if (is_running)
+		pgm_sock_reader_unlock (sock, &sock->peers_lock);
+	pgm_sock_reader_unlock (sock, &sock->lock);
+}
+
+/* total length of the APDU a message belongs to.  with PGM_LARGE_APDU an APDU of
+ * more than PGM_MAX_FRAGMENTS TPDUs is returned across consecutive messages.
+ */
+
+size_t
+pgm_msgv_apdu_length (
+	const struct pgm_msgv_t* const	msgv
+	)
+{
+	size_t apdu_length = 0;
+
+	pgm_return_val_if_fail (NULL != msgv, 0);
+
+	if (PGM_UNLIKELY(0 == msgv->msgv_len))
+		return 0;
+	if (NULL != msgv->msgv_skb[0]->pgm_opt_fragment)
+		return pgm_ntohl (msgv->msgv_skb[0]->of_apdu_len);
+	for (unsigned i = 0; i < msgv->msgv_len; i++)
+		apdu_length += msgv->msgv_skb[i]->len;
+	return apdu_length;
+}
+
+/* offset of the first byte of a message within its APDU.
+ */
+
+size_t
+pgm_msgv_apdu_offset (
+	const struct pgm_msgv_t* const	msgv
+	)
+{
+	pgm_return_val_if_fail (NULL != msgv, 0);
+
+	if (PGM_UNLIKELY(0 == msgv->msgv_len) ||
+	    NULL == msgv->msgv_skb[0]->pgm_opt_fragment)
+		return 0;
+	return pgm_ntohl (msgv->msgv_skb[0]->of_frag_offset);
+}
+
+/* release receive buffers deferred with PGM_RECV_RECLAIM, for example from
+ * a background thread.  must be called before pgm_close() but may be called
+ * from any thread.
+ *
+ * returns number of buffers released.
+ */
+
+unsigned
+pgm_reclaim (
+	pgm_sock_t* const	sock
+	)
+{
+	unsigned count = 0;
+
+	pgm_return_val_if_fail (NULL != sock, 0);
+
+	pgm_debug ("pgm_reclaim (sock:%p)", (const void*)sock);
+
+	pgm_sock_reader_lock (sock, &sock->lock);
+	if (sock->reclaim_max)
+		count = pgm_rxw_reclaim (&sock->reclaim);
+	pgm_sock_reader_unlock (sock, &sock->lock);
+	return count;
+}
+
 /* vanilla read function.  copies from the receive window to the provided buffer
  * location.  the caller must provide an adequately sized buffer to store the largest
- * expected apdu or else it will be truncated.
+ * expected apdu or else it will be truncated.  an APDU returned across several
+ * messages is gathered into the one buffer.
  *
  * on success, returns PGM_IO_STATUS_NORMAL.
  */
@@ -994,28 +1562,50 @@ pgm_recvfrom (
 	if (PGM_IO_STATUS_NORMAL != status)
 		return status;
 
+	const size_t apdu_length = pgm_msgv_apdu_length (&msgv);
 	size_t bytes_copied = 0;
-	struct pgm_sk_buff_t** skb = msgv.msgv_skb;
-	struct pgm_sk_buff_t* pskb = *skb;
+	size_t apdu_read = 0;
+	bool is_truncated = FALSE;
 
 	if (from) {
+		const struct pgm_sk_buff_t* pskb = msgv.msgv_skb[0];
 		from->sa_port = pgm_ntohs (sock->dport);
 		from->sa_addr.sport = pgm_ntohs (pskb->tsi.sport);
 		memcpy (&from->sa_addr.gsi, &pskb->tsi.gsi, sizeof(pgm_gsi_t));
 	}
 
-	while (bytes_copied < bytes_read) {
-		size_t copy_len = pskb->len;
-		if (bytes_copied + copy_len > buflen) {
-			pgm_warn (_("APDU truncated, original length %" PRIzu " bytes."),
-				bytes_read);
-			copy_len = buflen - bytes_copied;
-			bytes_read = buflen;
+	for (;;)
+	{
+		for (unsigned i = 0; i < msgv.msgv_len; i++)
+		{
+			const struct pgm_sk_buff_t* pskb = msgv.msgv_skb[i];
+			size_t copy_len = pskb->len;
+			if (bytes_copied + copy_len > buflen) {
+				is_truncated = TRUE;
+				copy_len = buflen - bytes_copied;
+			}
+			memcpy ((char*)buf + bytes_copied, pskb->data, copy_len);
+			bytes_copied += copy_len;
+		}
+		apdu_read = pgm_msgv_apdu_offset (&msgv) + bytes_read;
+		if (sock->use_recv_lease)
+			pgm_msgv_release (sock, &msgv, 1);
+		if (PGM_LIKELY(apdu_read >= apdu_length))
+			break;
+/* remainder of the APDU is already complete in the receive window */
+		if (PGM_IO_STATUS_NORMAL != pgm_recvmsg (sock, &msgv, MSG_DONTWAIT, &bytes_read, NULL) ||
+		    pgm_msgv_apdu_offset (&msgv) != apdu_read)
+		{
+			pgm_warn (_("APDU incomplete, read %" PRIzu " of %" PRIzu " bytes."),
+				apdu_read, apdu_length);
+			if (PGM_UNLIKELY(msgv.msgv_len && sock->use_recv_lease))
+				pgm_msgv_release (sock, &msgv, 1);
+			break;
 		}
-		memcpy ((char*)buf + bytes_copied, pskb->data, copy_len);
-		bytes_copied += copy_len;
-		pskb = *(++skb);
 	}
+	if (PGM_UNLIKELY(is_truncated))
+		pgm_warn (_("APDU truncated, original length %" PRIzu " bytes."),
+			apdu_length);
 	if (_bytes_read)
 		*_bytes_read = bytes_copied;
 	return PGM_IO_STATUS_NORMAL;
@@ -105,6 +105,8 @@ static int mock_recvfrom (SOCKET, char*, int, int, struct sockaddr*, int*);
 #define pgm_txw_retransmit_is_empty	mock_pgm_txw_retransmit_is_empty
 #define pgm_rxw_create			mock_pgm_rxw_create
 #define pgm_rxw_readv			mock_pgm_rxw_readv
+#define pgm_rxw_release_lease		mock_pgm_rxw_release_lease
+#define pgm_rxw_reclaim			mock_pgm_rxw_reclaim
 #define pgm_new_peer			mock_pgm_new_peer
 #define pgm_on_data			mock_pgm_on_data
 #define pgm_on_spm			mock_pgm_on_spm
@@ -115,13 +117,16 @@ static int mock_recvfrom (SOCKET, char*, int, int, struct sockaddr*, int*);
 #define pgm_on_nnak			mock_pgm_on_nnak
 #define pgm_on_ncf			mock_pgm_on_ncf
 #define pgm_on_spmr			mock_pgm_on_spmr
-#define pgm_sendto			mock_pgm_sendto
+#define pgm_sendto_hops			mock_pgm_sendto_hops
+#define pgm_zerocopy_reap		mock_pgm_zerocopy_reap
 #define pgm_timer_prepare		mock_pgm_timer_prepare
 #define pgm_timer_check			mock_pgm_timer_check
 #define pgm_timer_expiration		mock_pgm_timer_expiration
 #define pgm_timer_dispatch		mock_pgm_timer_dispatch
+#define pgm_timer_arm			mock_pgm_timer_arm
 #define pgm_time_now			mock_pgm_time_now
 #define pgm_time_update_now		mock_pgm_time_update_now
+#define pgm_time_from_realtime		mock_pgm_time_from_realtime
 #define recvmsg				mock_recvmsg
 #define recvfrom			mock_recvfrom
 #define pgm_WSARecvMsg			mock_pgm_WSARecvMsg
@@ -134,6 +139,11 @@ static int mock_recvfrom (SOCKET, char*, int, int, struct sockaddr*, int*);
 pgm_rxw_t* mock_pgm_rxw_create (const pgm_tsi_t*, const uint16_t, const unsigned, const unsigned, const ssize_t, const uint32_t);
 static pgm_time_t _mock_pgm_time_update_now (void);
 pgm_time_update_func mock_pgm_time_update_now = _mock_pgm_time_update_now;
+PGM_THREAD_LOCAL struct pgm_time_cache_t pgm_time_cache;
+static pgm_time_t mock_pgm_time_step = 0;
+static unsigned mock_pgm_time_reads = 0;
+static pgm_time_t mock_spm_tstamp[3];
+static unsigned mock_spm_count = 0;
 
 
 static
@@ -155,6 +165,8 @@ mock_teardown (void)
 	mock_peer = NULL;
 	mock_data_list = NULL;
 	mock_pgm_loss_rate = 0;
+	mock_pgm_time_step = 0;
+	mock_spm_count = 0;
 }
 
 static
@@ -848,6 +860,8 @@ mock_pgm_on_spm (
 	g_debug ("mock_pgm_on_spm (sock:%p sender:%p skb:%p)",
 		(gpointer)sock, (gpointer)sender, (gpointer)skb);
 	mock_pgm_type = PGM_SPM;
+	if (mock_spm_count < G_N_ELEMENTS(mock_spm_tstamp))
+		mock_spm_tstamp[mock_spm_count++] = skb->tstamp;
 	return TRUE;
 }
 
@@ -906,13 +920,31 @@ mock_pgm_rxw_readv (
 	return -1;
 }
 
+void
+mock_pgm_rxw_release_lease (
+	pgm_rxw_t* const	window,
+	const unsigned		count
+	)
+{
+}
+
+unsigned
+mock_pgm_rxw_reclaim (
+	pgm_rxw_reclaim_t* const	reclaim
+	)
+{
+	return 0;
+}
+
 /** net module */
 PGM_GNUC_INTERNAL
 ssize_t
-mock_pgm_sendto (
-	pgm_sock_t*		sock,
+mock_pgm_sendto_hops (
+	pgm_sock_t*			sock,
 	bool				use_rate_limit,
+	pgm_rate_t*			minor_rate_control,
 	bool				use_router_alert,
+	int				hops,
 	const void*			buf,
 	size_t				len,
 	const struct sockaddr*		to,
@@ -922,6 +954,17 @@ mock_pgm_sendto (
 	return len;
 }
 
+#ifdef HAVE_MSG_ZEROCOPY
+PGM_GNUC_INTERNAL
+unsigned
+mock_pgm_zerocopy_reap (
+	pgm_sock_t* const		sock
+	)
+{
+	return 0;
+}
+#endif
+
 /** timer module */
 PGM_GNUC_INTERNAL
 bool
@@ -959,6 +1002,17 @@ mock_pgm_timer_dispatch (
 	return TRUE;
 }
 
+#ifdef HAVE_TIMERFD_CREATE
+PGM_GNUC_INTERNAL
+void
+mock_pgm_timer_arm (
+	pgm_sock_t* const		sock,
+	const pgm_time_t		rate_expiry
+	)
+{
+}
+#endif
+
 /** time module */
 static pgm_time_t mock_pgm_time_now = 0x1;
 
@@ -966,9 +1020,22 @@ static
 pgm_time_t
 _mock_pgm_time_update_now (void)
 {
+	mock_pgm_time_reads++;
+	mock_pgm_time_now += mock_pgm_time_step;
 	return mock_pgm_time_now;
 }
 
+#if defined(HAVE_SO_TIMESTAMPNS) && defined(HAVE_GETTIMEOFDAY)
+PGM_GNUC_INTERNAL
+pgm_time_t
+mock_pgm_time_from_realtime (
+	const pgm_time_t	realtime
+	)
+{
+	return realtime;
+}
+#endif
+
 /** libc */
 #ifndef _WIN32
 static
@@ -1188,6 +1255,31 @@ START_TEST (test_spm_pass_001)
 }
 END_TEST
 
+/* each datagram of one call is stamped with its own clock read */
+START_TEST (test_spm_pass_002)
+{
+	pgm_sock_t* sock = generate_sock();
+	fail_if (NULL == sock, "generate_sock failed");
+	guint8 buffer[ TEST_TXW_SQNS * TEST_MAX_TPDU ];
+	gpointer packet; gsize packet_len;
+	for (unsigned i = 0; i < 3; i++) {
+		generate_spm (200 + i /* spm-sqn */, -1 /* trail */, 0 /* lead */, &packet, &packet_len);
+		generate_msghdr (packet, packet_len);
+	}
+	push_block_event ();
+	mock_pgm_time_step = 10;
+	mock_pgm_time_reads = 0;
+	gsize bytes_read;
+	pgm_error_t* err = NULL;
+	fail_unless (PGM_IO_STATUS_TIMER_PENDING == pgm_recv (sock, buffer, sizeof(buffer), MSG_DONTWAIT, &bytes_read, &err), "recv failed");
+	fail_unless (3 == mock_spm_count, "unexpected SPM count");
+	fail_unless (mock_spm_tstamp[0] < mock_spm_tstamp[1], "shared time stamp");
+	fail_unless (mock_spm_tstamp[1] < mock_spm_tstamp[2], "shared time stamp");
+	g_message ("clock reads:%u", mock_pgm_time_reads);
+	fail_unless (mock_pgm_time_reads >= 3, "too few clock reads");
+}
+END_TEST
+
 /* recv -> on_nak */
 START_TEST (test_nak_pass_001)
 {
@@ -1659,6 +1751,7 @@ make_test_suite (void)
 	suite_add_tcase (s, tc_spm);
 	tcase_add_checked_fixture (tc_spm, mock_setup, mock_teardown);
 	tcase_add_test (tc_spm, test_spm_pass_001);
+	tcase_add_test (tc_spm, test_spm_pass_002);
 
 	TCase* tc_nak = tcase_create ("nak");
 	suite_add_tcase (s, tc_nak);
@@ -22,6 +22,13 @@
 #ifdef HAVE_CONFIG_H
 #	include <config.h>
 #endif
+#ifndef _WIN32
+#	include <fcntl.h>
+#	include <stdio.h>
+#	include <stdlib.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#endif
 #include <impl/i18n.h>
 #include <impl/framework.h>
 #include <impl/rxw.h>
@@ -70,12 +77,20 @@ static int _pgm_rxw_insert (pgm_rxw_t*const restrict, struct pgm_sk_buff_t*const
 static int _pgm_rxw_append (pgm_rxw_t*const restrict, struct pgm_sk_buff_t*const restrict, const pgm_time_t);
 static int _pgm_rxw_add_placeholder_range (pgm_rxw_t*const, const uint32_t, const pgm_time_t, const pgm_time_t);
 static void _pgm_rxw_unlink (pgm_rxw_t*const restrict, struct pgm_sk_buff_t*const restrict);
+static inline void _pgm_rxw_free_skb (pgm_rxw_t*const restrict, struct pgm_sk_buff_t*const restrict);
+static void _pgm_rxw_reassemble (pgm_rxw_t*const restrict, struct pgm_sk_buff_t*const restrict);
+static inline void _pgm_rxw_reassembled (struct pgm_msgv_t*const);
 static uint32_t _pgm_rxw_remove_trail (pgm_rxw_t*const);
 static void _pgm_rxw_state (pgm_rxw_t*const restrict, struct pgm_sk_buff_t*const restrict, const int);
 static inline void _pgm_rxw_shuffle_parity (pgm_rxw_t*const restrict, struct pgm_sk_buff_t*const restrict);
 static inline ssize_t _pgm_rxw_incoming_read (pgm_rxw_t*const restrict, struct pgm_msgv_t**restrict, uint32_t);
 static bool _pgm_rxw_is_apdu_complete (pgm_rxw_t*const, const uint32_t);
+static bool _pgm_rxw_spill_apdu (pgm_rxw_t*const);
+static void _pgm_rxw_spill_close (pgm_rxw_spill_t*const);
+static inline bool _pgm_rxw_spill_is_empty (const pgm_rxw_spill_t*const);
+static ssize_t _pgm_rxw_spill_read (pgm_rxw_t*const restrict, struct pgm_msgv_t**restrict, const unsigned);
 static inline ssize_t _pgm_rxw_incoming_read_apdu (pgm_rxw_t*const restrict, struct pgm_msgv_t**restrict);
+static ssize_t _pgm_rxw_unordered_read (pgm_rxw_t*const restrict, struct pgm_msgv_t**restrict, unsigned);
 static inline int _pgm_rxw_recovery_update (pgm_rxw_t*const, const uint32_t, const pgm_time_t);
 static inline int _pgm_rxw_recovery_append (pgm_rxw_t*const, const pgm_time_t, const pgm_time_t);
 
@@ -145,6 +160,23 @@ _pgm_rxw_commit_is_empty (
 	return (_pgm_rxw_commit_length (window) == 0);
 }
 
+/* discard the unread remainder of an APDU at the commit lead when the commit
+ * lead is moved other than by reading, the caller accounts the data-loss.
+ */
+
+static inline
+void
+_pgm_rxw_reset_apdu_remaining (
+	pgm_rxw_t* const	window
+	)
+{
+	pgm_assert (NULL != window);
+	if (PGM_UNLIKELY(window->apdu_remaining)) {
+		pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Discarding unread remainder of APDU #%" PRIu32 "."),window->apdu_remaining_first);
+		window->apdu_remaining = 0;
+	}
+}
+
 static inline
 uint32_t
 _pgm_rxw_incoming_length (
@@ -221,6 +253,10 @@ pgm_rxw_create (
 /* minimum value of RS::k = 1 */
 	window->tg_size = 1;
 
+/* protocol limits, raised for large APDUs */
+	window->max_apdu = PGM_MAX_APDU;
+	window->max_fragments = PGM_MAX_FRAGMENTS;
+
 /* PGMCC filter weight */
 	window->ack_c_p = pgm_fp16 (ack_c_p);
 	window->bitmap = 0xffffffff;
@@ -253,11 +289,28 @@ pgm_rxw_destroy (
 
 	pgm_debug ("destroy (window:%p)", (const void*)window);
 
+/* socket may be closing, release directly */
+	window->reclaim = NULL;
+
+/* overflow log and messages read from it */
+	window->spill_threshold = 0;
+	while (window->spill_commit_queue.length)
+		pgm_free_skb ((struct pgm_sk_buff_t*)pgm_queue_pop_tail_link (&window->spill_commit_queue));
+	if (NULL != window->spill) {
+		_pgm_rxw_spill_close (window->spill);
+		window->spill = NULL;
+	}
+
 /* contents of window */
 	while (!pgm_rxw_is_empty (window)) {
 		_pgm_rxw_remove_trail (window);
 	}
 
+/* leased skbs remain valid until released by the application */
+	if (pgm_atomic_read32 (&window->lease_count) > 0)
+		pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Destroying window with %" PRIu32 " leased packets outstanding."),
+			pgm_atomic_read32 (&window->lease_count));
+
 /* window must now be empty */
 	pgm_assert_cmpuint (pgm_rxw_length (window), ==, 0);
 	pgm_assert_cmpuint (pgm_rxw_size (window), ==, 0);
@@ -350,7 +403,7 @@ pgm_rxw_add (
 			return PGM_RXW_MALFORMED;
 
 /* protocol sanity check: maximum APDU length */
-		if (PGM_UNLIKELY(pgm_ntohl (skb->of_apdu_len) > PGM_MAX_APDU))
+		if (PGM_UNLIKELY(pgm_ntohl (skb->of_apdu_len) > window->max_apdu))
 			return PGM_RXW_MALFORMED;
 	}
 
@@ -442,6 +495,9 @@ _pgm_rxw_define (
 
 	window->lead = lead;
 	window->commit_lead = window->rxw_trail = window->rxw_trail_init = window->trail = window->lead + 1;
+	window->unordered_lead = window->commit_lead;
+	window->apdu_remaining = 0;
+	window->is_apdu_scan_valid = 0;
 	window->is_constrained = window->is_defined = TRUE;
 
 /* post-conditions */
@@ -527,6 +583,7 @@ _pgm_rxw_update_trail (
 		const uint32_t distance = (int32_t)(window->rxw_trail) - (int32_t)(window->trail);
 		window->commit_lead = window->trail += distance;
 		window->lead += distance;
+		_pgm_rxw_reset_apdu_remaining (window);
 
 /* add loss to bitmap */
 		if (distance > 32)	window->bitmap = 0;
@@ -1003,6 +1060,10 @@ _pgm_rxw_insert (
 /* statistics */
 	const uint32_t fill_time = (uint32_t)(new_skb->tstamp - skb->tstamp);
 	PGM_HISTOGRAM_TIMES("Rx.RepairTime", fill_time);
+	pgm_latency_add (&window->latency[PGM_LATENCY_RECEIVER_REPAIR], fill_time);
+	if (state->nak_tstamp)
+		pgm_latency_add (&window->latency[PGM_LATENCY_RECEIVER_NAK_SVC],
+				 pgm_time_after (new_skb->tstamp, state->nak_tstamp) ? new_skb->tstamp - state->nak_tstamp : 0);
 	PGM_HISTOGRAM_COUNTS("Rx.NakTransmits", state->nak_transmit_count);
 	PGM_HISTOGRAM_COUNTS("Rx.NcfRetries", state->ncf_retry_count);
 	PGM_HISTOGRAM_COUNTS("Rx.DataRetries", state->data_retry_count);
@@ -1046,7 +1107,7 @@ _pgm_rxw_insert (
 	state = (void*)new_skb->cb;
 	state->pkt_state = PGM_PKT_STATE_ERROR;
 	_pgm_rxw_unlink (window, skb);
-	pgm_free_skb (skb);
+	_pgm_rxw_free_skb (window, skb);
 	const uint_fast32_t index_ = new_skb->sequence % pgm_rxw_max_length (window);
 	window->pdata[index_] = new_skb;
 	if (new_skb->pgm_header->pgm_options & PGM_OPT_PARITY)
@@ -1190,6 +1251,10 @@ pgm_rxw_remove_commit (
 /* pre-conditions */
 	pgm_assert (NULL != window);
 
+/* messages read from the overflow log */
+	while (window->spill_commit_queue.length)
+		_pgm_rxw_free_skb (window, (struct pgm_sk_buff_t*)pgm_queue_pop_tail_link (&window->spill_commit_queue));
+
 	const uint32_t tg_sqn_of_commit_lead = _pgm_rxw_tg_sqn (window, window->commit_lead);
 
 	while (!_pgm_rxw_commit_is_empty (window) &&
@@ -1208,8 +1273,11 @@ pgm_rxw_remove_commit (
  *
  * returns -1 on nothing read, returns length of bytes read, 0 is a valid read length.
  *
- * PGM skbuffs will have an increased reference count and must be unreferenced by the 
- * calling application.
+ * with unordered delivery complete APDUs following the commit lead are also
+ * read, and are skipped when the commit lead later passes them.
+ *
+ * PGM skbuffs remain owned by the window until the next commit removal unless
+ * leased with pgm_rxw_lease().
  */
 
 PGM_GNUC_INTERNAL
@@ -1224,6 +1292,7 @@ pgm_rxw_readv (
 	struct pgm_sk_buff_t* skb;
 	pgm_rxw_state_t* state;
 	ssize_t bytes_read;
+	ssize_t spill_bytes = -1;
 
 /* pre-conditions */
 	pgm_assert (NULL != window);
@@ -1235,8 +1304,15 @@ pgm_rxw_readv (
 
 	msg_end = *pmsg + pmsglen - 1;
 
+/* spilled data precedes the window */
+	if (PGM_UNLIKELY(!_pgm_rxw_spill_is_empty (window->spill))) {
+		spill_bytes = _pgm_rxw_spill_read (window, pmsg, pmsglen);
+		if (*pmsg > msg_end || !_pgm_rxw_spill_is_empty (window->spill))
+			return spill_bytes;
+	}
+
 	if (_pgm_rxw_incoming_is_empty (window))
-		return -1;
+		return spill_bytes;
 
 	skb = _pgm_rxw_peek (window, window->commit_lead);
 	pgm_assert (NULL != skb);
@@ -1271,9 +1347,64 @@ pgm_rxw_readv (
 		break;
 	}
 
+/* complete APDUs beyond a gap are delivered in arrival order */
+	if (window->is_unordered && *pmsg <= msg_end) {
+		const ssize_t unordered_bytes = _pgm_rxw_unordered_read (window, pmsg, (unsigned)(msg_end - *pmsg + 1));
+		if (unordered_bytes >= 0)
+			bytes_read = (bytes_read > 0 ? bytes_read : 0) + unordered_bytes;
+	}
+
+	if (spill_bytes >= 0)
+		bytes_read = (bytes_read > 0 ? bytes_read : 0) + spill_bytes;
 	return bytes_read;
 }
 
+/* lease messages appended by pgm_rxw_readv() to the application, taking a
+ * reference on each skb such that it remains valid after removal from the
+ * commit window.  msg_end is one past the last message read.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_rxw_lease (
+	pgm_rxw_t*	   const restrict window,
+	const struct pgm_msgv_t* restrict msg,
+	const struct pgm_msgv_t* const restrict msg_end
+	)
+{
+	uint32_t count = 0;
+
+/* pre-conditions */
+	pgm_assert (NULL != window);
+	pgm_assert (NULL != msg);
+	pgm_assert (NULL != msg_end);
+	pgm_assert (msg <= msg_end);
+
+	for (; msg < msg_end; msg++) {
+		for (unsigned i = 0; i < msg->msgv_len; i++)
+			pgm_skb_get (msg->msgv_skb[i]);
+		count += msg->msgv_len;
+	}
+	pgm_atomic_add32 (&window->lease_count, count);
+}
+
+/* account for count skbs returned by the application.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_rxw_release_lease (
+	pgm_rxw_t* const	window,
+	const unsigned		count
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != window);
+	pgm_assert_cmpuint (pgm_atomic_read32 (&window->lease_count), >=, count);
+
+	pgm_atomic_add32 (&window->lease_count, (uint32_t)-count);
+}
+
 /* remove lost sequences from the trailing edge of the window.  lost sequence
  * at lead of commit window invalidates all parity-data packets as any 
  * transmission group is now unrecoverable.
@@ -1293,8 +1424,18 @@ _pgm_rxw_remove_trail (
 	pgm_assert (NULL != window);
 	pgm_assert (!pgm_rxw_is_empty (window));
 
+/* spill undelivered data instead of dropping */
+	if (window->spill_threshold &&
+	    window->trail == window->commit_lead &&
+	    _pgm_rxw_spill_apdu (window))
+	{
+		pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Spilled trail on full receive window."));
+		return 0;
+	}
+
 	skb = _pgm_rxw_peek (window, window->trail);
 	pgm_assert (NULL != skb);
+	const bool is_delivered = ((pgm_rxw_state_t*)&skb->cb)->is_delivered;
 	_pgm_rxw_unlink (window, skb);
 	window->size -= skb->len;
 /* remove reference to skb */
@@ -1302,10 +1443,14 @@ _pgm_rxw_remove_trail (
 		const uint_fast32_t index_ = skb->sequence % pgm_rxw_max_length (window);
 		window->pdata[index_] = NULL;
 	}
-	pgm_free_skb (skb);
+	_pgm_rxw_free_skb (window, skb);
 	if (window->trail++ == window->commit_lead) {
-/* data-loss */
 		window->commit_lead++;
+/* already read out of order */
+		if (is_delivered)
+			return 0;
+/* data-loss */
+		_pgm_rxw_reset_apdu_remaining (window);
 		window->cumulative_losses++;
 		pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Data loss due to pulled trailing edge, fragment count %" PRIu32 "."),window->fragment_count);
 		return 1;
@@ -1358,7 +1503,27 @@ _pgm_rxw_incoming_read (
 	do {
 		skb = _pgm_rxw_peek (window, window->commit_lead);
 		pgm_assert (NULL != skb);
-		if (_pgm_rxw_is_apdu_complete (window,
+		if (PGM_UNLIKELY(window->apdu_remaining))
+		{
+/* remainder of an APDU spanning several messages, already complete */
+			if (PGM_UNLIKELY(PGM_PKT_STATE_HAVE_DATA != ((pgm_rxw_state_t*)&skb->cb)->pkt_state ||
+					 NULL == skb->pgm_opt_fragment ||
+					 pgm_ntohl (skb->of_apdu_first_sqn) != window->apdu_remaining_first))
+			{
+				_pgm_rxw_reset_apdu_remaining (window);
+				window->cumulative_losses++;
+				continue;
+			}
+			bytes_read += _pgm_rxw_incoming_read_apdu (window, pmsg);
+			data_read  ++;
+		}
+		else if (PGM_UNLIKELY(((pgm_rxw_state_t*)&skb->cb)->is_delivered))
+		{
+/* already read out of order, commit without reading again */
+			_pgm_rxw_state (window, skb, PGM_PKT_STATE_COMMIT_DATA);
+			window->commit_lead++;
+		}
+		else if (_pgm_rxw_is_apdu_complete (window,
 					      skb->pgm_opt_fragment ? pgm_ntohl (skb->of_apdu_first_sqn) : skb->sequence))
 		{
 			bytes_read += _pgm_rxw_incoming_read_apdu (window, pmsg);
@@ -1493,6 +1658,7 @@ _pgm_rxw_reconstruct (
 	}
 
 /* reconstruct payload */
+	const pgm_time_t decode_start = pgm_time_update_now();
 	pgm_rs_decode_parity_appended (&window->rs,
 				       tg_data,
 				       offsets,
@@ -1504,6 +1670,7 @@ _pgm_rxw_reconstruct (
 					       tg_opts,
 					       offsets,
 					       sizeof(struct pgm_opt_fragment));
+	pgm_latency_add (&window->latency[PGM_LATENCY_RECEIVER_FEC], pgm_time_update_now() - decode_start);
 
 /* swap parity skbs with reconstructed skbs */
 	for (uint_fast8_t i = 0; i < window->rs.k; i++)
@@ -1552,7 +1719,11 @@ _pgm_rxw_reconstruct (
  * packets with single fragment fragment headers must be normalised as regular
  * packets before calling.
  *
- * APDUs exceeding PGM_MAX_FRAGMENTS or PGM_MAX_APDU length will be discarded.
+ * APDUs exceeding the window fragment or length limits will be discarded.
+ *
+ * without FEC the scan of an incomplete APDU is saved and resumed from the
+ * first missing sequence, such that large APDUs are not rescanned from the
+ * first fragment on every arrival.
  *
  * returns FALSE if APDU is incomplete or longer than max_len sequences.
  */
@@ -1565,6 +1736,7 @@ _pgm_rxw_is_apdu_complete (
 	)
 {
 	struct pgm_sk_buff_t	*skb;
+	uint32_t		 sequence = first_sequence;
 	unsigned		 contiguous_tpdus = 0;
 	size_t			 contiguous_size = 0;
 	bool			 check_parity = FALSE;
@@ -1586,12 +1758,23 @@ _pgm_rxw_is_apdu_complete (
 	pgm_assert_cmpuint (apdu_size, >=, skb->len);
 
 /* protocol sanity check: maximum length */
-	if (PGM_UNLIKELY(apdu_size > PGM_MAX_APDU)) {
+	if (PGM_UNLIKELY(apdu_size > window->max_apdu)) {
 		pgm_rxw_lost (window, first_sequence);
 		return FALSE;
 	}
 
-	for (uint32_t sequence = first_sequence;
+/* resume from previous scan */
+	if (window->is_apdu_scan_valid &&
+	    window->apdu_scan_first == first_sequence &&
+	    !window->is_fec_available)
+	{
+		sequence         = window->apdu_scan_next;
+		contiguous_tpdus = window->apdu_scan_tpdus;
+		contiguous_size  = window->apdu_scan_size;
+		skb = _pgm_rxw_peek (window, sequence);
+	}
+
+	for (;
 	     skb;
 	     skb = _pgm_rxw_peek (window, ++sequence))
 	{
@@ -1610,7 +1793,7 @@ _pgm_rxw_is_apdu_complete (
 			}
 			else
 			{
-				return FALSE;
+				goto pending;
 			}
 		}
 
@@ -1646,27 +1829,36 @@ _pgm_rxw_is_apdu_complete (
 			}
 
 /* protocol sanity check: maximum number of fragments per apdu */
-			if (PGM_UNLIKELY(++contiguous_tpdus > PGM_MAX_FRAGMENTS)) {
+			if (PGM_UNLIKELY(++contiguous_tpdus > window->max_fragments)) {
 				pgm_rxw_lost (window, first_sequence);
 				return FALSE;
 			}
 
 			contiguous_size += skb->len;
-			if (apdu_size == contiguous_size)
+			if (apdu_size == contiguous_size) {
+				window->is_apdu_scan_valid = 0;
 				return TRUE;
-			else if (PGM_UNLIKELY(apdu_size < contiguous_size)) {
+			} else if (PGM_UNLIKELY(apdu_size < contiguous_size)) {
 				pgm_rxw_lost (window, first_sequence);
 				return FALSE;
 			}
 		}
 	}
 
-/* pending */
+pending:
+	if (!check_parity && !window->is_fec_available) {
+		window->apdu_scan_first  = first_sequence;
+		window->apdu_scan_next   = sequence;
+		window->apdu_scan_tpdus  = contiguous_tpdus;
+		window->apdu_scan_size   = contiguous_size;
+		window->is_apdu_scan_valid = 1;
+	}
 	return FALSE;
 }
 
-/* read one APDU consisting of one or more TPDUs.  target array is guaranteed
- * to be big enough to store complete APDU.
+/* read one APDU consisting of one or more TPDUs.  an APDU of more than
+ * PGM_MAX_FRAGMENTS TPDUs continues in following messages, with the remainder
+ * recorded in apdu_remaining.
  */
 
 static inline
@@ -1690,7 +1882,8 @@ _pgm_rxw_incoming_read_apdu (
 	skb = _pgm_rxw_peek (window, window->commit_lead);
 	pgm_assert (NULL != skb);
 
-	const size_t apdu_len = skb->pgm_opt_fragment ? pgm_ntohl (skb->of_apdu_len) : skb->len;
+	const size_t apdu_len = window->apdu_remaining ? window->apdu_remaining :
+					skb->pgm_opt_fragment ? pgm_ntohl (skb->of_apdu_len) : skb->len;
 	pgm_assert_cmpuint (apdu_len, >=, skb->len);
 
 	do {
@@ -1698,12 +1891,17 @@ _pgm_rxw_incoming_read_apdu (
 		(*pmsg)->msgv_skb[ count++ ] = skb;
 		contiguous_len += skb->len;
 		window->commit_lead++;
-		if (apdu_len == contiguous_len)
+		if (apdu_len == contiguous_len || PGM_MAX_FRAGMENTS == count)
 			break;
 		skb = _pgm_rxw_peek (window, window->commit_lead);
 	} while (apdu_len > contiguous_len);
 
+	window->apdu_remaining = apdu_len - contiguous_len;
+	if (window->apdu_remaining)
+		window->apdu_remaining_first = pgm_ntohl (skb->of_apdu_first_sqn);
 	(*pmsg)->msgv_len = count;
+	if (window->is_reassemble && count > 1)
+		_pgm_rxw_reassembled (*pmsg);
 	(*pmsg)++;
 
 /* post-conditions */
@@ -1712,6 +1910,587 @@ _pgm_rxw_incoming_read_apdu (
 	return contiguous_len;
 }
 
+/* copy a fragment payload into the contiguous buffer of its APDU, shared
+ * with any sibling fragment already placed, otherwise allocated.  each
+ * fragment holds one reference on the buffer.  fragments failing sanity
+ * checks are left out and the APDU is then delivered as fragments.
+ */
+
+static
+void
+_pgm_rxw_reassemble (
+	pgm_rxw_t*	      const restrict window,
+	struct pgm_sk_buff_t* const restrict skb
+	)
+{
+	pgm_rxw_state_t* state = (pgm_rxw_state_t*)&skb->cb;
+	struct pgm_sk_buff_t* apdu_skb = NULL;
+
+/* pre-conditions */
+	pgm_assert (NULL != window);
+	pgm_assert (NULL != skb);
+	pgm_assert (NULL != skb->pgm_opt_fragment);
+
+	if (NULL != state->apdu_skb)
+		return;
+
+	const uint32_t first_sequence = pgm_ntohl (skb->of_apdu_first_sqn);
+	const uint32_t apdu_len = pgm_ntohl (skb->of_apdu_len);
+	const uint32_t frag_off = pgm_ntohl (skb->of_frag_offset);
+	if (PGM_UNLIKELY(apdu_len > PGM_MAX_APDU ||
+			 frag_off > apdu_len ||
+			 skb->len > apdu_len - frag_off))
+		return;
+	if (PGM_UNLIKELY(pgm_uint32_lt (first_sequence, window->trail) ||
+			 pgm_uint32_gt (first_sequence, skb->sequence) ||
+			 skb->sequence - first_sequence >= PGM_MAX_FRAGMENTS))
+		return;
+
+	for (uint32_t sequence = first_sequence;
+	     pgm_uint32_lte (sequence, window->lead) && sequence - first_sequence < PGM_MAX_FRAGMENTS;
+	     sequence++)
+	{
+		const struct pgm_sk_buff_t* sibling = _pgm_rxw_peek (window, sequence);
+		const pgm_rxw_state_t* sibling_state = (const pgm_rxw_state_t*)&sibling->cb;
+		if (NULL != sibling_state->apdu_skb &&
+		    pgm_ntohl (sibling->of_apdu_first_sqn) == first_sequence)
+		{
+			apdu_skb = sibling_state->apdu_skb;
+			break;
+		}
+	}
+
+	if (NULL == apdu_skb) {
+		apdu_skb = pgm_alloc_skb ((uint16_t)apdu_len);
+		apdu_skb->sock     = skb->sock;
+		apdu_skb->tstamp   = skb->tstamp;
+		apdu_skb->tsi      = skb->tsi;
+		apdu_skb->sequence = first_sequence;
+		pgm_skb_put (apdu_skb, (uint16_t)apdu_len);
+	} else if (PGM_UNLIKELY(apdu_skb->len != apdu_len)) {
+		return;
+	} else {
+		pgm_skb_get (apdu_skb);
+	}
+	memcpy ((char*)apdu_skb->data + frag_off, skb->data, skb->len);
+	state->apdu_skb = apdu_skb;
+}
+
+/* replace the fragments of a message with the contiguous APDU when every
+ * fragment has been placed in sequence.
+ */
+
+static inline
+void
+_pgm_rxw_reassembled (
+	struct pgm_msgv_t* const	msg
+	)
+{
+	const pgm_rxw_state_t* state = (const pgm_rxw_state_t*)&msg->msgv_skb[0]->cb;
+	struct pgm_sk_buff_t* apdu_skb = state->apdu_skb;
+	size_t frag_off = 0;
+
+	if (NULL == apdu_skb)
+		return;
+	for (unsigned i = 0; i < msg->msgv_len; i++)
+	{
+		const struct pgm_sk_buff_t* skb = msg->msgv_skb[i];
+		state = (const pgm_rxw_state_t*)&skb->cb;
+		if (state->apdu_skb != apdu_skb ||
+		    pgm_ntohl (skb->of_frag_offset) != frag_off)
+			return;
+		frag_off += skb->len;
+	}
+	if (frag_off != apdu_skb->len)
+		return;
+	msg->msgv_skb[0] = apdu_skb;
+	msg->msgv_len = 1;
+}
+
+/* read complete APDUs ahead of the commit lead in sequence order, skipping
+ * incomplete APDUs.  packets remain in the incoming window tagged delivered.
+ *
+ * the scan resumes from unordered_lead, which is rewound by new data.
+ *
+ * returns -1 on nothing read, returns length of bytes read.
+ */
+
+static
+ssize_t
+_pgm_rxw_unordered_read (
+	pgm_rxw_t*    const restrict window,
+	struct pgm_msgv_t** restrict pmsg,		/* message array, updated as messages appended */
+	unsigned		     pmsglen		/* number of items in pmsg */
+	)
+{
+	const struct pgm_msgv_t* msg_end;
+	struct pgm_sk_buff_t* skb;
+	pgm_rxw_state_t* state;
+	uint32_t sequence;
+	ssize_t bytes_read = 0;
+	size_t  data_read  = 0;
+
+/* pre-conditions */
+	pgm_assert (NULL != window);
+	pgm_assert (NULL != pmsg);
+	pgm_assert_cmpuint (pmsglen, >, 0);
+
+	pgm_debug ("_pgm_rxw_unordered_read (window:%p pmsg:%p pmsglen:%u)",
+		 (void*)window, (void*)pmsg, pmsglen);
+
+	msg_end = *pmsg + pmsglen - 1;
+	sequence = pgm_uint32_lt (window->unordered_lead, window->commit_lead) ? window->commit_lead : window->unordered_lead;
+	for (;
+	     *pmsg <= msg_end && pgm_uint32_lte (sequence, window->lead);
+	     sequence++)
+	{
+		skb = _pgm_rxw_peek (window, sequence);
+		pgm_assert (NULL != skb);
+		state = (pgm_rxw_state_t*)&skb->cb;
+		if (PGM_PKT_STATE_HAVE_DATA != state->pkt_state || state->is_delivered)
+			continue;
+/* start of APDU */
+		if (skb->pgm_opt_fragment && pgm_ntohl (skb->of_apdu_first_sqn) != sequence)
+			continue;
+		if (!_pgm_rxw_is_apdu_complete (window, sequence))
+			continue;
+
+/* reconstruction may replace packets */
+		skb = _pgm_rxw_peek (window, sequence);
+		const size_t apdu_len = skb->pgm_opt_fragment ? pgm_ntohl (skb->of_apdu_len) : skb->len;
+		size_t contiguous_len = 0;
+		unsigned count = 0;
+/* APDUs spanning several messages are delivered in order */
+		for (uint32_t i = sequence; count < PGM_MAX_FRAGMENTS && contiguous_len < apdu_len; i++, count++)
+			contiguous_len += _pgm_rxw_peek (window, i)->len;
+		if (contiguous_len < apdu_len)
+			continue;
+		contiguous_len = 0;
+		count = 0;
+		do {
+			state = (pgm_rxw_state_t*)&skb->cb;
+			state->is_delivered = 1;
+			(*pmsg)->msgv_skb[ count++ ] = skb;
+			contiguous_len += skb->len;
+			if (apdu_len == contiguous_len)
+				break;
+			skb = _pgm_rxw_peek (window, ++sequence);
+		} while (apdu_len > contiguous_len);
+		(*pmsg)->msgv_len = count;
+		if (window->is_reassemble && count > 1)
+			_pgm_rxw_reassembled (*pmsg);
+		(*pmsg)++;
+		bytes_read += contiguous_len;
+		data_read  ++;
+	}
+	window->unordered_lead = sequence;
+
+	window->bytes_delivered += bytes_read;
+	window->msgs_delivered  += data_read;
+	return data_read > 0 ? bytes_read : -1;
+}
+
+/* overflow log record of one TPDU, followed by the payload padded to the
+ * record alignment.
+ */
+
+struct pgm_rxw_spill_record_t {
+	pgm_time_t		tstamp;
+	pgm_sock_t*		sock;
+	pgm_tsi_t		tsi;
+	uint32_t		sequence;
+	uint16_t		len;
+	uint16_t		has_fragment;
+	struct pgm_opt_fragment	opt_fragment;
+};
+
+#define PGM_RXW_SPILL_ALIGN(len)	(((len) + 7) & ~(size_t)7)
+#define PGM_RXW_SPILL_RECORD_LEN(len)	PGM_RXW_SPILL_ALIGN(sizeof(struct pgm_rxw_spill_record_t) + (len))
+#define PGM_RXW_SPILL_INITIAL		(1024 * 1024)
+
+#ifndef _WIN32
+/* allocate backing store for the byte range such that later writes through
+ * the shared mapping cannot fault with SIGBUS on a full file system.
+ *
+ * returns 0 on success, returns error number on failure.
+ */
+
+static
+int
+_pgm_rxw_spill_allocate (
+	const int		fd,
+	const off_t		offset,
+	const size_t		len
+	)
+{
+#	ifdef HAVE_POSIX_FALLOCATE
+	return posix_fallocate (fd, offset, (off_t)len);
+#	else
+/* no reservation, the file is sparse */
+	return 0 == ftruncate (fd, offset + (off_t)len) ? 0 : errno;
+#	endif
+}
+#endif /* _WIN32 */
+
+/* create the overflow log as an unlinked file in PGM_SPILL_DIR, by default
+ * the system temporary directory.  on failure spilling is disabled and the
+ * window reverts to dropping the trail.
+ *
+ * returns TRUE on success, returns FALSE on failure.
+ */
+
+static
+bool
+_pgm_rxw_spill_open (
+	pgm_rxw_t* const	window
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != window);
+	pgm_assert (NULL == window->spill);
+
+#ifndef _WIN32
+	char path[1024], errbuf[1024];
+	char* dir;
+	size_t envlen;
+	int fd;
+
+	const errno_t err = pgm_dupenv_s (&dir, &envlen, "PGM_SPILL_DIR");
+	if (0 != err || 0 == envlen)
+		dir = pgm_strdup (P_tmpdir);
+	pgm_snprintf_s (path, sizeof (path), _TRUNCATE, "%s/pgm-spill-XXXXXX", dir);
+	pgm_free (dir);
+	fd = mkstemp (path);
+	if (-1 == fd) {
+		pgm_warn (_("Cannot create receive overflow log %s: %s"),
+			path, pgm_strerror_s (errbuf, sizeof (errbuf), errno));
+		window->spill_threshold = 0;
+		return FALSE;
+	}
+	unlink (path);
+	const int alloc_errno = _pgm_rxw_spill_allocate (fd, 0, PGM_RXW_SPILL_INITIAL);
+	if (0 != alloc_errno) {
+		pgm_warn (_("Cannot size receive overflow log: %s"),
+			pgm_strerror_s (errbuf, sizeof (errbuf), alloc_errno));
+		close (fd);
+		window->spill_threshold = 0;
+		return FALSE;
+	}
+	void* base = mmap (NULL, PGM_RXW_SPILL_INITIAL, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (MAP_FAILED == base) {
+		pgm_warn (_("Cannot map receive overflow log: %s"),
+			pgm_strerror_s (errbuf, sizeof (errbuf), errno));
+		close (fd);
+		window->spill_threshold = 0;
+		return FALSE;
+	}
+	window->spill = pgm_new0 (pgm_rxw_spill_t, 1);
+	window->spill->fd	= fd;
+	window->spill->base	= base;
+	window->spill->capacity	= PGM_RXW_SPILL_INITIAL;
+	return TRUE;
+#else
+	pgm_warn (_("Receive overflow log not supported on this platform."));
+	window->spill_threshold = 0;
+	return FALSE;
+#endif /* _WIN32 */
+}
+
+static
+void
+_pgm_rxw_spill_close (
+	pgm_rxw_spill_t* const	spill
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != spill);
+
+#ifndef _WIN32
+	munmap (spill->base, spill->capacity);
+	close (spill->fd);
+#endif
+	pgm_free (spill);
+}
+
+static inline
+bool
+_pgm_rxw_spill_is_empty (
+	const pgm_rxw_spill_t* const	spill
+	)
+{
+	return NULL == spill || spill->head == spill->tail;
+}
+
+/* make room for length bytes at the tail of the log, compacting unread
+ * records to the start of the file or else doubling the file.
+ *
+ * returns TRUE on success, returns FALSE if the file cannot be extended.
+ */
+
+static
+bool
+_pgm_rxw_spill_reserve (
+	pgm_rxw_spill_t* const	spill,
+	const size_t		length
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != spill);
+
+	if (PGM_LIKELY(spill->tail + length <= spill->capacity))
+		return TRUE;
+	const size_t unread = spill->tail - spill->head;
+	if (unread + length <= spill->capacity / 2) {
+		memmove (spill->base, spill->base + spill->head, unread);
+		spill->head = 0;
+		spill->tail = unread;
+		return TRUE;
+	}
+#ifndef _WIN32
+	size_t capacity = spill->capacity * 2;
+	while (capacity < spill->tail + length)
+		capacity *= 2;
+	if (0 != _pgm_rxw_spill_allocate (spill->fd, (off_t)spill->capacity, capacity - spill->capacity))
+		return FALSE;
+	void* base = mmap (NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, spill->fd, 0);
+	if (MAP_FAILED == base)
+		return FALSE;
+	munmap (spill->base, spill->capacity);
+	spill->base	= base;
+	spill->capacity	= capacity;
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+/* move committed sequences out of the window to free sequence space, skbs
+ * read by the application remain valid until the commit is removed.
+ */
+
+static
+void
+_pgm_rxw_spill_commit (
+	pgm_rxw_t* const	window
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != window);
+
+	while (!_pgm_rxw_commit_is_empty (window))
+	{
+		struct pgm_sk_buff_t* skb = _pgm_rxw_peek (window, window->trail);
+		pgm_assert (NULL != skb);
+		_pgm_rxw_unlink (window, skb);
+		window->size -= skb->len;
+		if (PGM_UNLIKELY(pgm_mem_gc_friendly)) {
+			const uint_fast32_t index_ = skb->sequence % pgm_rxw_max_length (window);
+			window->pdata[index_] = NULL;
+		}
+		pgm_queue_push_head_link (&window->spill_commit_queue, &skb->link_);
+		window->trail++;
+	}
+}
+
+/* remove the TPDU at the commit lead from the window after spilling.
+ */
+
+static
+void
+_pgm_rxw_spill_remove (
+	pgm_rxw_t*	      const restrict window,
+	struct pgm_sk_buff_t* const restrict skb
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != window);
+	pgm_assert (NULL != skb);
+	pgm_assert (_pgm_rxw_commit_is_empty (window));
+	pgm_assert_cmpuint (skb->sequence, ==, window->trail);
+
+	_pgm_rxw_unlink (window, skb);
+	window->size -= skb->len;
+	if (PGM_UNLIKELY(pgm_mem_gc_friendly)) {
+		const uint_fast32_t index_ = skb->sequence % pgm_rxw_max_length (window);
+		window->pdata[index_] = NULL;
+	}
+	_pgm_rxw_free_skb (window, skb);
+	window->trail++;
+	window->commit_lead++;
+}
+
+/* append the APDU, or the unread remainder of an APDU, at the commit lead to
+ * the overflow log and remove the TPDUs from the window, releasing memory and
+ * sequence space.  read-ahead APDUs are removed without spilling.
+ *
+ * returns TRUE if committed, returns FALSE if incomplete or on failure.
+ */
+
+static
+bool
+_pgm_rxw_spill_apdu (
+	pgm_rxw_t* const	window
+	)
+{
+	struct pgm_sk_buff_t* skb;
+	pgm_rxw_state_t* state;
+	size_t apdu_len, contiguous_len = 0, length = 0;
+	uint32_t sequence;
+
+/* pre-conditions */
+	pgm_assert (NULL != window);
+	pgm_assert (!_pgm_rxw_incoming_is_empty (window));
+
+	skb = _pgm_rxw_peek (window, window->commit_lead);
+	pgm_assert (NULL != skb);
+	state = (pgm_rxw_state_t*)&skb->cb;
+	if (PGM_PKT_STATE_HAVE_DATA != state->pkt_state)
+		return FALSE;
+	if (state->is_delivered) {
+		_pgm_rxw_state (window, skb, PGM_PKT_STATE_COMMIT_DATA);
+		window->commit_lead++;
+		_pgm_rxw_spill_commit (window);
+		return TRUE;
+	}
+
+	if (NULL == skb->pgm_opt_fragment) {
+		apdu_len = skb->len;
+	} else if (pgm_ntohl (skb->of_apdu_first_sqn) != skb->sequence) {
+/* remainder of an APDU spanning several messages, already complete */
+		apdu_len = pgm_ntohl (skb->of_apdu_len) - pgm_ntohl (skb->of_frag_offset);
+	} else if (_pgm_rxw_is_apdu_complete (window, skb->sequence)) {
+		apdu_len = pgm_ntohl (skb->of_apdu_len);
+	} else
+		return FALSE;
+
+/* reserve the entire APDU to never leave a partial APDU in the log */
+	sequence = window->commit_lead;
+	do {
+		if (PGM_UNLIKELY(pgm_uint32_gt (sequence, window->lead)))
+			return FALSE;
+		skb = _pgm_rxw_peek (window, sequence++);
+		pgm_assert (NULL != skb);
+		length += PGM_RXW_SPILL_RECORD_LEN(skb->len);
+		contiguous_len += skb->len;
+	} while (apdu_len > contiguous_len);
+
+	if (NULL == window->spill && !_pgm_rxw_spill_open (window))
+		return FALSE;
+	if (!_pgm_rxw_spill_reserve (window->spill, length)) {
+		pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Receive overflow log full."));
+		return FALSE;
+	}
+
+	_pgm_rxw_spill_commit (window);
+	while (window->commit_lead != sequence)
+	{
+		struct pgm_rxw_spill_record_t* record = (void*)(window->spill->base + window->spill->tail);
+		skb = _pgm_rxw_peek (window, window->commit_lead);
+		record->tstamp		= skb->tstamp;
+		record->sock		= skb->sock;
+		record->tsi		= skb->tsi;
+		record->sequence	= skb->sequence;
+		record->len		= skb->len;
+		record->has_fragment	= NULL != skb->pgm_opt_fragment;
+		if (record->has_fragment)
+			memcpy (&record->opt_fragment, skb->pgm_opt_fragment, sizeof (struct pgm_opt_fragment));
+		memcpy (record + 1, skb->data, skb->len);
+		window->spill->tail += PGM_RXW_SPILL_RECORD_LEN(skb->len);
+		_pgm_rxw_spill_remove (window, skb);
+		window->cumulative_spilled++;
+	}
+	return TRUE;
+}
+
+/* spill complete APDUs from the commit lead, for a window above its memory
+ * threshold.
+ *
+ * returns number of TPDUs committed.
+ */
+
+PGM_GNUC_INTERNAL
+unsigned
+pgm_rxw_spill (
+	pgm_rxw_t* const	window
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != window);
+
+	const uint32_t commit_lead = window->commit_lead;
+	while (window->spill_threshold &&
+	       !_pgm_rxw_incoming_is_empty (window) &&
+	       _pgm_rxw_spill_apdu (window));
+	return window->commit_lead - commit_lead;
+}
+
+/* read APDUs from the overflow log into new skbs, an APDU of more than
+ * PGM_MAX_FRAGMENTS TPDUs continues in the next message.  the skbs are
+ * freed on removing the commit.
+ *
+ * returns -1 on nothing read, returns length of bytes read.
+ */
+
+static
+ssize_t
+_pgm_rxw_spill_read (
+	pgm_rxw_t*    const restrict window,
+	struct pgm_msgv_t** restrict pmsg,		/* message array, updated as messages appended */
+	const unsigned		     pmsglen		/* number of items in pmsg */
+	)
+{
+	pgm_rxw_spill_t* spill = window->spill;
+	const struct pgm_msgv_t* msg_end;
+	ssize_t bytes_read = 0;
+	size_t  data_read  = 0;
+
+/* pre-conditions */
+	pgm_assert (NULL != window);
+	pgm_assert (NULL != pmsg);
+	pgm_assert_cmpuint (pmsglen, >, 0);
+	pgm_assert (!_pgm_rxw_spill_is_empty (spill));
+
+	msg_end = *pmsg + pmsglen - 1;
+	while (*pmsg <= msg_end && !_pgm_rxw_spill_is_empty (spill))
+	{
+		const struct pgm_rxw_spill_record_t* record;
+		unsigned count = 0;
+		size_t apdu_remaining;
+		do {
+			record = (const void*)(spill->base + spill->head);
+			struct pgm_sk_buff_t* skb = pgm_alloc_skb ((uint16_t)(sizeof (struct pgm_opt_fragment) + record->len));
+			skb->sock	= record->sock;
+			skb->tstamp	= record->tstamp;
+			skb->tsi	= record->tsi;
+			skb->sequence	= record->sequence;
+			if (record->has_fragment) {
+				skb->pgm_opt_fragment = skb->head;
+				memcpy (skb->pgm_opt_fragment, &record->opt_fragment, sizeof (struct pgm_opt_fragment));
+			}
+			pgm_skb_reserve (skb, sizeof (struct pgm_opt_fragment));
+			memcpy (pgm_skb_put (skb, record->len), record + 1, record->len);
+			spill->head += PGM_RXW_SPILL_RECORD_LEN(record->len);
+			pgm_queue_push_head_link (&window->spill_commit_queue, &skb->link_);
+			(*pmsg)->msgv_skb[ count++ ] = skb;
+			bytes_read += skb->len;
+			apdu_remaining = record->has_fragment ?
+				pgm_ntohl (record->opt_fragment.opt_frag_len) - pgm_ntohl (record->opt_fragment.opt_frag_off) - record->len : 0;
+		} while (apdu_remaining && PGM_MAX_FRAGMENTS != count && !_pgm_rxw_spill_is_empty (spill));
+		window->apdu_remaining = apdu_remaining;
+		if (apdu_remaining)
+			window->apdu_remaining_first = pgm_ntohl (record->opt_fragment.opt_sqn);
+		(*pmsg)->msgv_len = count;
+		(*pmsg)++;
+		data_read++;
+	}
+	if (_pgm_rxw_spill_is_empty (spill))
+		spill->head = spill->tail = 0;
+
+	window->bytes_delivered += bytes_read;
+	window->msgs_delivered  += data_read;
+	return data_read > 0 ? bytes_read : -1;
+}
+
 /* returns transmission group sequence (TG_SQN) from sequence (SQN).
  */
 
@@ -1817,6 +2596,15 @@ _pgm_rxw_state (
 	case PGM_PKT_STATE_HAVE_DATA:
 		window->fragment_count++;
 		pgm_assert_cmpuint (window->fragment_count, <=, pgm_rxw_length (window));
+		if (window->is_reassemble && NULL != skb->pgm_opt_fragment)
+			_pgm_rxw_reassemble (window, skb);
+/* rewind read ahead to the start of the APDU */
+		if (window->is_unordered) {
+			const uint32_t first_sequence = skb->pgm_opt_fragment ? pgm_ntohl (skb->of_apdu_first_sqn) : skb->sequence;
+			if (pgm_uint32_lt (first_sequence, window->unordered_lead))
+				window->unordered_lead = first_sequence;
+			window->has_event = 1;
+		}
 		break;
 
 	case PGM_PKT_STATE_HAVE_PARITY:
@@ -1833,6 +2621,7 @@ _pgm_rxw_state (
 		window->lost_count++;
 		window->cumulative_losses++;
 		window->has_event = 1;
+		window->is_apdu_scan_valid = 0;
 		pgm_assert_cmpuint (window->lost_count, <=, pgm_rxw_length (window));
 		break;
 
@@ -1858,6 +2647,69 @@ pgm_rxw_state (
 	_pgm_rxw_state (window, skb, new_pkt_state);
 }
 
+/* drop the window reference to an skb, with deferred release the last
+ * reference is pushed onto the reclaim stack instead of freed.
+ */
+
+static inline
+void
+_pgm_rxw_free_skb (
+	pgm_rxw_t*	      const restrict window,
+	struct pgm_sk_buff_t* const restrict skb
+	)
+{
+	pgm_rxw_state_t* state = (pgm_rxw_state_t*)&skb->cb;
+	pgm_rxw_reclaim_t* reclaim = window->reclaim;
+	void* head;
+
+/* drop fragment reference to the reassembled APDU */
+	if (NULL != state->apdu_skb) {
+		struct pgm_sk_buff_t* apdu_skb = state->apdu_skb;
+		state->apdu_skb = NULL;
+		_pgm_rxw_free_skb (window, apdu_skb);
+	}
+	if (NULL == reclaim) {
+		pgm_free_skb (skb);
+		return;
+	}
+	if (!pgm_skb_unref (skb))
+		return;
+	do {
+		head = reclaim->head;
+		skb->link_.next = head;
+	} while (!pgm_atomic_cas_pointer ((void* volatile*)&reclaim->head, head, skb));
+	reclaim->pushed++;
+}
+
+/* release all skbs on the reclaim stack, may be called from any thread.
+ *
+ * returns number of skbs released.
+ */
+
+PGM_GNUC_INTERNAL
+unsigned
+pgm_rxw_reclaim (
+	pgm_rxw_reclaim_t* const	reclaim
+	)
+{
+	struct pgm_sk_buff_t* skb;
+	unsigned count = 0;
+
+/* pre-conditions */
+	pgm_assert (NULL != reclaim);
+
+	skb = pgm_atomic_exchange_pointer ((void* volatile*)&reclaim->head, NULL);
+	while (NULL != skb) {
+		struct pgm_sk_buff_t* next = (void*)skb->link_.next;
+		pgm_skb_release (skb);
+		skb = next;
+		count++;
+	}
+	if (count)
+		pgm_atomic_add32 (&reclaim->freed, count);
+	return count;
+}
+
 /* remove current state from sequence.
  */
 
@@ -1940,6 +2792,62 @@ pgm_rxw_peek (
 	return _pgm_rxw_peek (window, sequence);
 }
 
+/* returns the first sequence from the given sequence, not before the commit
+ * lead, that is waiting on recovery, or NULL if none.  placeholders are added
+ * in sequence order such that it is also the longest outstanding.
+ *
+ * sequences only start waiting on recovery at the lead, so the scan resumes
+ * from missing_trail, before which no sequence is waiting, and each sequence
+ * is passed over once.
+ */
+
+PGM_GNUC_INTERNAL
+struct pgm_sk_buff_t*
+pgm_rxw_first_missing (
+	pgm_rxw_t* const	window,
+	uint32_t		sequence
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != window);
+
+	pgm_debug ("first_missing (window:%p sequence:%" PRIu32 ")", (void*)window, sequence);
+
+	if (0 == window->nak_backoff_queue.length &&
+	    0 == window->wait_ncf_queue.length &&
+	    0 == window->wait_data_queue.length)
+	{
+		window->missing_trail = pgm_rxw_next_lead (window);
+		return NULL;
+	}
+
+	if (pgm_uint32_lt (window->missing_trail, window->commit_lead) ||
+	    pgm_uint32_gt (window->missing_trail, pgm_rxw_next_lead (window)))
+		window->missing_trail = window->commit_lead;
+	const bool is_trail = pgm_uint32_lte (sequence, window->missing_trail);
+	if (is_trail)
+		sequence = window->missing_trail;
+	for (; pgm_uint32_lte (sequence, window->lead); sequence++)
+	{
+		struct pgm_sk_buff_t* skb = _pgm_rxw_peek (window, sequence);
+		pgm_assert (NULL != skb);
+		const pgm_rxw_state_t* state = (const pgm_rxw_state_t*)&skb->cb;
+		switch (state->pkt_state) {
+		case PGM_PKT_STATE_BACK_OFF:
+		case PGM_PKT_STATE_WAIT_NCF:
+		case PGM_PKT_STATE_WAIT_DATA:
+			if (is_trail)
+				window->missing_trail = sequence;
+			return skb;
+
+		default: break;
+		}
+	}
+	if (is_trail)
+		window->missing_trail = sequence;
+	return NULL;
+}
+
 /* mark an existing sequence lost due to failed recovery.
  */
 
@@ -2148,6 +3056,7 @@ pgm_rxw_dump (
 		"fragment_count = %" PRIu32 ", "
 		"parity_count = %" PRIu32 ", "
 		"committed_count = %" PRIu32 ", "
+		"lease_count = %" PRIu32 ", "
 		"max_tpdu = %" PRIu16 ", "
 		"tg_size = %" PRIu32 ", "
 		"tg_sqn_shift = %u, "
@@ -2160,6 +3069,8 @@ pgm_rxw_dump (
 		"is_defined = %u, "
 		"has_event = %u, "
 		"is_fec_available = %u, "
+		"is_unordered = %u, "
+		"unordered_lead = %" PRIu32 ", "
 		"min_fill_time = %" PRIu32 ", "
 		"max_fill_time = %" PRIu32 ", "
 		"min_nak_transmit_count = %" PRIu32 ", "
@@ -2191,6 +3102,7 @@ pgm_rxw_dump (
 		window->fragment_count,
 		window->parity_count,
 		window->committed_count,
+		pgm_atomic_read32 (&window->lease_count),
 		window->max_tpdu,
 		window->tg_size,
 		window->tg_sqn_shift,
@@ -2203,6 +3115,8 @@ pgm_rxw_dump (
 		window->is_defined,
 		window->has_event,
 		window->is_fec_available,
+		window->is_unordered,
+		window->unordered_lead,
 		window->min_fill_time,
 		window->max_fill_time,
 		window->min_nak_transmit_count,
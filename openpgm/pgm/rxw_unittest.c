@@ -36,6 +36,7 @@
 
 #define pgm_histogram_add		mock_pgm_histogram_add
 #define pgm_time_now			mock_pgm_time_now
+#define pgm_time_update_now		mock_pgm_time_update_now
 #define pgm_rs_create			mock_pgm_rs_create
 #define pgm_rs_destroy			mock_pgm_rs_destroy
 #define pgm_rs_decode_parity_appended	mock_pgm_rs_decode_parity_appended
@@ -49,10 +50,19 @@
 #endif
 
 static pgm_time_t mock_pgm_time_now = 0x1;
+static pgm_time_t _mock_pgm_time_update_now (void);
+pgm_time_update_func mock_pgm_time_update_now = _mock_pgm_time_update_now;
 
 
 /* mock functions for external references */
 
+static
+pgm_time_t
+_mock_pgm_time_update_now (void)
+{
+	return mock_pgm_time_now;
+}
+
 size_t
 pgm_pkt_offset (
         const bool                      can_fragment,
@@ -139,6 +149,38 @@ generate_valid_skb (void)
 	return skb;
 }
 
+/* generate valid fragment of an APDU, payload filled with the fragment offset
+ */
+static
+struct pgm_sk_buff_t*
+generate_fragment_skb (
+	const guint32		first_sqn,
+	const guint32		frag_off,
+	const guint32		apdu_len
+	)
+{
+	const pgm_tsi_t tsi = { { 200, 202, 203, 204, 205, 206 }, 2000 };
+	const guint16 tsdu_length = 1000;
+	const guint16 header_length = sizeof(struct pgm_header) + sizeof(struct pgm_data) + sizeof(struct pgm_opt_fragment);
+	struct pgm_sk_buff_t* skb = pgm_alloc_skb (1500);
+	memcpy (&skb->tsi, &tsi, sizeof(tsi));
+	skb->sock = (pgm_sock_t*)0x1;
+	skb->tstamp = pgm_time_now;
+	pgm_skb_reserve (skb, header_length);
+	memset (skb->head, 0, header_length);
+	skb->pgm_header = (struct pgm_header*)skb->head;
+	skb->pgm_data   = (struct pgm_data*)(skb->pgm_header + 1);
+	skb->pgm_opt_fragment = (struct pgm_opt_fragment*)(skb->pgm_data + 1);
+	skb->pgm_header->pgm_type = PGM_ODATA;
+	skb->pgm_header->pgm_options = PGM_OPT_PRESENT;
+	skb->pgm_header->pgm_tsdu_length = g_htons (tsdu_length);
+	skb->of_apdu_first_sqn = g_htonl (first_sqn);
+	skb->of_frag_offset = g_htonl (frag_off);
+	skb->of_apdu_len = g_htonl (apdu_len);
+	memset (pgm_skb_put (skb, tsdu_length), (int)(frag_off / tsdu_length), tsdu_length);
+	return skb;
+}
+
 /* target:
  *	pgm_rxw_t*
  *	pgm_rxw_create (
@@ -321,6 +363,40 @@ START_TEST (test_add_pass_002)
 }
 END_TEST
 
+/* missing + inserted records repair and NAK service latency */
+START_TEST (test_add_pass_006)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	struct pgm_sk_buff_t* skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (0);
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+	fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (2);
+	fail_unless (PGM_RXW_MISSING == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not missing");
+/* NAK sent for placeholder #1 */
+	pgm_rxw_state_t* state = (pgm_rxw_state_t*)&_pgm_rxw_peek (window, 1)->cb;
+	state->nak_tstamp = 51;
+	skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (1);
+	skb->tstamp = 101;
+	fail_unless (PGM_RXW_INSERTED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not inserted");
+	fail_unless (1 == window->latency[PGM_LATENCY_RECEIVER_REPAIR].count, "repair count");
+	fail_unless (100 == window->latency[PGM_LATENCY_RECEIVER_REPAIR].max, "repair latency");
+	fail_unless (100 == pgm_latency_percentile (&window->latency[PGM_LATENCY_RECEIVER_REPAIR], 99.9), "repair percentile");
+	fail_unless (1 == window->latency[PGM_LATENCY_RECEIVER_NAK_SVC].count, "nak service count");
+	fail_unless (50 == window->latency[PGM_LATENCY_RECEIVER_NAK_SVC].min, "nak service latency");
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
 /* duplicate + append */
 START_TEST (test_add_pass_003)
 {
@@ -976,6 +1052,261 @@ START_TEST (test_readv_pass_006)
 }
 END_TEST
 
+/* unordered delivery */
+START_TEST (test_readv_pass_010)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	window->is_unordered = 1;
+	struct pgm_msgv_t msgv[4], *pmsg;
+	struct pgm_sk_buff_t* skb;
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+/* #0, #2, #3 with #1 missing */
+	skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (0);
+	fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (2);
+	fail_unless (PGM_RXW_MISSING == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not missing");
+	skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (3);
+	fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	pmsg = msgv;
+	fail_unless (3000 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	fail_unless (3 == pmsg - msgv, "readv failed");
+	fail_unless (2 == msgv[1].msgv_skb[0]->sequence, "readv failed");
+	fail_unless (1 == window->commit_lead, "commit_lead failed");
+	pmsg = msgv;
+	fail_unless (-1 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+/* repair #1, read-ahead #2, #3 are committed without being read again */
+	skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (1);
+	fail_unless (PGM_RXW_INSERTED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not inserted");
+	pmsg = msgv;
+	fail_unless (1000 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	fail_unless (1 == pmsg - msgv, "readv failed");
+	fail_unless (1 == msgv[0].msgv_skb[0]->sequence, "readv failed");
+	fail_unless (4 == window->commit_lead, "commit_lead failed");
+	pmsg = msgv;
+	fail_unless (-1 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
+/* contiguous reassembly of a fragmented APDU */
+START_TEST (test_readv_pass_011)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	window->is_reassemble = 1;
+	struct pgm_msgv_t msgv[4], *pmsg;
+	struct pgm_sk_buff_t* skb;
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+/* #0, #2 with #1 missing */
+	skb = generate_fragment_skb (0, 0, 3000);
+	skb->pgm_data->data_sqn = g_htonl (0);
+	fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	skb = generate_fragment_skb (0, 2000, 3000);
+	skb->pgm_data->data_sqn = g_htonl (2);
+	fail_unless (PGM_RXW_MISSING == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not missing");
+	pmsg = msgv;
+	fail_unless (-1 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	skb = generate_fragment_skb (0, 1000, 3000);
+	skb->pgm_data->data_sqn = g_htonl (1);
+	fail_unless (PGM_RXW_INSERTED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not inserted");
+	pmsg = msgv;
+	fail_unless (3000 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	fail_unless (1 == pmsg - msgv, "readv failed");
+	fail_unless (1 == msgv[0].msgv_len, "msgv_len failed");
+	skb = msgv[0].msgv_skb[0];
+	fail_unless (3000 == skb->len, "len failed");
+	fail_unless (0 == skb->sequence, "sequence failed");
+	for (unsigned i = 0; i < 3; i++)
+		fail_unless (i == ((guint8*)skb->data)[i * 1000] && i == ((guint8*)skb->data)[i * 1000 + 999], "data failed");
+	pgm_rxw_remove_commit (window);
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
+/* APDU of more than PGM_MAX_FRAGMENTS fragments continues in the next message */
+START_TEST (test_readv_pass_012)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	const guint32 apdu_len = (PGM_MAX_FRAGMENTS + 4) * 1000;
+	window->max_apdu = apdu_len;
+	window->max_fragments = pgm_rxw_max_length (window);
+	struct pgm_msgv_t msgv[1], *pmsg;
+	struct pgm_sk_buff_t* skb;
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+/* all but the final fragment */
+	for (guint32 i = 0; i < PGM_MAX_FRAGMENTS + 3; i++) {
+		skb = generate_fragment_skb (0, i * 1000, apdu_len);
+		skb->pgm_data->data_sqn = g_htonl (i);
+		fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+		pmsg = msgv;
+		fail_unless (-1 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	}
+	skb = generate_fragment_skb (0, (PGM_MAX_FRAGMENTS + 3) * 1000, apdu_len);
+	skb->pgm_data->data_sqn = g_htonl (PGM_MAX_FRAGMENTS + 3);
+	fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	pmsg = msgv;
+	fail_unless (PGM_MAX_FRAGMENTS * 1000 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	fail_unless (PGM_MAX_FRAGMENTS == msgv[0].msgv_len, "msgv_len failed");
+	fail_unless (0 == g_ntohl (msgv[0].msgv_skb[0]->of_frag_offset), "frag_offset failed");
+	pmsg = msgv;
+	fail_unless (4000 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	fail_unless (4 == msgv[0].msgv_len, "msgv_len failed");
+	fail_unless (PGM_MAX_FRAGMENTS * 1000 == g_ntohl (msgv[0].msgv_skb[0]->of_frag_offset), "frag_offset failed");
+	pgm_rxw_remove_commit (window);
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
+/* unread remainder of an APDU is discarded when pulled from the trail */
+START_TEST (test_readv_pass_015)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	const guint32 apdu_len = (PGM_MAX_FRAGMENTS + 4) * 1000;
+	window->max_apdu = apdu_len;
+	window->max_fragments = pgm_rxw_max_length (window);
+	struct pgm_msgv_t msgv[1], *pmsg;
+	struct pgm_sk_buff_t* skb;
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+	for (guint32 i = 0; i < PGM_MAX_FRAGMENTS + 4; i++) {
+		skb = generate_fragment_skb (0, i * 1000, apdu_len);
+		skb->pgm_data->data_sqn = g_htonl (i);
+		fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	}
+	pmsg = msgv;
+	fail_unless (PGM_MAX_FRAGMENTS * 1000 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	fail_unless (4000 == window->apdu_remaining, "apdu_remaining failed");
+	pgm_rxw_remove_commit (window);
+	for (guint32 i = 0; i < 4; i++)
+		fail_unless (1 == pgm_rxw_remove_trail (window), "remove_trail failed");
+	fail_unless (0 == window->apdu_remaining, "apdu_remaining failed");
+	fail_unless (4 == window->cumulative_losses, "cumulative_losses failed");
+/* following APDU is read on its own */
+	skb = generate_valid_skb ();
+	skb->pgm_data->data_sqn = g_htonl (PGM_MAX_FRAGMENTS + 4);
+	fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	pmsg = msgv;
+	fail_unless (1000 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	fail_unless (1 == msgv[0].msgv_len, "msgv_len failed");
+	fail_unless (PGM_MAX_FRAGMENTS + 4 == msgv[0].msgv_skb[0]->sequence, "sequence failed");
+	pgm_rxw_remove_commit (window);
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
+/* APDUs spilled to the overflow log are read in order after the window commits */
+START_TEST (test_readv_pass_013)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	window->spill_threshold = 1;
+	struct pgm_msgv_t msgv[1], *pmsg;
+	struct pgm_sk_buff_t* skb;
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+/* #0, #1 single TPDU APDUs, #2-#4 one fragmented APDU */
+	for (guint32 i = 0; i < 2; i++) {
+		skb = generate_valid_skb ();
+		skb->pgm_data->data_sqn = g_htonl (i);
+		fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	}
+	for (guint32 i = 0; i < 3; i++) {
+		skb = generate_fragment_skb (2, i * 1000, 3000);
+		skb->pgm_data->data_sqn = g_htonl (2 + i);
+		fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	}
+	fail_unless (5 == pgm_rxw_spill (window), "spill failed");
+	fail_unless (5 == window->cumulative_spilled, "cumulative_spilled failed");
+	fail_unless (0 == pgm_rxw_length (window), "length failed");
+	fail_unless (0 == pgm_rxw_size (window), "size failed");
+	pgm_rxw_remove_commit (window);
+	for (guint32 i = 0; i < 2; i++) {
+		pmsg = msgv;
+		fail_unless (1000 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+		fail_unless (1 == msgv[0].msgv_len, "msgv_len failed");
+		fail_unless (i == msgv[0].msgv_skb[0]->sequence, "sequence failed");
+		pgm_rxw_remove_commit (window);
+	}
+	pmsg = msgv;
+	fail_unless (3000 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	fail_unless (3 == msgv[0].msgv_len, "msgv_len failed");
+	for (guint32 i = 0; i < 3; i++) {
+		skb = msgv[0].msgv_skb[i];
+		fail_unless (2 + i == skb->sequence, "sequence failed");
+		fail_unless (i * 1000 == g_ntohl (skb->of_frag_offset), "frag_offset failed");
+		fail_unless (i == ((guint8*)skb->data)[0], "data failed");
+	}
+	pgm_rxw_remove_commit (window);
+	pmsg = msgv;
+	fail_unless (-1 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
+/* spilling frees sequence space behind data held by the application */
+START_TEST (test_readv_pass_014)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	struct pgm_msgv_t msgv[1], *pmsg;
+	struct pgm_sk_buff_t* skb;
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+	skb = generate_valid_skb ();
+	skb->pgm_data->data_sqn = g_htonl (0);
+	fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	pmsg = msgv;
+	fail_unless (1000 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	struct pgm_sk_buff_t* read_skb = msgv[0].msgv_skb[0];
+/* slow consumer, more than a window of data arrives before the next read */
+	window->spill_threshold = 1;
+	for (guint32 i = 1; i < 250; i++) {
+		skb = generate_valid_skb ();
+		skb->pgm_data->data_sqn = g_htonl (i);
+		fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+		fail_unless (1 == pgm_rxw_spill (window), "spill failed");
+	}
+	fail_unless (0 == pgm_rxw_length (window), "length failed");
+	fail_unless (0 == read_skb->sequence, "read skb invalidated");
+	fail_unless (249 == window->cumulative_spilled, "cumulative_spilled failed");
+	fail_unless (0 == window->cumulative_losses, "cumulative_losses failed");
+	pgm_rxw_remove_commit (window);
+	for (guint32 i = 1; i < 250; i++) {
+		pmsg = msgv;
+		fail_unless (1000 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+		fail_unless (i == msgv[0].msgv_skb[0]->sequence, "sequence failed");
+		pgm_rxw_remove_commit (window);
+	}
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
 /* NULL window */
 START_TEST (test_readv_fail_001)
 {
@@ -1116,6 +1447,112 @@ START_TEST (test_remove_commit_fail_001)
 }
 END_TEST
 
+/* target:
+ *	void
+ *	pgm_rxw_lease (
+ *		pgm_rxw_t* const		window,
+ *		const struct pgm_msgv_t*	msg,
+ *		const struct pgm_msgv_t* const	msg_end
+ *		)
+ */
+
+START_TEST (test_lease_pass_001)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	struct pgm_msgv_t msgv[2], *pmsg;
+	struct pgm_sk_buff_t* skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (0);
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+	fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	pmsg = msgv;
+	fail_unless (1000 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	pgm_rxw_lease (window, msgv, pmsg);
+	fail_unless (1 == pgm_atomic_read32 (&window->lease_count), "lease_count failed");
+	fail_unless (2 == pgm_atomic_read32 (&skb->users), "users failed");
+/* leased skb survives removal from window */
+	pgm_rxw_remove_commit (window);
+	fail_unless (1 == pgm_atomic_read32 (&skb->users), "users failed");
+	pgm_rxw_release_lease (window, 1);
+	fail_unless (0 == pgm_atomic_read32 (&window->lease_count), "lease_count failed");
+	pgm_free_skb (skb);
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
+START_TEST (test_lease_fail_001)
+{
+	struct pgm_msgv_t msgv[1];
+	pgm_rxw_lease (NULL, msgv, msgv);
+	fail ("reached");
+}
+END_TEST
+
+/* target:
+ *	void
+ *	pgm_rxw_release_lease (
+ *		pgm_rxw_t* const	window,
+ *		const unsigned		count
+ *		)
+ */
+
+START_TEST (test_release_lease_fail_001)
+{
+	pgm_rxw_release_lease (NULL, 0);
+	fail ("reached");
+}
+END_TEST
+
+/* target:
+ *	unsigned
+ *	pgm_rxw_reclaim (
+ *		pgm_rxw_reclaim_t* const	reclaim
+ *		)
+ */
+
+START_TEST (test_reclaim_pass_001)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	pgm_rxw_reclaim_t reclaim;
+	memset (&reclaim, 0, sizeof(reclaim));
+	window->reclaim = &reclaim;
+	struct pgm_msgv_t msgv[2], *pmsg;
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+	for (unsigned i = 0; i < 2; i++) {
+		struct pgm_sk_buff_t* skb = generate_valid_skb ();
+		fail_if (NULL == skb, "generate_valid_skb failed");
+		skb->pgm_data->data_sqn = g_htonl (i);
+		fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	}
+	pmsg = msgv;
+	fail_unless (2000 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+/* committed skbs are deferred on removal */
+	pgm_rxw_remove_commit (window);
+	fail_unless (2 == pgm_rxw_reclaim_backlog (&reclaim), "backlog failed");
+	fail_if (NULL == reclaim.head, "head failed");
+	fail_unless (2 == pgm_rxw_reclaim (&reclaim), "reclaim failed");
+	fail_unless (0 == pgm_rxw_reclaim_backlog (&reclaim), "backlog failed");
+	fail_unless (NULL == reclaim.head, "head failed");
+	fail_unless (0 == pgm_rxw_reclaim (&reclaim), "reclaim failed");
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
+START_TEST (test_reclaim_fail_001)
+{
+	pgm_rxw_reclaim (NULL);
+	fail ("reached");
+}
+END_TEST
+
 /* target:
  *	unsigned
  *	pgm_rxw_remove_trail (
@@ -1357,6 +1794,107 @@ START_TEST (test_lost_fail_001)
 }
 END_TEST
 
+/* target:
+ *	struct pgm_sk_buff_t*
+ *	pgm_rxw_first_missing (
+ *		pgm_rxw_t* const	window,
+ *		uint32_t		sequence
+ *		)
+ */
+
+START_TEST (test_first_missing_pass_001)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+/* #100, #103 with #101, #102 missing */
+	struct pgm_sk_buff_t* skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (100);
+	fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	fail_unless (NULL == pgm_rxw_first_missing (window, 100), "first_missing failed");
+	skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (103);
+	fail_unless (PGM_RXW_MISSING == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not missing");
+	skb = pgm_rxw_first_missing (window, 100);
+	fail_if (NULL == skb, "first_missing failed");
+	fail_unless (101 == skb->sequence, "first_missing failed");
+	skb = pgm_rxw_first_missing (window, 102);
+	fail_if (NULL == skb, "first_missing failed");
+	fail_unless (102 == skb->sequence, "first_missing failed");
+	fail_unless (NULL == pgm_rxw_first_missing (window, 103), "first_missing failed");
+/* lost sequences are no longer missing */
+	pgm_rxw_lost (window, 101);
+	pgm_rxw_lost (window, 102);
+	fail_unless (NULL == pgm_rxw_first_missing (window, 100), "first_missing failed");
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
+/* resume from the oldest missing sequence as gaps are repaired and opened */
+START_TEST (test_first_missing_pass_002)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+/* #100, #103 with #101, #102 missing */
+	struct pgm_sk_buff_t* skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (100);
+	fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (103);
+	fail_unless (PGM_RXW_MISSING == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not missing");
+	skb = pgm_rxw_first_missing (window, 100);
+	fail_if (NULL == skb, "first_missing failed");
+	fail_unless (101 == skb->sequence, "first_missing failed");
+/* repair #101 */
+	skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (101);
+	fail_unless (PGM_RXW_INSERTED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not inserted");
+	skb = pgm_rxw_first_missing (window, 100);
+	fail_if (NULL == skb, "first_missing failed");
+	fail_unless (102 == skb->sequence, "first_missing failed");
+	fail_unless (102 == window->missing_trail, "missing_trail not advanced");
+/* #106 with #104, #105 missing, then lose #102 */
+	skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (106);
+	fail_unless (PGM_RXW_MISSING == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not missing");
+	pgm_rxw_lost (window, 102);
+	skb = pgm_rxw_first_missing (window, 100);
+	fail_if (NULL == skb, "first_missing failed");
+	fail_unless (104 == skb->sequence, "first_missing failed");
+	fail_unless (104 == window->missing_trail, "missing_trail not advanced");
+/* later sequences do not move the trail */
+	skb = pgm_rxw_first_missing (window, 105);
+	fail_if (NULL == skb, "first_missing failed");
+	fail_unless (105 == skb->sequence, "first_missing failed");
+	fail_unless (104 == window->missing_trail, "missing_trail moved");
+	pgm_rxw_lost (window, 104);
+	pgm_rxw_lost (window, 105);
+	fail_unless (NULL == pgm_rxw_first_missing (window, 100), "first_missing failed");
+	fail_unless (107 == window->missing_trail, "missing_trail not at next lead");
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
+START_TEST (test_first_missing_fail_001)
+{
+	struct pgm_sk_buff_t* skb = pgm_rxw_first_missing (NULL, 0);
+	fail ("reached");
+}
+END_TEST
+
 /* target:
  *	void
  *	pgm_rxw_state (
@@ -1507,6 +2045,7 @@ make_basic_test_suite (void)
 	tcase_add_test (tc_add, test_add_pass_003);
 	tcase_add_test (tc_add, test_add_pass_004);
 	tcase_add_test (tc_add, test_add_pass_005);
+	tcase_add_test (tc_add, test_add_pass_006);
 #ifndef PGM_CHECK_NOFORK
 	tcase_add_test_raise_signal (tc_add, test_add_fail_001, SIGABRT);
 	tcase_add_test_raise_signal (tc_add, test_add_fail_002, SIGABRT);
@@ -1577,6 +2116,12 @@ make_basic_test_suite (void)
 	tcase_add_test (tc_readv, test_readv_pass_004);
 	tcase_add_test (tc_readv, test_readv_pass_005);
 	tcase_add_test (tc_readv, test_readv_pass_006);
+	tcase_add_test (tc_readv, test_readv_pass_010);
+	tcase_add_test (tc_readv, test_readv_pass_011);
+	tcase_add_test (tc_readv, test_readv_pass_012);
+	tcase_add_test (tc_readv, test_readv_pass_013);
+	tcase_add_test (tc_readv, test_readv_pass_014);
+	tcase_add_test (tc_readv, test_readv_pass_015);
 #ifndef PGM_CHECK_NOFORK
 	tcase_add_test_raise_signal (tc_readv, test_readv_fail_001, SIGABRT);
 	tcase_add_test_raise_signal (tc_readv, test_readv_fail_002, SIGABRT);
@@ -1590,6 +2135,21 @@ make_basic_test_suite (void)
 	tcase_add_test_raise_signal (tc_remove_commit, test_remove_commit_fail_001, SIGABRT);
 #endif
 
+	TCase* tc_lease = tcase_create ("lease");
+	suite_add_tcase (s, tc_lease);
+	tcase_add_test (tc_lease, test_lease_pass_001);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_lease, test_lease_fail_001, SIGABRT);
+	tcase_add_test_raise_signal (tc_lease, test_release_lease_fail_001, SIGABRT);
+#endif
+
+	TCase* tc_reclaim = tcase_create ("reclaim");
+	suite_add_tcase (s, tc_reclaim);
+	tcase_add_test (tc_reclaim, test_reclaim_pass_001);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_reclaim, test_reclaim_fail_001, SIGABRT);
+#endif
+
 	TCase* tc_remove_trail = tcase_create ("remove-trail");
 	TCase* tc_update = tcase_create ("update");
 	suite_add_tcase (s, tc_update);
@@ -1613,6 +2173,14 @@ make_basic_test_suite (void)
 	tcase_add_test_raise_signal (tc_lost, test_lost_fail_001, SIGABRT);
 #endif
 
+	TCase* tc_first_missing = tcase_create ("first-missing");
+	suite_add_tcase (s, tc_first_missing);
+	tcase_add_test (tc_first_missing, test_first_missing_pass_001);
+	tcase_add_test (tc_first_missing, test_first_missing_pass_002);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_first_missing, test_first_missing_fail_001, SIGABRT);
+#endif
+
         TCase* tc_state = tcase_create ("state");
 	suite_add_tcase (s, tc_state);
 	tcase_add_test (tc_state, test_state_pass_001);
@@ -0,0 +1,344 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * Shared memory statistics segment.  A publisher thread copies socket and
+ * peer counters, window edges and rate limit state into a POSIX shared
+ * memory segment at a fixed interval, external readers such as
+ * examples/pgmstat map the segment read-only and never touch the process.
+ *
+ * Copyright (c) 2006-2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+#include <errno.h>
+#include <stdio.h>
+#ifdef HAVE_SHM_OPEN
+#	include <fcntl.h>
+#	include <poll.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+#include <impl/i18n.h>
+#include <impl/framework.h>
+#include <impl/socket.h>
+#include <impl/receiver.h>
+#include <impl/txw.h>
+#include <impl/rxw.h>
+#include <pgm/shm.h>
+
+
+//#define SHM_DEBUG
+
+#ifdef HAVE_SHM_OPEN
+static char				shm_name[256];
+static int				shm_fd = -1;
+static struct pgm_shm_header_t*		shm_header = NULL;
+static size_t				shm_size = 0;
+static pthread_t			shm_thread;
+static pgm_notify_t			shm_notify = PGM_NOTIFY_INIT;
+static volatile uint32_t		shm_ref_count = 0;
+
+static void* shm_routine (void*);
+
+
+static
+void
+shm_publish_sock (
+	const pgm_sock_t*	 const restrict sock,
+	struct pgm_shm_sock_t*	 const restrict s
+	)
+{
+	memset (s, 0, sizeof (struct pgm_shm_sock_t));
+	s->stats.version = PGM_STATS_VERSION;
+	pgm_sock_copy_stats (sock, &s->stats);
+	memcpy (&s->tsi, &sock->tsi, sizeof (pgm_tsi_t));
+	s->dport		= pgm_ntohs (sock->dport);
+	s->can_send_data	= sock->can_send_data;
+	s->can_recv_data	= sock->can_recv_data;
+	if (sock->can_send_data && NULL != sock->window) {
+		s->txw_lead	= pgm_txw_lead_atomic (sock->window);
+		s->txw_trail	= pgm_txw_trail_atomic (sock->window);
+		s->txw_bytes	= pgm_txw_size (sock->window);
+	}
+	s->txw_max_rte		= sock->txw_max_rte;
+	s->odata_max_rte	= sock->odata_max_rte;
+	s->rdata_max_rte	= sock->rdata_max_rte;
+	s->rate_limit		= sock->rate_control.rate_limit;
+	s->odata_rate_limit	= sock->odata_rate_control.rate_limit;
+	s->rdata_rate_limit	= sock->rdata_rate_control.rate_limit;
+	if (sock->use_pgmcc) {
+		s->cwnd_size	= pgm_fp8tou (sock->cwnd_size);
+		s->tokens	= pgm_fp8tou (sock->tokens);
+		s->is_congested	= sock->is_congested;
+	}
+	s->is_apdu_eagain	= sock->is_apdu_eagain;
+}
+
+static
+void
+shm_publish_peer (
+	const pgm_peer_t*	 const restrict peer,
+	struct pgm_shm_peer_t*	 const restrict p
+	)
+{
+	const pgm_rxw_t* window = peer->window;
+
+	memset (p, 0, sizeof (struct pgm_shm_peer_t));
+	pgm_peer_copy_stats (peer, &p->stats);
+	if (NULL != window) {
+		p->rxw_lead		= window->lead;
+		p->rxw_trail		= window->trail;
+		p->rxw_commit_lead	= window->commit_lead;
+		p->rxw_losses		= window->cumulative_losses;
+		p->rxw_bytes		= window->size;
+	}
+	p->last_packet		= peer->last_packet;
+}
+
+/* one update of the segment, readers see the sequence odd until done.  the
+ * socket list lock only excludes pgm_socket() and pgm_close(), peer tables
+ * are held as a reader.  PGM_SINGLE_THREADED sockets take no peer lock so only
+ * their source counters are published.
+ */
+
+static
+void
+shm_publish (
+	struct pgm_shm_header_t* const	header
+	)
+{
+	struct pgm_shm_sock_t* socks = pgm_shm_socks (header);
+	struct pgm_shm_peer_t* peers = pgm_shm_peers (header);
+	unsigned sock_count = 0, peer_count = 0;
+
+	pgm_atomic_inc32 (&header->sequence);
+	pgm_rwlock_reader_lock (&pgm_sock_list_lock);
+	for (pgm_slist_t* list = pgm_sock_list;
+	     NULL != list && sock_count < header->max_socks;
+	     list = list->next)
+	{
+		const pgm_sock_t* sock = (const pgm_sock_t*)list->data;
+		struct pgm_shm_sock_t* s = &socks[sock_count++];
+
+		shm_publish_sock (sock, s);
+		s->peer_index = peer_count;
+		if (sock->is_single_threaded)
+			continue;
+		pgm_rwlock_reader_lock (&((pgm_sock_t*)sock)->peers_lock);
+		for (pgm_list_t* peer_list = sock->peers_list;
+		     NULL != peer_list && peer_count < header->max_peers;
+		     peer_list = peer_list->next)
+		{
+			shm_publish_peer ((const pgm_peer_t*)peer_list->data, &peers[peer_count++]);
+			s->peer_count++;
+		}
+		pgm_rwlock_reader_unlock (&((pgm_sock_t*)sock)->peers_lock);
+	}
+	pgm_rwlock_reader_unlock (&pgm_sock_list_lock);
+	header->sock_count	= sock_count;
+	header->peer_count	= peer_count;
+	header->timestamp	= pgm_time_update_now();
+	pgm_atomic_inc32 (&header->sequence);
+#ifdef SHM_DEBUG
+	pgm_debug ("published %u sockets %u peers", sock_count, peer_count);
+#endif
+}
+
+/* create the segment and spawn the publisher, name defaults to
+ * PGM_SHM_PREFIX<pid>.  interval is in milliseconds.
+ */
+
+bool
+pgm_shm_init (
+	const char*   restrict name,
+	const unsigned	       interval,
+	pgm_error_t** restrict error
+	)
+{
+	pgm_return_val_if_fail (NULL == name || '/' == name[0], FALSE);
+	pgm_return_val_if_fail (interval > 0, FALSE);
+
+	if (pgm_atomic_exchange_and_add32 (&shm_ref_count, 1) > 0)
+		return TRUE;
+
+	if (NULL != name)
+		snprintf (shm_name, sizeof (shm_name), "%s", name);
+	else
+		snprintf (shm_name, sizeof (shm_name), PGM_SHM_PREFIX "%d", (int)getpid());
+
+	shm_fd = shm_open (shm_name, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (-1 == shm_fd) {
+		const int save_errno = errno;
+		char errbuf[1024];
+		pgm_set_error (error,
+			     PGM_ERROR_DOMAIN_ENGINE,
+			     pgm_error_from_errno (save_errno),
+			     _("Opening shared memory segment %s: %s"),
+			     shm_name,
+			     pgm_strerror_s (errbuf, sizeof (errbuf), save_errno));
+		goto err_cleanup;
+	}
+	shm_size = pgm_shm_size (PGM_SHM_MAX_SOCKS, PGM_SHM_MAX_PEERS);
+	if (0 != ftruncate (shm_fd, (off_t)shm_size)) {
+		const int save_errno = errno;
+		char errbuf[1024];
+		pgm_set_error (error,
+			     PGM_ERROR_DOMAIN_ENGINE,
+			     pgm_error_from_errno (save_errno),
+			     _("Sizing shared memory segment %s: %s"),
+			     shm_name,
+			     pgm_strerror_s (errbuf, sizeof (errbuf), save_errno));
+		goto err_cleanup;
+	}
+	shm_header = mmap (NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+	if (MAP_FAILED == shm_header) {
+		const int save_errno = errno;
+		char errbuf[1024];
+		shm_header = NULL;
+		pgm_set_error (error,
+			     PGM_ERROR_DOMAIN_ENGINE,
+			     pgm_error_from_errno (save_errno),
+			     _("Mapping shared memory segment %s: %s"),
+			     shm_name,
+			     pgm_strerror_s (errbuf, sizeof (errbuf), save_errno));
+		goto err_cleanup;
+	}
+	memset (shm_header, 0, shm_size);
+	shm_header->magic	= PGM_SHM_MAGIC;
+	shm_header->version	= PGM_SHM_VERSION;
+	shm_header->pid		= (uint32_t)getpid();
+	shm_header->interval	= interval;
+	shm_header->max_socks	= PGM_SHM_MAX_SOCKS;
+	shm_header->max_peers	= PGM_SHM_MAX_PEERS;
+
+/* create notification channel */
+	if (0 != pgm_notify_init (&shm_notify)) {
+		const int save_errno = pgm_get_last_sock_error();
+		char errbuf[1024];
+		pgm_set_error (error,
+			     PGM_ERROR_DOMAIN_ENGINE,
+			     pgm_error_from_sock_errno (save_errno),
+			     _("Creating shared memory notification channel: %s"),
+			     pgm_sock_strerror_s (errbuf, sizeof (errbuf), save_errno));
+		goto err_cleanup;
+	}
+
+/* spawn publisher */
+	const int status = pthread_create (&shm_thread, NULL, &shm_routine, NULL);
+	if (0 != status) {
+		char errbuf[1024];
+		pgm_set_error (error,
+			     PGM_ERROR_DOMAIN_ENGINE,
+			     pgm_error_from_errno (status),
+			     _("Creating shared memory thread: %s"),
+			     pgm_strerror_s (errbuf, sizeof (errbuf), status));
+		goto err_cleanup;
+	}
+	pgm_minor (_("Statistics segment: /dev/shm%s"), shm_name);
+	return TRUE;
+
+err_cleanup:
+	if (pgm_notify_is_valid (&shm_notify)) {
+		pgm_notify_destroy (&shm_notify);
+	}
+	if (NULL != shm_header) {
+		munmap (shm_header, shm_size);
+		shm_header = NULL;
+	}
+	if (-1 != shm_fd) {
+		close (shm_fd);
+		shm_fd = -1;
+		shm_unlink (shm_name);
+	}
+	pgm_atomic_dec32 (&shm_ref_count);
+	return FALSE;
+}
+
+/* notify publisher to shutdown, wait, and remove the segment.
+ */
+
+bool
+pgm_shm_shutdown (void)
+{
+	pgm_return_val_if_fail (pgm_atomic_read32 (&shm_ref_count) > 0, FALSE);
+
+	if (pgm_atomic_exchange_and_add32 (&shm_ref_count, (uint32_t)-1) != 1)
+		return TRUE;
+
+	pgm_notify_send (&shm_notify);
+	pthread_join (shm_thread, NULL);
+	pgm_notify_destroy (&shm_notify);
+	munmap (shm_header, shm_size);
+	shm_header = NULL;
+	close (shm_fd);
+	shm_fd = -1;
+	shm_unlink (shm_name);
+	return TRUE;
+}
+
+static
+void*
+shm_routine (
+	PGM_GNUC_UNUSED	void*	arg
+	)
+{
+	struct pollfd fds;
+
+	fds.fd		= pgm_notify_get_socket (&shm_notify);
+	fds.events	= POLLIN;
+	for (;;)
+	{
+		shm_publish (shm_header);
+		fds.revents = 0;
+		const int ready = poll (&fds, 1, (int)shm_header->interval);
+		if (ready > 0)
+			break;
+		if (ready < 0 && EINTR != errno) {
+			char errbuf[1024];
+			pgm_warn (_("Shared memory publisher poll failed: %s"),
+				  pgm_strerror_s (errbuf, sizeof (errbuf), errno));
+			break;
+		}
+	}
+	return NULL;
+}
+
+#else /* !HAVE_SHM_OPEN */
+bool
+pgm_shm_init (
+	PGM_GNUC_UNUSED const char*   restrict name,
+	PGM_GNUC_UNUSED const unsigned	       interval,
+	pgm_error_t**		      restrict error
+	)
+{
+	pgm_set_error (error,
+		       PGM_ERROR_DOMAIN_ENGINE,
+		       PGM_ERROR_NOSYS,
+		       _("Statistics segment requires POSIX shared memory."));
+	return FALSE;
+}
+
+bool
+pgm_shm_shutdown (void)
+{
+	return FALSE;
+}
+#endif /* HAVE_SHM_OPEN */
+
+/* eof */
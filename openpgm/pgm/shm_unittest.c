@@ -0,0 +1,240 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * unit tests for shared memory statistics segment.
+ *
+ * Copyright (c) 2006-2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <check.h>
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+#include <impl/framework.h>
+
+
+/* mock state */
+static pgm_rwlock_t	mock_pgm_sock_list_lock;
+static pgm_slist_t*	mock_pgm_sock_list;
+
+#define TEST_SHM_NAME	"/pgm.unittest"
+
+/* mock functions for external references */
+
+#define pgm_sock_list_lock	mock_pgm_sock_list_lock
+#define pgm_sock_list		mock_pgm_sock_list
+#define pgm_sock_copy_stats	mock_pgm_sock_copy_stats
+#define pgm_peer_copy_stats	mock_pgm_peer_copy_stats
+
+#include "shm.c"
+
+PGM_GNUC_INTERNAL
+void
+mock_pgm_sock_copy_stats (
+	const pgm_sock_t*   const restrict sock,
+	struct pgm_stats_t* const restrict stats
+	)
+{
+	stats->data_msgs_sent = sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT];
+}
+
+PGM_GNUC_INTERNAL
+void
+mock_pgm_peer_copy_stats (
+	const pgm_peer_t*	     const restrict peer,
+	struct pgm_peer_stats_t* const restrict stats
+	)
+{
+	memcpy (&stats->tsi, &peer->tsi, sizeof (pgm_tsi_t));
+	stats->data_msgs_received = peer->cumulative_stats[PGM_PC_RECEIVER_DATA_MSGS_RECEIVED];
+}
+
+static
+void
+mock_setup (void)
+{
+	g_assert (pgm_time_init (NULL));
+	pgm_rwlock_init (&mock_pgm_sock_list_lock);
+}
+
+static
+void
+mock_teardown (void)
+{
+	pgm_rwlock_free (&mock_pgm_sock_list_lock);
+	g_assert (pgm_time_shutdown ());
+}
+
+/* target:
+ *	bool
+ *	pgm_shm_init (
+ *		const char*	name,
+ *		const unsigned	interval,
+ *		pgm_error_t**	error
+ *	)
+ */
+
+START_TEST (test_init_pass_001)
+{
+	pgm_error_t* err = NULL;
+	fail_unless (TRUE == pgm_shm_init (TEST_SHM_NAME, 10, &err), "init failed");
+	fail_unless (NULL == err, "init failed");
+	const int fd = shm_open (TEST_SHM_NAME, O_RDONLY, 0);
+	fail_unless (-1 != fd, "shm_open failed");
+	const struct pgm_shm_header_t* header = mmap (NULL, sizeof (struct pgm_shm_header_t), PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	fail_unless (MAP_FAILED != header, "mmap failed");
+	fail_unless (PGM_SHM_MAGIC == header->magic, "magic mismatch");
+	fail_unless (PGM_SHM_VERSION == header->version, "version mismatch");
+	fail_unless (PGM_SHM_MAX_SOCKS == header->max_socks, "max_socks mismatch");
+	munmap ((void*)header, sizeof (struct pgm_shm_header_t));
+	fail_unless (TRUE == pgm_shm_shutdown (), "shutdown failed");
+	fail_unless (-1 == shm_open (TEST_SHM_NAME, O_RDONLY, 0), "segment not removed");
+}
+END_TEST
+
+/* name must be absolute */
+START_TEST (test_init_fail_001)
+{
+	pgm_error_t* err = NULL;
+	fail_unless (FALSE == pgm_shm_init ("pgm.unittest", 10, &err), "init failed");
+}
+END_TEST
+
+/* target:
+ *	void
+ *	shm_publish (
+ *		struct pgm_shm_header_t*	header
+ *	)
+ */
+
+START_TEST (test_publish_pass_001)
+{
+	const size_t len = pgm_shm_size (2, 2);
+	struct pgm_shm_header_t* header = g_malloc0 (len);
+	header->max_socks = 2;
+	header->max_peers = 2;
+	pgm_sock_t* sock = g_new0 (pgm_sock_t, 1);
+	pgm_peer_t* peer = g_new0 (pgm_peer_t, 1);
+	pgm_rwlock_init (&sock->peers_lock);
+	sock->dport = pgm_htons (7500);
+	sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT] = 42;
+	peer->tsi.sport = pgm_htons (1000);
+	peer->cumulative_stats[PGM_PC_RECEIVER_DATA_MSGS_RECEIVED] = 24;
+	sock->peers_list = pgm_list_append (sock->peers_list, peer);
+	mock_pgm_sock_list = pgm_slist_append (mock_pgm_sock_list, sock);
+
+	shm_publish (header);
+	fail_unless (2 == header->sequence, "sequence not even");
+	fail_unless (1 == header->sock_count, "sock_count mismatch");
+	fail_unless (1 == header->peer_count, "peer_count mismatch");
+	fail_unless (7500 == pgm_shm_socks (header)[0].dport, "dport mismatch");
+	fail_unless (42 == pgm_shm_socks (header)[0].stats.data_msgs_sent, "source stats mismatch");
+	fail_unless (0 == pgm_shm_socks (header)[0].peer_index, "peer_index mismatch");
+	fail_unless (1 == pgm_shm_socks (header)[0].peer_count, "peer_count mismatch");
+	fail_unless (24 == pgm_shm_peers (header)[0].stats.data_msgs_received, "peer stats mismatch");
+	fail_unless (pgm_tsi_equal (&peer->tsi, &pgm_shm_peers (header)[0].stats.tsi), "peer tsi mismatch");
+
+/* single-threaded sockets publish source counters only */
+	sock->is_single_threaded = TRUE;
+	shm_publish (header);
+	fail_unless (4 == header->sequence, "sequence not even");
+	fail_unless (1 == header->sock_count, "sock_count mismatch");
+	fail_unless (0 == header->peer_count, "peer_count mismatch");
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_shm_shutdown (void)
+ */
+
+START_TEST (test_shutdown_pass_001)
+{
+	pgm_error_t* err = NULL;
+	fail_unless (TRUE == pgm_shm_init (TEST_SHM_NAME, 10, &err), "init failed");
+	fail_unless (NULL == err, "init failed");
+	fail_unless (TRUE == pgm_shm_init (TEST_SHM_NAME, 10, &err), "init failed");
+	fail_unless (TRUE == pgm_shm_shutdown (), "shutdown failed");
+	fail_unless (TRUE == pgm_shm_shutdown (), "shutdown failed");
+	fail_unless (FALSE == pgm_shm_shutdown (), "shutdown failed");
+}
+END_TEST
+
+/* no running publisher */
+START_TEST (test_shutdown_fail_001)
+{
+	fail_unless (FALSE == pgm_shm_shutdown (), "shutdown failed");
+}
+END_TEST
+
+
+static
+Suite*
+make_test_suite (void)
+{
+	Suite* s;
+
+	s = suite_create (__FILE__);
+
+	TCase* tc_init = tcase_create ("init");
+	suite_add_tcase (s, tc_init);
+	tcase_add_checked_fixture (tc_init, mock_setup, mock_teardown);
+	tcase_add_test (tc_init, test_init_pass_001);
+	tcase_add_test (tc_init, test_init_fail_001);
+
+	TCase* tc_publish = tcase_create ("publish");
+	suite_add_tcase (s, tc_publish);
+	tcase_add_checked_fixture (tc_publish, mock_setup, mock_teardown);
+	tcase_add_test (tc_publish, test_publish_pass_001);
+
+	TCase* tc_shutdown = tcase_create ("shutdown");
+	suite_add_tcase (s, tc_shutdown);
+	tcase_add_checked_fixture (tc_shutdown, mock_setup, mock_teardown);
+	tcase_add_test (tc_shutdown, test_shutdown_pass_001);
+	tcase_add_test (tc_shutdown, test_shutdown_fail_001);
+
+	return s;
+}
+
+static
+Suite*
+make_master_suite (void)
+{
+	Suite* s = suite_create ("Master");
+	return s;
+}
+
+int
+main (void)
+{
+	pgm_messages_init();
+	SRunner* sr = srunner_create (make_master_suite ());
+	srunner_add_suite (sr, make_test_suite ());
+	srunner_run_all (sr, CK_ENV);
+	int number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	pgm_messages_shutdown();
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
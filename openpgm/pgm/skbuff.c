@@ -48,6 +48,21 @@ pgm_skb_under_panic (
 	pgm_assert_not_reached();
 }
 
+/* drop a reference on an external payload, releasing the application buffer
+ * with the last reference.
+ */
+
+void
+pgm_skb_ref_put (
+	struct pgm_skb_ref_t*const ref
+	)
+{
+	if (pgm_atomic_exchange_and_add32 (&ref->users, (uint32_t)-1) == 1) {
+		ref->release (ref->buffer, ref->user_data);
+		pgm_free (ref);
+	}
+}
+
 #ifndef SKB_DEBUG
 bool
 pgm_skb_is_valid (
@@ -77,22 +92,26 @@ pgm_skb_is_valid (
 	pgm_return_val_if_fail (NULL != skb->head, FALSE);
 	pgm_return_val_if_fail ((const char*)skb->head > (const char*)&skb->users, FALSE);
 	pgm_return_val_if_fail (NULL != skb->data, FALSE);
-	pgm_return_val_if_fail ((const char*)skb->data >= (const char*)skb->head, FALSE);
+	pgm_return_val_if_fail (NULL != skb->ref || (const char*)skb->data >= (const char*)skb->head, FALSE);
 	pgm_return_val_if_fail (NULL != skb->tail, FALSE);
 	pgm_return_val_if_fail ((const char*)skb->tail >= (const char*)skb->data, FALSE);
 	pgm_return_val_if_fail (skb->len == (char*)skb->tail - (const char*)skb->data, FALSE);
 	pgm_return_val_if_fail (NULL != skb->end, FALSE);
-	pgm_return_val_if_fail ((const char*)skb->end >= (const char*)skb->tail, FALSE);
+	pgm_return_val_if_fail (NULL != skb->ref || (const char*)skb->end >= (const char*)skb->tail, FALSE);
+/* external payload follows the linear header */
+	const char* linear_tail = (const char*)skb->head + pgm_skb_linear_length (skb);
 /* pgm_header */
 	if (skb->pgm_header) {
 		pgm_return_val_if_fail ((const char*)skb->pgm_header >= (const char*)skb->head, FALSE);
-		pgm_return_val_if_fail ((const char*)skb->pgm_header + sizeof(struct pgm_header) <= (const char*)skb->tail, FALSE);
+		pgm_return_val_if_fail ((const char*)skb->pgm_header + sizeof(struct pgm_header) <= linear_tail, FALSE);
 		pgm_return_val_if_fail (NULL != skb->pgm_data, FALSE);
 		pgm_return_val_if_fail ((const char*)skb->pgm_data >= (const char*)skb->pgm_header + sizeof(struct pgm_header), FALSE);
-		pgm_return_val_if_fail ((const char*)skb->pgm_data <= (const char*)skb->tail, FALSE);
+		pgm_return_val_if_fail ((const char*)skb->pgm_data <= linear_tail, FALSE);
 		if (skb->pgm_opt_fragment) {
 			pgm_return_val_if_fail ((const char*)skb->pgm_opt_fragment > (const char*)skb->pgm_data, FALSE);
-			pgm_return_val_if_fail ((const char*)skb->pgm_opt_fragment + sizeof(struct pgm_opt_fragment) < (const char*)skb->tail, FALSE);
+			pgm_return_val_if_fail (NULL != skb->ref ?
+						(const char*)skb->pgm_opt_fragment + sizeof(struct pgm_opt_fragment) <= linear_tail :
+						(const char*)skb->pgm_opt_fragment + sizeof(struct pgm_opt_fragment) < linear_tail, FALSE);
 /* of_apdu_first_sqn can be any value */
 /* of_frag_offset */
 			pgm_return_val_if_fail (pgm_ntohl (skb->of_frag_offset) < pgm_ntohl (skb->of_apdu_len), FALSE);
@@ -107,7 +126,7 @@ pgm_skb_is_valid (
 		pgm_return_val_if_fail (NULL == skb->pgm_opt_fragment, FALSE);
 	}
 /* truesize */
-	pgm_return_val_if_fail (skb->truesize >= sizeof(struct pgm_sk_buff_t*) + skb->len, FALSE);
+	pgm_return_val_if_fail (NULL != skb->ref || skb->truesize >= sizeof(struct pgm_sk_buff_t*) + skb->len, FALSE);
 	pgm_return_val_if_fail (skb->truesize == ((const char*)skb->end - (const char*)skb), FALSE);
 /* users */
 	pgm_return_val_if_fail (pgm_atomic_read32 (&skb->users) > 0, FALSE);
@@ -82,6 +82,26 @@ pgm_slist_prepend_link (
 	return new_list;
 }
 
+PGM_GNUC_INTERNAL
+pgm_slist_t*
+pgm_slist_append_link (
+	pgm_slist_t* restrict list,
+	pgm_slist_t* restrict link_
+	)
+{
+	pgm_slist_t *last;
+
+	link_->next = NULL;
+	if (list)
+	{
+		last = pgm_slist_last (list);
+		last->next = link_;
+		return list;
+	}
+	else
+		return link_;
+}
+
 PGM_GNUC_INTERNAL
 pgm_slist_t*
 pgm_slist_remove (
@@ -27,6 +27,9 @@
 #	include <sys/socket.h>
 #	include <netdb.h>
 #endif
+#ifdef HAVE_UDP_GRO
+#	include <netinet/udp.h>
+#endif
 #include <impl/framework.h>
 
 
@@ -550,6 +553,62 @@ pgm_sockaddr_router_alert (
 	return retval;
 }
 
+/* Receive coalesced UDP datagrams, segment size is passed as UDP_GRO ancillary
+ * data with each read.
+ *
+ * If no error occurs, pgm_sockaddr_udp_gro returns zero.  Otherwise, a value
+ * of SOCKET_ERROR is returned, and a specific error code can be retrieved by
+ * calling pgm_get_last_sock_error().
+ */
+
+PGM_GNUC_INTERNAL
+int
+pgm_sockaddr_udp_gro (
+	const SOCKET		s,
+	const bool		v
+	)
+{
+	int retval = SOCKET_ERROR;
+#ifdef HAVE_UDP_GRO
+/* Linux:udp(7) "int" */
+	const int optval = v ? 1 : 0;
+	retval = setsockopt (s, IPPROTO_UDP, UDP_GRO, (const char*)&optval, sizeof(optval));
+#else
+	(void)s;
+	(void)v;
+	pgm_set_last_sock_error (PGM_SOCK_EINVAL);
+#endif
+	return retval;
+}
+
+/* Time stamp received datagrams, arrival time is passed as SCM_TIMESTAMPNS
+ * ancillary data with each read.
+ *
+ * If no error occurs, pgm_sockaddr_timestamp returns zero.  Otherwise, a value
+ * of SOCKET_ERROR is returned, and a specific error code can be retrieved by
+ * calling pgm_get_last_sock_error().
+ */
+
+PGM_GNUC_INTERNAL
+int
+pgm_sockaddr_timestamp (
+	const SOCKET		s,
+	const bool		v
+	)
+{
+	int retval = SOCKET_ERROR;
+#ifdef HAVE_SO_TIMESTAMPNS
+/* Linux:socket(7) "int" */
+	const int optval = v ? 1 : 0;
+	retval = setsockopt (s, SOL_SOCKET, SO_TIMESTAMPNS, (const char*)&optval, sizeof(optval));
+#else
+	(void)s;
+	(void)v;
+	pgm_set_last_sock_error (PGM_SOCK_EINVAL);
+#endif
+	return retval;
+}
+
 /* Type-of-service and precedence.
  *
  * If no error occurs, pgm_sockaddr_tos returns zero.  Otherwise, a value of
@@ -33,9 +33,12 @@
 #include <stdio.h>
 #include <impl/i18n.h>
 #include <impl/framework.h>
+#include <impl/mem.h>
 #include <impl/socket.h>
 #include <impl/receiver.h>
+#include <impl/recv.h>
 #include <impl/source.h>
+#include <impl/net.h>
 #include <impl/timer.h>
 
 
@@ -283,7 +286,24 @@ pgm_close (
 			sock->peers_list = next;
 		} while (sock->peers_list);
 	}
+	if (sock->reclaim_max) {
+		pgm_debug ("releasing deferred receive buffers.");
+		pgm_rxw_reclaim (&sock->reclaim);
+	}
+	if (sock->peer_weights) {
+		pgm_debug ("destroying peer weights.");
+		for (pgm_slist_t* it = sock->peer_weights; NULL != it; it = it->next)
+			pgm_free (it->data);
+		pgm_slist_free (sock->peer_weights);
+		sock->peer_weights = NULL;
+	}
 
+#ifdef HAVE_MSG_ZEROCOPY
+	if (sock->zerocopy) {
+		pgm_debug ("releasing zero-copy transmit buffers.");
+		pgm_zerocopy_destroy (sock);
+	}
+#endif
 	if (sock->window) {
 		pgm_trace (PGM_LOG_ROLE_TX_WINDOW,_("Destroying transmit window."));
 		pgm_txw_shutdown (sock->window);
@@ -306,6 +326,12 @@ pgm_close (
 		pgm_free_skb (sock->rx_buffer);
 		sock->rx_buffer = NULL;
 	}
+#ifdef HAVE_RECVMMSG
+	if (sock->rx_batch) {
+		pgm_debug ("freeing receive batch buffers.");
+		pgm_rx_batch_destroy (sock);
+	}
+#endif
 	pgm_debug ("destroying notification channels.");
 	if (sock->can_send_data) {
 		if (sock->use_pgmcc) {
@@ -314,6 +340,16 @@ pgm_close (
 		pgm_notify_destroy (&sock->rdata_notify);
 	}
 	pgm_notify_destroy (&sock->pending_notify);
+#ifdef HAVE_TIMERFD_CREATE
+	if (INVALID_SOCKET != sock->event_sock) {
+		pgm_debug ("closing event socket.");
+		pgm_timer_event_destroy (sock);
+	}
+	if (-1 != sock->rate_timer) {
+		pgm_debug ("closing rate timer.");
+		pgm_timer_rate_destroy (sock);
+	}
+#endif
 	pgm_debug ("freeing sock locks.");
 	pgm_rwlock_free (&sock->peers_lock);
 	pgm_spinlock_free (&sock->txw_spinlock);
@@ -324,7 +360,7 @@ pgm_close (
 	pgm_rwlock_writer_unlock (&sock->lock);
 	pgm_rwlock_free (&sock->lock);
 	pgm_debug ("freeing sock data.");
-	pgm_free (sock);
+	pgm_free_aligned (sock);
 	pgm_debug ("finished.");
 	return TRUE;
 }
@@ -367,7 +403,7 @@ pgm_socket (
 	pgm_debug ("socket (sock:%p family:%s sock-type:%s protocol:%s error:%p)",
 		 (const void*)sock, pgm_family_string(family), pgm_sock_type_string(pgm_sock_type), pgm_protocol_string(protocol), (const void*)error);
 
-	new_sock = pgm_new0 (pgm_sock_t, 1);
+	new_sock = pgm_malloc0_aligned (sizeof (pgm_sock_t), PGM_CACHELINE_SIZE);
 	new_sock->family	= family;
 	new_sock->socket_type	= pgm_sock_type;
 	new_sock->protocol	= protocol;
@@ -377,6 +413,9 @@ pgm_socket (
 	new_sock->dport		= DEFAULT_DATA_DESTINATION_PORT;
 	new_sock->tsi.sport	= DEFAULT_DATA_SOURCE_PORT;
 	new_sock->adv_mode	= 0;	/* advance with time */
+	new_sock->event_sock	= INVALID_SOCKET;
+	new_sock->event_timer	= -1;
+	new_sock->rate_timer	= -1;
 
 /* PGMCC */
 	new_sock->acker_nla.ss_family = family;
@@ -603,10 +642,71 @@ err_destroy:
 		}
 		new_sock->send_with_router_alert_sock = INVALID_SOCKET;
 	}
-	pgm_free (new_sock);
+	pgm_free_aligned (new_sock);
 	return FALSE;
 }
 
+/* counters are written without locks by pgm_stats_add() or pgm_atomic_add64(),
+ * read each counter once.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_sock_copy_stats (
+	const pgm_sock_t*   const restrict sock,
+	struct pgm_stats_t* const restrict stats
+	)
+{
+	const volatile uint64_t* counters = sock->cumulative_stats;
+
+	stats->data_bytes_sent			= pgm_atomic_read64 (&counters[PGM_PC_SOURCE_DATA_BYTES_SENT]);
+	stats->data_msgs_sent			= pgm_atomic_read64 (&counters[PGM_PC_SOURCE_DATA_MSGS_SENT]);
+	stats->bytes_sent			= pgm_atomic_read64 (&counters[PGM_PC_SOURCE_BYTES_SENT]);
+	stats->cksum_errors			= pgm_atomic_read64 (&counters[PGM_PC_SOURCE_CKSUM_ERRORS]);
+	stats->malformed_naks			= pgm_atomic_read64 (&counters[PGM_PC_SOURCE_MALFORMED_NAKS]);
+	stats->packets_discarded		= pgm_atomic_read64 (&counters[PGM_PC_SOURCE_PACKETS_DISCARDED]);
+	stats->selective_bytes_retransmitted	= pgm_atomic_read64 (&counters[PGM_PC_SOURCE_SELECTIVE_BYTES_RETRANSMITTED]);
+	stats->selective_msgs_retransmitted	= pgm_atomic_read64 (&counters[PGM_PC_SOURCE_SELECTIVE_MSGS_RETRANSMITTED]);
+	stats->parity_naks_received		= pgm_atomic_read64 (&counters[PGM_PC_SOURCE_PARITY_NAKS_RECEIVED]);
+	stats->selective_naks_received		= pgm_atomic_read64 (&counters[PGM_PC_SOURCE_SELECTIVE_NAKS_RECEIVED]);
+	stats->ack_packets_received		= pgm_atomic_read64 (&counters[PGM_PC_SOURCE_ACK_PACKETS_RECEIVED]);
+	stats->ack_errors			= pgm_atomic_read64 (&counters[PGM_PC_SOURCE_ACK_ERRORS]);
+	stats->selective_nnak_packets_received	= pgm_atomic_read64 (&counters[PGM_PC_SOURCE_SELECTIVE_NNAK_PACKETS_RECEIVED]);
+	stats->selective_nnaks_received		= pgm_atomic_read64 (&counters[PGM_PC_SOURCE_SELECTIVE_NNAKS_RECEIVED]);
+	stats->nnak_errors			= pgm_atomic_read64 (&counters[PGM_PC_SOURCE_NNAK_ERRORS]);
+}
+
+PGM_GNUC_INTERNAL
+void
+pgm_peer_copy_stats (
+	const pgm_peer_t*	     const restrict peer,
+	struct pgm_peer_stats_t* const restrict stats
+	)
+{
+	const volatile uint64_t* counters = peer->cumulative_stats;
+
+	memcpy (&stats->tsi, &peer->tsi, sizeof (pgm_tsi_t));
+	stats->data_bytes_received		= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_DATA_BYTES_RECEIVED]);
+	stats->data_msgs_received		= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_DATA_MSGS_RECEIVED]);
+	stats->bytes_received			= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_BYTES_RECEIVED]);
+	stats->malformed_spms			= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_MALFORMED_SPMS]);
+	stats->malformed_odata			= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_MALFORMED_ODATA]);
+	stats->malformed_ncfs			= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_MALFORMED_NCFS]);
+	stats->packets_discarded		= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_PACKETS_DISCARDED]);
+	stats->dup_spms				= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_DUP_SPMS]);
+	stats->dup_datas			= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_DUP_DATAS]);
+	stats->parity_nak_packets_sent		= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_PARITY_NAK_PACKETS_SENT]);
+	stats->selective_nak_packets_sent	= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_SELECTIVE_NAK_PACKETS_SENT]);
+	stats->parity_naks_sent			= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_PARITY_NAKS_SENT]);
+	stats->selective_naks_sent		= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_SELECTIVE_NAKS_SENT]);
+	stats->naks_failed_ncf_retries_exceeded	= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_NAKS_FAILED_NCF_RETRIES_EXCEEDED]);
+	stats->naks_failed_data_retries_exceeded = pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_NAKS_FAILED_DATA_RETRIES_EXCEEDED]);
+	stats->naks_failed_gen_expired		= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_NAKS_FAILED_GEN_EXPIRED]);
+	stats->selective_naks_suppressed	= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_SELECTIVE_NAKS_SUPPRESSED]);
+	stats->nak_errors			= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_NAK_ERRORS]);
+	stats->acks_sent			= pgm_atomic_read64 (&counters[PGM_PC_RECEIVER_ACKS_SENT]);
+}
+
 bool
 pgm_getsockopt (
 	pgm_sock_t* const restrict sock,
@@ -719,6 +819,92 @@ pgm_getsockopt (
 		status = TRUE;
 		break;
 
+/* aggregated event socket */
+	case PGM_EVENT_SOCK:
+		if (PGM_UNLIKELY(!sock->is_connected))
+			break;
+		if (PGM_UNLIKELY(*optlen != sizeof (SOCKET)))
+			break;
+		if (PGM_UNLIKELY(INVALID_SOCKET == sock->event_sock))
+			break;
+		*(SOCKET*restrict)optval = sock->event_sock;
+		status = TRUE;
+		break;
+
+/* rate limit socket, readable once a rate limited send can proceed */
+	case PGM_RATE_SOCK:
+		if (PGM_UNLIKELY(!sock->is_connected))
+			break;
+		if (PGM_UNLIKELY(*optlen != sizeof (SOCKET)))
+			break;
+		if (PGM_UNLIKELY(-1 == sock->rate_timer))
+			break;
+		*(SOCKET*restrict)optval = sock->rate_timer;
+		status = TRUE;
+		break;
+
+	case PGM_SINGLE_THREADED:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = sock->is_single_threaded ? 1 : 0;
+		status = TRUE;
+		break;
+
+/* counter snapshot, peers copied up to the caller's capacity */
+	case PGM_STATS:
+		if (PGM_UNLIKELY(*optlen != sizeof (struct pgm_stats_t)))
+			break;
+		{
+			struct pgm_stats_t* stats = optval;
+			if (PGM_UNLIKELY(PGM_STATS_VERSION != stats->version))
+				break;
+			if (PGM_UNLIKELY(stats->peers_len > 0 && NULL == stats->peers))
+				break;
+			pgm_sock_copy_stats (sock, stats);
+			stats->peer_count = 0;
+			pgm_sock_reader_lock (sock, &sock->peers_lock);
+			for (pgm_list_t* list = sock->peers_list; list; list = list->next) {
+				const pgm_peer_t* peer = list->data;
+				if (stats->peer_count < stats->peers_len)
+					pgm_peer_copy_stats (peer, &stats->peers[stats->peer_count]);
+				stats->peer_count++;
+			}
+			pgm_sock_reader_unlock (sock, &sock->peers_lock);
+		}
+		status = TRUE;
+		break;
+
+/* latency histograms of one peer, or with a null TSI the socket summed over
+ * current and expired peers.
+ */
+	case PGM_LATENCY:
+		if (PGM_UNLIKELY(*optlen != sizeof (struct pgm_latency_stats_t)))
+			break;
+		{
+			static const pgm_tsi_t null_tsi;
+			struct pgm_latency_stats_t* stats = optval;
+			if (PGM_UNLIKELY(PGM_LATENCY_VERSION != stats->version))
+				break;
+			pgm_sock_reader_lock (sock, &sock->peers_lock);
+			if (pgm_tsi_equal (&null_tsi, &stats->tsi)) {
+				memcpy (stats->latency, sock->latency, sizeof (sock->latency));
+				for (pgm_list_t* list = sock->peers_list; list; list = list->next) {
+					const pgm_peer_t* peer = list->data;
+					for (unsigned i = 0; i < PGM_LATENCY_MAX; i++)
+						pgm_latency_merge (&stats->latency[i], &peer->window->latency[i]);
+				}
+				status = TRUE;
+			} else if (NULL != sock->peers_hashtable) {
+				const pgm_peer_t* peer = pgm_hashtable_lookup (sock->peers_hashtable, &stats->tsi);
+				if (NULL != peer) {
+					memcpy (stats->latency, peer->window->latency, sizeof (stats->latency));
+					status = TRUE;
+				}
+			}
+			pgm_sock_reader_unlock (sock, &sock->peers_lock);
+		}
+		break;
+
 /* ACK or congestion socket */
 	case PGM_ACK_SOCK:
 		if (PGM_UNLIKELY(!sock->is_connected))
@@ -1041,6 +1227,118 @@ pgm_getsockopt (
 		status = TRUE;
 		break;
 
+	case PGM_RECV_BATCH:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = sock->rx_batch_size;
+		status = TRUE;
+		break;
+
+	case PGM_SEND_BATCH:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = sock->tx_batch_size;
+		status = TRUE;
+		break;
+
+	case PGM_UDP_GSO:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = sock->use_udp_gso;
+		status = TRUE;
+		break;
+
+	case PGM_UDP_GRO:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = sock->use_udp_gro;
+		status = TRUE;
+		break;
+
+	case PGM_ZEROCOPY:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = (int)sock->zerocopy_threshold;
+		status = TRUE;
+		break;
+
+	case PGM_RECV_TIMESTAMP:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = sock->use_kernel_tstamp;
+		status = TRUE;
+		break;
+
+	case PGM_RECV_LEASE:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = sock->use_recv_lease;
+		status = TRUE;
+		break;
+
+	case PGM_RECV_UNORDERED:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = sock->use_unordered_recv;
+		status = TRUE;
+		break;
+
+	case PGM_RECV_DEADLINE:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = (int)sock->recv_deadline;
+		status = TRUE;
+		break;
+
+	case PGM_RECV_QUANTUM:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = (int)sock->recv_quantum;
+		status = TRUE;
+		break;
+
+	case PGM_RECV_RECLAIM:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = (int)sock->reclaim_max;
+		status = TRUE;
+		break;
+
+	case PGM_LARGE_APDU:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = (int)sock->large_apdu;
+		status = TRUE;
+		break;
+
+	case PGM_RECV_REASSEMBLE:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = sock->use_recv_reassemble;
+		status = TRUE;
+		break;
+
+	case PGM_RECV_SPILL:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = (int)sock->spill_threshold;
+		status = TRUE;
+		break;
+
+	case PGM_TXW_HISTORY_SQNS:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = (int)sock->txw_history_sqns;
+		status = TRUE;
+		break;
+
+	case PGM_LATE_JOIN:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = (int)sock->late_join;
+		status = TRUE;
+		break;
+
 /** write-only options **/
 	case PGM_IP_ROUTER_ALERT:
 	case PGM_MULTICAST_LOOP:
@@ -1875,6 +2173,319 @@ pgm_setsockopt (
 		status = TRUE;
 		break;
 
+/* number of datagrams read per system call with recvmmsg(), 1 disables batching.
+ * 0 < batch <= UIO_MAXIOV, fixed at bind.
+ */
+	case PGM_RECV_BATCH:
+#ifdef HAVE_RECVMMSG
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval <= 0))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval > 1024))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		sock->rx_batch_size = *(const int*)optval;
+		status = TRUE;
+#endif
+		break;
+
+/* number of TPDUs of one APDU sent per system call with sendmmsg(), 1 disables
+ * batching.  segmentation offload takes precedence when enabled.
+ * 0 < batch <= PGM_UDP_MAX_SEGMENTS, fixed at bind.
+ */
+	case PGM_SEND_BATCH:
+#ifdef HAVE_SENDMMSG
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval <= 0))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval > PGM_UDP_MAX_SEGMENTS))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		sock->tx_batch_size = *(const int*)optval;
+		status = TRUE;
+#endif
+		break;
+
+/* send fragments of one APDU as UDP segmentation offload super-buffers,
+ * UDP encapsulation only.
+ */
+	case PGM_UDP_GSO:
+#ifdef HAVE_UDP_SEGMENT
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(IPPROTO_UDP != sock->protocol))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		sock->use_udp_gso = (0 != *(const int*)optval);
+		status = TRUE;
+#endif
+		break;
+
+/* read coalesced datagrams with one call and split into the receive batch,
+ * UDP encapsulation only.
+ */
+	case PGM_UDP_GRO:
+#if defined(HAVE_RECVMMSG) && defined(HAVE_UDP_GRO)
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(IPPROTO_UDP != sock->protocol))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		{
+			const bool v = (0 != *(const int*)optval);
+			if (SOCKET_ERROR == pgm_sockaddr_udp_gro (sock->recv_sock, v))
+				break;
+			sock->use_udp_gro = v;
+		}
+		status = TRUE;
+#endif
+		break;
+
+/* send fragmented APDUs with MSG_ZEROCOPY when a system call carries at
+ * least this many bytes, 0 disables.  pinning pages only pays off for large
+ * sends, such as segmentation offload super-buffers.
+ */
+	case PGM_ZEROCOPY:
+#ifdef HAVE_MSG_ZEROCOPY
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval < 0))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		sock->zerocopy_threshold = *(const int*)optval;
+		status = TRUE;
+#endif
+		break;
+
+/* take packet arrival time from kernel receive time stamps instead of reading
+ * the clock for every packet.
+ */
+	case PGM_RECV_TIMESTAMP:
+#if defined(HAVE_SO_TIMESTAMPNS) && defined(HAVE_GETTIMEOFDAY)
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		{
+			const bool v = (0 != *(const int*)optval);
+			if (SOCKET_ERROR == pgm_sockaddr_timestamp (sock->recv_sock, v))
+				break;
+			sock->use_kernel_tstamp = v;
+		}
+		status = TRUE;
+#endif
+		break;
+
+/* messages returned by pgm_recvmsgv() hold a reference on each skb until
+ * returned with pgm_msgv_release(), instead of until the next read.
+ */
+	case PGM_RECV_LEASE:
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		sock->use_recv_lease = (0 != *(const int*)optval);
+		status = TRUE;
+		break;
+
+/* deliver complete APDUs as they arrive instead of waiting on repairs of
+ * earlier sequences, every APDU is still delivered exactly once.
+ */
+	case PGM_RECV_UNORDERED:
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		sock->use_unordered_recv = (0 != *(const int*)optval);
+		status = TRUE;
+		break;
+
+/* maximum time a sequence is waited for before recovery is cancelled and
+ * the loss reported, in microseconds, zero to disable.
+ */
+	case PGM_RECV_DEADLINE:
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval < 0))
+			break;
+		sock->recv_deadline = *(const int*)optval;
+		status = TRUE;
+		break;
+
+/* maximum messages delivered from one peer before moving to the next
+ * pending peer, scaled by the peer weight, zero for unlimited.
+ */
+	case PGM_RECV_QUANTUM:
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval < 0 || *(const int*)optval > UINT16_MAX))
+			break;
+		sock->recv_quantum = *(const int*)optval;
+		status = TRUE;
+		break;
+
+/* weight of a source transport session in receive quantum multiples,
+ * applies to the current peer and any later one with the same TSI.
+ */
+	case PGM_PEER_WEIGHT:
+		if (PGM_UNLIKELY(optlen != sizeof (struct pgm_peerweight_t)))
+			break;
+		{
+			const struct pgm_peerweight_t* peerweight = optval;
+			struct pgm_peerweight_t* entry = NULL;
+			if (PGM_UNLIKELY(0 == peerweight->weight || peerweight->weight > UINT16_MAX))
+				break;
+			pgm_rwlock_writer_lock (&sock->peers_lock);
+			for (pgm_slist_t* it = sock->peer_weights; NULL != it; it = it->next)
+				if (pgm_tsi_equal (&((struct pgm_peerweight_t*)it->data)->tsi, &peerweight->tsi)) {
+					entry = it->data;
+					break;
+				}
+			if (NULL == entry) {
+				entry = pgm_new (struct pgm_peerweight_t, 1);
+				entry->tsi = peerweight->tsi;
+				sock->peer_weights = pgm_slist_append (sock->peer_weights, entry);
+			}
+			entry->weight = peerweight->weight;
+			if (sock->peers_hashtable) {
+				pgm_peer_t* peer = pgm_hashtable_lookup (sock->peers_hashtable, &peerweight->tsi);
+				if (peer)
+					peer->weight = peerweight->weight;
+			}
+			pgm_rwlock_writer_unlock (&sock->peers_lock);
+		}
+		status = TRUE;
+		break;
+
+/* defer release of receive buffers to idle time or pgm_reclaim(), releasing
+ * in line only when more than this many are pending, zero to disable.
+ */
+	case PGM_RECV_RECLAIM:
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval < 0))
+			break;
+		sock->reclaim_max = *(const int*)optval;
+		status = TRUE;
+		break;
+
+/* copy fragments into one contiguous buffer per APDU as they arrive, such
+ * that fragmented messages are delivered with a single skb.
+ */
+	case PGM_RECV_REASSEMBLE:
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		sock->use_recv_reassemble = (0 != *(const int*)optval);
+		status = TRUE;
+		break;
+
+/* bytes held by a peer receive window before complete APDUs are appended to
+ * an overflow log on disk, read back in order.  with a full message vector
+ * the socket continues reading into the windows to absorb bursts.
+ */
+	case PGM_RECV_SPILL:
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval < 0))
+			break;
+		sock->spill_threshold = *(const int*)optval;
+		status = TRUE;
+		break;
+
+/* sequence numbers retained for repair after leaving the transmit window, held
+ * in a memory-mapped file and advertised in the trailing edge.  selective
+ * NAKs only, parity is generated from the transmit window.
+ * 0 < txw_history_sqns < one less than half sequence space
+ */
+	case PGM_TXW_HISTORY_SQNS:
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval < 0))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval >= (int)((UINT32_MAX/2)-1)))
+			break;
+		sock->txw_history_sqns = *(const int*)optval;
+		status = TRUE;
+		break;
+
+/* late join, a source advertises up to late_join sequences of retained data
+ * with OPT_JOIN in SPMs, a receiver starts from the advertised point and
+ * recovers the backlog with NAKs, bounded by late_join and the receive window.
+ * 0 < late_join < one less than half sequence space
+ */
+	case PGM_LATE_JOIN:
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval < 0))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval >= (int)((UINT32_MAX/2)-1)))
+			break;
+		sock->late_join = *(const int*)optval;
+		status = TRUE;
+		break;
+
+/* expose one pollable socket per PGM socket, an epoll set of the receive
+ * socket and notification channels with a timer following the next timer
+ * expiration and rate limited sends.  readable when pgm_recvmsgv() or a
+ * blocked send should be called, no timeout is needed from PGM_TIME_REMAIN
+ * or PGM_RATE_REMAIN.
+ */
+	case PGM_EVENT_SOCK:
+#ifdef HAVE_TIMERFD_CREATE
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		sock->use_event_sock = (0 != *(const int*)optval);
+		status = TRUE;
+#endif
+		break;
+
+/* socket used by one thread only from bind to close, including the release of
+ * leased messages, elides socket locks and atomic skb reference counts on the
+ * send, receive and timer paths.
+ */
+	case PGM_SINGLE_THREADED:
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		sock->is_single_threaded = (0 != *(const int*)optval);
+		status = TRUE;
+		break;
+
+/* maximum APDU length beyond the PGM_MAX_APDU and PGM_MAX_FRAGMENTS defaults,
+ * limited by the transmit and receive windows.  APDUs of more than
+ * PGM_MAX_FRAGMENTS TPDUs are delivered over consecutive messages.
+ */
+	case PGM_LARGE_APDU:
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval < 0))
+			break;
+		sock->large_apdu = *(const int*)optval;
+		status = TRUE;
+		break;
+
 /** read-only options **/
 	case PGM_MSSS:
 	case PGM_MSS:
@@ -2129,6 +2740,34 @@ pgm_bind3 (
 		pgm_rwlock_writer_unlock (&sock->lock);
 		return FALSE;
 	}
+#ifdef HAVE_TIMERFD_CREATE
+	if (sock->use_event_sock &&
+	    !pgm_timer_event_create (sock))
+	{
+		const int save_errno = pgm_get_last_sock_error();
+		char errbuf[1024];
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       pgm_error_from_sock_errno (save_errno),
+			       _("Creating event socket: %s"),
+			       pgm_sock_strerror_s (errbuf, sizeof (errbuf), save_errno));
+		pgm_rwlock_writer_unlock (&sock->lock);
+		return FALSE;
+	}
+	if (sock->can_send_data &&
+	    !pgm_timer_rate_create (sock))
+	{
+		const int save_errno = pgm_get_last_sock_error();
+		char errbuf[1024];
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       pgm_error_from_sock_errno (save_errno),
+			       _("Creating rate limit timer: %s"),
+			       pgm_sock_strerror_s (errbuf, sizeof (errbuf), save_errno));
+		pgm_rwlock_writer_unlock (&sock->lock);
+		return FALSE;
+	}
+#endif
 
 /* determine IP header size for rate regulation engine & stats */
 	sock->iphdr_len = (AF_INET == sock->family) ? sizeof(struct pgm_ip) : sizeof(struct pgm_ip6_hdr);
@@ -2143,8 +2782,14 @@ pgm_bind3 (
 	const sa_family_t pgmcc_family = sock->use_pgmcc ? sock->family : 0;
 	sock->max_tsdu = (uint16_t)(sock->max_tpdu - sock->iphdr_len - pgm_pkt_offset (FALSE, pgmcc_family));
 	sock->max_tsdu_fragment = (uint16_t)(sock->max_tpdu - sock->iphdr_len - pgm_pkt_offset (TRUE, pgmcc_family));
-	const unsigned max_fragments = sock->txw_sqns ? MIN( PGM_MAX_FRAGMENTS, sock->txw_sqns ) : PGM_MAX_FRAGMENTS;
-	sock->max_apdu = MIN( PGM_MAX_APDU, max_fragments * sock->max_tsdu_fragment );
+	if (sock->large_apdu) {
+/* APDU limited by the transmit window for repairs */
+		const size_t max_fragments = sock->txw_sqns ? sock->txw_sqns : (size_t)( (sock->txw_secs * sock->txw_max_rte) / sock->max_tpdu );
+		sock->max_apdu = MIN( sock->large_apdu, max_fragments * sock->max_tsdu_fragment );
+	} else {
+		const unsigned max_fragments = sock->txw_sqns ? MIN( PGM_MAX_FRAGMENTS, sock->txw_sqns ) : PGM_MAX_FRAGMENTS;
+		sock->max_apdu = MIN( PGM_MAX_APDU, max_fragments * sock->max_tsdu_fragment );
+	}
 
 	if (sock->can_send_data)
 	{
@@ -2167,6 +2812,19 @@ pgm_bind3 (
 							sock->rs_n,
 							sock->rs_k);
 		pgm_assert (NULL != sock->window);
+		if (sock->txw_history_sqns &&
+		    !pgm_txw_history_create (sock->window, sock->max_tpdu, sock->txw_history_sqns))
+		{
+			const int save_errno = errno;
+			char errbuf[1024];
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_SOCKET,
+				       pgm_error_from_errno (save_errno),
+				       _("Creating transmit window history: %s"),
+				       pgm_strerror_s (errbuf, sizeof (errbuf), save_errno));
+			pgm_rwlock_writer_unlock (&sock->lock);
+			return FALSE;
+		}
 	}
 
 /* create peer list */
@@ -2385,10 +3043,76 @@ pgm_bind3 (
 			pgm_rate_create (&sock->rdata_rate_control, sock->rdata_max_rte, sock->iphdr_len, sock->max_tpdu);
 			sock->is_controlled_rdata = TRUE;
 		}
+#if defined( HAVE_UDP_SEGMENT ) || defined( HAVE_SENDMMSG )
+/* one call is bounded by the transmit window, and depth of each rate bucket
+ * such that non-blocking rate checks can pass.
+ */
+		size_t batch_limit = MIN( PGM_UDP_MAX_SEGMENTS, pgm_txw_max_length (sock->window) );
+		if (sock->txw_max_rte > 0) {
+			const ssize_t depth = sock->rate_control.rate_per_msec ? sock->rate_control.rate_per_msec : sock->rate_control.rate_per_sec;
+			batch_limit = MIN( batch_limit, (size_t)depth / sock->max_tpdu );
+		}
+		if (sock->odata_max_rte > 0) {
+			const ssize_t depth = sock->odata_rate_control.rate_per_msec ? sock->odata_rate_control.rate_per_msec : sock->odata_rate_control.rate_per_sec;
+			batch_limit = MIN( batch_limit, (size_t)depth / sock->max_tpdu );
+		}
+#endif
+#ifdef HAVE_UDP_SEGMENT
+/* super-buffer is further bounded by maximum IP datagram */
+		if (sock->use_udp_gso) {
+			const size_t tpdu_length = sock->max_tpdu - sock->iphdr_len;
+			const size_t segments = MIN( batch_limit, (UINT16_MAX - sock->iphdr_len) / tpdu_length );
+			if (segments > 1) {
+				pgm_trace (PGM_LOG_ROLE_NETWORK,_("Segmentation offload of up to %u TPDUs per call."),
+						(unsigned)segments);
+				sock->udp_gso_segments = (unsigned)segments;
+			} else {
+				pgm_trace (PGM_LOG_ROLE_NETWORK,_("Segmentation offload disabled as rate regulation permits one TPDU per call."));
+				sock->use_udp_gso = FALSE;
+			}
+		}
+#endif
+#ifdef HAVE_SENDMMSG
+		if (sock->use_udp_gso) {
+			sock->tx_batch_size = 0;
+		} else if (sock->tx_batch_size > 1) {
+			sock->tx_batch_size = (unsigned)MIN( sock->tx_batch_size, batch_limit );
+			if (sock->tx_batch_size > 1) {
+				pgm_trace (PGM_LOG_ROLE_NETWORK,_("Batching send of up to %u TPDUs per call."),
+						sock->tx_batch_size);
+			} else {
+				pgm_trace (PGM_LOG_ROLE_NETWORK,_("Send batching disabled as rate regulation permits one TPDU per call."));
+				sock->tx_batch_size = 0;
+			}
+		}
+#endif
+#ifdef HAVE_MSG_ZEROCOPY
+		if (sock->zerocopy_threshold > 0) {
+			if (pgm_zerocopy_create (sock)) {
+				pgm_trace (PGM_LOG_ROLE_NETWORK,_("Zero-copy transmit of sends of %" PRIzu " bytes or more."),
+						sock->zerocopy_threshold);
+			} else {
+				pgm_trace (PGM_LOG_ROLE_NETWORK,_("Zero-copy transmit unsupported by send socket."));
+				sock->zerocopy_threshold = 0;
+			}
+		}
+#endif
 	}
 
 /* allocate first incoming packet buffer */
-	sock->rx_buffer = pgm_alloc_skb (sock->max_tpdu);
+	sock->rx_buffer = pgm_sock_alloc_skb (sock, sock->max_tpdu);
+#ifdef HAVE_RECVMMSG
+#	ifdef HAVE_UDP_GRO
+/* one skb per coalesced segment */
+	if (sock->use_udp_gro && sock->rx_batch_size < PGM_UDP_MAX_SEGMENTS)
+		sock->rx_batch_size = PGM_UDP_MAX_SEGMENTS;
+#	endif
+	if (sock->rx_batch_size > 1) {
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Batching receive of up to %u datagrams per call."),
+				sock->rx_batch_size);
+		pgm_rx_batch_create (sock);
+	}
+#endif
 
 /* bind complete */
 	sock->is_bound = TRUE;
@@ -2464,6 +3188,7 @@ pgm_connect (
 		sock->next_poll = pgm_time_update_now() + pgm_secs( 30 );
 	}
 
+	pgm_timer_arm_event (sock, 0);
 	sock->is_connected = TRUE;
 
 /* cleanup */
@@ -2521,6 +3246,7 @@ pgm_select_info (
 	}
 
 	const bool is_congested = (sock->use_pgmcc && sock->tokens < pgm_fp8 (1)) ? TRUE : FALSE;
+	const bool is_rate_limited = sock->can_send_data && pgm_timer_is_rate_limited (sock);
 
 	if (readfds)
 	{
@@ -2547,6 +3273,12 @@ pgm_select_info (
 				fds++;
 #endif
 			}
+#ifdef HAVE_TIMERFD_CREATE
+			if (is_rate_limited) {
+				FD_SET(sock->rate_timer, readfds);
+				fds = MAX(fds, sock->rate_timer + 1);
+			}
+#endif
 		}
 		const SOCKET pending_fd = pgm_notify_get_socket (&sock->pending_notify);
 		FD_SET(pending_fd, readfds);
@@ -2557,7 +3289,7 @@ pgm_select_info (
 #endif
 	}
 
-	if (sock->can_send_data && writefds && !is_congested)
+	if (sock->can_send_data && writefds && !is_congested && !is_rate_limited)
 	{
 		FD_SET(sock->send_sock, writefds);
 #ifndef _WIN32
@@ -2651,6 +3383,12 @@ pgm_wsapoll_info (
 /* rx thread poll for ACK */
 			fds[nfds].fd = pgm_notify_get_socket (&sock->ack_notify);
 			fds[nfds].events = PGM_POLLIN;
+#ifdef HAVE_TIMERFD_CREATE
+		} else if (pgm_timer_is_rate_limited (sock)) {
+/* rate limit credit for the blocked send */
+			fds[nfds].fd = sock->rate_timer;
+			fds[nfds].events = PGM_POLLIN;
+#endif
 		} else {
 /* kernel resource poll */
 			fds[nfds].fd = sock->send_sock;
@@ -2740,9 +3478,24 @@ pgm_epoll_ctl (
 		{
 /* kernel resource poll */
 			event.events = events & (EPOLLOUT | EPOLLET | EPOLLONESHOT);
+/* rate limited send waits on the rate timer instead */
+			if (EPOLL_CTL_MOD == op && pgm_timer_is_rate_limited (sock))
+				event.events &= ~EPOLLOUT;
 			event.data.ptr = sock;
 			retval = epoll_ctl (epfd, op, sock->send_sock, &event);
+			if (retval)
+				goto out;
 		}
+
+#ifdef HAVE_TIMERFD_CREATE
+/* edge-triggered, the timer remains readable after firing */
+		if (-1 != sock->rate_timer)
+		{
+			event.events = EPOLLIN | EPOLLET | (events & EPOLLONESHOT);
+			event.data.ptr = sock;
+			retval = epoll_ctl (epfd, op, sock->rate_timer, &event);
+		}
+#endif
 	}
 out:
 	return retval;
@@ -0,0 +1,335 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * performance tests for PGM socket lock elision and cache line layout
+ *
+ * Copyright (c) 2010-2016 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <check.h>
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+#include <impl/framework.h>
+#include <impl/mem.h>
+#include <impl/socket.h>
+#include <impl/timer.h>
+
+
+/* mock state */
+
+static const unsigned perf_iterations = 1000000;
+static bool perf_single_threaded = FALSE;
+static pgm_sock_t* perf_sock = NULL;
+
+
+/* mock functions for external references */
+
+PGM_GNUC_INTERNAL
+int
+pgm_get_nprocs (void)
+{
+	return 1;
+}
+
+static
+void
+mock_setup (void)
+{
+	g_assert (pgm_time_init (NULL));
+	perf_sock = pgm_malloc0_aligned (sizeof (pgm_sock_t), PGM_CACHELINE_SIZE);
+	perf_sock->can_send_data = TRUE;
+	perf_sock->is_single_threaded = perf_single_threaded;
+	pgm_rwlock_init (&perf_sock->lock);
+	pgm_rwlock_init (&perf_sock->peers_lock);
+	pgm_mutex_init (&perf_sock->receiver_mutex);
+	pgm_mutex_init (&perf_sock->source_mutex);
+	pgm_spinlock_init (&perf_sock->txw_spinlock);
+	pgm_mutex_init (&perf_sock->send_mutex);
+	pgm_mutex_init (&perf_sock->timer_mutex);
+}
+
+static
+void
+mock_setup_locked (void)
+{
+	perf_single_threaded = FALSE;
+	mock_setup ();
+}
+
+static
+void
+mock_setup_single_threaded (void)
+{
+	perf_single_threaded = TRUE;
+	mock_setup ();
+}
+
+static
+void
+mock_teardown (void)
+{
+	pgm_mutex_free (&perf_sock->timer_mutex);
+	pgm_mutex_free (&perf_sock->send_mutex);
+	pgm_spinlock_free (&perf_sock->txw_spinlock);
+	pgm_mutex_free (&perf_sock->source_mutex);
+	pgm_mutex_free (&perf_sock->receiver_mutex);
+	pgm_rwlock_free (&perf_sock->peers_lock);
+	pgm_rwlock_free (&perf_sock->lock);
+	pgm_free_aligned (perf_sock);
+	perf_sock = NULL;
+	g_assert (pgm_time_shutdown ());
+}
+
+static
+void
+report (
+	const char*		name,
+	const pgm_time_t	start,
+	const pgm_time_t	check
+	)
+{
+	g_message ("%s/%s: elapsed time %" PGM_TIME_FORMAT " us, unit time %.1f ns",
+		name,
+		perf_single_threaded ? "single-threaded" : "locked",
+		(guint64)(check - start),
+		(double)(check - start) * 1000.0 / perf_iterations);
+}
+
+/* locks taken by pgm_send() for one packet: socket, source API, transmit
+ * window, send socket, and timer for the heartbeat SPM.
+ */
+
+START_TEST (test_send)
+{
+	pgm_sock_t* sock = perf_sock;
+	pgm_time_t start, check;
+
+	start = pgm_time_update_now();
+	for (unsigned i = perf_iterations; i; i--) {
+		fail_unless (pgm_sock_reader_trylock (sock, &sock->lock), "trylock failed");
+		pgm_sock_mutex_lock (sock, &sock->source_mutex);
+		pgm_sock_spinlock_lock (sock, &sock->txw_spinlock);
+		pgm_sock_spinlock_unlock (sock, &sock->txw_spinlock);
+		pgm_sock_mutex_lock (sock, &sock->send_mutex);
+		pgm_sock_mutex_unlock (sock, &sock->send_mutex);
+		pgm_timer_lock (sock);
+		pgm_timer_unlock (sock);
+		pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+		pgm_sock_reader_unlock (sock, &sock->lock);
+	}
+	check = pgm_time_update_now();
+	report ("send", start, check);
+}
+END_TEST
+
+/* locks taken by pgm_recvmsgv() for one call: socket, receiver API, peer
+ * list, and timer for the next expiration.
+ */
+
+START_TEST (test_recv)
+{
+	pgm_sock_t* sock = perf_sock;
+	pgm_time_t start, check;
+
+	start = pgm_time_update_now();
+	for (unsigned i = perf_iterations; i; i--) {
+		fail_unless (pgm_sock_reader_trylock (sock, &sock->lock), "trylock failed");
+		pgm_sock_mutex_lock (sock, &sock->receiver_mutex);
+		pgm_sock_reader_lock (sock, &sock->peers_lock);
+		pgm_sock_reader_unlock (sock, &sock->peers_lock);
+		pgm_timer_lock (sock);
+		pgm_timer_unlock (sock);
+		pgm_sock_mutex_unlock (sock, &sock->receiver_mutex);
+		pgm_sock_reader_unlock (sock, &sock->lock);
+	}
+	check = pgm_time_update_now();
+	report ("recv", start, check);
+}
+END_TEST
+
+/* skb references for one packet: held by the window and the application.
+ */
+
+START_TEST (test_skb)
+{
+	pgm_sock_t* sock = perf_sock;
+	struct pgm_sk_buff_t* skb = pgm_sock_alloc_skb (sock, 1500);
+	pgm_time_t start, check;
+
+	start = pgm_time_update_now();
+	for (unsigned i = perf_iterations; i; i--) {
+		pgm_skb_get (skb);
+		pgm_skb_get (skb);
+		pgm_free_skb (skb);
+		pgm_free_skb (skb);
+	}
+	check = pgm_time_update_now();
+	fail_unless (1 == skb->users, "reference count mismatch %u", skb->users);
+	pgm_free_skb (skb);
+	report ("skb", start, check);
+}
+END_TEST
+
+/* cache line of a socket member */
+#define CACHELINE_OF(m)		(offsetof (pgm_sock_t, m) / PGM_CACHELINE_SIZE)
+
+/* state written per packet by the sending thread must not share a line with
+ * state written per packet by the receiving thread.
+ */
+
+START_TEST (test_layout)
+{
+	fail_unless (0 == (uintptr_t)perf_sock % PGM_CACHELINE_SIZE, "socket not aligned");
+	fail_unless (CACHELINE_OF(lock) > CACHELINE_OF(rate_timer), "shared state overlaps configuration");
+	fail_unless (CACHELINE_OF(source_mutex) > CACHELINE_OF(txw_spinlock), "sender overlaps shared state");
+	fail_unless (CACHELINE_OF(receiver_mutex) > CACHELINE_OF(ack_notify), "receiver overlaps sender");
+	fail_unless (CACHELINE_OF(cumulative_stats) > CACHELINE_OF(rdata_notify), "counters overlap receiver");
+	g_message ("pgm_sock_t: %" PRIzu " bytes, %" PRIzu " cache lines, sender @%" PRIzu ", receiver @%" PRIzu ", counters @%" PRIzu,
+		sizeof (pgm_sock_t),
+		sizeof (pgm_sock_t) / PGM_CACHELINE_SIZE,
+		CACHELINE_OF(source_mutex),
+		CACHELINE_OF(receiver_mutex),
+		CACHELINE_OF(cumulative_stats));
+}
+END_TEST
+
+/* two threads each incrementing one member, as the send and receive paths do
+ * for window state per packet.
+ */
+
+static
+void*
+writer_routine (
+	void*		arg
+	)
+{
+	volatile uint32_t* value = arg;
+	for (unsigned i = perf_iterations * 10; i; i--)
+		(*value)++;
+	return NULL;
+}
+
+static
+void
+contend (
+	const char*		name,
+	volatile uint32_t*	value1,
+	volatile uint32_t*	value2
+	)
+{
+	pthread_t thread1, thread2;
+	pgm_time_t start, check;
+
+	start = pgm_time_update_now();
+	fail_unless (0 == pthread_create (&thread1, NULL, writer_routine, (void*)value1), "pthread_create failed");
+	fail_unless (0 == pthread_create (&thread2, NULL, writer_routine, (void*)value2), "pthread_create failed");
+	pthread_join (thread1, NULL);
+	pthread_join (thread2, NULL);
+	check = pgm_time_update_now();
+	g_message ("%s: elapsed time %" PGM_TIME_FORMAT " us, unit time %.1f ns",
+		name,
+		(guint64)(check - start),
+		(double)(check - start) * 100.0 / perf_iterations);
+}
+
+/* sender sequence state against receiver commit state */
+
+START_TEST (test_split)
+{
+	contend ("split", (volatile uint32_t*)&perf_sock->pkt_dontwait_state.first_sqn, (volatile uint32_t*)&perf_sock->last_commit);
+}
+END_TEST
+
+/* control: both writers within the sender line */
+
+START_TEST (test_shared)
+{
+	contend ("shared", (volatile uint32_t*)&perf_sock->pkt_dontwait_state.first_sqn, (volatile uint32_t*)&perf_sock->pkt_dontwait_state.unfolded_odata);
+}
+END_TEST
+
+
+static
+Suite*
+make_lock_performance_suite (void)
+{
+	Suite* s;
+
+	s = suite_create ("Socket lock performance");
+
+	TCase* tc_locked = tcase_create ("locked");
+	suite_add_tcase (s, tc_locked);
+	tcase_add_checked_fixture (tc_locked, mock_setup_locked, mock_teardown);
+	tcase_add_test (tc_locked, test_send);
+	tcase_add_test (tc_locked, test_recv);
+	tcase_add_test (tc_locked, test_skb);
+
+	TCase* tc_single = tcase_create ("single-threaded");
+	suite_add_tcase (s, tc_single);
+	tcase_add_checked_fixture (tc_single, mock_setup_single_threaded, mock_teardown);
+	tcase_add_test (tc_single, test_send);
+	tcase_add_test (tc_single, test_recv);
+	tcase_add_test (tc_single, test_skb);
+	return s;
+}
+
+static
+Suite*
+make_layout_performance_suite (void)
+{
+	Suite* s;
+
+	s = suite_create ("Socket layout performance");
+
+	TCase* tc_layout = tcase_create ("false sharing");
+	suite_add_tcase (s, tc_layout);
+	tcase_add_checked_fixture (tc_layout, mock_setup_locked, mock_teardown);
+	tcase_add_test (tc_layout, test_layout);
+	tcase_add_test (tc_layout, test_split);
+	tcase_add_test (tc_layout, test_shared);
+	return s;
+}
+
+static
+Suite*
+make_master_suite (void)
+{
+	Suite* s = suite_create ("Master");
+	return s;
+}
+
+int
+main (void)
+{
+	SRunner* sr = srunner_create (make_master_suite ());
+	srunner_add_suite (sr, make_lock_performance_suite ());
+	srunner_add_suite (sr, make_layout_performance_suite ());
+	srunner_run_all (sr, CK_ENV);
+	int number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
@@ -62,14 +62,25 @@
 #define pgm_timer_check		mock_pgm_timer_check
 #define pgm_timer_expiration	mock_pgm_timer_expiration
 #define pgm_timer_dispatch	mock_pgm_timer_dispatch
+#define pgm_timer_event_create	mock_pgm_timer_event_create
+#define pgm_timer_event_destroy	mock_pgm_timer_event_destroy
+#define pgm_timer_arm		mock_pgm_timer_arm
+#define pgm_timer_rate_create	mock_pgm_timer_rate_create
+#define pgm_timer_rate_destroy	mock_pgm_timer_rate_destroy
+#define pgm_timer_arm_rate	mock_pgm_timer_arm_rate
 #define pgm_txw_create		mock_pgm_txw_create
 #define pgm_txw_shutdown	mock_pgm_txw_shutdown
+#define pgm_rxw_reclaim		mock_pgm_rxw_reclaim
 #define pgm_rate_create		mock_pgm_rate_create
 #define pgm_rate_destroy	mock_pgm_rate_destroy
 #define pgm_rate_remaining	mock_pgm_rate_remaining
 #define pgm_rs_create		mock_pgm_rs_create
 #define pgm_rs_destroy		mock_pgm_rs_destroy
 #define pgm_time_update_now	mock_pgm_time_update_now
+#define pgm_rx_batch_create	mock_pgm_rx_batch_create
+#define pgm_rx_batch_destroy	mock_pgm_rx_batch_destroy
+#define pgm_zerocopy_create	mock_pgm_zerocopy_create
+#define pgm_zerocopy_destroy	mock_pgm_zerocopy_destroy
 
 #define SOCK_DEBUG
 #include "socket.c"
@@ -187,6 +198,7 @@ generate_sock (void)
 	sock->iphdr_len = sizeof(struct pgm_ip);
 	pgm_spinlock_init (&sock->txw_spinlock);
 	pgm_rwlock_init (&sock->lock);
+	pgm_rwlock_init (&sock->peers_lock);
 	return sock;
 }
 
@@ -199,6 +211,16 @@ mock_pgm_peer_unref (
 {
 }
 
+/** receive window module */
+PGM_GNUC_INTERNAL
+unsigned
+mock_pgm_rxw_reclaim (
+	pgm_rxw_reclaim_t* const	reclaim
+	)
+{
+	return 0;
+}
+
 /** source module */
 static
 bool
@@ -258,6 +280,60 @@ mock_pgm_timer_dispatch (
 	return TRUE;
 }
 
+#ifdef HAVE_TIMERFD_CREATE
+PGM_GNUC_INTERNAL
+bool
+mock_pgm_timer_event_create (
+	pgm_sock_t* const		sock
+	)
+{
+	return TRUE;
+}
+
+PGM_GNUC_INTERNAL
+void
+mock_pgm_timer_event_destroy (
+	pgm_sock_t* const		sock
+	)
+{
+}
+
+PGM_GNUC_INTERNAL
+void
+mock_pgm_timer_arm (
+	pgm_sock_t* const		sock,
+	const pgm_time_t		rate_expiry
+	)
+{
+}
+
+PGM_GNUC_INTERNAL
+bool
+mock_pgm_timer_rate_create (
+	pgm_sock_t* const		sock
+	)
+{
+	return TRUE;
+}
+
+PGM_GNUC_INTERNAL
+void
+mock_pgm_timer_rate_destroy (
+	pgm_sock_t* const		sock
+	)
+{
+}
+
+PGM_GNUC_INTERNAL
+void
+mock_pgm_timer_arm_rate (
+	pgm_sock_t* const		sock,
+	const pgm_time_t		send_expiry
+	)
+{
+}
+#endif
+
 /** transmit window module */
 pgm_txw_t*
 mock_pgm_txw_create (
@@ -330,6 +406,45 @@ mock_pgm_rs_destroy (
 {
 }
 
+/** recv module */
+PGM_GNUC_INTERNAL
+void
+mock_pgm_rx_batch_create (
+	pgm_sock_t* const	sock
+	)
+{
+}
+
+PGM_GNUC_INTERNAL
+void
+mock_pgm_rx_batch_destroy (
+	pgm_sock_t* const	sock
+	)
+{
+	sock->rx_batch = NULL;
+}
+
+/** net module */
+#ifdef HAVE_MSG_ZEROCOPY
+PGM_GNUC_INTERNAL
+bool
+mock_pgm_zerocopy_create (
+	pgm_sock_t* const	sock
+	)
+{
+	return FALSE;
+}
+
+PGM_GNUC_INTERNAL
+void
+mock_pgm_zerocopy_destroy (
+	pgm_sock_t* const	sock
+	)
+{
+	sock->zerocopy = NULL;
+}
+#endif
+
 /** time module */
 static pgm_time_t _mock_pgm_time_update_now (void);
 pgm_time_update_func mock_pgm_time_update_now = _mock_pgm_time_update_now;
@@ -1154,6 +1269,163 @@ START_TEST (test_set_udp_multicast_fail_001)
 }
 END_TEST
 
+/* target:
+ *	bool
+ *	pgm_setsockopt (
+ *		pgm_sock_t* const	sock,
+ *		const int		level = IPPROTO_PGM,
+ *		const int		optname = PGM_RECV_QUANTUM,
+ *		const void*		optval,
+ *		const socklen_t		optlen = sizeof(int)
+ *	)
+ */
+
+START_TEST (test_set_recv_quantum_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	const int level		= IPPROTO_PGM;
+	const int optname	= PGM_RECV_QUANTUM;
+	const int recv_quantum	= UINT16_MAX;
+	const void* optval	= &recv_quantum;
+	const socklen_t optlen	= sizeof(recv_quantum);
+	fail_unless (TRUE == pgm_setsockopt (sock, level, optname, optval, optlen), "set_recv_quantum failed");
+	fail_unless (UINT16_MAX == sock->recv_quantum, "recv_quantum mismatch");
+}
+END_TEST
+
+/* beyond 16 bits the quantum scaled by a peer weight overflows */
+START_TEST (test_set_recv_quantum_fail_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	const int level		= IPPROTO_PGM;
+	const int optname	= PGM_RECV_QUANTUM;
+	int recv_quantum	= UINT16_MAX + 1;
+	const void* optval	= &recv_quantum;
+	const socklen_t optlen	= sizeof(recv_quantum);
+	fail_unless (FALSE == pgm_setsockopt (sock, level, optname, optval, optlen), "set_recv_quantum failed");
+	recv_quantum = -1;
+	fail_unless (FALSE == pgm_setsockopt (sock, level, optname, optval, optlen), "set_recv_quantum failed");
+	fail_unless (0 == sock->recv_quantum, "recv_quantum mismatch");
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_setsockopt (
+ *		pgm_sock_t* const	sock,
+ *		const int		level = IPPROTO_PGM,
+ *		const int		optname = PGM_PEER_WEIGHT,
+ *		const void*		optval,
+ *		const socklen_t		optlen = sizeof(struct pgm_peerweight_t)
+ *	)
+ */
+
+START_TEST (test_set_peer_weight_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	const int level		= IPPROTO_PGM;
+	const int optname	= PGM_PEER_WEIGHT;
+	const pgm_tsi_t tsi	= { { 9, 8, 7, 6, 5, 4 }, g_htons(1000) };
+	struct pgm_peerweight_t peerweight = { .tsi = tsi, .weight = 4 };
+	const void* optval	= &peerweight;
+	const socklen_t optlen	= sizeof(peerweight);
+	fail_unless (TRUE == pgm_setsockopt (sock, level, optname, optval, optlen), "set_peer_weight failed");
+	fail_unless (1 == pgm_slist_length (sock->peer_weights), "peer_weights length mismatch");
+	fail_unless (4 == ((struct pgm_peerweight_t*)sock->peer_weights->data)->weight, "weight mismatch");
+/* same TSI replaces the weight */
+	peerweight.weight = UINT16_MAX;
+	fail_unless (TRUE == pgm_setsockopt (sock, level, optname, optval, optlen), "set_peer_weight failed");
+	fail_unless (1 == pgm_slist_length (sock->peer_weights), "peer_weights length mismatch");
+	fail_unless (UINT16_MAX == ((struct pgm_peerweight_t*)sock->peer_weights->data)->weight, "weight mismatch");
+/* another TSI */
+	peerweight.tsi.sport = g_htons(1001);
+	fail_unless (TRUE == pgm_setsockopt (sock, level, optname, optval, optlen), "set_peer_weight failed");
+	fail_unless (2 == pgm_slist_length (sock->peer_weights), "peer_weights length mismatch");
+}
+END_TEST
+
+/* zero weight, weight beyond 16 bits, or short option */
+START_TEST (test_set_peer_weight_fail_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	const int level		= IPPROTO_PGM;
+	const int optname	= PGM_PEER_WEIGHT;
+	const pgm_tsi_t tsi	= { { 9, 8, 7, 6, 5, 4 }, g_htons(1000) };
+	struct pgm_peerweight_t peerweight = { .tsi = tsi, .weight = 0 };
+	const void* optval	= &peerweight;
+	const socklen_t optlen	= sizeof(peerweight);
+	fail_unless (FALSE == pgm_setsockopt (sock, level, optname, optval, optlen), "set_peer_weight failed");
+	peerweight.weight = UINT16_MAX + 1;
+	fail_unless (FALSE == pgm_setsockopt (sock, level, optname, optval, optlen), "set_peer_weight failed");
+	peerweight.weight = 1;
+	fail_unless (FALSE == pgm_setsockopt (sock, level, optname, optval, optlen - 1), "set_peer_weight failed");
+	fail_unless (NULL == sock->peer_weights, "peer_weights not empty");
+}
+END_TEST
+
+START_TEST (test_set_peer_weight_fail_002)
+{
+	const int level		= IPPROTO_PGM;
+	const int optname	= PGM_PEER_WEIGHT;
+	const pgm_tsi_t tsi	= { { 9, 8, 7, 6, 5, 4 }, g_htons(1000) };
+	const struct pgm_peerweight_t peerweight = { .tsi = tsi, .weight = 1 };
+	const void* optval	= &peerweight;
+	const socklen_t optlen	= sizeof(peerweight);
+	fail_unless (FALSE == pgm_setsockopt (NULL, level, optname, optval, optlen), "set_peer_weight failed");
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_setsockopt (
+ *		pgm_sock_t* const	sock,
+ *		const int		level = IPPROTO_PGM,
+ *		const int		optname = PGM_SEND_BATCH,
+ *		const void*		optval,
+ *		const socklen_t		optlen = sizeof(int)
+ *	)
+ */
+
+#ifdef HAVE_SENDMMSG
+START_TEST (test_set_send_batch_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	const int level		= IPPROTO_PGM;
+	const int optname	= PGM_SEND_BATCH;
+	const int batch_size	= 8;
+	const void* optval	= &batch_size;
+	const socklen_t optlen	= sizeof(batch_size);
+	fail_unless (TRUE == pgm_setsockopt (sock, level, optname, optval, optlen), "set_send_batch failed");
+	fail_unless (8 == sock->tx_batch_size, "tx_batch_size mismatch");
+}
+END_TEST
+
+/* batch is bounded by the transmit vector */
+START_TEST (test_set_send_batch_fail_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	const int level		= IPPROTO_PGM;
+	const int optname	= PGM_SEND_BATCH;
+	int batch_size		= PGM_UDP_MAX_SEGMENTS + 1;
+	const void* optval	= &batch_size;
+	const socklen_t optlen	= sizeof(batch_size);
+	fail_unless (FALSE == pgm_setsockopt (sock, level, optname, optval, optlen), "set_send_batch failed");
+	batch_size = 0;
+	fail_unless (FALSE == pgm_setsockopt (sock, level, optname, optval, optlen), "set_send_batch failed");
+	batch_size = 8;
+	fail_unless (FALSE == pgm_setsockopt (sock, level, optname, optval, optlen - 1), "set_send_batch failed");
+	fail_unless (FALSE == pgm_setsockopt (NULL, level, optname, optval, optlen), "set_send_batch failed");
+	fail_unless (0 == sock->tx_batch_size, "tx_batch_size mismatch");
+}
+END_TEST
+#endif /* HAVE_SENDMMSG */
+
 static
 Suite*
 make_test_suite (void)
@@ -1275,6 +1547,27 @@ make_test_suite (void)
 	tcase_add_test (tc_set_udp_multicast, test_set_udp_multicast_pass_001);
 	tcase_add_test (tc_set_udp_multicast, test_set_udp_multicast_fail_001);
 
+	TCase* tc_set_recv_quantum = tcase_create ("set-recv-quantum");
+	suite_add_tcase (s, tc_set_recv_quantum);
+	tcase_add_checked_fixture (tc_set_recv_quantum, mock_setup, mock_teardown);
+	tcase_add_test (tc_set_recv_quantum, test_set_recv_quantum_pass_001);
+	tcase_add_test (tc_set_recv_quantum, test_set_recv_quantum_fail_001);
+
+	TCase* tc_set_peer_weight = tcase_create ("set-peer-weight");
+	suite_add_tcase (s, tc_set_peer_weight);
+	tcase_add_checked_fixture (tc_set_peer_weight, mock_setup, mock_teardown);
+	tcase_add_test (tc_set_peer_weight, test_set_peer_weight_pass_001);
+	tcase_add_test (tc_set_peer_weight, test_set_peer_weight_fail_001);
+	tcase_add_test (tc_set_peer_weight, test_set_peer_weight_fail_002);
+
+#ifdef HAVE_SENDMMSG
+	TCase* tc_set_send_batch = tcase_create ("set-send-batch");
+	suite_add_tcase (s, tc_set_send_batch);
+	tcase_add_checked_fixture (tc_set_send_batch, mock_setup, mock_teardown);
+	tcase_add_test (tc_set_send_batch, test_set_send_batch_pass_001);
+	tcase_add_test (tc_set_send_batch, test_set_send_batch_fail_001);
+#endif
+
 	return s;
 }
 
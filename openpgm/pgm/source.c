@@ -30,6 +30,7 @@
 #include <impl/sqn_list.h>
 #include <impl/packet_parse.h>
 #include <impl/net.h>
+#include <impl/timer.h>
 
 
 //#define SOURCE_DEBUG
@@ -38,6 +39,8 @@
 #	define PGM_DISABLE_ASSERT
 #endif
 
+/* maximum repairs sent per deferred NAK pass */
+#define PGM_DEFERRED_NAK_BATCH		32
 
 /* locals */
 static inline bool peer_is_source (const pgm_peer_t*) PGM_GNUC_CONST;
@@ -97,6 +100,21 @@ reset_spmr_timer (
 	peer->spmr_expiry = 0;
 }
 
+/* empty token bucket: leave the ACK channel to signal only when tokens
+ * return, re-raising it for an ACK that arrived before the clear.
+ */
+
+static inline
+void
+reset_ack_notify (
+	pgm_sock_t* const	sock
+	)
+{
+	pgm_notify_clear (&sock->ack_notify);
+	if (sock->tokens >= pgm_fp8 (1))
+		pgm_notify_send (&sock->ack_notify);
+}
+
 static inline
 size_t
 source_max_tsdu (
@@ -124,7 +142,8 @@ pgm_schedule_proactive_nak (
 	const bool status = pgm_txw_retransmit_push (sock->window,
 						     nak_tg_sqn | sock->rs_proactive_h,
 						     TRUE /* is_parity */,
-						     sock->tg_sqn_shift);
+						     sock->tg_sqn_shift,
+						     0 /* not a NAK */);
 	return status;
 }
 
@@ -158,11 +177,19 @@ pgm_on_deferred_nak (
 /* peek from the retransmit queue so we can eliminate duplicate NAKs up until the repair packet
  * has been retransmitted.
  */
-	pgm_spinlock_lock (&sock->txw_spinlock);
-	skb = pgm_txw_retransmit_try_peek (sock->window);
-	if (skb) {
+/* drain a bounded batch per call so a late join replay is not paced by the
+ * caller's event loop, the RDATA rate limit still applies per packet.
+ */
+	for (unsigned i = 0; i < PGM_DEFERRED_NAK_BATCH; i++)
+	{
+		pgm_sock_spinlock_lock (sock, &sock->txw_spinlock);
+		skb = pgm_txw_retransmit_try_peek (sock->window);
+		if (!skb) {
+			pgm_sock_spinlock_unlock (sock, &sock->txw_spinlock);
+			break;
+		}
 		skb = pgm_skb_get (skb);
-		pgm_spinlock_unlock (&sock->txw_spinlock);
+		pgm_sock_spinlock_unlock (sock, &sock->txw_spinlock);
 		if (!send_rdata (sock, skb)) {
 			pgm_free_skb (skb);
 			pgm_notify_send (&sock->rdata_notify);
@@ -170,9 +197,12 @@ pgm_on_deferred_nak (
 		}
 		pgm_free_skb (skb);
 /* now remove sequence number from retransmit queue, re-enabling NAK processing for this sequence number */
-		pgm_txw_retransmit_remove_head (sock->window);
-	} else
-		pgm_spinlock_unlock (&sock->txw_spinlock);
+		const pgm_time_t nak_tstamp = pgm_txw_retransmit_remove_head (sock->window);
+		if (nak_tstamp) {
+			const pgm_time_t now = pgm_time_cached();
+			pgm_latency_add (&sock->latency[PGM_LATENCY_SOURCE_NAK_SVC], pgm_time_after (now, nak_tstamp) ? now - nak_tstamp : 0);
+		}
+	}
 	return TRUE;
 }
 
@@ -302,18 +332,18 @@ pgm_on_nak (
 
 	const bool is_parity = skb->pgm_header->pgm_options & PGM_OPT_PARITY;
 	if (is_parity) {
-		sock->cumulative_stats[PGM_PC_SOURCE_PARITY_NAKS_RECEIVED]++;
+		pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_PARITY_NAKS_RECEIVED]);
 		if (!sock->use_ondemand_parity) {
 			pgm_trace (PGM_LOG_ROLE_NETWORK,_("Parity NAK rejected as on-demand parity is not enabled."));
-			sock->cumulative_stats[PGM_PC_SOURCE_MALFORMED_NAKS]++;
+			pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_MALFORMED_NAKS]);
 			return FALSE;
 		}
 	} else
-		sock->cumulative_stats[PGM_PC_SOURCE_SELECTIVE_NAKS_RECEIVED]++;
+		pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_SELECTIVE_NAKS_RECEIVED]);
 
 	if (PGM_UNLIKELY(!pgm_verify_nak (skb))) {
 		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Malformed NAK rejected on verification."));
-		sock->cumulative_stats[PGM_PC_SOURCE_MALFORMED_NAKS]++;
+		pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_MALFORMED_NAKS]);
 		return FALSE;
 	}
 
@@ -334,7 +364,7 @@ pgm_on_nak (
 		char saddr[INET6_ADDRSTRLEN];
 		pgm_sockaddr_ntop ((struct sockaddr*)&nak_src_nla, saddr, sizeof(saddr));
 		pgm_trace (PGM_LOG_ROLE_NETWORK,_("NAK rejected for unmatched NLA: %s"), saddr);
-		sock->cumulative_stats[PGM_PC_SOURCE_MALFORMED_NAKS]++;
+		pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_MALFORMED_NAKS]);
 		return FALSE;
 	}
 
@@ -352,7 +382,7 @@ pgm_on_nak (
 		char sgroup[INET6_ADDRSTRLEN];
 		pgm_sockaddr_ntop ((struct sockaddr*)&nak_src_nla, sgroup, sizeof(sgroup));
 		pgm_trace (PGM_LOG_ROLE_NETWORK,_("NAK rejected as targeted for different multicast group: %s"), sgroup);
-		sock->cumulative_stats[PGM_PC_SOURCE_MALFORMED_NAKS]++;
+		pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_MALFORMED_NAKS]);
 		return FALSE;
 	}
 
@@ -373,12 +403,12 @@ pgm_on_nak (
 				(const struct pgm_opt_length*)(nak  + 1);
 		if (PGM_UNLIKELY(opt_len->opt_type != PGM_OPT_LENGTH)) {
 			pgm_trace (PGM_LOG_ROLE_NETWORK,_("Malformed NAK rejected on unexpected primary PGM option type."));
-			sock->cumulative_stats[PGM_PC_SOURCE_MALFORMED_NAKS]++;
+			pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_MALFORMED_NAKS]);
 			return FALSE;
 		}
 		if (PGM_UNLIKELY(opt_len->opt_length != sizeof(struct pgm_opt_length))) {
 			pgm_trace (PGM_LOG_ROLE_NETWORK,_("Malformed NAK rejected on length of length option header."));
-			sock->cumulative_stats[PGM_PC_SOURCE_MALFORMED_NAKS]++;
+			pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_MALFORMED_NAKS]);
 			return FALSE;
 		}
 /* TODO: check for > 16 options & past packet end */
@@ -416,7 +446,7 @@ pgm_on_nak (
 
 /* queue retransmit requests */
 	for (uint_fast8_t i = 0; i < sqn_list.len; i++) {
-		const bool push_status = pgm_txw_retransmit_push (sock->window, sqn_list.sqn[i], is_parity, sock->tg_sqn_shift);
+		const bool push_status = pgm_txw_retransmit_push (sock->window, sqn_list.sqn[i], is_parity, sock->tg_sqn_shift, skb->tstamp);
 		if (PGM_UNLIKELY(!push_status)) {
 			pgm_trace (PGM_LOG_ROLE_TX_WINDOW,_("Failed to push retransmit request for #%" PRIu32), sqn_list.sqn[i]);
 		}
@@ -448,10 +478,10 @@ pgm_on_nnak (
 	pgm_debug ("pgm_on_nnak (sock:%p skb:%p)",
 		(void*)sock, (void*)skb);
 
-	sock->cumulative_stats[PGM_PC_SOURCE_SELECTIVE_NNAK_PACKETS_RECEIVED]++;
+	pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_SELECTIVE_NNAK_PACKETS_RECEIVED]);
 
 	if (PGM_UNLIKELY(!pgm_verify_nnak (skb))) {
-		sock->cumulative_stats[PGM_PC_SOURCE_NNAK_ERRORS]++;
+		pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_NNAK_ERRORS]);
 		return FALSE;
 	}
 
@@ -463,7 +493,7 @@ pgm_on_nnak (
 
 	if (PGM_UNLIKELY(pgm_sockaddr_cmp ((struct sockaddr*)&nnak_src_nla, (struct sockaddr*)&sock->send_addr) != 0))
 	{
-		sock->cumulative_stats[PGM_PC_SOURCE_NNAK_ERRORS]++;
+		pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_NNAK_ERRORS]);
 		return FALSE;
 	}
 
@@ -471,7 +501,7 @@ pgm_on_nnak (
 	pgm_nla_to_sockaddr ((AF_INET6 == nnak_src_nla.ss_family) ? &nnak6->nak6_grp_nla_afi : &nnak->nak_grp_nla_afi, (struct sockaddr*)&nnak_grp_nla);
 	if (PGM_UNLIKELY(pgm_sockaddr_cmp ((struct sockaddr*)&nnak_grp_nla, (struct sockaddr*)&sock->send_gsr.gsr_group) != 0))
 	{
-		sock->cumulative_stats[PGM_PC_SOURCE_NNAK_ERRORS]++;
+		pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_NNAK_ERRORS]);
 		return FALSE;
 	}
 
@@ -482,11 +512,11 @@ pgm_on_nnak (
 							(const struct pgm_opt_length*)(nnak6 + 1) :
 							(const struct pgm_opt_length*)(nnak + 1);
 		if (PGM_UNLIKELY(opt_len->opt_type != PGM_OPT_LENGTH)) {
-			sock->cumulative_stats[PGM_PC_SOURCE_NNAK_ERRORS]++;
+			pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_NNAK_ERRORS]);
 			return FALSE;
 		}
 		if (PGM_UNLIKELY(opt_len->opt_length != sizeof(struct pgm_opt_length))) {
-			sock->cumulative_stats[PGM_PC_SOURCE_NNAK_ERRORS]++;
+			pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_NNAK_ERRORS]);
 			return FALSE;
 		}
 /* TODO: check for > 16 options & past packet end */
@@ -500,7 +530,7 @@ pgm_on_nnak (
 		} while (!(opt_header->opt_type & PGM_OPT_END));
 	}
 
-	sock->cumulative_stats[PGM_PC_SOURCE_SELECTIVE_NNAKS_RECEIVED] += 1 + nnak_list_len;
+	pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_SELECTIVE_NNAKS_RECEIVED], 1 + nnak_list_len);
 	return TRUE;
 }
 
@@ -528,10 +558,10 @@ pgm_on_ack (
 	pgm_debug ("pgm_on_ack (sock:%p skb:%p)",
 		(const void*)sock, (const void*)skb);
 
-	sock->cumulative_stats[PGM_PC_SOURCE_ACK_PACKETS_RECEIVED]++;
+	pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_ACK_PACKETS_RECEIVED]);
 
 	if (PGM_UNLIKELY(!pgm_verify_ack (skb))) {
-		sock->cumulative_stats[PGM_PC_SOURCE_ACK_ERRORS]++;
+		pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_ACK_ERRORS]);
 		return FALSE;
 	}
 
@@ -709,6 +739,7 @@ pgm_send_spm (
 	if (sock->use_proactive_parity ||
 	    sock->use_ondemand_parity ||
 	    sock->is_pending_crqst ||
+	    sock->late_join ||
 	    PGM_OPT_FIN == flags)
 	{
 		tpdu_length += sizeof(struct pgm_opt_length);
@@ -721,6 +752,10 @@ pgm_send_spm (
 		if (sock->is_pending_crqst)
 			tpdu_length += sizeof(struct pgm_opt_header) +
 				       sizeof(struct pgm_opt_crqst);
+/* late join */
+		if (sock->late_join)
+			tpdu_length += sizeof(struct pgm_opt_header) +
+				       sizeof(struct pgm_opt_join);
 /* end of session */
 		if (PGM_OPT_FIN == flags)
 			tpdu_length += sizeof(struct pgm_opt_header) +
@@ -739,7 +774,7 @@ pgm_send_spm (
 
 /* SPM */
 	spm->spm_sqn		= pgm_htonl (sock->spm_sqn);
-	spm->spm_trail		= pgm_htonl (pgm_txw_trail_atomic (sock->window));
+	spm->spm_trail		= pgm_htonl (pgm_txw_repair_trail (sock->window));
 	spm->spm_lead		= pgm_htonl (pgm_txw_lead_atomic (sock->window));
 	spm->spm_reserved	= 0;
 /* our nla */
@@ -749,6 +784,7 @@ pgm_send_spm (
 	if (sock->use_proactive_parity ||
 	    sock->use_ondemand_parity ||
 	    sock->is_pending_crqst ||
+	    sock->late_join ||
 	    PGM_OPT_FIN == flags)
 	{
 		struct pgm_opt_header *opt_header, *last_opt_header;
@@ -803,6 +839,27 @@ pgm_send_spm (
 			opt_header = (struct pgm_opt_header*)(opt_crqst + 1);
 		}
 
+/* OPT_JOIN */
+		if (sock->late_join)
+		{
+			struct pgm_opt_join *opt_join;
+			const uint32_t txw_lead  = pgm_txw_lead_atomic (sock->window);
+			const uint32_t txw_trail = pgm_txw_repair_trail (sock->window);
+			uint32_t join_min = txw_lead + 1 - sock->late_join;
+			if (pgm_uint32_lt (join_min, txw_trail))
+				join_min = txw_trail;
+
+			opt_total_length += sizeof(struct pgm_opt_header) +
+					    sizeof(struct pgm_opt_join);
+			opt_header->opt_type	= PGM_OPT_JOIN;
+			opt_header->opt_length	= sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_join);
+			opt_join = (struct pgm_opt_join*)(opt_header + 1);
+			opt_join->opt_reserved = 0;
+			opt_join->opt_join_min = pgm_htonl (join_min);
+			last_opt_header = opt_header;
+			opt_header = (struct pgm_opt_header*)(opt_join + 1);
+		}
+
 /* OPT_FIN */
 		if (PGM_OPT_FIN == flags)
 		{
@@ -846,7 +903,7 @@ pgm_send_spm (
 
 /* advance SPM sequence only on successful transmission */
 	sock->spm_sqn++;
-	pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)tpdu_length);
+	pgm_atomic_add64 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint64_t)tpdu_length);
 	return TRUE;
 }
 
@@ -931,7 +988,7 @@ send_ncf (
 		return FALSE;
 /* fall through silently on other errors */
 			
-	pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)tpdu_length);
+	pgm_atomic_add64 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint64_t)tpdu_length);
 	return TRUE;
 }
 
@@ -1046,7 +1103,7 @@ send_ncf_list (
 		return FALSE;
 /* fall through silently on other errors */
 
-	pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)tpdu_length);
+	pgm_atomic_add64 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint64_t)tpdu_length);
 	return TRUE;
 }
 
@@ -1060,7 +1117,7 @@ reset_heartbeat_spm (
 	const pgm_time_t	now
 	)
 {
-	pgm_mutex_lock (&sock->timer_mutex);
+	pgm_sock_mutex_lock (sock, &sock->timer_mutex);
 	const pgm_time_t next_poll = sock->next_poll;
 	const pgm_time_t spm_heartbeat_interval = sock->spm_heartbeat_interval[ sock->spm_heartbeat_state = 1 ];
 	sock->next_heartbeat_spm = now + spm_heartbeat_interval;
@@ -1072,7 +1129,7 @@ reset_heartbeat_spm (
 			sock->is_pending_read = TRUE;
 		}
 	}
-	pgm_mutex_unlock (&sock->timer_mutex);
+	pgm_sock_mutex_unlock (sock, &sock->timer_mutex);
 }
 
 /* state helper for resuming sends
@@ -1117,14 +1174,14 @@ send_odata (
 
 /* continue if send would block */
 	if (sock->is_apdu_eagain) {
-		STATE(skb)->tstamp = pgm_time_update_now();
+		STATE(skb)->tstamp = pgm_time_cached();
 		goto retry_send;
 	}
 
 /* add PGM header to skbuff */
 	STATE(skb) = pgm_skb_get(skb);
 	STATE(skb)->sock = sock;
-	STATE(skb)->tstamp = pgm_time_update_now();
+	STATE(skb)->tstamp = pgm_time_cached();
 
 	STATE(skb)->pgm_header = (struct pgm_header*)STATE(skb)->head;
 	STATE(skb)->pgm_data   = (struct pgm_data*)(STATE(skb)->pgm_header + 1);
@@ -1137,7 +1194,7 @@ send_odata (
 
 /* ODATA */
         STATE(skb)->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(sock->window));
-        STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(sock->window));
+        STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_repair_trail (sock->window));
 
         STATE(skb)->pgm_header->pgm_checksum    = 0;
 	data = STATE(skb)->pgm_data + 1;
@@ -1171,9 +1228,9 @@ send_odata (
         STATE(skb)->pgm_header->pgm_checksum	= pgm_csum_fold (pgm_csum_block_add (unfolded_header, STATE(unfolded_odata), (uint16_t)pgm_header_len));
 
 /* add to transmit window, skb::data set to payload */
-	pgm_spinlock_lock (&sock->txw_spinlock);
+	pgm_sock_spinlock_lock (sock, &sock->txw_spinlock);
 	pgm_txw_add (sock->window, STATE(skb));
-	pgm_spinlock_unlock (&sock->txw_spinlock);
+	pgm_sock_spinlock_unlock (sock, &sock->txw_spinlock);
 
 /* check rate limit at last moment */
 	STATE(is_rate_limited) = FALSE;
@@ -1186,6 +1243,7 @@ send_odata (
 		{
 			sock->is_apdu_eagain = TRUE;
 			sock->blocklen = tpdu_length + sock->iphdr_len;
+			pgm_timer_arm_send (sock);
 			return PGM_IO_STATUS_RATE_LIMITED;
 		}
 		STATE(is_rate_limited) = TRUE;
@@ -1203,6 +1261,7 @@ retry_send:
 //		pgm_trace (PGM_LOG_ROLE_CONGESTION_CONTROL,_("Token limit reached."));
 		sock->is_apdu_eagain = TRUE;
 		sock->blocklen = tpdu_length + sock->iphdr_len;
+		reset_ack_notify (sock);
 		return PGM_IO_STATUS_CONGESTION;	/* peer expiration to re-elect ACKer */
 	}
 
@@ -1220,8 +1279,10 @@ retry_send:
 		{
 			sock->is_apdu_eagain = TRUE;
 			sock->blocklen = tpdu_length + sock->iphdr_len;
-			if (PGM_SOCK_ENOBUFS == save_errno)
+			if (PGM_SOCK_ENOBUFS == save_errno) {
+				pgm_timer_arm_send (sock);
 				return PGM_IO_STATUS_RATE_LIMITED;
+			}
 			if (sock->use_pgmcc)
 				pgm_notify_clear (&sock->ack_notify);
 			return PGM_IO_STATUS_WOULD_BLOCK;
@@ -1242,9 +1303,9 @@ retry_send:
 	pgm_txw_set_unfolded_checksum (STATE(skb), STATE(unfolded_odata));
 /* increment socket statistics */
 	if (PGM_LIKELY((size_t)sent == tpdu_length)) {
-		sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT] += tsdu_length;
-		sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]  ++;
-		pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)(tpdu_length + sock->iphdr_len));
+		pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT], tsdu_length);
+		pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]);
+		pgm_atomic_add64 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint64_t)(tpdu_length + sock->iphdr_len));
 	}
 /* check for end of transmission group for pro-active packets */
 	if (sock->use_proactive_parity) {
@@ -1292,13 +1353,13 @@ send_odata_copy (
 
 /* continue if blocked mid-apdu, updating timestamp */
 	if (sock->is_apdu_eagain) {
-		STATE(skb)->tstamp = pgm_time_update_now();
+		STATE(skb)->tstamp = pgm_time_cached();
 		goto retry_send;
 	}
 
-	STATE(skb) = pgm_alloc_skb (sock->max_tpdu);
+	STATE(skb) = pgm_sock_alloc_skb (sock, sock->max_tpdu);
 	STATE(skb)->sock = sock;
-	STATE(skb)->tstamp = pgm_time_update_now();
+	STATE(skb)->tstamp = pgm_time_cached();
 	pgm_skb_reserve (STATE(skb), (uint16_t)pgm_pkt_offset (FALSE, pgmcc_family));
 	pgm_skb_put (STATE(skb), (uint16_t)tsdu_length);
 
@@ -1313,7 +1374,7 @@ send_odata_copy (
 
 /* ODATA */
 	STATE(skb)->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(sock->window));
-	STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(sock->window));
+	STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_repair_trail (sock->window));
 
 	STATE(skb)->pgm_header->pgm_checksum	= 0;
 	data = STATE(skb)->pgm_data + 1;
@@ -1348,9 +1409,9 @@ send_odata_copy (
 	STATE(skb)->pgm_header->pgm_checksum	= pgm_csum_fold (pgm_csum_block_add (unfolded_header, STATE(unfolded_odata), (uint16_t)pgm_header_len));
 
 /* add to transmit window, skb::data set to payload */
-	pgm_spinlock_lock (&sock->txw_spinlock);
+	pgm_sock_spinlock_lock (sock, &sock->txw_spinlock);
 	pgm_txw_add (sock->window, STATE(skb));
-	pgm_spinlock_unlock (&sock->txw_spinlock);
+	pgm_sock_spinlock_unlock (sock, &sock->txw_spinlock);
 
 /* check rate limit at last moment */
 	STATE(is_rate_limited) = FALSE;
@@ -1363,6 +1424,7 @@ send_odata_copy (
 		{
 			sock->is_apdu_eagain = TRUE;
 			sock->blocklen = tpdu_length + sock->iphdr_len;
+			pgm_timer_arm_send (sock);
 			return PGM_IO_STATUS_RATE_LIMITED;
 		}
 		STATE(is_rate_limited) = TRUE;
@@ -1376,6 +1438,7 @@ retry_send:
 //		pgm_trace (PGM_LOG_ROLE_CONGESTION_CONTROL,_("Token limit reached."));
 		sock->is_apdu_eagain = TRUE;
 		sock->blocklen = tpdu_length + sock->iphdr_len;
+		reset_ack_notify (sock);
 		return PGM_IO_STATUS_CONGESTION;
 	}
 
@@ -1393,8 +1456,10 @@ retry_send:
 		{
 			sock->is_apdu_eagain = TRUE;
 			sock->blocklen = tpdu_length + sock->iphdr_len;
-			if (PGM_SOCK_ENOBUFS == save_errno)
+			if (PGM_SOCK_ENOBUFS == save_errno) {
+				pgm_timer_arm_send (sock);
 				return PGM_IO_STATUS_RATE_LIMITED;
+			}
 			if (sock->use_pgmcc)
 				pgm_notify_clear (&sock->ack_notify);
 			return PGM_IO_STATUS_WOULD_BLOCK;
@@ -1417,9 +1482,9 @@ retry_send:
 	pgm_txw_set_unfolded_checksum (STATE(skb), STATE(unfolded_odata));
 /* increment socket statistics */
 	if (PGM_LIKELY((size_t)sent == tpdu_length)) {
-		sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT] += tsdu_length;
-		sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]  ++;
-		pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)(tpdu_length + sock->iphdr_len));
+		pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT], tsdu_length);
+		pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]);
+		pgm_atomic_add64 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint64_t)(tpdu_length + sock->iphdr_len));
 	}
 /* check for end of transmission group for pro-active packets */
 	if (sock->use_proactive_parity) {
@@ -1489,9 +1554,9 @@ send_odatav (
 	}
 	pgm_return_val_if_fail (STATE(tsdu_length) <= sock->max_tsdu, PGM_IO_STATUS_ERROR);
 
-	STATE(skb) = pgm_alloc_skb (sock->max_tpdu);
+	STATE(skb) = pgm_sock_alloc_skb (sock, sock->max_tpdu);
 	STATE(skb)->sock = sock;
-	STATE(skb)->tstamp = pgm_time_update_now();
+	STATE(skb)->tstamp = pgm_time_cached();
 	const sa_family_t pgmcc_family = sock->use_pgmcc ? sock->family : 0;
 	pgm_skb_reserve (STATE(skb), (uint16_t)pgm_pkt_offset (FALSE, pgmcc_family));
 	pgm_skb_put (STATE(skb), (uint16_t)STATE(tsdu_length));
@@ -1507,7 +1572,7 @@ send_odatav (
 
 /* ODATA */
 	STATE(skb)->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(sock->window));
-	STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(sock->window));
+	STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_repair_trail (sock->window));
 
 	STATE(skb)->pgm_header->pgm_checksum	= 0;
 	const size_t   pgm_header_len		= (char*)(STATE(skb)->pgm_data + 1) - (char*)STATE(skb)->pgm_header;
@@ -1527,9 +1592,9 @@ send_odatav (
 	STATE(skb)->pgm_header->pgm_checksum	= pgm_csum_fold (pgm_csum_block_add (unfolded_header, STATE(unfolded_odata), (uint16_t)pgm_header_len));
 
 /* add to transmit window, skb::data set to payload */
-	pgm_spinlock_lock (&sock->txw_spinlock);
+	pgm_sock_spinlock_lock (sock, &sock->txw_spinlock);
 	pgm_txw_add (sock->window, STATE(skb));
-	pgm_spinlock_unlock (&sock->txw_spinlock);
+	pgm_sock_spinlock_unlock (sock, &sock->txw_spinlock);
 
 	pgm_assert ((char*)STATE(skb)->tail > (char*)STATE(skb)->head);
 	tpdu_length = (char*)STATE(skb)->tail - (char*)STATE(skb)->head;
@@ -1545,6 +1610,7 @@ send_odatav (
 		{
 			sock->is_apdu_eagain = TRUE;
 			sock->blocklen = tpdu_length + sock->iphdr_len;
+			pgm_timer_arm_send (sock);
 			return PGM_IO_STATUS_RATE_LIMITED;
 		}
 		STATE(is_rate_limited) = TRUE;
@@ -1565,8 +1631,10 @@ retry_send:
 		{
 			sock->is_apdu_eagain = TRUE;
 			sock->blocklen = tpdu_length + sock->iphdr_len;
-			if (PGM_SOCK_ENOBUFS == save_errno)
+			if (PGM_SOCK_ENOBUFS == save_errno) {
+				pgm_timer_arm_send (sock);
 				return PGM_IO_STATUS_RATE_LIMITED;
+			}
 			if (sock->use_pgmcc)
 				pgm_notify_clear (&sock->ack_notify);
 			return PGM_IO_STATUS_WOULD_BLOCK;
@@ -1582,9 +1650,9 @@ retry_send:
 	pgm_txw_set_unfolded_checksum (STATE(skb), STATE(unfolded_odata));
 /* increment socket statistics */
 	if (PGM_LIKELY((size_t)sent == STATE(skb)->len)) {
-		sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT] += STATE(tsdu_length);
-		sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]  ++;
-		pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)(tpdu_length + sock->iphdr_len));
+		pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT], STATE(tsdu_length));
+		pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]);
+		pgm_atomic_add64 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint64_t)(tpdu_length + sock->iphdr_len));
 	}
 /* check for end of transmission group */
 	if (sock->use_proactive_parity) {
@@ -1600,8 +1668,52 @@ retry_send:
 	return PGM_IO_STATUS_NORMAL;
 }
 
+/* send the pending fragments of the current APDU directly from the transmit
+ * window, more than one fragment as a segmentation offload super-buffer.
+ *
+ * on success, returns number of bytes sent and the total TPDU and TSDU lengths
+ * of the pending fragments.  on error, returns -1 and errno set appropriately.
+ */
+
+static
+ssize_t
+send_odata_skbv (
+	pgm_sock_t*	const restrict	sock,
+	size_t*		      restrict	tpdu_length,
+	size_t*		      restrict	tsdu_length
+	)
+{
+	struct pgm_sk_buff_t* skbs[ PGM_UDP_MAX_SEGMENTS ];
+
+	pgm_assert (NULL != sock);
+	pgm_assert_cmpuint (STATE(gso_count), >, 0);
+	pgm_assert_cmpuint (STATE(gso_count), <=, PGM_UDP_MAX_SEGMENTS);
+
+	*tpdu_length = *tsdu_length = 0;
+	pgm_sock_spinlock_lock (sock, &sock->txw_spinlock);
+	for (unsigned i = 0; i < STATE(gso_count); i++)
+	{
+		skbs[i] = pgm_txw_peek (sock->window, STATE(gso_first_sqn) + i);
+		pgm_assert (NULL != skbs[i]);
+		*tpdu_length += pgm_skb_tpdu_length (skbs[i]);
+		*tsdu_length += pgm_ntohs (skbs[i]->pgm_header->pgm_tsdu_length);
+	}
+	pgm_sock_spinlock_unlock (sock, &sock->txw_spinlock);
+
+	return pgm_sendto_skbv (sock,
+				!STATE(is_rate_limited),	/* rate limit on blocking */
+				&sock->odata_rate_control,
+				FALSE,				/* regular socket */
+				skbs,
+				STATE(gso_count),
+				(struct sockaddr*)&sock->send_gsr.gsr_group,
+				pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+}
+
 /* send PGM original data, callee owned memory.  if larger than maximum TPDU
- * size will be fragmented.
+ * size will be fragmented.  with a release function the payload is referenced
+ * by the transmit window instead of copied, and released when the last
+ * fragment leaves the window.
  *
  * on success, returns PGM_IO_STATUS_NORMAL, on block for non-blocking sockets
  * returns PGM_IO_STATUS_WOULD_BLOCK, returns PGM_IO_STATUS_RATE_LIMITED if
@@ -1614,6 +1726,8 @@ send_apdu (
 	pgm_sock_t* 	 const restrict	sock,
 	const void*	       restrict	apdu,
 	const size_t			apdu_length,
+	pgm_release_func_t		release,
+	void*				release_data,
 	size_t*		       restrict	bytes_written
 	)
 {
@@ -1631,9 +1745,11 @@ send_apdu (
 	if (sock->is_apdu_eagain)
 		goto retry_send;
 
-/* if non-blocking calculate total wire size and check rate limit */
+/* if non-blocking calculate total wire size and check rate limit, large
+ * APDUs are rate limited per packet.
+ */
 	STATE(is_rate_limited) = FALSE;
-	if (sock->is_nonblocking && sock->is_controlled_odata)
+	if (sock->is_nonblocking && sock->is_controlled_odata && apdu_length <= PGM_MAX_APDU)
 	{
 		const size_t header_length = pgm_pkt_offset (TRUE, pgmcc_family);
 		size_t tpdu_length = 0;
@@ -1651,6 +1767,7 @@ send_apdu (
 				      sock->is_nonblocking))
 		{
 			sock->blocklen = tpdu_length;
+			pgm_timer_arm_send (sock);
 			return PGM_IO_STATUS_RATE_LIMITED;
 		}
 		STATE(is_rate_limited) = TRUE;
@@ -1658,6 +1775,16 @@ send_apdu (
 
 	STATE(data_bytes_offset)	= 0;
 	STATE(first_sqn)		= pgm_txw_next_lead(sock->window);
+	STATE(gso_count)		= 0;
+	STATE(ref)			= NULL;
+	if (NULL != release) {
+/* reference held until the APDU is completely sent */
+		STATE(ref) = pgm_new (struct pgm_skb_ref_t, 1);
+		pgm_atomic_write32 (&STATE(ref)->users, 1);
+		STATE(ref)->release	= release;
+		STATE(ref)->buffer	= (void*)apdu;
+		STATE(ref)->user_data	= release_data;
+	}
 
 	do {
 		size_t			 tpdu_length, header_length;
@@ -1666,14 +1793,27 @@ send_apdu (
 		ssize_t			 sent;
 
 /* retrieve packet storage from transmit window */
-		header_length = pgm_pkt_offset (TRUE, pgmcc_family);
 		STATE(tsdu_length) = MIN( source_max_tsdu (sock, TRUE), apdu_length - STATE(data_bytes_offset) );
 
-		STATE(skb) = pgm_alloc_skb (sock->max_tpdu);
-		STATE(skb)->sock = sock;
-		STATE(skb)->tstamp = pgm_time_update_now();
-		pgm_skb_reserve (STATE(skb), (uint16_t)header_length);
-		pgm_skb_put (STATE(skb), (uint16_t)STATE(tsdu_length));
+		if (NULL == STATE(ref))
+		{
+			header_length = pgm_pkt_offset (TRUE, pgmcc_family);
+			STATE(skb) = pgm_sock_alloc_skb (sock, sock->max_tpdu);
+			STATE(skb)->sock = sock;
+			STATE(skb)->tstamp = pgm_time_cached();
+			pgm_skb_reserve (STATE(skb), (uint16_t)header_length);
+			pgm_skb_put (STATE(skb), (uint16_t)STATE(tsdu_length));
+		}
+		else
+		{
+/* header only, payload referenced in place */
+			header_length = pgm_pkt_offset (TRUE, 0);
+			STATE(skb) = pgm_sock_alloc_skb (sock, (uint16_t)header_length);
+			STATE(skb)->sock = sock;
+			STATE(skb)->tstamp = pgm_time_cached();
+			pgm_skb_reserve (STATE(skb), (uint16_t)header_length);
+			pgm_skb_attach_ref (STATE(skb), STATE(ref), (const char*)apdu + STATE(data_bytes_offset), (uint16_t)STATE(tsdu_length));
+		}
 
 		STATE(skb)->pgm_header  = (struct pgm_header*)STATE(skb)->head;
 		STATE(skb)->pgm_data    = (struct pgm_data*)(STATE(skb)->pgm_header + 1);
@@ -1686,7 +1826,7 @@ send_apdu (
 
 /* ODATA */
 		STATE(skb)->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(sock->window));
-		STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(sock->window));
+		STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_repair_trail (sock->window));
 
 /* OPT_LENGTH */
 		opt_len					= (struct pgm_opt_length*)(STATE(skb)->pgm_data + 1);
@@ -1710,16 +1850,69 @@ send_apdu (
 		STATE(skb)->pgm_header->pgm_checksum	= 0;
 		const size_t   pgm_header_len		= (char*)(STATE(skb)->pgm_opt_fragment + 1) - (char*)STATE(skb)->pgm_header;
 		const uint32_t unfolded_header		= pgm_csum_partial (STATE(skb)->pgm_header, (uint16_t)pgm_header_len, 0);
-		STATE(unfolded_odata)			= pgm_csum_partial_copy ((const char*)apdu + STATE(data_bytes_offset), STATE(skb)->pgm_opt_fragment + 1, (uint16_t)STATE(tsdu_length), 0);
+		if (NULL == STATE(ref))
+			STATE(unfolded_odata)		= pgm_csum_partial_copy ((const char*)apdu + STATE(data_bytes_offset), STATE(skb)->pgm_opt_fragment + 1, (uint16_t)STATE(tsdu_length), 0);
+		else
+			STATE(unfolded_odata)		= pgm_csum_partial ((const char*)apdu + STATE(data_bytes_offset), (uint16_t)STATE(tsdu_length), 0);
 		STATE(skb)->pgm_header->pgm_checksum	= pgm_csum_fold (pgm_csum_block_add (unfolded_header, STATE(unfolded_odata), (uint16_t)pgm_header_len));
 
 /* add to transmit window, skb::data set to payload */
-		pgm_spinlock_lock (&sock->txw_spinlock);
+		pgm_sock_spinlock_lock (sock, &sock->txw_spinlock);
 		pgm_txw_add (sock->window, STATE(skb));
-		pgm_spinlock_unlock (&sock->txw_spinlock);
+		pgm_sock_spinlock_unlock (sock, &sock->txw_spinlock);
+
+/* send from the transmit window, deferred until super-buffer or send batch is
+ * full or APDU is complete.
+ */
+		if (sock->use_udp_gso || sock->tx_batch_size > 1 || NULL != sock->zerocopy || NULL != STATE(ref)) {
+			const unsigned batch_size = sock->use_udp_gso ? sock->udp_gso_segments : sock->tx_batch_size;
+			if (0 == STATE(gso_count)++)
+				STATE(gso_first_sqn) = pgm_ntohl (STATE(skb)->pgm_data->data_sqn);
+			if (STATE(gso_count) < batch_size &&
+			    (STATE(data_bytes_offset) + STATE(tsdu_length)) < apdu_length)
+			{
+				pgm_txw_set_unfolded_checksum (STATE(skb), STATE(unfolded_odata));
+				goto next_fragment;
+			}
+		}
 
 retry_send:
-		pgm_assert ((char*)STATE(skb)->tail > (char*)STATE(skb)->head);
+		pgm_assert (pgm_skb_tpdu_length (STATE(skb)) > 0);
+		if (STATE(gso_count) > 0)
+		{
+			size_t tsdu_length;
+			sent = send_odata_skbv (sock, &tpdu_length, &tsdu_length);
+			if (sent < 0) {
+				save_errno = pgm_get_last_sock_error();
+				if (PGM_LIKELY(PGM_SOCK_EAGAIN == save_errno || PGM_SOCK_ENOBUFS == save_errno))
+				{
+					sock->is_apdu_eagain = TRUE;
+					sock->blocklen = tpdu_length + STATE(gso_count) * sock->iphdr_len;
+					goto blocked;
+				}
+/* fall through silently on other errors */
+			}
+
+			pgm_txw_set_unfolded_checksum (STATE(skb), STATE(unfolded_odata));
+
+			if (PGM_LIKELY((size_t)sent == tpdu_length)) {
+				bytes_sent += tpdu_length + STATE(gso_count) * sock->iphdr_len;
+				packets_sent += STATE(gso_count);
+				data_bytes_sent += tsdu_length;
+			}
+
+/* check for end of transmission group, only once the deferred batch is out */
+			if (sock->use_proactive_parity) {
+				const uint32_t tg_sqn_mask = 0xffffffff << sock->tg_sqn_shift;
+				for (unsigned i = 0; i < STATE(gso_count); i++) {
+					const uint32_t odata_sqn = STATE(gso_first_sqn) + i;
+					if (!((odata_sqn + 1) & ~tg_sqn_mask))
+						pgm_schedule_proactive_nak (sock, odata_sqn & tg_sqn_mask);
+				}
+			}
+			STATE(gso_count) = 0;
+			goto next_fragment;
+		}
 		tpdu_length = (char*)STATE(skb)->tail - (char*)STATE(skb)->head;
 		sent = pgm_sendto (sock,
 				   !STATE(is_rate_limited),	/* rate limit on blocking */
@@ -1749,8 +1942,6 @@ retry_send:
 			data_bytes_sent += STATE(tsdu_length);
 		}
 
-		STATE(data_bytes_offset) += STATE(tsdu_length);
-
 /* check for end of transmission group */
 		if (sock->use_proactive_parity) {
 			const uint32_t odata_sqn = pgm_ntohl (STATE(skb)->pgm_data->data_sqn);
@@ -1759,6 +1950,9 @@ retry_send:
 				pgm_schedule_proactive_nak (sock, odata_sqn & tg_sqn_mask);
 		}
 
+next_fragment:
+		STATE(data_bytes_offset) += STATE(tsdu_length);
+
 	} while ( STATE(data_bytes_offset)  < apdu_length);
 	pgm_assert( STATE(data_bytes_offset) == apdu_length );
 
@@ -1766,10 +1960,15 @@ retry_send:
 	sock->is_apdu_eagain = FALSE;
 /* SPM heartbeats decay from last sent data packet */
 	reset_heartbeat_spm (sock, STATE(skb)->tstamp);
+/* payload now only referenced by the transmit window */
+	if (NULL != STATE(ref)) {
+		pgm_skb_ref_put (STATE(ref));
+		STATE(ref) = NULL;
+	}
 /* increment socket statistics */
-	pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)bytes_sent);
-	sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]  += packets_sent;
-	sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT] += data_bytes_sent;
+	pgm_atomic_add64 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint64_t)bytes_sent);
+	pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT], packets_sent);
+	pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT], data_bytes_sent);
 	if (bytes_written)
 		*bytes_written = apdu_length;
 	return PGM_IO_STATUS_NORMAL;
@@ -1777,12 +1976,14 @@ retry_send:
 blocked:
 	if (bytes_sent) {
 		reset_heartbeat_spm (sock, STATE(skb)->tstamp);
-		pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)bytes_sent);
-		sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]  += packets_sent;
-		sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT] += data_bytes_sent;
+		pgm_atomic_add64 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint64_t)bytes_sent);
+		pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT], packets_sent);
+		pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT], data_bytes_sent);
 	}
-	if (PGM_SOCK_ENOBUFS == save_errno)
+	if (PGM_SOCK_ENOBUFS == save_errno) {
+		pgm_timer_arm_send (sock);
 		return PGM_IO_STATUS_RATE_LIMITED;
+	}
 	if (sock->use_pgmcc)
 		pgm_notify_clear (&sock->ack_notify);
 	return PGM_IO_STATUS_WOULD_BLOCK;
@@ -1811,7 +2012,7 @@ pgm_send (
 	if (PGM_LIKELY(apdu_length)) pgm_return_val_if_fail (NULL != apdu, PGM_IO_STATUS_ERROR);
 
 /* shutdown */
-	if (PGM_UNLIKELY(!pgm_rwlock_reader_trylock (&sock->lock)))
+	if (PGM_UNLIKELY(!pgm_sock_reader_trylock (sock, &sock->lock)))
 		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
 
 /* state */
@@ -1819,30 +2020,107 @@ pgm_send (
 	    sock->is_destroyed ||
 	    apdu_length > sock->max_apdu))
 	{
-		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_sock_reader_unlock (sock, &sock->lock);
 		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
 	}
 
 /* source */
-	pgm_mutex_lock (&sock->source_mutex);
+	pgm_sock_mutex_lock (sock, &sock->source_mutex);
+	pgm_time_cache_begin ();
 
 /* pass on non-fragment calls */
 	if (apdu_length <= sock->max_tsdu)
 	{
 		const int status = send_odata_copy (sock, apdu, (uint16_t)apdu_length, bytes_written);
-		pgm_mutex_unlock (&sock->source_mutex);
-		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_time_cache_end ();
+		pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+		pgm_sock_reader_unlock (sock, &sock->lock);
 		return status;
 	}
 	else
 	{
-		const int status = send_apdu (sock, apdu, (uint16_t)apdu_length, bytes_written);
-		pgm_mutex_unlock (&sock->source_mutex);
-		pgm_rwlock_reader_unlock (&sock->lock);
+		const int status = send_apdu (sock, apdu, apdu_length, NULL, NULL, bytes_written);
+		pgm_time_cache_end ();
+		pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+		pgm_sock_reader_unlock (sock, &sock->lock);
 		return status;
 	}
 }
 
+/* Send one APDU from an application owned buffer without copying the payload
+ * into the transmit window.  The buffer must remain unmodified until release
+ * is called with the buffer and user_data, after the last fragment has left
+ * the transmit window and any zero-copy transmission has completed.
+ *
+ * APDUs that fit within one TPDU, and sockets with FEC enabled, are copied as
+ * pgm_send() and released before returning.
+ *
+ * on success, returns PGM_IO_STATUS_NORMAL, on block for non-blocking sockets
+ * returns PGM_IO_STATUS_WOULD_BLOCK, returns PGM_IO_STATUS_RATE_LIMITED if
+ * packet size exceeds the current rate limit.  release is not called unless
+ * PGM_IO_STATUS_NORMAL is returned, a blocked call must be repeated with the
+ * same parameters.
+ */
+
+int
+pgm_send_ref (
+	pgm_sock_t* 	 const restrict sock,
+	const void*	       restrict	apdu,
+	const size_t			apdu_length,
+	pgm_release_func_t		release,
+	void*				user_data,
+	size_t*	       	       restrict	bytes_written
+	)
+{
+	int status;
+
+	pgm_debug ("pgm_send_ref (sock:%p apdu:%p apdu-length:%" PRIzu " release:%p user-data:%p bytes-written:%p)",
+		(void*)sock, apdu, apdu_length, (void*)(uintptr_t)release, user_data, (void*)bytes_written);
+
+/* parameters */
+	pgm_return_val_if_fail (NULL != sock, PGM_IO_STATUS_ERROR);
+	pgm_return_val_if_fail (NULL != release, PGM_IO_STATUS_ERROR);
+	if (PGM_LIKELY(apdu_length)) pgm_return_val_if_fail (NULL != apdu, PGM_IO_STATUS_ERROR);
+
+/* shutdown */
+	if (PGM_UNLIKELY(!pgm_sock_reader_trylock (sock, &sock->lock)))
+		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
+
+/* state */
+	if (PGM_UNLIKELY(!sock->is_bound ||
+	    sock->is_destroyed ||
+	    apdu_length > sock->max_apdu))
+	{
+		pgm_sock_reader_unlock (sock, &sock->lock);
+		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
+	}
+
+/* source */
+	pgm_sock_mutex_lock (sock, &sock->source_mutex);
+	pgm_time_cache_begin ();
+
+/* parity packets are calculated from the window payload, copy */
+	if (apdu_length <= sock->max_tsdu)
+	{
+		status = send_odata_copy (sock, apdu, (uint16_t)apdu_length, bytes_written);
+		if (PGM_IO_STATUS_NORMAL == status)
+			release ((void*)apdu, user_data);
+	}
+	else if (sock->use_proactive_parity || sock->use_ondemand_parity)
+	{
+		status = send_apdu (sock, apdu, apdu_length, NULL, NULL, bytes_written);
+		if (PGM_IO_STATUS_NORMAL == status)
+			release ((void*)apdu, user_data);
+	}
+	else
+		status = send_apdu (sock, apdu, apdu_length, release, user_data, bytes_written);
+
+	pgm_time_cache_end ();
+	pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+	pgm_sock_reader_unlock (sock, &sock->lock);
+	return status;
+}
+
 /* send PGM original data, callee owned scatter/gather IO vector.  if larger than maximum TPDU
  * size will be fragmented.
  *
@@ -1887,23 +2165,25 @@ pgm_sendv (
 	pgm_return_val_if_fail (NULL != sock, PGM_IO_STATUS_ERROR);
 	pgm_return_val_if_fail (count <= PGM_MAX_FRAGMENTS, PGM_IO_STATUS_ERROR);
 	if (PGM_LIKELY(count)) pgm_return_val_if_fail (NULL != vector, PGM_IO_STATUS_ERROR);
-	if (PGM_UNLIKELY(!pgm_rwlock_reader_trylock (&sock->lock)))
+	if (PGM_UNLIKELY(!pgm_sock_reader_trylock (sock, &sock->lock)))
 		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
 	if (PGM_UNLIKELY(!sock->is_bound ||
 	    sock->is_destroyed))
 	{
-		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_sock_reader_unlock (sock, &sock->lock);
 		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
 	}
 
-	pgm_mutex_lock (&sock->source_mutex);
+	pgm_sock_mutex_lock (sock, &sock->source_mutex);
+	pgm_time_cache_begin ();
 
 /* pass on zero length as cannot count vector lengths */
 	if (PGM_UNLIKELY(0 == count))
 	{
 		const int status = send_odata_copy (sock, NULL, 0, bytes_written);
-		pgm_mutex_unlock (&sock->source_mutex);
-		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_time_cache_end ();
+		pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+		pgm_sock_reader_unlock (sock, &sock->lock);
 		return status;
 	}
 
@@ -1915,8 +2195,9 @@ pgm_sendv (
 			if (STATE(apdu_length) <= sock->max_tsdu)
 			{
 				const int status = send_odatav (sock, vector, count, bytes_written);
-				pgm_mutex_unlock (&sock->source_mutex);
-				pgm_rwlock_reader_unlock (&sock->lock);
+				pgm_time_cache_end ();
+				pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+				pgm_sock_reader_unlock (sock, &sock->lock);
 				return status;
 			}
 			else
@@ -1938,8 +2219,9 @@ pgm_sendv (
 		if (!is_one_apdu &&
 		    vector[i].iov_len > sock->max_apdu)
 		{
-			pgm_mutex_unlock (&sock->source_mutex);
-			pgm_rwlock_reader_unlock (&sock->lock);
+			pgm_time_cache_end ();
+			pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+			pgm_sock_reader_unlock (sock, &sock->lock);
 			pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
 		}
 		STATE(apdu_length) += vector[i].iov_len;
@@ -1949,12 +2231,14 @@ pgm_sendv (
 	if (is_one_apdu) {
 		if (STATE(apdu_length) <= sock->max_tsdu) {
 			const int status = send_odatav (sock, vector, count, bytes_written);
-			pgm_mutex_unlock (&sock->source_mutex);
-			pgm_rwlock_reader_unlock (&sock->lock);
+			pgm_time_cache_end ();
+			pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+			pgm_sock_reader_unlock (sock, &sock->lock);
 			return status;
 		} else if (STATE(apdu_length) > sock->max_apdu) {
-			pgm_mutex_unlock (&sock->source_mutex);
-			pgm_rwlock_reader_unlock (&sock->lock);
+			pgm_time_cache_end ();
+			pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+			pgm_sock_reader_unlock (sock, &sock->lock);
 			pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
 		}
 	}
@@ -1970,6 +2254,8 @@ retry_send:
 			status = send_apdu (sock,
 					    vector[STATE(data_pkt_offset)].iov_base,
 					    vector[STATE(data_pkt_offset)].iov_len,
+					    NULL,
+					    NULL,
 					    &wrote_bytes);
 			switch (status) {
 			case PGM_IO_STATUS_NORMAL:
@@ -1977,12 +2263,14 @@ retry_send:
 			case PGM_IO_STATUS_WOULD_BLOCK:
 			case PGM_IO_STATUS_RATE_LIMITED:
 				sock->is_apdu_eagain = TRUE;
-				pgm_mutex_unlock (&sock->source_mutex);
-				pgm_rwlock_reader_unlock (&sock->lock);
+				pgm_time_cache_end ();
+				pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+				pgm_sock_reader_unlock (sock, &sock->lock);
 				return status;
 			case PGM_IO_STATUS_ERROR:
-				pgm_mutex_unlock (&sock->source_mutex);
-				pgm_rwlock_reader_unlock (&sock->lock);
+				pgm_time_cache_end ();
+				pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+				pgm_sock_reader_unlock (sock, &sock->lock);
 				return status;
 			default:
 				pgm_assert_not_reached();
@@ -1993,14 +2281,17 @@ retry_send:
 		sock->is_apdu_eagain = FALSE;
 		if (bytes_written)
 			*bytes_written = data_bytes_sent;
-		pgm_mutex_unlock (&sock->source_mutex);
-		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_time_cache_end ();
+		pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+		pgm_sock_reader_unlock (sock, &sock->lock);
 		return PGM_IO_STATUS_NORMAL;
 	}
 
-/* if non-blocking calculate total wire size and check rate limit */
+/* if non-blocking calculate total wire size and check rate limit, large
+ * APDUs are rate limited per packet.
+ */
 	STATE(is_rate_limited) = FALSE;
-	if (sock->is_nonblocking && sock->is_controlled_odata)
+	if (sock->is_nonblocking && sock->is_controlled_odata && STATE(apdu_length) <= PGM_MAX_APDU)
         {
 		const size_t header_length = pgm_pkt_offset (TRUE, pgmcc_family);
                 size_t tpdu_length = 0;
@@ -2018,8 +2309,10 @@ retry_send:
 				      sock->is_nonblocking))
 		{
 			sock->blocklen = tpdu_length;
-			pgm_mutex_unlock (&sock->source_mutex);
-			pgm_rwlock_reader_unlock (&sock->lock);
+			pgm_timer_arm_send (sock);
+			pgm_time_cache_end ();
+			pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+			pgm_sock_reader_unlock (sock, &sock->lock);
 			return PGM_IO_STATUS_RATE_LIMITED;
 		}
 		STATE(is_rate_limited) = TRUE;
@@ -2043,9 +2336,9 @@ retry_send:
 /* retrieve packet storage from transmit window */
 		header_length = pgm_pkt_offset (TRUE, pgmcc_family);
 		STATE(tsdu_length) = MIN( source_max_tsdu (sock, TRUE), STATE(apdu_length) - STATE(data_bytes_offset) );
-		STATE(skb) = pgm_alloc_skb (sock->max_tpdu);
+		STATE(skb) = pgm_sock_alloc_skb (sock, sock->max_tpdu);
 		STATE(skb)->sock = sock;
-		STATE(skb)->tstamp = pgm_time_update_now();
+		STATE(skb)->tstamp = pgm_time_cached();
 		pgm_skb_reserve (STATE(skb), (uint16_t)header_length);
 		pgm_skb_put (STATE(skb), (uint16_t)STATE(tsdu_length));
 
@@ -2060,7 +2353,7 @@ retry_send:
 
 /* ODATA */
 		STATE(skb)->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(sock->window));
-		STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(sock->window));
+		STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_repair_trail (sock->window));
 
 /* OPT_LENGTH */
 		opt_len					= (struct pgm_opt_length*)(STATE(skb)->pgm_data + 1);
@@ -2126,9 +2419,9 @@ retry_send:
 		STATE(skb)->pgm_header->pgm_checksum = pgm_csum_fold (pgm_csum_block_add (unfolded_header, STATE(unfolded_odata), (uint16_t)pgm_header_len));
 
 /* add to transmit window, skb::data set to payload */
-		pgm_spinlock_lock (&sock->txw_spinlock);
+		pgm_sock_spinlock_lock (sock, &sock->txw_spinlock);
 		pgm_txw_add (sock->window, STATE(skb));
-		pgm_spinlock_unlock (&sock->txw_spinlock);
+		pgm_sock_spinlock_unlock (sock, &sock->txw_spinlock);
 
 retry_one_apdu_send:
 		tpdu_length = (char*)STATE(skb)->tail - (char*)STATE(skb)->head;
@@ -2178,24 +2471,28 @@ retry_one_apdu_send:
 /* SPM heartbeats decay from last sent data packet */
 	reset_heartbeat_spm (sock, STATE(skb)->tstamp);
 /* increment socket statistics */
-	pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)bytes_sent);
-	sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]  += packets_sent;
-	sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT] += data_bytes_sent;
+	pgm_atomic_add64 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint64_t)bytes_sent);
+	pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT], packets_sent);
+	pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT], data_bytes_sent);
 	if (bytes_written)
 		*bytes_written = STATE(apdu_length);
-	pgm_mutex_unlock (&sock->source_mutex);
-	pgm_rwlock_reader_unlock (&sock->lock);
+	pgm_time_cache_end ();
+	pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+	pgm_sock_reader_unlock (sock, &sock->lock);
 	return PGM_IO_STATUS_NORMAL;
 
 blocked:
 	if (bytes_sent) {
 		reset_heartbeat_spm (sock, STATE(skb)->tstamp);
-		pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)bytes_sent);
-		sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]  += packets_sent;
-		sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT] += data_bytes_sent;
+		pgm_atomic_add64 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint64_t)bytes_sent);
+		pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT], packets_sent);
+		pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT], data_bytes_sent);
 	}
-	pgm_mutex_unlock (&sock->source_mutex);
-	pgm_rwlock_reader_unlock (&sock->lock);
+	if (PGM_SOCK_ENOBUFS == save_errno)
+		pgm_timer_arm_send (sock);
+	pgm_time_cache_end ();
+	pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+	pgm_sock_reader_unlock (sock, &sock->lock);
 	if (PGM_SOCK_ENOBUFS == save_errno)
 		return PGM_IO_STATUS_RATE_LIMITED;
 	if (sock->use_pgmcc)
@@ -2238,30 +2535,33 @@ pgm_send_skbv (
 	pgm_return_val_if_fail (NULL != sock, PGM_IO_STATUS_ERROR);
 	pgm_return_val_if_fail (count <= PGM_MAX_FRAGMENTS, PGM_IO_STATUS_ERROR);
 	if (PGM_LIKELY(count)) pgm_return_val_if_fail (NULL != vector, PGM_IO_STATUS_ERROR);
-	if (PGM_UNLIKELY(!pgm_rwlock_reader_trylock (&sock->lock)))
+	if (PGM_UNLIKELY(!pgm_sock_reader_trylock (sock, &sock->lock)))
 		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
 	if (PGM_UNLIKELY(!sock->is_bound ||
 	    sock->is_destroyed))
 	{
-		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_sock_reader_unlock (sock, &sock->lock);
 		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
 	}
 
-	pgm_mutex_lock (&sock->source_mutex);
+	pgm_sock_mutex_lock (sock, &sock->source_mutex);
+	pgm_time_cache_begin ();
 
 /* pass on zero length as cannot count vector lengths */
 	if (PGM_UNLIKELY(0 == count))
 	{
 		const int status = send_odata_copy (sock, NULL, 0, bytes_written);
-		pgm_mutex_unlock (&sock->source_mutex);
-		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_time_cache_end ();
+		pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+		pgm_sock_reader_unlock (sock, &sock->lock);
 		return status;
 	}
 	else if (1 == count)
 	{
 		const int status = send_odata (sock, vector[0], bytes_written);
-		pgm_mutex_unlock (&sock->source_mutex);
-		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_time_cache_end ();
+		pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+		pgm_sock_reader_unlock (sock, &sock->lock);
 		return status;
 	}
 
@@ -2272,7 +2572,7 @@ pgm_send_skbv (
 		goto retry_send;
 
 	STATE(is_rate_limited) = FALSE;
-	if (sock->is_nonblocking && sock->is_controlled_odata)
+	if (sock->is_nonblocking && sock->is_controlled_odata && (!is_one_apdu || count <= PGM_MAX_FRAGMENTS))
 	{
 		size_t total_tpdu_length = 0;
 
@@ -2285,8 +2585,10 @@ pgm_send_skbv (
 				      sock->is_nonblocking))
 		{
 			sock->blocklen = total_tpdu_length;
-			pgm_mutex_unlock (&sock->source_mutex);
-			pgm_rwlock_reader_unlock (&sock->lock);
+			pgm_timer_arm_send (sock);
+			pgm_time_cache_end ();
+			pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+			pgm_sock_reader_unlock (sock, &sock->lock);
 			return PGM_IO_STATUS_RATE_LIMITED;
 		}
 		STATE(is_rate_limited) = TRUE;
@@ -2299,15 +2601,17 @@ pgm_send_skbv (
 		for (unsigned i = 0; i < count; i++)
 		{
 			if (PGM_UNLIKELY(vector[i]->len > sock->max_tsdu_fragment)) {
-				pgm_mutex_unlock (&sock->source_mutex);
-				pgm_rwlock_reader_unlock (&sock->lock);
+				pgm_time_cache_end ();
+				pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+				pgm_sock_reader_unlock (sock, &sock->lock);
 				return PGM_IO_STATUS_ERROR;
 			}
 			STATE(apdu_length) += vector[i]->len;
 		}
 		if (PGM_UNLIKELY(STATE(apdu_length) > sock->max_apdu)) {
-			pgm_mutex_unlock (&sock->source_mutex);
-			pgm_rwlock_reader_unlock (&sock->lock);
+			pgm_time_cache_end ();
+			pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+			pgm_sock_reader_unlock (sock, &sock->lock);
 			return PGM_IO_STATUS_ERROR;
 		}
 	}
@@ -2321,7 +2625,7 @@ pgm_send_skbv (
 		
 		STATE(skb) = pgm_skb_get(vector[STATE(vector_index)]);
 		STATE(skb)->sock = sock;
-		STATE(skb)->tstamp = pgm_time_update_now();
+		STATE(skb)->tstamp = pgm_time_cached();
 
 		STATE(skb)->pgm_header = (struct pgm_header*)STATE(skb)->head;
 		STATE(skb)->pgm_data   = (struct pgm_data*)(STATE(skb)->pgm_header + 1);
@@ -2334,7 +2638,7 @@ pgm_send_skbv (
 
 /* ODATA */
 		STATE(skb)->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(sock->window));
-		STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(sock->window));
+		STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_repair_trail (sock->window));
 
 		if (is_one_apdu)
 		{
@@ -2375,9 +2679,9 @@ pgm_send_skbv (
 		STATE(skb)->pgm_header->pgm_checksum	= pgm_csum_fold (pgm_csum_block_add (unfolded_header, STATE(unfolded_odata), (uint16_t)header_length));
 
 /* add to transmit window, skb::data set to payload */
-		pgm_spinlock_lock (&sock->txw_spinlock);
+		pgm_sock_spinlock_lock (sock, &sock->txw_spinlock);
 		pgm_txw_add (sock->window, STATE(skb));
-		pgm_spinlock_unlock (&sock->txw_spinlock);
+		pgm_sock_spinlock_unlock (sock, &sock->txw_spinlock);
 retry_send:
 		pgm_assert ((char*)STATE(skb)->tail > (char*)STATE(skb)->head);
 		tpdu_length = (char*)STATE(skb)->tail - (char*)STATE(skb)->head;
@@ -2433,24 +2737,28 @@ retry_send:
 /* SPM heartbeats decay from last sent data packet */
 	reset_heartbeat_spm (sock, STATE(skb)->tstamp);
 /* increment socket statistics */
-	pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)bytes_sent);
-	sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]  += packets_sent;
-	sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT] += data_bytes_sent;
+	pgm_atomic_add64 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint64_t)bytes_sent);
+	pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT], packets_sent);
+	pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT], data_bytes_sent);
 	if (bytes_written)
 		*bytes_written = data_bytes_sent;
-	pgm_mutex_unlock (&sock->source_mutex);
-	pgm_rwlock_reader_unlock (&sock->lock);
+	pgm_time_cache_end ();
+	pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+	pgm_sock_reader_unlock (sock, &sock->lock);
 	return PGM_IO_STATUS_NORMAL;
 
 blocked:
 	if (bytes_sent) {
 		reset_heartbeat_spm (sock, STATE(skb)->tstamp);
-		pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)bytes_sent);
-		sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]  += packets_sent;
-		sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT] += data_bytes_sent;
+		pgm_atomic_add64 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint64_t)bytes_sent);
+		pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT], packets_sent);
+		pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT], data_bytes_sent);
 	}
-	pgm_mutex_unlock (&sock->source_mutex);
-	pgm_rwlock_reader_unlock (&sock->lock);
+	if (PGM_SOCK_ENOBUFS == save_errno)
+		pgm_timer_arm_send (sock);
+	pgm_time_cache_end ();
+	pgm_sock_mutex_unlock (sock, &sock->source_mutex);
+	pgm_sock_reader_unlock (sock, &sock->lock);
 	if (PGM_SOCK_ENOBUFS == save_errno)
 		return PGM_IO_STATUS_RATE_LIMITED;
 	if (sock->use_pgmcc)
@@ -2482,9 +2790,9 @@ send_rdata (
 /* pre-conditions */
 	pgm_assert (NULL != sock);
 	pgm_assert (NULL != skb);
-	pgm_assert ((char*)skb->tail > (char*)skb->head);
+	pgm_assert (pgm_skb_tpdu_length (skb) > 0);
 
-	tpdu_length = (char*)skb->tail - (char*)skb->head;
+	tpdu_length = pgm_skb_tpdu_length (skb);
 
 /* rate check including rdata specific limits */
 	if (sock->is_controlled_rdata &&
@@ -2502,7 +2810,7 @@ send_rdata (
 	rdata				= skb->pgm_data;
 	header->pgm_type		= PGM_RDATA;
 /* RDATA */
-        rdata->data_trail		= pgm_htonl (pgm_txw_trail(sock->window));
+        rdata->data_trail		= pgm_htonl (pgm_txw_repair_trail (sock->window));
 
         header->pgm_checksum		= 0;
 	const size_t header_length	= tpdu_length - pgm_ntohs(header->pgm_tsdu_length);
@@ -2519,14 +2827,26 @@ send_rdata (
 		return FALSE;
 	}
 
-	sent = pgm_sendto (sock,
-			   FALSE,			/* already rate limited */
-			   &sock->rdata_rate_control,
-			   TRUE,			/* with router alert */
-			   header,
-			   tpdu_length,
-			   (struct sockaddr*)&sock->send_gsr.gsr_group,
-			   pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+	if (NULL == skb->ref)
+		sent = pgm_sendto (sock,
+				   FALSE,			/* already rate limited */
+				   &sock->rdata_rate_control,
+				   TRUE,			/* with router alert */
+				   header,
+				   tpdu_length,
+				   (struct sockaddr*)&sock->send_gsr.gsr_group,
+				   pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+	else {
+		struct pgm_sk_buff_t* skbs[1] = { skb };
+		sent = pgm_sendto_skbv (sock,
+					FALSE,			/* already rate limited */
+					&sock->rdata_rate_control,
+					TRUE,			/* with router alert */
+					skbs,
+					1,
+					(struct sockaddr*)&sock->send_gsr.gsr_group,
+					pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+	}
 	if (sent < 0) {
 		const int save_errno = pgm_get_last_sock_error();
 		if (PGM_LIKELY(PGM_SOCK_EAGAIN == save_errno || PGM_SOCK_ENOBUFS == save_errno))
@@ -2537,7 +2857,7 @@ send_rdata (
 /* fall through silently on other errors */
 	}
 
-	const pgm_time_t now = pgm_time_update_now();
+	const pgm_time_t now = pgm_time_cached();
 
 	if (sock->use_pgmcc) {
 		sock->tokens -= pgm_fp8 (1);
@@ -2546,15 +2866,15 @@ send_rdata (
 
 /* re-set spm timer: we are already in the timer thread, no need to prod timers
  */
-	pgm_mutex_lock (&sock->timer_mutex);
+	pgm_sock_mutex_lock (sock, &sock->timer_mutex);
 	sock->spm_heartbeat_state = 1;
 	sock->next_heartbeat_spm = now + sock->spm_heartbeat_interval[sock->spm_heartbeat_state++];
-	pgm_mutex_unlock (&sock->timer_mutex);
+	pgm_sock_mutex_unlock (sock, &sock->timer_mutex);
 
 	pgm_txw_inc_retransmit_count (skb);
-	sock->cumulative_stats[PGM_PC_SOURCE_SELECTIVE_BYTES_RETRANSMITTED] += pgm_ntohs(header->pgm_tsdu_length);
-	sock->cumulative_stats[PGM_PC_SOURCE_SELECTIVE_MSGS_RETRANSMITTED]++;	/* impossible to determine APDU count */
-	pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)(tpdu_length + sock->iphdr_len));
+	pgm_stats_add (&sock->cumulative_stats[PGM_PC_SOURCE_SELECTIVE_BYTES_RETRANSMITTED], pgm_ntohs(header->pgm_tsdu_length));
+	pgm_stats_inc (&sock->cumulative_stats[PGM_PC_SOURCE_SELECTIVE_MSGS_RETRANSMITTED]);	/* impossible to determine APDU count */
+	pgm_atomic_add64 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint64_t)(tpdu_length + sock->iphdr_len));
 	return TRUE;
 }
 
@@ -63,6 +63,15 @@ static gboolean mock_is_valid_spmr = TRUE;
 static gboolean mock_is_valid_ack = TRUE;
 static gboolean mock_is_valid_nak = TRUE;
 static gboolean mock_is_valid_nnak = TRUE;
+static char mock_sent_buf[TEST_MAX_TPDU];
+static size_t mock_sent_len = 0;
+/* transmit window contents by sequence, and TPDUs sent when parity was requested */
+static struct pgm_sk_buff_t* mock_txw_skbs[64];
+static unsigned mock_skbv_sent = 0;
+static unsigned mock_skbv_calls = 0;
+static guint32 mock_proactive_tg_sqn[8];
+static unsigned mock_proactive_sent[8];
+static unsigned mock_proactive_count = 0;
 
 
 #define pgm_txw_get_unfolded_checksum	mock_pgm_txw_get_unfolded_checksum
@@ -84,8 +93,11 @@ static gboolean mock_is_valid_nnak = TRUE;
 #define pgm_csum_block_add		mock_pgm_csum_block_add
 #define pgm_csum_fold			mock_pgm_csum_fold
 #define pgm_sendto_hops			mock_pgm_sendto_hops
+#define pgm_sendto_skbv			mock_pgm_sendto_skbv
 #define pgm_time_update_now		mock_pgm_time_update_now
 #define pgm_setsockopt			mock_pgm_setsockopt
+#define pgm_timer_arm			mock_pgm_timer_arm
+#define pgm_timer_arm_rate		mock_pgm_timer_arm_rate
 
 
 #define SOURCE_DEBUG
@@ -298,6 +310,8 @@ mock_pgm_txw_add (
 {
 	g_debug ("mock_pgm_txw_add (window:%p skb:%p)",
 		(gpointer)window, (gpointer)skb);
+	window->lead++;
+	mock_txw_skbs[window->lead % G_N_ELEMENTS(mock_txw_skbs)] = skb;
 }
 
 struct pgm_sk_buff_t*
@@ -308,7 +322,7 @@ mock_pgm_txw_peek (
 {
 	g_debug ("mock_pgm_txw_peek (window:%p sequence:%" G_GUINT32_FORMAT ")",
 		(gpointer)window, sequence);
-	return NULL;
+	return mock_txw_skbs[sequence % G_N_ELEMENTS(mock_txw_skbs)];
 }
 
 bool
@@ -316,14 +330,20 @@ mock_pgm_txw_retransmit_push (
 	pgm_txw_t* const		window,
 	const uint32_t			sequence,
 	const bool			is_parity,
-	const uint8_t			tg_sqn_shift
+	const uint8_t			tg_sqn_shift,
+	const pgm_time_t		nak_tstamp
 	)
 {
-	g_debug ("mock_pgm_txw_retransmit_push (window:%p sequence:%" G_GUINT32_FORMAT " is-parity:%s tg-sqn-shift:%d)",
+	g_debug ("mock_pgm_txw_retransmit_push (window:%p sequence:%" G_GUINT32_FORMAT " is-parity:%s tg-sqn-shift:%d nak-tstamp:%" PGM_TIME_FORMAT ")",
 		(gpointer)window,
 		sequence,
 		is_parity ? "YES" : "NO",
-		tg_sqn_shift);
+		tg_sqn_shift,
+		nak_tstamp);
+	if (is_parity && mock_proactive_count < G_N_ELEMENTS(mock_proactive_tg_sqn)) {
+		mock_proactive_tg_sqn[mock_proactive_count] = sequence & (0xffffffff << tg_sqn_shift);
+		mock_proactive_sent[mock_proactive_count++] = mock_skbv_sent;
+	}
 	return TRUE;
 }
 
@@ -360,13 +380,14 @@ mock_pgm_txw_retransmit_try_peek (
 	return generate_odata (); 
 }
 
-void
+pgm_time_t
 mock_pgm_txw_retransmit_remove_head (
 	pgm_txw_t* const		window
 	)
 {
 	g_debug ("mock_pgm_txw_retransmit_remove_head (window:%p)",
 		(gpointer)window);
+	return 0;
 }
 
 void
@@ -492,12 +513,68 @@ mock_pgm_sendto_hops (
 		(unsigned)len,
 		saddr,
 		tolen);
+	if (len <= sizeof(mock_sent_buf)) {
+		memcpy (mock_sent_buf, buf, len);
+		mock_sent_len = len;
+	}
+	return len;
+}
+
+PGM_GNUC_INTERNAL
+ssize_t
+mock_pgm_sendto_skbv (
+	pgm_sock_t*			sock,
+	bool				use_rate_limit,
+	pgm_rate_t*			minor_rate_control,
+	bool				use_router_alert,
+	struct pgm_sk_buff_t*const*	skbs,
+	unsigned			count,
+	const struct sockaddr*		to,
+	socklen_t			tolen
+	)
+{
+	size_t len = 0;
+	for (unsigned i = 0; i < count; i++)
+		len += pgm_skb_tpdu_length (skbs[i]);
+	g_debug ("mock_pgm_sendto_skbv (sock:%p use-rate-limit:%s minor-rate-control:%p use-router-alert:%s skbs:%p count:%u len:%u tolen:%d)",
+		(gpointer)sock,
+		use_rate_limit ? "YES" : "NO",
+		(gpointer)minor_rate_control,
+		use_router_alert ? "YES" : "NO",
+		(gconstpointer)skbs,
+		count,
+		(unsigned)len,
+		tolen);
+	mock_skbv_sent += count;
+	mock_skbv_calls++;
 	return len;
 }
 
+/** timer module */
+#ifdef HAVE_TIMERFD_CREATE
+PGM_GNUC_INTERNAL
+void
+mock_pgm_timer_arm (
+	pgm_sock_t* const		sock,
+	const pgm_time_t		rate_expiry
+	)
+{
+}
+
+PGM_GNUC_INTERNAL
+void
+mock_pgm_timer_arm_rate (
+	pgm_sock_t* const		sock,
+	const pgm_time_t		send_expiry
+	)
+{
+}
+#endif
+
 /** time module */
 static pgm_time_t _mock_pgm_time_update_now (void);
 pgm_time_update_func mock_pgm_time_update_now = _mock_pgm_time_update_now;
+PGM_THREAD_LOCAL struct pgm_time_cache_t pgm_time_cache;
 
 static
 pgm_time_t
@@ -583,6 +660,51 @@ START_TEST (test_send_pass_002)
 }
 END_TEST
 
+/* pro-active parity follows the deferred super-buffer holding the group end */
+START_TEST (test_send_pass_003)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->use_udp_gso = TRUE;
+	sock->udp_gso_segments = 8;
+	sock->use_proactive_parity = TRUE;
+	sock->rs_proactive_h = 1;
+	sock->tg_sqn_shift = 2;
+	mock_skbv_sent = 0;
+	mock_proactive_count = 0;
+	const gsize apdu_length = 6 * sock->max_tsdu_fragment;
+	guint8 buffer[ apdu_length ];
+	gsize bytes_written;
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send (sock, buffer, apdu_length, &bytes_written), "send not normal");
+	fail_unless ((gssize)apdu_length == bytes_written, "send underrun");
+	fail_unless (6 == mock_skbv_sent, "unexpected TPDUs sent");
+/* sequences 1-6, group 0-3 ends within the one batch */
+	fail_unless (1 == mock_proactive_count, "unexpected parity requests");
+	fail_unless (0 == mock_proactive_tg_sqn[0], "unexpected transmission group");
+	fail_unless (6 == mock_proactive_sent[0], "parity requested before group sent");
+}
+END_TEST
+
+/* without segmentation offload fragments are batched per send call */
+START_TEST (test_send_pass_004)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->tx_batch_size = 4;
+	mock_skbv_sent = 0;
+	mock_skbv_calls = 0;
+	const gsize apdu_length = 6 * sock->max_tsdu_fragment;
+	guint8 buffer[ apdu_length ];
+	gsize bytes_written;
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send (sock, buffer, apdu_length, &bytes_written), "send not normal");
+	fail_unless ((gssize)apdu_length == bytes_written, "send underrun");
+	fail_unless (6 == mock_skbv_sent, "unexpected TPDUs sent");
+	fail_unless (2 == mock_skbv_calls, "unexpected send calls");
+}
+END_TEST
+
 START_TEST (test_send_fail_001)
 {
 	guint8 buffer[ TEST_TXW_SQNS * TEST_MAX_TPDU ];
@@ -592,6 +714,76 @@ START_TEST (test_send_fail_001)
 }
 END_TEST
 
+/* target:
+ *	PGMIOStatus
+ *	pgm_send_ref (
+ *		pgm_sock_t*		sock,
+ *		gconstpointer		apdu,
+ *		gsize			apdu_length,
+ *		pgm_release_func_t	release,
+ *		gpointer		user_data,
+ *		gsize*			bytes_written
+ *		)
+ */
+
+static
+void
+release_apdu (
+	gpointer	buffer,
+	gpointer	user_data
+	)
+{
+	guint* released = (guint*)user_data;
+	g_debug ("release_apdu (buffer:%p user-data:%p)", buffer, user_data);
+	(*released)++;
+}
+
+/* fits one tpdu, copied and released immediately */
+START_TEST (test_send_ref_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	const gsize apdu_length = 100;
+	guint8 buffer[ apdu_length ];
+	gsize bytes_written;
+	guint released = 0;
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_ref (sock, buffer, apdu_length, release_apdu, &released, &bytes_written), "send_ref not normal");
+	fail_unless ((gssize)apdu_length == bytes_written, "send_ref underrun");
+	fail_unless (1 == released, "release not called");
+}
+END_TEST
+
+/* large apdu, payload referenced by the transmit window */
+START_TEST (test_send_ref_pass_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	const gsize apdu_length = 16000;
+	guint8 buffer[ apdu_length ];
+	gsize bytes_written;
+	guint released = 0;
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_ref (sock, buffer, apdu_length, release_apdu, &released, &bytes_written), "send_ref not normal");
+	fail_unless ((gssize)apdu_length == bytes_written, "send_ref underrun");
+	fail_unless (0 == released, "released whilst in transmit window");
+	fail_unless (NULL == sock->pkt_dontwait_state.ref, "reference not dropped");
+}
+END_TEST
+
+START_TEST (test_send_ref_fail_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	const gsize apdu_length = 100;
+	guint8 buffer[ apdu_length ];
+	gsize bytes_written;
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_ref (NULL, buffer, apdu_length, release_apdu, NULL, &bytes_written), "send_ref not error");
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_ref (sock, buffer, apdu_length, NULL, NULL, &bytes_written), "send_ref not error");
+}
+END_TEST
+
 /* target:
  *	PGMIOStatus
  *	pgm_sendv (
@@ -768,6 +960,32 @@ START_TEST (test_send_spm_pass_001)
 }
 END_TEST
 
+/* late join advertises OPT_JOIN bounded by the window trail */
+START_TEST (test_send_spm_pass_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->late_join = 10;
+	pgm_atomic_write32 (&sock->window->lead, 100);
+	pgm_atomic_write32 (&sock->window->trail, 95);
+	mock_sent_len = 0;
+	fail_unless (TRUE == pgm_send_spm (sock, 0), "send_spm failed");
+	const size_t spm_len = sizeof(struct pgm_header) + sizeof(struct pgm_spm) + sizeof(struct pgm_opt_length);
+	fail_unless ((spm_len + sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_join)) == mock_sent_len, "unexpected length");
+	const struct pgm_header* header = (const struct pgm_header*)mock_sent_buf;
+	fail_unless (PGM_OPT_PRESENT == (header->pgm_options & PGM_OPT_PRESENT), "options not present");
+	const struct pgm_opt_header* opt_header = (const struct pgm_opt_header*)(mock_sent_buf + spm_len);
+	fail_unless ((PGM_OPT_JOIN | PGM_OPT_END) == opt_header->opt_type, "not OPT_JOIN");
+	fail_unless ((sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_join)) == opt_header->opt_length, "unexpected option length");
+	const struct pgm_opt_join* opt_join = (const struct pgm_opt_join*)(opt_header + 1);
+	fail_unless (95 == pgm_ntohl (opt_join->opt_join_min), "join_min not bounded by trail");
+/* within the window the join point is late_join sequences back */
+	pgm_atomic_write32 (&sock->window->trail, 0);
+	fail_unless (TRUE == pgm_send_spm (sock, 0), "send_spm failed");
+	fail_unless (91 == pgm_ntohl (opt_join->opt_join_min), "unexpected join_min");
+}
+END_TEST
+
 START_TEST (test_send_spm_fail_001)
 {
 	pgm_send_spm (NULL, 0);
@@ -1158,8 +1376,17 @@ make_test_suite (void)
 	tcase_add_checked_fixture (tc_send, mock_setup, NULL);
 	tcase_add_test (tc_send, test_send_pass_001);
 	tcase_add_test (tc_send, test_send_pass_002);
+	tcase_add_test (tc_send, test_send_pass_003);
+	tcase_add_test (tc_send, test_send_pass_004);
 	tcase_add_test (tc_send, test_send_fail_001);
 
+	TCase* tc_send_ref = tcase_create ("send-ref");
+	suite_add_tcase (s, tc_send_ref);
+	tcase_add_checked_fixture (tc_send_ref, mock_setup, NULL);
+	tcase_add_test (tc_send_ref, test_send_ref_pass_001);
+	tcase_add_test (tc_send_ref, test_send_ref_pass_002);
+	tcase_add_test (tc_send_ref, test_send_ref_fail_001);
+
 	TCase* tc_sendv = tcase_create ("sendv");
 	suite_add_tcase (s, tc_sendv);
 	tcase_add_checked_fixture (tc_sendv, mock_setup, NULL);
@@ -1180,6 +1407,7 @@ make_test_suite (void)
 	suite_add_tcase (s, tc_send_spm);
 	tcase_add_checked_fixture (tc_send_spm, mock_setup, NULL);
 	tcase_add_test (tc_send_spm, test_send_spm_pass_001);
+	tcase_add_test (tc_send_spm, test_send_spm_pass_002);
 #ifndef PGM_CHECK_NOFORK
 	tcase_add_test_raise_signal (tc_send_spm, test_send_spm_fail_001, SIGABRT);
 #endif
@@ -26,6 +26,7 @@
 #endif
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #ifdef _WIN32
 #	define WIN32_LEAN_AND_MEAN
 #	include <windows.h>
@@ -41,6 +42,7 @@
 
 pgm_time_update_func		pgm_time_update_now PGM_GNUC_READ_MOSTLY;
 pgm_time_since_epoch_func	pgm_time_since_epoch PGM_GNUC_READ_MOSTLY;
+PGM_THREAD_LOCAL struct pgm_time_cache_t pgm_time_cache;
 
 
 /* locals */
@@ -63,6 +65,24 @@ pgm_time_since_epoch_func	pgm_time_since_epoch PGM_GNUC_READ_MOSTLY;
 static volatile uint32_t	time_ref_count = 0;
 static pgm_time_t		rel_offset PGM_GNUC_READ_MOSTLY = 0;
 
+#ifdef HAVE_GETTIMEOFDAY
+/* system clock calibration, published whole by pointer exchange.  records are
+ * filled in rotation by one writer at a time at most every 100ms of the time
+ * source, so a record is only reused several hundred milliseconds after
+ * readers have moved on.
+ */
+struct pgm_realtime_calibration_t {
+	pgm_time_t		realtime;			/* system clock */
+	pgm_time_t		now;				/* time source */
+};
+
+#	define PGM_REALTIME_CALIBRATIONS	4
+static struct pgm_realtime_calibration_t		realtime_calibrations[ PGM_REALTIME_CALIBRATIONS ];
+static struct pgm_realtime_calibration_t* volatile	realtime_calibration = &realtime_calibrations[0];
+static unsigned						realtime_calibration_next = 1;
+static pgm_spinlock_t					realtime_lock;
+#endif
+
 #ifdef _WIN32
 static UINT			wTimerRes = 0;
 #endif
@@ -73,6 +93,9 @@ static void			pgm_time_conv_from_reset (const pgm_time_t*const restrict, time_t*
 #if defined(HAVE_CLOCK_GETTIME)
 #	include <time.h>
 static pgm_time_t		pgm_clock_update (void);
+#	ifdef CLOCK_MONOTONIC_COARSE
+static pgm_time_t		pgm_coarse_update (void);
+#	endif
 #endif
 #ifdef HAVE_FTIME
 #	include <sys/timeb.h>
@@ -170,6 +193,20 @@ static pgm_time_t		pgm_rtc_update (void);
 #	elif defined(_MSC_VER)
 #		include <intrin.h>
 #	endif
+#	ifndef _WIN32
+#		include <unistd.h>
+#		include <fcntl.h>
+#		include <sys/stat.h>
+#		ifdef __linux__
+#			include <sys/mman.h>
+#			include <sys/syscall.h>
+#			include <linux/perf_event.h>
+#		endif
+#	endif
+#	define PGM_TSC_STATE_FILE		"pgm-tsc"
+#	define PGM_TSC_CALIBRATION_USEC		5000
+#	define PGM_TSC_CALIBRATION_ROUNDS	3
+#	define PGM_TSC_CALIBRATION_PPM		100
 #	define TSC_NS_SCALE	10 /* 2^10, carefully chosen */
 #	define TSC_US_SCALE	20
 static uint_fast32_t		tsc_khz PGM_GNUC_READ_MOSTLY = 0;
@@ -263,6 +300,14 @@ pgm_time_init (
 
 	pgm_time_since_epoch = pgm_time_conv;
 
+#ifdef HAVE_GETTIMEOFDAY
+/* calibration is specific to the time source */
+	pgm_spinlock_init (&realtime_lock);
+	memset (realtime_calibrations, 0, sizeof (realtime_calibrations));
+	realtime_calibration = &realtime_calibrations[0];
+	realtime_calibration_next = 1;
+#endif
+
 	switch (pgm_timer[0]) {
 #ifdef HAVE_FTIME
 	case 'F':
@@ -272,6 +317,21 @@ pgm_time_init (
 #endif
 #ifdef HAVE_CLOCK_GETTIME
 	case 'C':
+#	ifdef CLOCK_MONOTONIC_COARSE
+/* COARSE, kernel tick resolution of 1-10ms.  rate limiting refills at most one
+ * millisecond of tokens per check and so under-runs the configured rate when
+ * the tick is longer.
+ */
+		if ('O' == pgm_timer[1]) {
+			struct timespec resolution;
+			clock_getres (CLOCK_MONOTONIC_COARSE, &resolution);
+			pgm_minor (_("Using coarse clock_gettime() timer with %ldus resolution."),
+				(long)nsecs_to_usecs (resolution.tv_nsec));
+			pgm_time_update_now	= pgm_coarse_update;
+			pgm_time_since_epoch	= pgm_time_conv_from_reset;
+			break;
+		}
+#	endif
 		pgm_minor (_("Using clock_gettime() timer."));
 		pgm_time_update_now	= pgm_clock_update;
 		break;
@@ -373,22 +433,9 @@ pgm_time_init (
 		char	*rdtsc_frequency;
 
 #ifdef HAVE_PROC_CPUINFO
-/* attempt to parse clock ticks from kernel
+/* "cpu MHz" is the current core clock under frequency scaling and not the TSC
+ * rate, calibration below prefers the kernel's own TSC calibration.
  */
-		FILE	*fp = fopen ("/proc/cpuinfo", "r");
-		if (fp)
-		{
-			char buffer[1024];
-			while (!feof(fp) && fgets (buffer, sizeof(buffer), fp))
-			{
-				if (strstr (buffer, "cpu MHz")) {
-					const char *p = strchr (buffer, ':');
-					if (p) tsc_khz = atoi (p + 1) * 1000;
-					break;
-				}
-			}
-			fclose (fp);
-		}
 #elif defined(_WIN32)
 /* core frequency HKLM/Hardware/Description/System/CentralProcessor/0/~Mhz
  */
@@ -512,8 +559,11 @@ pgm_time_init (
 	pgm_time_update_now();
 
 /* calculate relative time offset */
-#if defined(HAVE_DEV_RTC) || defined(HAVE_RDTSC) || defined(HAVE_DEV_HPET) || defined(_WIN32)
+#if defined(HAVE_DEV_RTC) || defined(HAVE_RDTSC) || defined(HAVE_DEV_HPET) || defined(_WIN32) || (defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC_COARSE))
 	if (	0
+#	if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC_COARSE)
+		|| pgm_time_update_now == pgm_coarse_update
+#	endif
 #	ifdef HAVE_DEV_RTC
 		|| pgm_time_update_now == pgm_rtc_update
 #	endif
@@ -579,6 +629,9 @@ pgm_time_shutdown (void)
 #ifdef _WIN32
 	timeEndPeriod (wTimerRes);
 #endif
+#ifdef HAVE_GETTIMEOFDAY
+	pgm_spinlock_free (&realtime_lock);
+#endif
 
 #ifdef HAVE_DEV_RTC
 	if (pgm_time_update_now == pgm_rtc_update)
@@ -592,6 +645,56 @@ pgm_time_shutdown (void)
 }
 
 #ifdef HAVE_GETTIMEOFDAY
+/* re-calibrate the system clock against the time source, reading the time
+ * source first so that conversions err before the current time.  concurrent
+ * callers continue with the current calibration.
+ */
+
+static
+void
+pgm_realtime_calibrate (void)
+{
+	if (!pgm_spinlock_trylock (&realtime_lock))
+		return;
+	const struct pgm_realtime_calibration_t* current = realtime_calibration;
+	const pgm_time_t now = pgm_time_update_now();
+	if (0 == current->realtime || now - current->now >= msecs_to_usecs (100))
+	{
+		struct pgm_realtime_calibration_t* next = &realtime_calibrations[ realtime_calibration_next++ % PGM_REALTIME_CALIBRATIONS ];
+		struct timeval	gettimeofday_now;
+		gettimeofday (&gettimeofday_now, NULL);
+		next->realtime	= secs_to_usecs (gettimeofday_now.tv_sec) + gettimeofday_now.tv_usec;
+		next->now	= now;
+		pgm_atomic_exchange_pointer ((void* volatile*)&realtime_calibration, next);
+	}
+	pgm_spinlock_unlock (&realtime_lock);
+}
+
+/* convert a system clock time stamp, such as a kernel receive time stamp, in
+ * microseconds since the epoch to the active time source.
+ *
+ * the clock offset is re-calibrated when a time stamp is more than 100ms from
+ * the last calibration in either direction, such that a stepped system clock
+ * is followed.
+ */
+
+PGM_GNUC_INTERNAL
+pgm_time_t
+pgm_time_from_realtime (
+	const pgm_time_t	realtime
+	)
+{
+	if (pgm_time_update_now == pgm_gettimeofday_update)
+		return realtime;
+	const struct pgm_realtime_calibration_t* calibration = realtime_calibration;
+	const pgm_time_t drift = realtime > calibration->realtime ? realtime - calibration->realtime : calibration->realtime - realtime;
+	if (PGM_UNLIKELY(drift > msecs_to_usecs (100))) {
+		pgm_realtime_calibrate ();
+		calibration = realtime_calibration;
+	}
+	return realtime - (calibration->realtime - calibration->now);
+}
+
 static
 pgm_time_t
 pgm_gettimeofday_update (void)
@@ -625,6 +728,22 @@ pgm_clock_update (void)
 	else
 		return last = now;
 }
+
+#	ifdef CLOCK_MONOTONIC_COARSE
+/* vDSO read of the last timer tick without touching the clock source, for
+ * deployments that tolerate millisecond resolution in rate limiting and timers.
+ */
+
+static
+pgm_time_t
+pgm_coarse_update (void)
+{
+	struct timespec		clock_now;
+
+	clock_gettime (CLOCK_MONOTONIC_COARSE, &clock_now);
+	return secs_to_usecs (clock_now.tv_sec) + nsecs_to_usecs (clock_now.tv_nsec);
+}
+#	endif
 #endif /* HAVE_CLOCK_GETTIME */
 
 #ifdef HAVE_FTIME
@@ -800,8 +919,219 @@ pgm_rdtsc (void)
 }
 
 #	ifndef _WIN32
-/* determine ratio of ticks to nano-seconds, use /dev/rtc for high accuracy
- * millisecond timer and convert.
+/* TSC frequency cached between runs, keyed by processor signature and brand as
+ * the measured value is only valid for the same model.
+ */
+
+static
+void
+pgm_tsc_state_key (
+	char*		key,
+	const size_t	len
+	)
+{
+	pgm_cpu_t cpu;
+	pgm_cpuid (&cpu);
+	pgm_snprintf_s (key, len, _TRUNCATE, "%08" PRIx32 " %s", cpu.signature, cpu.brand);
+}
+
+/* per-user state file, PGM_TSC_STATE or under XDG_RUNTIME_DIR, returns NULL
+ * when neither is set.
+ */
+
+static
+char*
+pgm_tsc_state_path (void)
+{
+	char	*path, *dir;
+	size_t	 envlen;
+	errno_t	 err;
+
+	err = pgm_dupenv_s (&path, &envlen, "PGM_TSC_STATE");
+	if (0 == err && envlen > 0)
+		return path;
+	err = pgm_dupenv_s (&dir, &envlen, "XDG_RUNTIME_DIR");
+	if (0 != err || 0 == envlen)
+		return NULL;
+	envlen = strlen (dir) + 1 + sizeof (PGM_TSC_STATE_FILE);
+	path = pgm_malloc (envlen);
+	pgm_snprintf_s (path, envlen, _TRUNCATE, "%s/%s", dir, PGM_TSC_STATE_FILE);
+	pgm_free (dir);
+	return path;
+}
+
+/* trust only a regular file owned by this user and writable by no other.
+ */
+
+static
+uint_fast32_t
+pgm_tsc_load_state (void)
+{
+	char		 key[128], buffer[256];
+	char		*path = pgm_tsc_state_path ();
+	uint_fast32_t	 khz = 0;
+	struct stat	 st;
+	FILE		*fp;
+	int		 fd;
+
+	if (NULL == path)
+		return 0;
+	fd = open (path, O_RDONLY | O_NOFOLLOW);
+	pgm_free (path);
+	if (-1 == fd)
+		return 0;
+	if (0 != fstat (fd, &st) ||
+	    !S_ISREG (st.st_mode) ||
+	    st.st_uid != geteuid() ||
+	    (st.st_mode & (S_IWGRP | S_IWOTH)) ||
+	    NULL == (fp = fdopen (fd, "r")))
+	{
+		close (fd);
+		return 0;
+	}
+	pgm_tsc_state_key (key, sizeof (key));
+	if (fgets (buffer, sizeof (buffer), fp))
+	{
+		char *p = strrchr (buffer, '\t');
+		if (p) {
+			*p++ = '\0';
+			if (0 == strcmp (buffer, key))
+				khz = strtoul (p, NULL, 10);
+		}
+	}
+	fclose (fp);
+	return khz;
+}
+
+/* write to a private temporary file and rename into place so that concurrent
+ * processes only see a complete record.
+ */
+
+static
+void
+pgm_tsc_save_state (
+	const uint_fast32_t	khz
+	)
+{
+	char	 key[128], tmp_path[1024];
+	char	*path = pgm_tsc_state_path ();
+	FILE	*fp;
+	int	 fd;
+
+	if (NULL == path)
+		return;
+	pgm_tsc_state_key (key, sizeof (key));
+	pgm_snprintf_s (tmp_path, sizeof (tmp_path), _TRUNCATE, "%s.XXXXXX", path);
+/* mkstemp creates exclusively with mode 0600 */
+	fd = mkstemp (tmp_path);
+	if (-1 != fd) {
+		fp = fdopen (fd, "w");
+		if (NULL == fp) {
+			close (fd);
+		} else {
+			const bool is_written = (fprintf (fp, "%s\t%" PRIuFAST32 "\n", key, khz) > 0);
+			if (0 == fclose (fp) && is_written && 0 == rename (tmp_path, path)) {
+				pgm_free (path);
+				return;
+			}
+		}
+		unlink (tmp_path);
+	}
+	pgm_minor (_("Cannot save TSC frequency to \"%s\"."), path);
+	pgm_free (path);
+}
+
+#		ifdef __linux__
+/* kernel TSC calibration as exported for user-space conversion of perf event
+ * time stamps, ns = (tsc * time_mult) >> time_shift.
+ */
+
+static
+uint_fast32_t
+pgm_tsc_khz_from_perf (void)
+{
+	struct perf_event_attr	 attr;
+	struct perf_event_mmap_page* pc;
+	uint_fast32_t		 khz = 0;
+	const long		 page_size = sysconf (_SC_PAGESIZE);
+	int			 fd;
+
+	memset (&attr, 0, sizeof (attr));
+	attr.type		= PERF_TYPE_SOFTWARE;
+	attr.size		= sizeof (attr);
+	attr.config		= PERF_COUNT_SW_DUMMY;
+	attr.disabled		= 1;
+	attr.exclude_kernel	= 1;
+	attr.exclude_hv		= 1;
+	fd = (int)syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	if (-1 == fd)
+		return 0;
+	pc = mmap (NULL, page_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (MAP_FAILED != pc) {
+		if (pc->cap_user_time && pc->time_mult)
+			khz = (uint_fast32_t)((UINT64_C(1000000) << pc->time_shift) / pc->time_mult);
+		munmap (pc, page_size);
+	}
+	close (fd);
+	return khz;
+}
+#		endif /* __linux__ */
+
+#		ifdef HAVE_CLOCK_GETTIME
+/* measure the TSC against the raw monotonic clock over a few milliseconds.  each
+ * clock read is bracketed by TSC reads, the bracket width bounds the error of
+ * a round, the tightest round is used if within PGM_TSC_CALIBRATION_PPM.
+ */
+
+static
+uint_fast32_t
+pgm_tsc_khz_from_clock (void)
+{
+#			ifdef CLOCK_MONOTONIC_RAW
+	const clockid_t	 clock_id = CLOCK_MONOTONIC_RAW;
+#			else
+	const clockid_t	 clock_id = CLOCK_MONOTONIC;
+#			endif
+	uint_fast32_t	 khz = 0;
+	uint64_t	 best_error = UINT64_MAX, best_ticks = 0;
+
+	for (unsigned i = 0; i < PGM_TSC_CALIBRATION_ROUNDS; i++)
+	{
+		struct timespec	 ts0, ts1;
+		pgm_time_t	 a0, b0, a1, b1;
+		uint64_t	 ns;
+
+		a0 = pgm_rdtsc();
+		if (0 != clock_gettime (clock_id, &ts0))
+			return 0;
+		b0 = pgm_rdtsc();
+		do {
+			a1 = pgm_rdtsc();
+			clock_gettime (clock_id, &ts1);
+			b1 = pgm_rdtsc();
+			ns = secs_to_nsecs (ts1.tv_sec - ts0.tv_sec) + ts1.tv_nsec - ts0.tv_nsec;
+		} while (ns < usecs_to_nsecs (PGM_TSC_CALIBRATION_USEC));
+
+		if (b0 < a0 || a1 < b0 || b1 < a1)
+			continue;
+		const uint64_t ticks = ((a1 + b1) / 2) - ((a0 + b0) / 2);
+		const uint64_t error = (b0 - a0) + (b1 - a1);
+		if (error < best_error) {
+			best_error = error;
+			best_ticks = ticks;
+			khz = (uint_fast32_t)((ticks * 1000000) / ns);
+		}
+	}
+
+	if (0 == khz || best_error * (1000000 / PGM_TSC_CALIBRATION_PPM) > best_ticks)
+		return 0;
+	return khz;
+}
+#		endif /* HAVE_CLOCK_GETTIME */
+
+/* determine ratio of ticks to nano-seconds, in order of preference kernel
+ * calibration, processor enumeration, the cached state of an earlier
+ * measurement, a short measurement, and lastly a long benchmark.
  *
  * WARNING: time is relative to start of timer.
  */
@@ -817,16 +1147,11 @@ pgm_tsc_init (
  */
 	FILE	*fp = fopen ("/proc/cpuinfo", "r");
 	char	buffer[1024], *flags = NULL;
-	int	tmp_tsc_mhz = 0;
-	bool	ret = FALSE;
 	if (fp)
 	{
 		while (!feof(fp) && fgets (buffer, sizeof(buffer), fp))
 		{
-			if (strstr (buffer, "cpu MHz")) {
-				const char *p = strchr (buffer, ':');
-				if (p) tmp_tsc_mhz = atoi (p + 1) * 1000;
-			} else if (strstr (buffer, "flags")) {
+			if (strstr (buffer, "flags")) {
 				flags = strchr (buffer, ':');
 				break;
 			}
@@ -837,19 +1162,48 @@ pgm_tsc_init (
 		pgm_warn (_("Linux kernel reports no Time Stamp Counter (TSC)."));
 /* force both to stable clocks even though one might be OK */
 		pgm_time_update_now	= pgm_gettimeofday_update;
-		ret = TRUE;
+		return TRUE;
 	} else if (!strstr (flags, " constant_tsc")) {
 		pgm_warn (_("Linux kernel reports non-constant Time Stamp Counter (TSC)."));
 /* force both to stable clocks even though one might be OK */
 		pgm_time_update_now	= pgm_gettimeofday_update;
-		ret = TRUE;
+		return TRUE;
 	}
+#		endif /* HAVE_PROC_CPUINFO */
 
-/* Only return in case the kernel doesn't report 0 as cpu MHz */
-	if ((tmp_tsc_mhz != 0) && ret)
+#		ifdef __linux__
+	tsc_khz = pgm_tsc_khz_from_perf ();
+	if (tsc_khz > 0) {
+		pgm_minor (_("TSC frequency read from kernel calibration."));
 		return TRUE;
+	}
+#		endif
 
-#		endif /* HAVE_PROC_CPUINFO */
+	{
+		pgm_cpu_t cpu;
+		pgm_cpuid (&cpu);
+/* a TSC that varies with frequency scaling does not tick at the enumerated rate */
+		if (cpu.has_invariant_tsc && cpu.tsc_khz > 0) {
+			tsc_khz = cpu.tsc_khz;
+			pgm_minor (_("TSC frequency read from CPUID."));
+			return TRUE;
+		}
+	}
+
+	tsc_khz = pgm_tsc_load_state ();
+	if (tsc_khz > 0) {
+		pgm_minor (_("TSC frequency loaded from saved state."));
+		return TRUE;
+	}
+
+#		ifdef HAVE_CLOCK_GETTIME
+	tsc_khz = pgm_tsc_khz_from_clock ();
+	if (tsc_khz > 0) {
+		pgm_minor (_("TSC frequency measured against system clock."));
+		pgm_tsc_save_state (tsc_khz);
+		return TRUE;
+	}
+#		endif
 
 	pgm_time_t		start, stop, elapsed;
 	const pgm_time_t	calibration_usec = secs_to_usecs (4);
@@ -890,6 +1244,7 @@ pgm_tsc_init (
 		   "system. This value is dependent upon the CPU clock speed and "
 		   "architecture and should be determined separately for each server."),
 		   tsc_khz);
+	pgm_tsc_save_state (tsc_khz);
 	return TRUE;
 }
 #	endif
@@ -24,6 +24,8 @@
 #include <signal.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <glib.h>
 #include <check.h>
 
@@ -151,6 +153,176 @@ START_TEST (test_since_epoch_pass_001)
 }
 END_TEST
 
+/* target:
+ *	pgm_time_t
+ *	pgm_time_from_realtime (
+ *		const pgm_time_t	realtime
+ *		)
+ */
+
+#if defined(HAVE_GETTIMEOFDAY) && defined(HAVE_CLOCK_GETTIME)
+static
+bool
+is_near_now (
+	const pgm_time_t	t
+	)
+{
+	const pgm_time_t now = pgm_time_update_now ();
+	return t <= now && now - t < pgm_msecs (10);
+}
+
+/* system clock stepping backwards after calibration */
+START_TEST (test_from_realtime_pass_001)
+{
+	struct timeval tv;
+	fail_unless (TRUE == pgm_time_init (NULL), "init failed");
+	pgm_time_update_now = pgm_clock_update;
+	gettimeofday (&tv, NULL);
+	pgm_time_t realtime = pgm_secs (tv.tv_sec) + tv.tv_usec;
+	fail_unless (is_near_now (pgm_time_from_realtime (realtime)), "conversion failed");
+	realtime_calibration->realtime += pgm_secs (10);
+	realtime_calibration->now -= pgm_msecs (200);
+	gettimeofday (&tv, NULL);
+	realtime = pgm_secs (tv.tv_sec) + tv.tv_usec;
+	fail_unless (is_near_now (pgm_time_from_realtime (realtime)), "conversion failed");
+	fail_unless (TRUE == pgm_time_shutdown (), "shutdown failed");
+}
+END_TEST
+#endif
+
+#if defined(HAVE_RDTSC) && !defined(_WIN32)
+static char mock_state_dir[] = "/tmp/pgm.time.XXXXXX";
+static char mock_state_path[sizeof(mock_state_dir) + 16];
+
+static
+void
+mock_setup_state (void)
+{
+	g_assert (NULL != mkdtemp (mock_state_dir));
+	g_snprintf (mock_state_path, sizeof(mock_state_path), "%s/pgm-tsc", mock_state_dir);
+	g_setenv ("PGM_TSC_STATE", mock_state_path, TRUE);
+}
+
+static
+void
+mock_teardown_state (void)
+{
+	unlink (mock_state_path);
+	rmdir (mock_state_dir);
+	g_strlcpy (mock_state_dir, "/tmp/pgm.time.XXXXXX", sizeof(mock_state_dir));
+	g_unsetenv ("PGM_TSC_STATE");
+}
+
+/* target:
+ *	char*
+ *	pgm_tsc_state_path (void)
+ */
+
+START_TEST (test_tsc_state_path_pass_001)
+{
+	char* path = pgm_tsc_state_path ();
+	fail_unless (0 == strcmp (mock_state_path, path), "override ignored");
+	pgm_free (path);
+	g_unsetenv ("PGM_TSC_STATE");
+	g_setenv ("XDG_RUNTIME_DIR", "/run/user/1000", TRUE);
+	path = pgm_tsc_state_path ();
+	fail_unless (0 == strcmp ("/run/user/1000/pgm-tsc", path), "unexpected path");
+	pgm_free (path);
+}
+END_TEST
+
+/* no shared default */
+START_TEST (test_tsc_state_path_fail_001)
+{
+	g_unsetenv ("PGM_TSC_STATE");
+	g_unsetenv ("XDG_RUNTIME_DIR");
+	fail_unless (NULL == pgm_tsc_state_path (), "unexpected path");
+}
+END_TEST
+
+/* target:
+ *	void
+ *	pgm_tsc_save_state (const uint_fast32_t khz)
+ *
+ *	uint_fast32_t
+ *	pgm_tsc_load_state (void)
+ */
+
+START_TEST (test_tsc_state_pass_001)
+{
+	struct stat st;
+	fail_unless (0 == pgm_tsc_load_state (), "unexpected state");
+	pgm_tsc_save_state (2400000);
+	fail_unless (0 == stat (mock_state_path, &st), "state not saved");
+	fail_unless (0600 == (st.st_mode & 0777), "state not private");
+	fail_unless (2400000 == pgm_tsc_load_state (), "load failed");
+/* replaced in place */
+	pgm_tsc_save_state (3200000);
+	fail_unless (3200000 == pgm_tsc_load_state (), "load failed");
+}
+END_TEST
+
+/* writable by others */
+START_TEST (test_tsc_state_fail_001)
+{
+	pgm_tsc_save_state (2400000);
+	fail_unless (0 == chmod (mock_state_path, 0666), "chmod failed");
+	fail_unless (0 == pgm_tsc_load_state (), "untrusted state loaded");
+}
+END_TEST
+
+/* symbolic link */
+START_TEST (test_tsc_state_fail_002)
+{
+	char target[sizeof(mock_state_path) + 4];
+	g_snprintf (target, sizeof(target), "%s.bak", mock_state_path);
+	pgm_tsc_save_state (2400000);
+	fail_unless (0 == rename (mock_state_path, target), "rename failed");
+	fail_unless (0 == symlink (target, mock_state_path), "symlink failed");
+	fail_unless (0 == pgm_tsc_load_state (), "symbolic link followed");
+	unlink (target);
+}
+END_TEST
+
+/* different processor */
+START_TEST (test_tsc_state_fail_003)
+{
+	FILE* fp = fopen (mock_state_path, "w");
+	fail_unless (NULL != fp, "fopen failed");
+	fprintf (fp, "00000000 not this processor\t2400000\n");
+	fclose (fp);
+	chmod (mock_state_path, 0600);
+	fail_unless (0 == pgm_tsc_load_state (), "foreign state loaded");
+}
+END_TEST
+
+#	ifdef HAVE_CLOCK_GETTIME
+/* target:
+ *	uint_fast32_t
+ *	pgm_tsc_khz_from_clock (void)
+ */
+
+/* zero when too noisy, otherwise a plausible frequency agreeing with the
+ * kernel calibration if available.
+ */
+START_TEST (test_tsc_khz_from_clock_pass_001)
+{
+	const uint_fast32_t khz = pgm_tsc_khz_from_clock ();
+	g_message ("tsc-khz:%" PRIuFAST32, khz);
+	if (0 == khz)
+		return;
+	fail_unless (khz > 100000 && khz < 10000000, "implausible frequency");
+#		ifdef __linux__
+	const uint_fast32_t kernel_khz = pgm_tsc_khz_from_perf ();
+	g_message ("kernel-tsc-khz:%" PRIuFAST32, kernel_khz);
+	if (kernel_khz > 0)
+		fail_unless (labs ((long)khz - (long)kernel_khz) < (long)(kernel_khz / 100), "disagrees with kernel");
+#		endif
+}
+END_TEST
+#	endif /* HAVE_CLOCK_GETTIME */
+#endif /* HAVE_RDTSC */
+
 
 static
 Suite*
@@ -176,6 +348,29 @@ make_test_suite (void)
 	TCase* tc_since_epoch = tcase_create ("since-epoch");
 	suite_add_tcase (s, tc_since_epoch);
 	tcase_add_test (tc_since_epoch, test_since_epoch_pass_001);
+
+#if defined(HAVE_GETTIMEOFDAY) && defined(HAVE_CLOCK_GETTIME)
+	TCase* tc_from_realtime = tcase_create ("from-realtime");
+	suite_add_tcase (s, tc_from_realtime);
+	tcase_add_test (tc_from_realtime, test_from_realtime_pass_001);
+#endif
+
+#if defined(HAVE_RDTSC) && !defined(_WIN32)
+	TCase* tc_tsc_state = tcase_create ("tsc-state");
+	suite_add_tcase (s, tc_tsc_state);
+	tcase_add_checked_fixture (tc_tsc_state, mock_setup_state, mock_teardown_state);
+	tcase_add_test (tc_tsc_state, test_tsc_state_path_pass_001);
+	tcase_add_test (tc_tsc_state, test_tsc_state_path_fail_001);
+	tcase_add_test (tc_tsc_state, test_tsc_state_pass_001);
+	tcase_add_test (tc_tsc_state, test_tsc_state_fail_001);
+	tcase_add_test (tc_tsc_state, test_tsc_state_fail_002);
+	tcase_add_test (tc_tsc_state, test_tsc_state_fail_003);
+#	ifdef HAVE_CLOCK_GETTIME
+	TCase* tc_tsc_khz_from_clock = tcase_create ("tsc-khz-from-clock");
+	suite_add_tcase (s, tc_tsc_khz_from_clock);
+	tcase_add_test (tc_tsc_khz_from_clock, test_tsc_khz_from_clock_pass_001);
+#	endif
+#endif
 	return s;
 }
 
@@ -22,6 +22,12 @@
 #ifdef HAVE_CONFIG_H
 #	include <config.h>
 #endif
+#ifdef HAVE_TIMERFD_CREATE
+#	include <errno.h>
+#	include <unistd.h>
+#	include <sys/epoll.h>
+#	include <sys/timerfd.h>
+#endif
 #include <impl/i18n.h>
 #include <impl/framework.h>
 #include <impl/timer.h>
@@ -51,7 +57,7 @@ pgm_timer_prepare (
 	pgm_assert (NULL != sock);
 	pgm_assert (sock->can_send_data || sock->can_recv_data);
 
-	now = pgm_time_update_now();
+	now = pgm_time_cached();
 
 	if (sock->can_send_data)
 		expiration = sock->next_ambient_spm;
@@ -78,7 +84,7 @@ pgm_timer_check (
 	pgm_sock_t* const	sock
 	)
 {
-	const pgm_time_t now = pgm_time_update_now();
+	const pgm_time_t now = pgm_time_cached();
 	bool expired;
 
 /* pre-conditions */
@@ -99,7 +105,7 @@ pgm_timer_expiration (
 	pgm_sock_t* const	sock
 	)
 {
-	const pgm_time_t now = pgm_time_update_now();
+	const pgm_time_t now = pgm_time_cached();
 	pgm_time_t expiration;
 
 /* pre-conditions */
@@ -123,7 +129,7 @@ pgm_timer_dispatch (
 	pgm_sock_t* const	sock
 	)
 {
-	const pgm_time_t now = pgm_time_update_now();
+	const pgm_time_t now = pgm_time_cached();
 	pgm_time_t next_expiration = 0;
 
 /* pre-conditions */
@@ -166,10 +172,10 @@ printf ("ACK timeout, T:%u W:%u\n", pgm_fp8tou(sock->tokens), pgm_fp8tou(sock->c
 		}
 
 /* SPM broadcast */
-		pgm_mutex_lock (&sock->timer_mutex);
+		pgm_sock_mutex_lock (sock, &sock->timer_mutex);
 		const unsigned spm_heartbeat_state = sock->spm_heartbeat_state;
 		const pgm_time_t next_heartbeat_spm = sock->next_heartbeat_spm;
-		pgm_mutex_unlock (&sock->timer_mutex);
+		pgm_sock_mutex_unlock (sock, &sock->timer_mutex);
 
 /* no lock needed on ambient */
 		const pgm_time_t next_ambient_spm = sock->next_ambient_spm;
@@ -200,7 +206,7 @@ printf ("ACK timeout, T:%u W:%u\n", pgm_fp8tou(sock->tokens), pgm_fp8tou(sock->c
 				}
 			} while (pgm_time_after_eq (now, new_heartbeat_spm));
 /* check for reset heartbeat */
-			pgm_mutex_lock (&sock->timer_mutex);
+			pgm_sock_mutex_lock (sock, &sock->timer_mutex);
 			if (next_heartbeat_spm == sock->next_heartbeat_spm) {
 				sock->spm_heartbeat_state = new_heartbeat_state;
 				sock->next_heartbeat_spm  = new_heartbeat_spm;
@@ -208,16 +214,16 @@ printf ("ACK timeout, T:%u W:%u\n", pgm_fp8tou(sock->tokens), pgm_fp8tou(sock->c
 			} else
 				next_spm = MIN(sock->next_ambient_spm, sock->next_heartbeat_spm);
 			sock->next_poll = next_expiration > 0 ? MIN(next_expiration, next_spm) : next_spm;
-			pgm_mutex_unlock (&sock->timer_mutex);
+			pgm_sock_mutex_unlock (sock, &sock->timer_mutex);
 			return TRUE;
 		}
 
 		next_expiration = next_expiration > 0 ? MIN(next_expiration, next_spm) : next_spm;
 
 /* check for reset */
-		pgm_mutex_lock (&sock->timer_mutex);
+		pgm_sock_mutex_lock (sock, &sock->timer_mutex);
 		sock->next_poll = sock->next_poll > now ? MIN(sock->next_poll, next_expiration) : next_expiration;
-		pgm_mutex_unlock (&sock->timer_mutex);
+		pgm_sock_mutex_unlock (sock, &sock->timer_mutex);
 	}
 	else
 		sock->next_poll = next_expiration;
@@ -225,4 +231,184 @@ printf ("ACK timeout, T:%u W:%u\n", pgm_fp8tou(sock->tokens), pgm_fp8tou(sock->c
 	return TRUE;
 }
 
+#ifdef HAVE_TIMERFD_CREATE
+/* create the aggregated event socket, an epoll set of the receive socket,
+ * notification channels, and a timerfd following next_poll.
+ *
+ * returns TRUE on success, returns FALSE on failure and sets errno appropriately.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_timer_event_create (
+	pgm_sock_t* const	sock
+	)
+{
+	struct epoll_event event;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (INVALID_SOCKET != sock->recv_sock);
+
+	sock->event_sock = epoll_create1 (EPOLL_CLOEXEC);
+	if (INVALID_SOCKET == sock->event_sock)
+		return FALSE;
+	sock->event_timer = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (-1 == sock->event_timer)
+		goto err_destroy;
+
+/* level-triggered so that unread data and pending peers keep waking */
+	event.events = EPOLLIN;
+	event.data.ptr = sock;
+	if (0 != epoll_ctl (sock->event_sock, EPOLL_CTL_ADD, sock->recv_sock, &event))
+		goto err_destroy;
+	if (sock->can_send_data &&
+	    0 != epoll_ctl (sock->event_sock, EPOLL_CTL_ADD, pgm_notify_get_socket (&sock->rdata_notify), &event))
+		goto err_destroy;
+	if (0 != epoll_ctl (sock->event_sock, EPOLL_CTL_ADD, pgm_notify_get_socket (&sock->pending_notify), &event))
+		goto err_destroy;
+/* congestion tokens returned by an ACK */
+	if (sock->can_send_data && sock->use_pgmcc &&
+	    0 != epoll_ctl (sock->event_sock, EPOLL_CTL_ADD, pgm_notify_get_socket (&sock->ack_notify), &event))
+		goto err_destroy;
+	if (0 != epoll_ctl (sock->event_sock, EPOLL_CTL_ADD, sock->event_timer, &event))
+		goto err_destroy;
+	sock->event_expiry = sock->rate_expiry = 0;
+	return TRUE;
+
+err_destroy:
+	{
+		const int save_errno = errno;
+		pgm_timer_event_destroy (sock);
+		errno = save_errno;
+	}
+	return FALSE;
+}
+
+PGM_GNUC_INTERNAL
+void
+pgm_timer_event_destroy (
+	pgm_sock_t* const	sock
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+
+	if (-1 != sock->event_timer) {
+		close (sock->event_timer);
+		sock->event_timer = -1;
+	}
+	if (INVALID_SOCKET != sock->event_sock) {
+		closesocket (sock->event_sock);
+		sock->event_sock = INVALID_SOCKET;
+	}
+}
+
+/* set the timerfd to the earlier of the next timer and a blocked send being
+ * admitted by the rate limit.  an unchanged expiration is left alone as the
+ * timer is either pending or has fired and remains readable.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_timer_arm (
+	pgm_sock_t* const	sock,
+	const pgm_time_t	rate_expiry
+	)
+{
+	const pgm_time_t now = pgm_time_cached();
+	struct itimerspec value;
+	pgm_time_t expiration, usecs;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (INVALID_SOCKET != sock->event_sock);
+
+	pgm_timer_lock (sock);
+	if (0 != rate_expiry)
+		sock->rate_expiry = rate_expiry;
+	expiration = sock->next_poll;
+	if (pgm_time_after (sock->rate_expiry, now) &&
+	    pgm_time_after (expiration, sock->rate_expiry))
+		expiration = sock->rate_expiry;
+	if (expiration == sock->event_expiry) {
+		pgm_timer_unlock (sock);
+		return;
+	}
+	sock->event_expiry = expiration;
+/* zero disarms the timer */
+	usecs = pgm_time_after (expiration, now) ? pgm_to_usecs (expiration - now) : 1;
+	value.it_interval.tv_sec  = 0;
+	value.it_interval.tv_nsec = 0;
+	value.it_value.tv_sec     = (time_t)(usecs / 1000000UL);
+	value.it_value.tv_nsec    = (long)((usecs % 1000000UL) * 1000UL);
+	timerfd_settime (sock->event_timer, 0, &value, NULL);
+	pgm_timer_unlock (sock);
+}
+
+/* create the rate timer of a sending socket, a one-shot timerfd armed by a
+ * rate limited send.
+ *
+ * returns TRUE on success, returns FALSE on failure and sets errno appropriately.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_timer_rate_create (
+	pgm_sock_t* const	sock
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (-1 == sock->rate_timer);
+
+	sock->rate_timer = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	return (-1 != sock->rate_timer);
+}
+
+PGM_GNUC_INTERNAL
+void
+pgm_timer_rate_destroy (
+	pgm_sock_t* const	sock
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+
+	if (-1 != sock->rate_timer) {
+		close (sock->rate_timer);
+		sock->rate_timer = -1;
+	}
+}
+
+/* arm the rate timer to fire once at send_expiry.  setting the timer resets
+ * the expiration count so the descriptor is unreadable until then, each
+ * blocked send produces one wake-up.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_timer_arm_rate (
+	pgm_sock_t* const	sock,
+	const pgm_time_t	send_expiry
+	)
+{
+	const pgm_time_t now = pgm_time_cached();
+	struct itimerspec value;
+	pgm_time_t usecs;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (-1 != sock->rate_timer);
+
+	sock->send_expiry = send_expiry;
+	usecs = pgm_time_after (send_expiry, now) ? pgm_to_usecs (send_expiry - now) : 1;
+	value.it_interval.tv_sec  = 0;
+	value.it_interval.tv_nsec = 0;
+	value.it_value.tv_sec     = (time_t)(usecs / 1000000UL);
+	value.it_value.tv_nsec    = (long)((usecs % 1000000UL) * 1000UL);
+	timerfd_settime (sock->rate_timer, 0, &value, NULL);
+}
+#endif /* HAVE_TIMERFD_CREATE */
+
 /* eof */
@@ -20,6 +20,7 @@
  */
 
 
+#include <poll.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -55,6 +56,7 @@
 
 static pgm_time_t _mock_pgm_time_update_now(void);
 pgm_time_update_func mock_pgm_time_update_now = _mock_pgm_time_update_now;
+PGM_THREAD_LOCAL struct pgm_time_cache_t pgm_time_cache;
 static pgm_time_t mock_pgm_time_now = 0x1;
 
 
@@ -313,6 +315,59 @@ START_TEST (test_dispatch_fail_001)
 }
 END_TEST
 
+/* target:
+ *	void
+ *	pgm_timer_arm (
+ *		pgm_sock_t*	sock,
+ *		pgm_time_t	rate_expiry
+ *	)
+ */
+
+#ifdef HAVE_TIMERFD_CREATE
+START_TEST (test_arm_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->recv_sock = socket (AF_INET, SOCK_DGRAM, 0);
+	fail_if (INVALID_SOCKET == sock->recv_sock, "socket failed");
+	fail_unless (0 == pgm_notify_init (&sock->pending_notify), "notify_init failed");
+	fail_unless (TRUE == pgm_timer_event_create (sock), "event_create failed");
+	struct pollfd fds = { .fd = sock->event_sock, .events = POLLIN };
+/* expired timer */
+	sock->next_poll = mock_pgm_time_now;
+	pgm_timer_arm (sock, 0);
+	fail_unless (1 == poll (&fds, 1, 100), "expired poll failed");
+/* re-arm clears readiness */
+	sock->next_poll = mock_pgm_time_now + pgm_secs(10);
+	pgm_timer_arm (sock, 0);
+	fail_unless (0 == poll (&fds, 1, 0), "armed poll failed");
+/* rate limit before next timer */
+	pgm_timer_arm (sock, mock_pgm_time_now + pgm_msecs(1));
+	fail_unless (1 == poll (&fds, 1, 100), "rate poll failed");
+	pgm_timer_event_destroy (sock);
+	fail_unless (INVALID_SOCKET == sock->event_sock, "event_destroy failed");
+}
+END_TEST
+
+START_TEST (test_arm_rate_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->rate_timer = -1;
+	fail_unless (TRUE == pgm_timer_rate_create (sock), "rate_create failed");
+	struct pollfd fds = { .fd = sock->rate_timer, .events = POLLIN };
+	fail_unless (0 == poll (&fds, 1, 0), "unarmed poll failed");
+/* one wake-up per blocked send */
+	pgm_timer_arm_rate (sock, mock_pgm_time_now + pgm_msecs(1));
+	fail_unless (1 == poll (&fds, 1, 100), "rate poll failed");
+	pgm_timer_arm_rate (sock, mock_pgm_time_now + pgm_secs(10));
+	fail_unless (0 == poll (&fds, 1, 0), "re-armed poll failed");
+	pgm_timer_rate_destroy (sock);
+	fail_unless (-1 == sock->rate_timer, "rate_destroy failed");
+}
+END_TEST
+#endif
+
 
 static
 Suite*
@@ -349,6 +404,13 @@ make_test_suite (void)
 #ifndef PGM_CHECK_NOFORK
 	tcase_add_test_raise_signal (tc_dispatch, test_dispatch_fail_001, SIGABRT);
 #endif
+
+#ifdef HAVE_TIMERFD_CREATE
+	TCase* tc_arm = tcase_create ("arm");
+	suite_add_tcase (s, tc_arm);
+	tcase_add_test (tc_arm, test_arm_pass_001);
+	tcase_add_test (tc_arm, test_arm_rate_pass_001);
+#endif
 	return s;
 }
 
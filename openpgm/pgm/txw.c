@@ -22,6 +22,14 @@
 #ifdef HAVE_CONFIG_H
 #	include <config.h>
 #endif
+#ifndef _WIN32
+#	include <errno.h>
+#	include <fcntl.h>
+#	include <stdio.h>
+#	include <stdlib.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#endif
 #include <impl/i18n.h>
 #include <impl/framework.h>
 #include <impl/txw.h>
@@ -152,8 +160,12 @@ pgm_txw_retransmit_is_empty (
 /* globals */
 
 static void pgm_txw_remove_tail (pgm_txw_t*const);
-static bool pgm_txw_retransmit_push_parity (pgm_txw_t*const, const uint32_t, const uint8_t);
-static bool pgm_txw_retransmit_push_selective (pgm_txw_t*const, const uint32_t);
+static void pgm_txw_history_append (pgm_txw_t*const restrict, const struct pgm_sk_buff_t*const restrict);
+static struct pgm_sk_buff_t* pgm_txw_history_peek (const pgm_txw_t*const, const uint32_t);
+static void pgm_txw_history_release (pgm_txw_t*const restrict, struct pgm_sk_buff_t*const restrict);
+static void pgm_txw_history_destroy (pgm_txw_t*const);
+static bool pgm_txw_retransmit_push_parity (pgm_txw_t*const, const uint32_t, const uint8_t, const pgm_time_t);
+static bool pgm_txw_retransmit_push_selective (pgm_txw_t*const, const uint32_t, const pgm_time_t);
 
 
 /* constructor for transmit window.  zero-length windows are not permitted.
@@ -250,6 +262,10 @@ pgm_txw_shutdown (
 
 	pgm_debug ("shutdown (window:%p)", (const void*)window);
 
+/* history first to not append the window contents */
+	if (NULL != window->history)
+		pgm_txw_history_destroy (window);
+
 /* contents of window */
 	while (!pgm_txw_is_empty (window)) {
 		pgm_txw_remove_tail (window);
@@ -274,6 +290,260 @@ pgm_txw_shutdown (
 	pgm_free (window);
 }
 
+/* history slot of one TPDU, followed by the PGM header and options then the
+ * TSDU.
+ */
+
+struct pgm_txw_history_record_t {
+	struct pgm_sk_buff_t*	skb;			/* rebuilt for repair, or NULL */
+	uint32_t		sequence;
+	uint32_t		unfolded_checksum;
+	uint16_t		header_len;		/* PGM header and options */
+	uint16_t		len;			/* TSDU */
+	uint16_t		opt_fragment;		/* offset from header, zero if none */
+};
+
+#define PGM_TXW_HISTORY_SLOT_LEN(tpdu_size) \
+	((sizeof(struct pgm_txw_history_record_t) + (tpdu_size) + 7) & ~(size_t)7)
+
+static inline
+struct pgm_txw_history_record_t*
+_pgm_txw_history_record (
+	const pgm_txw_history_t*const	history,
+	const uint32_t			sequence
+	)
+{
+	const uint_fast32_t index_ = sequence % history->alloc;
+	return (struct pgm_txw_history_record_t*)(history->base + index_ * history->slot_len);
+}
+
+/* extend the window with a repair history of sqns sequence numbers following
+ * the trail, held in an unlinked file in PGM_HISTORY_DIR, by default the system
+ * temporary directory.  the file is fully allocated up front such that evicting
+ * TPDUs to a full file system cannot fault.  must be called on an empty window.
+ *
+ * returns TRUE on success, returns FALSE on failure with errno set.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_txw_history_create (
+	pgm_txw_t*const		window,
+	const uint16_t		tpdu_size,
+	const uint32_t		sqns		/* history size in sequence numbers */
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != window);
+	pgm_assert (NULL == window->history);
+	pgm_assert (pgm_txw_is_empty (window));
+	pgm_assert_cmpuint (tpdu_size, >, 0);
+	pgm_assert_cmpuint (sqns, >, 0);
+	pgm_assert_cmpuint (sqns & PGM_UINT32_SIGN_BIT, ==, 0);
+
+	pgm_debug ("history_create (window:%p max-tpdu:%" PRIu16 " sqns:%" PRIu32 ")",
+		(const void*)window, tpdu_size, sqns);
+
+#ifndef _WIN32
+	const size_t slot_len = PGM_TXW_HISTORY_SLOT_LEN(tpdu_size);
+	const size_t length   = (size_t)sqns * slot_len;
+	char path[1024];
+	char* dir;
+	size_t envlen;
+	void* base;
+	int fd, save_errno;
+
+	if (PGM_UNLIKELY(length / slot_len != sqns)) {
+		errno = ENOMEM;
+		return FALSE;
+	}
+	const errno_t err = pgm_dupenv_s (&dir, &envlen, "PGM_HISTORY_DIR");
+	if (0 != err || 0 == envlen)
+		dir = pgm_strdup (P_tmpdir);
+	pgm_snprintf_s (path, sizeof (path), _TRUNCATE, "%s/pgm-history-XXXXXX", dir);
+	pgm_free (dir);
+	fd = mkstemp (path);
+	if (-1 == fd)
+		return FALSE;
+	unlink (path);
+#	ifdef HAVE_POSIX_FALLOCATE
+	save_errno = posix_fallocate (fd, 0, (off_t)length);
+#	else
+	save_errno = (0 == ftruncate (fd, length)) ? 0 : errno;
+#	endif
+	if (0 != save_errno) {
+		close (fd);
+		errno = save_errno;
+		return FALSE;
+	}
+	base = mmap (NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (MAP_FAILED == base) {
+		save_errno = errno;
+		close (fd);
+		errno = save_errno;
+		return FALSE;
+	}
+	window->history = pgm_new0 (pgm_txw_history_t, 1);
+	window->history->fd		= fd;
+	window->history->base		= base;
+	window->history->slot_len	= slot_len;
+	window->history->alloc		= sqns;
+	window->history->trail		= window->trail;
+	return TRUE;
+#else
+	errno = ENOSYS;
+	return FALSE;
+#endif /* _WIN32 */
+}
+
+/* remove the oldest TPDU of the history, cancelling any pending repair.
+ */
+
+static
+void
+pgm_txw_history_remove_tail (
+	pgm_txw_t* const	window
+	)
+{
+	pgm_txw_history_t* history = window->history;
+	struct pgm_txw_history_record_t* record;
+
+/* pre-conditions */
+	pgm_assert (NULL != history);
+	pgm_assert (history->trail != window->trail);
+
+	record = _pgm_txw_history_record (history, history->trail);
+	if (NULL != record->skb) {
+		pgm_txw_state_t* state = (pgm_txw_state_t*)&record->skb->cb;
+		if (state->waiting_retransmit) {
+			pgm_queue_unlink (&window->retransmit_queue, (pgm_list_t*)record->skb);
+			state->waiting_retransmit = 0;
+		}
+		pgm_free_skb (record->skb);
+		record->skb = NULL;
+	}
+	pgm_atomic_inc32 (&history->trail);
+}
+
+static
+void
+pgm_txw_history_destroy (
+	pgm_txw_t* const	window
+	)
+{
+	pgm_txw_history_t* history = window->history;
+
+/* pre-conditions */
+	pgm_assert (NULL != history);
+
+	while (history->trail != window->trail)
+		pgm_txw_history_remove_tail (window);
+#ifndef _WIN32
+	munmap (history->base, (size_t)history->alloc * history->slot_len);
+	close (history->fd);
+#endif
+	pgm_free (history);
+	window->history = NULL;
+}
+
+/* copy the TPDU leaving the trail of the window to the history.
+ */
+
+static
+void
+pgm_txw_history_append (
+	pgm_txw_t*		    const restrict window,
+	const struct pgm_sk_buff_t* const restrict skb
+	)
+{
+	pgm_txw_history_t* history = window->history;
+	struct pgm_txw_history_record_t* record;
+
+/* pre-conditions */
+	pgm_assert (NULL != history);
+	pgm_assert (NULL != skb);
+	pgm_assert_cmpuint (skb->sequence, ==, window->trail);
+
+/* history full */
+	if (window->trail - history->trail == history->alloc)
+		pgm_txw_history_remove_tail (window);
+
+	const uint16_t header_len = pgm_skb_tpdu_length (skb) - skb->len;
+	pgm_assert_cmpuint (sizeof(struct pgm_txw_history_record_t) + header_len + skb->len, <=, history->slot_len);
+
+	record = _pgm_txw_history_record (history, skb->sequence);
+	pgm_assert (NULL == record->skb);
+	record->sequence		= skb->sequence;
+	record->unfolded_checksum	= pgm_txw_get_unfolded_checksum (skb);
+	record->header_len		= header_len;
+	record->len			= skb->len;
+	record->opt_fragment		= NULL == skb->pgm_opt_fragment ? 0 : (uint16_t)((const char*)skb->pgm_opt_fragment - (const char*)skb->pgm_header);
+	memcpy (record + 1, skb->pgm_header, header_len);
+	memcpy ((char*)(record + 1) + header_len, skb->data, skb->len);
+}
+
+/* rebuild an skb from the history, held by the history slot until released
+ * after retransmission or the slot is removed.
+ *
+ * returns pointer to skbuff, returns NULL if not in history.
+ */
+
+static
+struct pgm_sk_buff_t*
+pgm_txw_history_peek (
+	const pgm_txw_t*const	window,
+	const uint32_t		sequence
+	)
+{
+	const pgm_txw_history_t* history = window->history;
+	struct pgm_txw_history_record_t* record;
+	struct pgm_sk_buff_t* skb;
+	pgm_txw_state_t* state;
+
+	if (NULL == history ||
+	    !pgm_uint32_gte (sequence, history->trail) ||
+	    !pgm_uint32_lt (sequence, window->trail))
+		return NULL;
+
+	record = _pgm_txw_history_record (history, sequence);
+	pgm_assert_cmpuint (record->sequence, ==, sequence);
+	if (NULL != record->skb)
+		return record->skb;
+
+	skb = pgm_alloc_skb (record->header_len + record->len);
+	pgm_skb_reserve (skb, record->header_len);
+	memcpy (skb->head, record + 1, record->header_len);
+	memcpy (pgm_skb_put (skb, record->len), (const char*)(record + 1) + record->header_len, record->len);
+	skb->sequence	= sequence;
+	skb->pgm_header	= skb->head;
+	skb->pgm_data	= (void*)(skb->pgm_header + 1);
+	if (record->opt_fragment)
+		skb->pgm_opt_fragment = (void*)((char*)skb->head + record->opt_fragment);
+	state = (pgm_txw_state_t*)&skb->cb;
+	state->unfolded_checksum = record->unfolded_checksum;
+	state->is_history = 1;
+	record->skb = skb;
+	return skb;
+}
+
+static
+void
+pgm_txw_history_release (
+	pgm_txw_t*	      const restrict window,
+	struct pgm_sk_buff_t* const restrict skb
+	)
+{
+	struct pgm_txw_history_record_t* record;
+
+/* pre-conditions */
+	pgm_assert (NULL != window->history);
+
+	record = _pgm_txw_history_record (window->history, skb->sequence);
+	pgm_assert (skb == record->skb);
+	record->skb = NULL;
+	pgm_free_skb (skb);
+}
+
 /* add skb to transmit window, taking ownership.  window does not grow.
  * PGM skbuff data/tail pointers must point to the PGM payload, and hence skb->len
  * is allowed to be zero.
@@ -304,8 +574,8 @@ pgm_txw_add (
 	pgm_assert (((const pgm_list_t*)skb)->next == NULL);
 	pgm_assert (((const pgm_list_t*)skb)->prev == NULL);
 	pgm_assert (pgm_tsi_is_null (&skb->tsi));
-	pgm_assert ((char*)skb->data > (char*)skb->head);
-	pgm_assert ((sizeof(struct pgm_header) + sizeof(struct pgm_data)) <= (size_t)((char*)skb->data - (char*)skb->head));
+	pgm_assert (NULL != skb->ref || (char*)skb->data > (char*)skb->head);
+	pgm_assert ((sizeof(struct pgm_header) + sizeof(struct pgm_data)) <= (size_t)(pgm_skb_tpdu_length (skb) - skb->len));
 
 	pgm_debug ("add (window:%p skb:%p)", (const void*)window, (const void*)skb);
 
@@ -331,7 +601,8 @@ pgm_txw_add (
 	pgm_assert_cmpuint (pgm_txw_length (window), <=, pgm_txw_max_length (window));
 }
 
-/* peek an entry from the window for retransmission.
+/* peek an entry from the window for retransmission, falling back to the
+ * history.
  *
  * returns pointer to skbuff on success, returns NULL on invalid parameters.
  */
@@ -345,7 +616,10 @@ pgm_txw_peek (
 {
 	pgm_debug ("peek (window:%p sequence:%" PRIu32 ")",
 		(const void*)window, sequence);
-	return _pgm_txw_peek (window, sequence);
+	struct pgm_sk_buff_t* skb = _pgm_txw_peek (window, sequence);
+	if (NULL == skb && NULL != window->history)
+		skb = pgm_txw_history_peek (window, sequence);
+	return skb;
 }
 
 /* remove an entry from the trailing edge of the transmit window.
@@ -386,6 +660,10 @@ pgm_txw_remove_tail (
 		PGM_HISTOGRAM_COUNTS("Tx.NakEliminationCount", state->nak_elimination_count);
 	}
 
+/* keep a copy for repairs */
+	if (NULL != window->history)
+		pgm_txw_history_append (window, skb);
+
 /* remove reference to skb */
 	if (PGM_UNLIKELY(pgm_mem_gc_friendly)) {
 		const uint_fast32_t index_ = skb->sequence % pgm_txw_max_length (window);
@@ -409,6 +687,8 @@ pgm_txw_remove_tail (
  * transmisison group.  Parity NAKs are ignored if the packet count is
  * less than or equal to the count already queued for retransmission.
  *
+ * nak_tstamp is kept with a new request for service time statistics.
+ *
  * returns FALSE if request was eliminated, returns TRUE if request was
  * added to queue.
  */
@@ -419,7 +699,8 @@ pgm_txw_retransmit_push (
 	pgm_txw_t* const	window,
 	const uint32_t		sequence,
 	const bool		is_parity,	/* parity NAK ⇒ sequence_number = transmission group | packet count */
-	const uint8_t		tg_sqn_shift
+	const uint8_t		tg_sqn_shift,
+	const pgm_time_t	nak_tstamp	/* 0 = not a NAK */
 	)
 {
 /* pre-conditions */
@@ -435,11 +716,11 @@ pgm_txw_retransmit_push (
 
 	if (is_parity)
 	{
-		return pgm_txw_retransmit_push_parity (window, sequence, tg_sqn_shift);
+		return pgm_txw_retransmit_push_parity (window, sequence, tg_sqn_shift, nak_tstamp);
 	}
 	else
 	{
-		return pgm_txw_retransmit_push_selective (window, sequence);
+		return pgm_txw_retransmit_push_selective (window, sequence, nak_tstamp);
 	}
 }
 
@@ -448,7 +729,8 @@ bool
 pgm_txw_retransmit_push_parity (
 	pgm_txw_t* const	window,
 	const uint32_t		sequence,
-	const uint8_t		tg_sqn_shift
+	const uint8_t		tg_sqn_shift,
+	const pgm_time_t	nak_tstamp
 	)
 {
 	struct pgm_sk_buff_t	*skb;
@@ -495,6 +777,7 @@ pgm_txw_retransmit_push_parity (
 	pgm_queue_push_head_link (&window->retransmit_queue, (pgm_list_t*)skb);
 	pgm_assert (!pgm_queue_is_empty (&window->retransmit_queue));
 	state->waiting_retransmit = 1;
+	state->nak_tstamp = nak_tstamp;
 	return TRUE;
 }
 
@@ -502,7 +785,8 @@ static
 bool
 pgm_txw_retransmit_push_selective (
 	pgm_txw_t* const	window,
-	const uint32_t		sequence
+	const uint32_t		sequence,
+	const pgm_time_t	nak_tstamp
 	)
 {
 	struct pgm_sk_buff_t	*skb;
@@ -512,6 +796,8 @@ pgm_txw_retransmit_push_selective (
 	pgm_assert (NULL != window);
 
 	skb = _pgm_txw_peek (window, sequence);
+	if (NULL == skb && NULL != window->history)
+		skb = pgm_txw_history_peek (window, sequence);
 	if (NULL == skb) {
 		pgm_trace (PGM_LOG_ROLE_TX_WINDOW,_("Requested packet #%" PRIu32 " not in window."), sequence);
 		return FALSE;
@@ -535,6 +821,7 @@ pgm_txw_retransmit_push_selective (
 	pgm_queue_push_head_link (&window->retransmit_queue, (pgm_list_t*)skb);
 	pgm_assert (!pgm_queue_is_empty (&window->retransmit_queue));
 	state->waiting_retransmit = 1;
+	state->nak_tstamp = nak_tstamp;
 	return TRUE;
 }
 
@@ -741,10 +1028,13 @@ pgm_txw_retransmit_try_peek (
 }
 
 /* remove head entry from retransmit queue, will fail on assertion if queue is empty.
+ *
+ * returns the NAK time stamp of a completed request, or 0 if parity packets
+ * remain to be sent or the request was not from a NAK.
  */
 
 PGM_GNUC_INTERNAL
-void
+pgm_time_t
 pgm_txw_retransmit_remove_head (
 	pgm_txw_t* const	window
 	)
@@ -768,6 +1058,7 @@ pgm_txw_retransmit_remove_head (
 		pgm_assert (((const pgm_list_t*)skb)->next == NULL);
 		pgm_assert (((const pgm_list_t*)skb)->prev == NULL);
 	}
+	const pgm_time_t nak_tstamp = state->nak_tstamp;
 	if (state->pkt_cnt_requested)
 	{
 		state->pkt_cnt_sent++;
@@ -776,12 +1067,18 @@ pgm_txw_retransmit_remove_head (
 		if (state->pkt_cnt_sent == state->pkt_cnt_requested) {
 			pgm_queue_pop_tail_link (&window->retransmit_queue);
 			state->waiting_retransmit = 0;
+			return nak_tstamp;
 		}
+		return 0;
 	}
 	else	/* selective request */
 	{
 		pgm_queue_pop_tail_link (&window->retransmit_queue);
 		state->waiting_retransmit = 0;
+/* rebuilt history is only held until repaired */
+		if (state->is_history)
+			pgm_txw_history_release (window, skb);
+		return nak_tstamp;
 	}
 }
 
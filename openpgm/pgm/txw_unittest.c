@@ -23,6 +23,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <check.h>
 #include <glib.h>
 
@@ -267,6 +268,50 @@ START_TEST (test_add_pass_001)
 }
 END_TEST
 
+/* external payload released on window shutdown */
+static
+void
+release_payload (
+	void*		buffer,
+	void*		user_data
+	)
+{
+	(*(int*)user_data)++;
+}
+
+START_TEST (test_add_pass_002)
+{
+	const pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const guint16 tsdu_length = 1000;
+	const guint16 header_length = sizeof(struct pgm_header) + sizeof(struct pgm_data);
+	static char payload[1000];
+	int released = 0;
+	pgm_txw_t* window = pgm_txw_create (&tsi, 0, 100, 0, 0, FALSE, 0, 0);
+	fail_if (NULL == window, "create failed");
+	struct pgm_skb_ref_t* ref = pgm_new0 (struct pgm_skb_ref_t, 1);
+	ref->users = 1;
+	ref->release = release_payload;
+	ref->buffer = payload;
+	ref->user_data = &released;
+	struct pgm_sk_buff_t* skb = pgm_alloc_skb (header_length);
+	skb->sock = (pgm_sock_t*)0x1;
+	skb->tstamp = 1;
+	pgm_skb_reserve (skb, header_length);
+	memset (skb->head, 0, header_length);
+	skb->pgm_header = (struct pgm_header*)skb->head;
+	skb->pgm_data   = (struct pgm_data*)(skb->pgm_header + 1);
+	skb->pgm_header->pgm_type = PGM_ODATA;
+	skb->pgm_header->pgm_tsdu_length = g_htons (tsdu_length);
+	pgm_skb_attach_ref (skb, ref, payload, tsdu_length);
+	fail_unless ((guint)(header_length + tsdu_length) == pgm_skb_tpdu_length (skb), "tpdu_length failed");
+	pgm_txw_add (window, skb);
+	pgm_skb_ref_put (ref);
+	fail_unless (0 == released, "released early");
+	pgm_txw_shutdown (window);
+	fail_unless (1 == released, "release failed");
+}
+END_TEST
+
 /* null skb */
 START_TEST (test_add_fail_001)
 {
@@ -322,6 +367,79 @@ START_TEST (test_peek_pass_001)
 }
 END_TEST
 
+/* target:
+ *	bool
+ *	pgm_txw_history_create (
+ *		pgm_txw_t* const	window,
+ *		const uint16_t		tpdu_size,
+ *		const uint32_t		sqns
+ *		)
+ */
+
+/* history file space is allocated on creation */
+START_TEST (test_history_create_pass_001)
+{
+	const pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	pgm_txw_t* window = pgm_txw_create (&tsi, 0, 4, 0, 0, FALSE, 0, 0);
+	fail_if (NULL == window, "create failed");
+	fail_unless (TRUE == pgm_txw_history_create (window, 1500, 64), "history_create failed");
+	struct stat buf;
+	fail_unless (0 == fstat (window->history->fd, &buf), "fstat failed");
+	fail_unless ((size_t)buf.st_size == 64 * window->history->slot_len, "size failed");
+#ifdef HAVE_POSIX_FALLOCATE
+	fail_unless ((size_t)buf.st_blocks * 512 >= (size_t)buf.st_size, "allocation failed");
+#endif
+	pgm_txw_shutdown (window);
+}
+END_TEST
+
+/* history directory is unusable */
+START_TEST (test_history_create_fail_001)
+{
+	const pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	pgm_txw_t* window = pgm_txw_create (&tsi, 0, 4, 0, 0, FALSE, 0, 0);
+	fail_if (NULL == window, "create failed");
+	g_setenv ("PGM_HISTORY_DIR", "/nonexistent/pgm", TRUE);
+	fail_unless (FALSE == pgm_txw_history_create (window, 1500, 4), "history_create succeeded");
+	g_unsetenv ("PGM_HISTORY_DIR");
+	fail_unless (NULL == window->history, "history created");
+	pgm_txw_shutdown (window);
+}
+END_TEST
+
+/* sequence evicted from the window rebuilt from history */
+START_TEST (test_peek_pass_002)
+{
+	const pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	pgm_txw_t* window = pgm_txw_create (&tsi, 0, 4, 0, 0, FALSE, 0, 0);
+	fail_if (NULL == window, "create failed");
+	fail_unless (TRUE == pgm_txw_history_create (window, 1500, 4), "history_create failed");
+	for (guint i = 0; i < 8; i++) {
+		struct pgm_sk_buff_t* skb = generate_valid_skb ();
+		fail_if (NULL == skb, "generate_valid_skb failed");
+		memset (skb->data, i, skb->len);
+		pgm_txw_set_unfolded_checksum (skb, i);
+		pgm_txw_add (window, skb);
+	}
+	fail_unless (4 == pgm_txw_trail (window), "trail failed");
+	fail_unless (0 == pgm_txw_repair_trail (window), "repair_trail failed");
+	struct pgm_sk_buff_t* skb = pgm_txw_peek (window, 1);
+	fail_if (NULL == skb, "peek failed");
+	fail_unless (1 == skb->sequence, "sequence failed");
+	fail_unless (1000 == skb->len, "len failed");
+	fail_unless (1 == ((guint8*)skb->data)[0] && 1 == ((guint8*)skb->data)[999], "data failed");
+	fail_unless (1 == pgm_txw_get_unfolded_checksum (skb), "unfolded_checksum failed");
+	fail_unless (pgm_skb_tpdu_length (skb) - skb->len == sizeof(struct pgm_header) + sizeof(struct pgm_data), "tpdu_length failed");
+	fail_unless (skb == pgm_txw_peek (window, 1), "peek failed");
+/* evicted from history */
+	struct pgm_sk_buff_t* skb2 = generate_valid_skb ();
+	pgm_txw_add (window, skb2);
+	fail_unless (1 == pgm_txw_repair_trail (window), "repair_trail failed");
+	fail_unless (NULL == pgm_txw_peek (window, 0), "peek failed");
+	pgm_txw_shutdown (window);
+}
+END_TEST
+
 /* null window */
 START_TEST (test_peek_fail_001)
 {
@@ -536,7 +654,8 @@ END_TEST
  *		pgm_txw_t* const	window,
  *		const uint32_t		sequence,
  *		const bool		is_parity,
- *		const uint8_t		tg_sqn_shift
+ *		const uint8_t		tg_sqn_shift,
+ *		const pgm_time_t	nak_tstamp
  *		)
  */
 
@@ -546,21 +665,21 @@ START_TEST (test_retransmit_push_pass_001)
 	pgm_txw_t* window = pgm_txw_create (&tsi, 0, 100, 0, 0, FALSE, 0, 0);
 	fail_if (NULL == window, "create failed");
 /* empty window invalidates all requests */
-	fail_unless (FALSE == pgm_txw_retransmit_push (window, window->trail, FALSE, 0), "retransmit_push failed");
+	fail_unless (FALSE == pgm_txw_retransmit_push (window, window->trail, FALSE, 0, 0), "retransmit_push failed");
 	struct pgm_sk_buff_t* skb = generate_valid_skb ();
 	fail_if (NULL == skb, "generate_valid_skb failed");
 	pgm_txw_add (window, skb);
 /* first request */
-	fail_unless (TRUE == pgm_txw_retransmit_push (window, window->trail, FALSE, 0), "retransmit_push failed");
+	fail_unless (TRUE == pgm_txw_retransmit_push (window, window->trail, FALSE, 0, 0), "retransmit_push failed");
 /* second request eliminated */
-	fail_unless (FALSE == pgm_txw_retransmit_push (window, window->trail, FALSE, 0), "retransmit_push failed");
+	fail_unless (FALSE == pgm_txw_retransmit_push (window, window->trail, FALSE, 0, 0), "retransmit_push failed");
 	pgm_txw_shutdown (window);
 }
 END_TEST
 
 START_TEST (test_retransmit_push_fail_001)
 {
-	const bool answer = pgm_txw_retransmit_push (NULL, 0, FALSE, 0);
+	const bool answer = pgm_txw_retransmit_push (NULL, 0, FALSE, 0, 0);
 	fail ("reached");
 }
 END_TEST
@@ -580,7 +699,7 @@ START_TEST (test_retransmit_try_peek_pass_001)
 	struct pgm_sk_buff_t* skb = generate_valid_skb ();
 	fail_if (NULL == skb, "generate_valid_skb failed");
 	pgm_txw_add (window, skb);
-	fail_unless (1 == pgm_txw_retransmit_push (window, window->trail, FALSE, 0), "retransmit_push failed");
+	fail_unless (1 == pgm_txw_retransmit_push (window, window->trail, FALSE, 0, 0), "retransmit_push failed");
 	fail_unless (NULL != pgm_txw_retransmit_try_peek (window), "retransmit_try_peek failed");
 	pgm_txw_shutdown (window);
 }
@@ -595,7 +714,7 @@ START_TEST (test_retransmit_try_peek_fail_001)
 END_TEST
 
 /* target:
- *	void
+ *	pgm_time_t
  *	pgm_txw_retransmit_remove_head (
  *		pgm_txw_t* const	window
  *		)
@@ -609,9 +728,29 @@ START_TEST (test_retransmit_remove_head_pass_001)
 	struct pgm_sk_buff_t* skb = generate_valid_skb ();
 	fail_if (NULL == skb, "generate_valid_skb failed");
 	pgm_txw_add (window, skb);
-	fail_unless (1 == pgm_txw_retransmit_push (window, window->trail, FALSE, 0), "retransmit_push failed");
+	fail_unless (1 == pgm_txw_retransmit_push (window, window->trail, FALSE, 0, 1000), "retransmit_push failed");
 	fail_unless (NULL != pgm_txw_retransmit_try_peek (window), "retransmit_try_peek failed");
+	fail_unless (1000 == pgm_txw_retransmit_remove_head (window), "retransmit_remove_head failed");
+	pgm_txw_shutdown (window);
+}
+END_TEST
+
+/* repair from history */
+START_TEST (test_retransmit_remove_head_pass_002)
+{
+	const pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	pgm_txw_t* window = pgm_txw_create (&tsi, 0, 1, 0, 0, FALSE, 0, 0);
+	fail_if (NULL == window, "create failed");
+	fail_unless (TRUE == pgm_txw_history_create (window, 1500, 4), "history_create failed");
+	pgm_txw_add (window, generate_valid_skb ());
+	pgm_txw_add (window, generate_valid_skb ());
+	fail_unless (1 == pgm_txw_retransmit_push (window, 0, FALSE, 0, 0), "retransmit_push failed");
+	fail_unless (0 == pgm_txw_retransmit_push (window, 0, FALSE, 0, 0), "retransmit_push not eliminated");
+	struct pgm_sk_buff_t* skb = pgm_txw_retransmit_try_peek (window);
+	fail_if (NULL == skb, "retransmit_try_peek failed");
+	fail_unless (0 == skb->sequence, "sequence failed");
 	pgm_txw_retransmit_remove_head (window);
+	fail_unless (pgm_txw_retransmit_is_empty (window), "retransmit_is_empty failed");
 	pgm_txw_shutdown (window);
 }
 END_TEST
@@ -666,15 +805,22 @@ make_test_suite (void)
 	TCase* tc_add = tcase_create ("add");
 	suite_add_tcase (s, tc_add);
 	tcase_add_test (tc_add, test_add_pass_001);
+	tcase_add_test (tc_add, test_add_pass_002);
 #ifndef PGM_CHECK_NOFORK
 	tcase_add_test_raise_signal (tc_add, test_add_fail_001, SIGABRT);
 	tcase_add_test_raise_signal (tc_add, test_add_fail_002, SIGABRT);
 	tcase_add_test_raise_signal (tc_add, test_add_fail_003, SIGABRT);
 #endif
 
+	TCase* tc_history_create = tcase_create ("history-create");
+	suite_add_tcase (s, tc_history_create);
+	tcase_add_test (tc_history_create, test_history_create_pass_001);
+	tcase_add_test (tc_history_create, test_history_create_fail_001);
+
 	TCase* tc_peek = tcase_create ("peek");
 	suite_add_tcase (s, tc_peek);
 	tcase_add_test (tc_peek, test_peek_pass_001);
+	tcase_add_test (tc_peek, test_peek_pass_002);
 #ifndef PGM_CHECK_NOFORK
 	tcase_add_test_raise_signal (tc_peek, test_peek_fail_001, SIGABRT);
 #endif
@@ -753,6 +899,7 @@ make_test_suite (void)
 	TCase* tc_retransmit_remove_head = tcase_create ("retransmit-remove-head");
 	suite_add_tcase (s, tc_retransmit_remove_head);
 	tcase_add_test (tc_retransmit_remove_head, test_retransmit_remove_head_pass_001);
+	tcase_add_test (tc_retransmit_remove_head, test_retransmit_remove_head_pass_002);
 #ifndef PGM_CHECK_NOFORK
 	tcase_add_test_raise_signal (tc_retransmit_remove_head, test_retransmit_remove_head_fail_001, SIGABRT);
 	tcase_add_test_raise_signal (tc_retransmit_remove_head, test_retransmit_remove_head_fail_002, SIGABRT);